@@ -0,0 +1,56 @@
+/*
+ *  arch/arm/include/asm/dma-contiguous.h
+ *
+ *  Contiguous DMA area shared with the page allocator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_DMA_CONTIGUOUS_H
+#define __ASM_ARM_DMA_CONTIGUOUS_H
+
+#include <linux/mmzone.h>
+
+struct device;
+struct page;
+
+#ifdef CONFIG_CMA
+
+extern void dma_contiguous_reserve(pg_data_t *pgdat, unsigned long start_pfn,
+				   unsigned long end_pfn);
+extern int dma_contiguous_usable(u64 mask);
+extern struct page *dma_alloc_from_contiguous(struct device *dev, int count,
+					      unsigned int order);
+extern int dma_release_from_contiguous(struct device *dev, struct page *pages,
+				       int count);
+
+#else
+
+static inline void dma_contiguous_reserve(pg_data_t *pgdat,
+					  unsigned long start_pfn,
+					  unsigned long end_pfn)
+{
+}
+
+static inline int dma_contiguous_usable(u64 mask)
+{
+	return 0;
+}
+
+static inline struct page *dma_alloc_from_contiguous(struct device *dev,
+						     int count,
+						     unsigned int order)
+{
+	return NULL;
+}
+
+static inline int dma_release_from_contiguous(struct device *dev,
+					      struct page *pages, int count)
+{
+	return 0;
+}
+
+#endif
+
+#endif
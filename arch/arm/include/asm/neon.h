@@ -0,0 +1,24 @@
+/*
+ *  linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Use of NEON from kernel mode is bracketed by kernel_neon_begin() and
+ * kernel_neon_end().  Process context only: the VFP/NEON state of whichever
+ * task owns the hardware is saved first and reloaded lazily, and preemption
+ * stays disabled in between.  Interrupt handlers must not use NEON.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif
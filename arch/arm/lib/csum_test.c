@@ -0,0 +1,231 @@
+/*
+ *  linux/arch/arm/lib/csum_test.c
+ *
+ *  csum_partial() / csum_partial_copy_nocheck() test and benchmark
+ *
+ *  Every source and destination alignment within a word pair is combined
+ *  with all lengths up to TEST_SHORT_LEN plus a set of random longer ones,
+ *  and the results are checked against a byte-at-a-time C reference.  Each
+ *  case is run twice: from process context, where the NEON code is used if
+ *  configured, and with bottom halves disabled, which forces the scalar
+ *  code.  The throughput of both paths is then reported for a few typical
+ *  packet sizes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <asm/checksum.h>
+
+#define TEST_SHORT_LEN	400
+#define TEST_MAX_LEN	9000
+#define TEST_GUARD	16
+#define TEST_POISON	0xa5
+#define TEST_BUF_LEN	(TEST_MAX_LEN + 8 + TEST_GUARD)
+
+static unsigned int rounds = 500;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Random long buffers to check per alignment pair");
+
+static unsigned int bench_mb = 32;
+module_param(bench_mb, uint, 0444);
+MODULE_PARM_DESC(bench_mb, "Megabytes to checksum per benchmark run");
+
+static unsigned int seed;
+module_param(seed, uint, 0444);
+MODULE_PARM_DESC(seed, "Random seed (0 picks one)");
+
+static u8 *src_buf, *dst_buf;
+
+/* One's complement sum of @len bytes plus @sum, reduced mod 0xffff */
+static u32 ref_csum(const u8 *p, int len, u32 sum)
+{
+	u64 acc = sum;
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		acc += p[i] | (p[i + 1] << 8);
+	if (len & 1)
+		acc += p[len - 1];
+
+	return do_div(acc, 0xffff);
+}
+
+static inline u32 csum_mod(__wsum sum)
+{
+	return (__force u32)sum % 0xffff;
+}
+
+static int test_one(int soff, int doff, int len, int bh)
+{
+	const u8 *src = src_buf + soff;
+	u8 *dst = dst_buf + doff;
+	u32 init = random32();
+	u32 want = ref_csum(src, len, init % 0xffff);
+	__wsum got, got_copy;
+	int i;
+
+	memset(dst_buf, TEST_POISON, TEST_BUF_LEN);
+
+	if (bh)
+		local_bh_disable();
+	got = csum_partial(src, len, (__force __wsum)init);
+	got_copy = csum_partial_copy_nocheck(src, dst, len,
+					     (__force __wsum)init);
+	if (bh)
+		local_bh_enable();
+
+	if (csum_mod(got) != want) {
+		printk(KERN_ERR "csum_test: csum_partial src+%d len %d%s: "
+		       "%08x, want %04x\n", soff, len, bh ? " (bh)" : "",
+		       (__force u32)got, want);
+		return 1;
+	}
+	if (csum_mod(got_copy) != want) {
+		printk(KERN_ERR "csum_test: csum_partial_copy src+%d dst+%d "
+		       "len %d%s: %08x, want %04x\n", soff, doff, len,
+		       bh ? " (bh)" : "", (__force u32)got_copy, want);
+		return 1;
+	}
+	if (memcmp(dst, src, len)) {
+		printk(KERN_ERR "csum_test: csum_partial_copy src+%d dst+%d "
+		       "len %d%s: bad copy\n", soff, doff, len,
+		       bh ? " (bh)" : "");
+		return 1;
+	}
+	for (i = 0; i < doff; i++)
+		if (dst_buf[i] != TEST_POISON)
+			goto clobbered;
+	for (i = doff + len; i < doff + len + TEST_GUARD; i++)
+		if (dst_buf[i] != TEST_POISON)
+			goto clobbered;
+	return 0;
+
+clobbered:
+	printk(KERN_ERR "csum_test: csum_partial_copy src+%d dst+%d len %d%s: "
+	       "wrote outside the destination\n", soff, doff, len,
+	       bh ? " (bh)" : "");
+	return 1;
+}
+
+static unsigned int test_correctness(void)
+{
+	unsigned int fails = 0;
+	int soff, doff, len, bh, n;
+
+	for (soff = 0; soff < 8; soff++) {
+		for (doff = 0; doff < 8; doff++) {
+			for (bh = 0; bh < 2; bh++) {
+				for (len = 0; len <= TEST_SHORT_LEN; len++)
+					fails += test_one(soff, doff, len, bh);
+				for (n = 0; n < rounds; n++) {
+					len = TEST_SHORT_LEN +
+					      random32() %
+					      (TEST_MAX_LEN - TEST_SHORT_LEN);
+					fails += test_one(soff, doff, len, bh);
+				}
+				if (fails)
+					return fails;
+			}
+			cond_resched();
+		}
+	}
+
+	return fails;
+}
+
+static void test_bench(void)
+{
+	static const int sizes[] = { 64, 256, 576, 1500, 4096 };
+	int i, bh;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		unsigned int loops = (bench_mb << 20) / sizes[i];
+		u64 ns[2][2];
+
+		for (bh = 0; bh < 2; bh++) {
+			volatile __wsum sum = 0;
+			ktime_t start;
+			unsigned int n;
+
+			start = ktime_get();
+			for (n = 0; n < loops; n++) {
+				if (bh)
+					local_bh_disable();
+				sum = csum_partial(src_buf, sizes[i], sum);
+				if (bh)
+					local_bh_enable();
+				if (!(n & 1023))
+					cond_resched();
+			}
+			ns[bh][0] = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+			start = ktime_get();
+			for (n = 0; n < loops; n++) {
+				if (bh)
+					local_bh_disable();
+				sum = csum_partial_copy_nocheck(src_buf,
+						dst_buf, sizes[i], sum);
+				if (bh)
+					local_bh_enable();
+				if (!(n & 1023))
+					cond_resched();
+			}
+			ns[bh][1] = ktime_to_ns(ktime_sub(ktime_get(), start));
+		}
+
+#define MBPS(ns)	((ns) ? div64_u64((u64)bench_mb * NSEC_PER_SEC, ns) : 0ULL)
+		printk(KERN_INFO "csum_test: %4d bytes: csum %llu / %llu MB/s, "
+		       "copy %llu / %llu MB/s (process / bh)\n", sizes[i],
+		       MBPS(ns[0][0]), MBPS(ns[1][0]),
+		       MBPS(ns[0][1]), MBPS(ns[1][1]));
+#undef MBPS
+	}
+}
+
+static int __init csum_test_init(void)
+{
+	unsigned int fails;
+	int i, ret = -ENOMEM;
+
+	if (!seed)
+		get_random_bytes(&seed, sizeof(seed));
+	srandom32(seed);
+
+	src_buf = kmalloc(TEST_BUF_LEN, GFP_KERNEL);
+	dst_buf = kmalloc(TEST_BUF_LEN, GFP_KERNEL);
+	if (!src_buf || !dst_buf)
+		goto out;
+	for (i = 0; i < TEST_BUF_LEN; i++)
+		src_buf[i] = random32();
+
+	fails = test_correctness();
+	printk(KERN_INFO "csum_test: %u failures (seed %u)\n", fails, seed);
+
+	test_bench();
+	ret = fails ? -EINVAL : 0;
+out:
+	kfree(dst_buf);
+	kfree(src_buf);
+	return ret;
+}
+
+static void __exit csum_test_exit(void)
+{
+}
+
+module_init(csum_test_init);
+module_exit(csum_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ARM checksum test and benchmark");
@@ -0,0 +1,67 @@
+/*
+ *  linux/arch/arm/lib/csumneon.c
+ *
+ *  csum_partial() and csum_partial_copy_nocheck() for CPUs with NEON.
+ *
+ *  Large buffers are summed 64 bytes at a time with NEON and the remainder
+ *  goes to the scalar routines in csumpartial.S/csumpartialcopy.S, which are
+ *  also used outright for short buffers and wherever the NEON register file
+ *  cannot be borrowed: interrupt and softirq context, or a CPU without NEON.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/hardirq.h>
+#include <linux/types.h>
+#include <asm/checksum.h>
+#include <asm/neon.h>
+
+/*
+ * Below this many bytes saving the VFP context and toggling FPEXC costs more
+ * than the wider loop saves.
+ */
+#define CSUM_NEON_MIN	256
+
+__wsum __csum_partial_arm(const void *buff, int len, __wsum sum);
+__wsum __csum_partial_copy_nocheck_arm(const void *src, void *dst, int len,
+				       __wsum sum);
+__wsum csum_partial_neon(const void *buff, int len, __wsum sum);
+__wsum csum_partial_copy_neon(const void *src, void *dst, int len,
+			      __wsum sum);
+
+static inline int csum_use_neon(int len)
+{
+	return len >= CSUM_NEON_MIN && cpu_has_neon() && !in_interrupt();
+}
+
+__wsum csum_partial(const void *buff, int len, __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (!csum_use_neon(len))
+		return __csum_partial_arm(buff, len, sum);
+
+	kernel_neon_begin();
+	sum = csum_partial_neon(buff, bulk, sum);
+	kernel_neon_end();
+
+	/* bulk is even, so the tail's byte lanes line up with the head's */
+	return __csum_partial_arm(buff + bulk, len - bulk, sum);
+}
+
+__wsum
+csum_partial_copy_nocheck(const void *src, void *dst, int len, __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (!csum_use_neon(len))
+		return __csum_partial_copy_nocheck_arm(src, dst, len, sum);
+
+	kernel_neon_begin();
+	sum = csum_partial_copy_neon(src, dst, bulk, sum);
+	kernel_neon_end();
+
+	return __csum_partial_copy_nocheck_arm(src + bulk, dst + bulk,
+					       len - bulk, sum);
+}
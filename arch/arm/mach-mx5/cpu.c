@@ -128,6 +128,15 @@ static int __init post_cpu_init(void)
 		iram_init(MX53_IRAM_BASE_ADDR, iram_size);
 	}
 
+	/*
+	 * VPU work RAM and audio buffers are latency critical: set their
+	 * IRAM aside before anything else can claim it.
+	 */
+	if (VPU_IRAM_SIZE)
+		iram_client_register("vpu", VPU_IRAM_SIZE, VPU_IRAM_SIZE);
+	if (SND_RAM_SIZE)
+		iram_client_register("audio", SND_RAM_SIZE, SND_RAM_SIZE);
+
 	gpc_base = ioremap(MX53_BASE_ADDR(GPC_BASE_ADDR), SZ_4K);
 	clk_enable(gpcclk);
 
@@ -291,7 +291,12 @@ static void __init mx51_efikamx_fixup(struct machine_desc *desc, struct tag *tag
 	int total_mem = SZ_512M;
 	int fb_mem = SZ_16M;
 	int gpu_mem = SZ_32M + SZ_16M;
+#ifdef CONFIG_CMA
+	/* the VPU allocates from the contiguous DMA area instead */
+	int vpu_mem = 0;
+#else
 	int vpu_mem = SZ_32M;
+#endif
 	int sys_mem;
 
 	mxc_set_cpu_type(MXC_CPU_MX51);
@@ -316,7 +321,8 @@ static void __init mx51_efikamx_fixup(struct machine_desc *desc, struct tag *tag
 		mem_tag->u.mem.size = sys_mem;
 		mx51_efikamx_display_adjust_mem(fb_start, fb_mem);
 		mx51_efikamx_gpu_adjust_mem(gpu_start, gpu_mem);
-		mx51_efikamx_vpu_adjust_mem(vpu_start, vpu_mem);
+		if (vpu_mem)
+			mx51_efikamx_vpu_adjust_mem(vpu_start, vpu_mem);
 	}
 }
 
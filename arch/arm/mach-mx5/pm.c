@@ -181,7 +181,8 @@ static int __init pm_init(void)
 	}
 	suspend_set_ops(&mx51_suspend_ops);
 	/* Move suspend routine into iRAM */
-	iram_alloc(SZ_4K, &iram_paddr);
+	iram_client_alloc(iram_client_register("suspend", SZ_4K, 0), SZ_4K,
+			  SZ_4K, &iram_paddr);
 	/* Need to remap the area here since we want the memory region
 		 to be executable. */
 	suspend_iram_base = __arm_ioremap(iram_paddr, SZ_4K,
@@ -0,0 +1,244 @@
+/*
+ *  linux/arch/arm/mm/dma-contiguous.c
+ *
+ *  Contiguous DMA area shared with the page allocator.
+ *
+ *  A region is taken from bootmem at boot time ("cma=" or
+ *  CONFIG_CMA_SIZE_MBYTES) and, once the buddy allocator is running,
+ *  released into it as MIGRATE_CMA pageblocks.  Only movable allocations
+ *  (page cache, anonymous memory) may borrow those pages, so whenever a
+ *  driver asks for a physically contiguous buffer the borrowed pages can
+ *  be migrated elsewhere and the range handed out.  Which parts of the
+ *  region are owned by drivers is tracked in a bitmap.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/bootmem.h>
+#include <linux/device.h>
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+
+#include <asm/dma-contiguous.h>
+#include <asm/memory.h>
+#include <asm/setup.h>
+
+struct cma {
+	unsigned long	base_pfn;
+	unsigned long	count;
+	unsigned long	*bitmap;
+};
+
+static struct cma dma_contiguous_area;
+
+/* Serialises bitmap updates and isolation of the area's pageblocks */
+static DEFINE_MUTEX(cma_mutex);
+
+static unsigned long cma_size __initdata = CONFIG_CMA_SIZE_MBYTES * SZ_1M;
+
+static void __init early_cma(char **p)
+{
+	cma_size = memparse(*p, p);
+}
+__early_param("cma=", early_cma);
+
+/*
+ * Take the area from the top of node 0's lowmem, well clear of ZONE_DMA.
+ * Called from bootmem_init() after the fixed reservations are in place.
+ */
+void __init dma_contiguous_reserve(pg_data_t *pgdat, unsigned long start_pfn,
+				   unsigned long end_pfn)
+{
+	unsigned long count = ALIGN(cma_size >> PAGE_SHIFT, pageblock_nr_pages);
+	unsigned long base_pfn;
+
+	if (!count)
+		return;
+
+	base_pfn = (end_pfn - count) & ~(pageblock_nr_pages - 1);
+	if (count >= end_pfn - start_pfn || base_pfn < start_pfn + count) {
+		printk(KERN_ERR "cma: %lu MiB area does not fit in lowmem\n",
+		       count >> (20 - PAGE_SHIFT));
+		return;
+	}
+
+	if (reserve_bootmem_node(pgdat, __pfn_to_phys(base_pfn),
+				 count << PAGE_SHIFT, BOOTMEM_EXCLUSIVE)) {
+		printk(KERN_ERR "cma: %lu MiB at 0x%08lx is already in use\n",
+		       count >> (20 - PAGE_SHIFT), __pfn_to_phys(base_pfn));
+		return;
+	}
+
+	dma_contiguous_area.base_pfn = base_pfn;
+	dma_contiguous_area.count = count;
+	printk(KERN_INFO "cma: reserved %lu MiB at 0x%08lx\n",
+	       count >> (20 - PAGE_SHIFT), __pfn_to_phys(base_pfn));
+}
+
+/*
+ * Hand the reserved pageblocks to the buddy allocator.  The area must not
+ * straddle zones: alloc_contig_range() works within a single zone.
+ */
+static int __init dma_contiguous_activate(void)
+{
+	struct cma *cma = &dma_contiguous_area;
+	unsigned long pfn, end_pfn = cma->base_pfn + cma->count;
+	struct zone *zone;
+
+	if (!cma->count)
+		return 0;
+
+	cma->bitmap = kzalloc(BITS_TO_LONGS(cma->count) * sizeof(long),
+			      GFP_KERNEL);
+	if (!cma->bitmap)
+		return -ENOMEM;
+
+	zone = page_zone(pfn_to_page(cma->base_pfn));
+	for (pfn = cma->base_pfn; pfn < end_pfn; pfn += pageblock_nr_pages) {
+		if (page_zone(pfn_to_page(pfn)) != zone) {
+			printk(KERN_ERR "cma: area crosses a zone boundary, "
+			       "%lu MiB left unused\n",
+			       (end_pfn - pfn) >> (20 - PAGE_SHIFT));
+			cma->count = pfn - cma->base_pfn;
+			break;
+		}
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+	}
+
+	return 0;
+}
+core_initcall(dma_contiguous_activate);
+
+/*
+ * The whole area has to be reachable through the device's coherent mask,
+ * and a mask narrower than 32 bits means the caller is asking for GFP_DMA
+ * memory, which the area is not part of.
+ */
+int dma_contiguous_usable(u64 mask)
+{
+	struct cma *cma = &dma_contiguous_area;
+
+	return cma->bitmap && mask == 0xffffffff &&
+	       __pfn_to_phys(cma->base_pfn + cma->count) - 1 <= mask;
+}
+
+static unsigned long find_zero_area(unsigned long *map, unsigned long size,
+				    unsigned long start, unsigned int nr,
+				    unsigned long align_mask)
+{
+	unsigned long index, end, i;
+
+again:
+	index = find_next_zero_bit(map, size, start);
+	index = (index + align_mask) & ~align_mask;
+
+	end = index + nr;
+	if (end > size)
+		return size;
+	i = find_next_bit(map, end, index);
+	if (i < end) {
+		start = i + 1;
+		goto again;
+	}
+	return index;
+}
+
+static void set_area_bits(unsigned long *map, unsigned long start, int nr)
+{
+	while (nr--)
+		__set_bit(start++, map);
+}
+
+static void clear_area_bits(unsigned long *map, unsigned long start, int nr)
+{
+	while (nr--)
+		__clear_bit(start++, map);
+}
+
+/**
+ * dma_alloc_from_contiguous() - allocate pages from the contiguous area
+ * @dev:   device the buffer is for (may be NULL)
+ * @count: number of pages
+ * @order: requested alignment, as a page order
+ *
+ * Finds a free stretch of the area and migrates away whatever movable pages
+ * are borrowing it.  Stretches that cannot be emptied (pages pinned for I/O,
+ * for example) are skipped.  May sleep.  Returns the first page, each page
+ * carrying its own reference, or NULL.
+ */
+struct page *dma_alloc_from_contiguous(struct device *dev, int count,
+				       unsigned int order)
+{
+	struct cma *cma = &dma_contiguous_area;
+	unsigned long mask, pageno, start = 0, pfn;
+	struct page *page = NULL;
+	int ret;
+
+	if (!cma->bitmap || count <= 0)
+		return NULL;
+
+	if (order > pageblock_order)
+		order = pageblock_order;
+	mask = (1UL << order) - 1;
+
+	mutex_lock(&cma_mutex);
+	for (;;) {
+		pageno = find_zero_area(cma->bitmap, cma->count, start,
+					count, mask);
+		if (pageno >= cma->count)
+			break;
+
+		pfn = cma->base_pfn + pageno;
+		ret = alloc_contig_range(pfn, pfn + count);
+		if (ret == 0) {
+			set_area_bits(cma->bitmap, pageno, count);
+			page = pfn_to_page(pfn);
+			break;
+		} else if (ret != -EBUSY) {
+			break;
+		}
+
+		pr_debug("cma: pfn 0x%lx busy, retrying\n", pfn);
+		start = pageno + mask + 1;
+	}
+	mutex_unlock(&cma_mutex);
+
+	return page;
+}
+
+/**
+ * dma_release_from_contiguous() - give pages back to the contiguous area
+ * @dev:   device the buffer was allocated for
+ * @pages: first page returned by dma_alloc_from_contiguous()
+ * @count: number of pages
+ *
+ * Returns 1 if the pages belonged to the area and have been freed, 0 if
+ * they came from somewhere else and the caller must free them itself.
+ */
+int dma_release_from_contiguous(struct device *dev, struct page *pages,
+				int count)
+{
+	struct cma *cma = &dma_contiguous_area;
+	unsigned long pfn;
+
+	if (!cma->bitmap || !pages)
+		return 0;
+
+	pfn = page_to_pfn(pages);
+	if (pfn < cma->base_pfn || pfn >= cma->base_pfn + cma->count)
+		return 0;
+
+	BUG_ON(pfn + count > cma->base_pfn + cma->count);
+
+	mutex_lock(&cma_mutex);
+	clear_area_bits(cma->bitmap, pfn - cma->base_pfn, count);
+	free_contig_range(pfn, count);
+	mutex_unlock(&cma_mutex);
+
+	return 1;
+}
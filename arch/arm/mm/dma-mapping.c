@@ -14,13 +14,18 @@
 #include <linux/slab.h>
 #include <linux/errno.h>
 #include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/rbtree.h>
 #include <linux/init.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 
 #include <asm/memory.h>
 #include <asm/highmem.h>
 #include <asm/cacheflush.h>
+#include <asm/dma-contiguous.h>
 #include <asm/tlbflush.h>
 #include <asm/sizes.h>
 
@@ -46,50 +51,114 @@ static DEFINE_SPINLOCK(consistent_lock);
 /*
  * VM region handling support.
  *
- * This should become something generic, handling VM region allocations for
- * vmalloc and similar (ioremap, module space, etc).
+ * The consistent area is carved into regions kept in an rbtree sorted by
+ * address.  Every address in the area belongs to exactly one region,
+ * either in use or free; free regions ("holes") are merged with their free
+ * neighbours and are additionally kept in a second rbtree sorted by size,
+ * so that both a best-fit allocation and the lookup of a region being
+ * freed take O(log n) however fragmented the area has become.
  *
- * I envisage vmalloc()'s supporting vm_struct becoming:
- *
- *  struct vm_struct {
- *    struct vm_region	region;
- *    unsigned long	flags;
- *    struct page	**pages;
- *    unsigned int	nr_pages;
- *    unsigned long	phys_addr;
- *  };
- *
- * get_vm_area() would then call vm_region_alloc with an appropriate
- * struct vm_region head (eg):
- *
- *  struct vm_region vmalloc_head = {
- *	.vm_list	= LIST_HEAD_INIT(vmalloc_head.vm_list),
- *	.vm_start	= VMALLOC_START,
- *	.vm_end		= VMALLOC_END,
- *  };
- *
- * However, vmalloc_head.vm_start is variable (typically, it is dependent on
- * the amount of RAM found at boot time.)  I would imagine that get_vm_area()
- * would have to initialise this each time prior to calling vm_region_alloc().
+ * Regions of up to DMA_CACHE_MAX_PAGES pages that are freed are parked,
+ * still mapped, on a per-size list, so that drivers which keep allocating
+ * and freeing small descriptor rings and bounce buffers do not go through
+ * the page allocator and rebuild the page tables every time.  A shrinker
+ * gives the parked chunks back under memory pressure.
  */
 struct arm_vm_region {
-	struct list_head	vm_list;
+	struct list_head	vm_list;	/* chunk cache */
+	struct rb_node		vm_rb;		/* all regions, by address */
+	struct rb_node		vm_size_rb;	/* holes only, by size */
 	unsigned long		vm_start;
 	unsigned long		vm_end;
 	struct page		*vm_pages;
+	pgprot_t		vm_prot;
 	int			vm_active;
+	int			vm_contig;
+	int			vm_hole;
 };
 
-static struct arm_vm_region consistent_head = {
-	.vm_list	= LIST_HEAD_INIT(consistent_head.vm_list),
-	.vm_start	= CONSISTENT_BASE,
-	.vm_end		= CONSISTENT_END,
+#define DMA_CACHE_MAX_PAGES	8
+#define DMA_CACHE_DEPTH		16
+
+struct dma_chunk_cache {
+	struct list_head	list;
+	unsigned int		count;
+	unsigned long		hits;
+	unsigned long		misses;
 };
 
+static struct rb_root consistent_root = RB_ROOT;
+static struct rb_root consistent_holes = RB_ROOT;
+static struct dma_chunk_cache dma_chunk_cache[DMA_CACHE_MAX_PAGES];
+
+/* Statistics, all under consistent_lock */
+static unsigned long consistent_free_bytes;
+static unsigned int consistent_nr_holes;
+static unsigned int consistent_nr_regions;
+
+#define region_size(c)	((c)->vm_end - (c)->vm_start)
+
+static void arm_vm_hole_insert(struct arm_vm_region *new)
+{
+	struct rb_node **p = &consistent_holes.rb_node, *parent = NULL;
+	unsigned long size = region_size(new);
+
+	while (*p) {
+		struct arm_vm_region *c;
+
+		parent = *p;
+		c = rb_entry(parent, struct arm_vm_region, vm_size_rb);
+		if (size < region_size(c) ||
+		    (size == region_size(c) && new->vm_start < c->vm_start))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&new->vm_size_rb, parent, p);
+	rb_insert_color(&new->vm_size_rb, &consistent_holes);
+}
+
+static void arm_vm_region_insert(struct arm_vm_region *new)
+{
+	struct rb_node **p = &consistent_root.rb_node, *parent = NULL;
+
+	while (*p) {
+		struct arm_vm_region *c;
+
+		parent = *p;
+		c = rb_entry(parent, struct arm_vm_region, vm_rb);
+		if (new->vm_start < c->vm_start)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&new->vm_rb, parent, p);
+	rb_insert_color(&new->vm_rb, &consistent_root);
+}
+
+/* Smallest hole that fits @size, or NULL */
+static struct arm_vm_region *arm_vm_hole_find(size_t size)
+{
+	struct rb_node *n = consistent_holes.rb_node;
+	struct arm_vm_region *best = NULL;
+
+	while (n) {
+		struct arm_vm_region *c;
+
+		c = rb_entry(n, struct arm_vm_region, vm_size_rb);
+		if (region_size(c) >= size) {
+			best = c;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	return best;
+}
+
 static struct arm_vm_region *
-arm_vm_region_alloc(struct arm_vm_region *head, size_t size, gfp_t gfp)
+arm_vm_region_alloc(size_t size, gfp_t gfp)
 {
-	unsigned long addr = head->vm_start, end = head->vm_end - size;
 	unsigned long flags;
 	struct arm_vm_region *c, *new;
 
@@ -99,26 +168,36 @@ arm_vm_region_alloc(struct arm_vm_region *head, size_t size, gfp_t gfp)
 
 	spin_lock_irqsave(&consistent_lock, flags);
 
-	list_for_each_entry(c, &head->vm_list, vm_list) {
-		if ((addr + size) < addr)
-			goto nospc;
-		if ((addr + size) <= c->vm_start)
-			goto found;
-		addr = c->vm_end;
-		if (addr > end)
-			goto nospc;
-	}
+	c = arm_vm_hole_find(size);
+	if (!c)
+		goto nospc;
+
+	new->vm_start = c->vm_start;
+	new->vm_end = c->vm_start + size;
+	new->vm_active = 1;
+	new->vm_contig = 0;
+	new->vm_hole = 0;
+	INIT_LIST_HEAD(&new->vm_list);
 
- found:
 	/*
-	 * Insert this entry _before_ the one we found.
+	 * Take the front of the hole; what is left keeps its place in the
+	 * address tree but moves in the size tree.
 	 */
-	list_add_tail(&new->vm_list, &c->vm_list);
-	new->vm_start = addr;
-	new->vm_end = addr + size;
-	new->vm_active = 1;
+	rb_erase(&c->vm_size_rb, &consistent_holes);
+	if (region_size(c) == size) {
+		rb_erase(&c->vm_rb, &consistent_root);
+		consistent_nr_holes--;
+	} else {
+		c->vm_start += size;
+		arm_vm_hole_insert(c);
+		c = NULL;
+	}
+	arm_vm_region_insert(new);
+	consistent_free_bytes -= size;
+	consistent_nr_regions++;
 
 	spin_unlock_irqrestore(&consistent_lock, flags);
+	kfree(c);
 	return new;
 
  nospc:
@@ -128,23 +207,246 @@ arm_vm_region_alloc(struct arm_vm_region *head, size_t size, gfp_t gfp)
 	return NULL;
 }
 
-static struct arm_vm_region *arm_vm_region_find(struct arm_vm_region *head, unsigned long addr)
+/*
+ * Turn @c back into a hole, merging it with free neighbours.  Called with
+ * consistent_lock held.
+ */
+static void arm_vm_region_release(struct arm_vm_region *c)
+{
+	struct arm_vm_region *prev = NULL, *next = NULL;
+	struct rb_node *n;
+
+	consistent_free_bytes += region_size(c);
+	consistent_nr_regions--;
+
+	n = rb_prev(&c->vm_rb);
+	if (n)
+		prev = rb_entry(n, struct arm_vm_region, vm_rb);
+	n = rb_next(&c->vm_rb);
+	if (n)
+		next = rb_entry(n, struct arm_vm_region, vm_rb);
+
+	if (prev && prev->vm_hole && prev->vm_end == c->vm_start) {
+		rb_erase(&prev->vm_size_rb, &consistent_holes);
+		rb_erase(&c->vm_rb, &consistent_root);
+		prev->vm_end = c->vm_end;
+		kfree(c);
+		c = prev;
+	} else {
+		c->vm_hole = 1;
+		c->vm_active = 0;
+		consistent_nr_holes++;
+	}
+
+	if (next && next->vm_hole && c->vm_end == next->vm_start) {
+		rb_erase(&next->vm_size_rb, &consistent_holes);
+		rb_erase(&next->vm_rb, &consistent_root);
+		c->vm_end = next->vm_end;
+		consistent_nr_holes--;
+		kfree(next);
+	}
+
+	arm_vm_hole_insert(c);
+}
+
+static struct arm_vm_region *arm_vm_region_find(unsigned long addr)
 {
+	struct rb_node *n = consistent_root.rb_node;
+
+	while (n) {
+		struct arm_vm_region *c;
+
+		c = rb_entry(n, struct arm_vm_region, vm_rb);
+		if (addr < c->vm_start)
+			n = n->rb_left;
+		else if (addr > c->vm_start)
+			n = n->rb_right;
+		else
+			return c->vm_active ? c : NULL;
+	}
+	return NULL;
+}
+
+/*
+ * Unmap a region, give its pages back and return its addresses to the
+ * free space.  Must not be called with IRQs disabled.
+ */
+static void __dma_free_region(struct device *dev, struct arm_vm_region *c)
+{
+	unsigned long flags, addr = c->vm_start;
+	size_t size = region_size(c);
+	pte_t *ptep;
+	int idx;
+	u32 off;
+
+	idx = CONSISTENT_PTE_INDEX(c->vm_start);
+	off = CONSISTENT_OFFSET(c->vm_start) & (PTRS_PER_PTE-1);
+	ptep = consistent_pte[idx] + off;
+	do {
+		pte_t pte = ptep_get_and_clear(&init_mm, addr, ptep);
+		unsigned long pfn;
+
+		ptep++;
+		addr += PAGE_SIZE;
+		off++;
+		if (off >= PTRS_PER_PTE) {
+			off = 0;
+			ptep = consistent_pte[++idx];
+		}
+
+		if (!pte_none(pte) && pte_present(pte)) {
+			pfn = pte_pfn(pte);
+
+			if (pfn_valid(pfn)) {
+				struct page *page = pfn_to_page(pfn);
+
+				/*
+				 * x86 does not mark the pages reserved...
+				 */
+				ClearPageReserved(page);
+
+				if (!c->vm_contig)
+					__free_page(page);
+				continue;
+			}
+		}
+
+		printk(KERN_CRIT "%s: bad page in kernel page table\n",
+		       __func__);
+	} while (size -= PAGE_SIZE);
+
+	flush_tlb_kernel_range(c->vm_start, c->vm_end);
+
+	if (c->vm_contig)
+		dma_release_from_contiguous(dev, c->vm_pages,
+				region_size(c) >> PAGE_SHIFT);
+
+	spin_lock_irqsave(&consistent_lock, flags);
+	arm_vm_region_release(c);
+	spin_unlock_irqrestore(&consistent_lock, flags);
+}
+
+static inline int dma_chunk_usable(struct arm_vm_region *c, gfp_t gfp,
+				   pgprot_t prot)
+{
+	if (pgprot_val(c->vm_prot) != pgprot_val(prot))
+		return 0;
+#ifdef CONFIG_ZONE_DMA
+	if ((gfp & GFP_DMA) && page_zonenum(c->vm_pages) != ZONE_DMA)
+		return 0;
+#endif
+	return 1;
+}
+
+/* Take a parked chunk of @count pages mapped with @prot, if there is one */
+static struct arm_vm_region *
+dma_chunk_cache_get(int count, gfp_t gfp, pgprot_t prot)
+{
+	struct dma_chunk_cache *cc;
 	struct arm_vm_region *c;
-	
-	list_for_each_entry(c, &head->vm_list, vm_list) {
-		if (c->vm_active && c->vm_start == addr)
+	unsigned long flags;
+
+	if (count > DMA_CACHE_MAX_PAGES)
+		return NULL;
+	cc = &dma_chunk_cache[count - 1];
+
+	spin_lock_irqsave(&consistent_lock, flags);
+	list_for_each_entry(c, &cc->list, vm_list) {
+		if (dma_chunk_usable(c, gfp, prot)) {
+			list_del_init(&c->vm_list);
+			cc->count--;
+			cc->hits++;
+			c->vm_active = 1;
 			goto out;
+		}
 	}
 	c = NULL;
+	cc->misses++;
  out:
+	spin_unlock_irqrestore(&consistent_lock, flags);
 	return c;
 }
 
+/* Park a small region being freed; returns 0 if the caller must free it */
+static int dma_chunk_cache_put(struct arm_vm_region *c)
+{
+	int count = region_size(c) >> PAGE_SHIFT;
+	struct dma_chunk_cache *cc;
+	unsigned long flags;
+	int ret = 0;
+
+	if (c->vm_contig || count > DMA_CACHE_MAX_PAGES)
+		return 0;
+	cc = &dma_chunk_cache[count - 1];
+
+	spin_lock_irqsave(&consistent_lock, flags);
+	if (cc->count < DMA_CACHE_DEPTH) {
+		list_add(&c->vm_list, &cc->list);
+		cc->count++;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&consistent_lock, flags);
+	return ret;
+}
+
+/*
+ * Free up to @nr_to_scan parked chunks, largest and least recently
+ * parked first.  Returns the number of chunks still parked.
+ */
+static int dma_chunk_cache_shrink(int nr_to_scan, gfp_t gfp_mask)
+{
+	struct arm_vm_region *c;
+	unsigned long flags;
+	int i, left;
+
+	while (nr_to_scan-- > 0) {
+		c = NULL;
+		spin_lock_irqsave(&consistent_lock, flags);
+		for (i = DMA_CACHE_MAX_PAGES - 1; i >= 0; i--) {
+			struct dma_chunk_cache *cc = &dma_chunk_cache[i];
+
+			if (cc->count) {
+				c = list_entry(cc->list.prev,
+					       struct arm_vm_region, vm_list);
+				list_del_init(&c->vm_list);
+				cc->count--;
+				break;
+			}
+		}
+		spin_unlock_irqrestore(&consistent_lock, flags);
+		if (!c)
+			break;
+		__dma_free_region(NULL, c);
+	}
+
+	left = 0;
+	for (i = 0; i < DMA_CACHE_MAX_PAGES; i++)
+		left += dma_chunk_cache[i].count;
+	return left;
+}
+
+static struct shrinker dma_chunk_shrinker = {
+	.shrink	= dma_chunk_cache_shrink,
+	.seeks	= DEFAULT_SEEKS,
+};
+
 #ifdef CONFIG_HUGETLB_PAGE
 #error ARM Coherent DMA allocator does not (yet) support huge TLB
 #endif
 
+/*
+ * Invalidate any data that might be lurking in the
+ * kernel direct-mapped region for device DMA.
+ */
+static void __dma_clear_buffer(struct page *page, size_t size)
+{
+	void *ptr = page_address(page);
+
+	memset(ptr, 0, size);
+	dmac_flush_range(ptr, ptr + size);
+	outer_flush_range(__pa(ptr), __pa(ptr) + size);
+}
+
 static void *
 __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	    pgprot_t prot)
@@ -153,6 +455,7 @@ __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	struct arm_vm_region *c;
 	unsigned long order;
 	u64 mask = ISA_DMA_THRESHOLD, limit;
+	int count, contig = 0;
 
 	if (!consistent_pte[0]) {
 		printk(KERN_ERR "%s: not initialised\n", __func__);
@@ -193,40 +496,63 @@ __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	}
 
 	order = get_order(size);
+	count = size >> PAGE_SHIFT;
 
 	if (mask != 0xffffffff)
 		gfp |= GFP_DMA;
 
-	page = alloc_pages(gfp, order);
-	if (!page)
-		goto no_page;
+	c = dma_chunk_cache_get(count, gfp, prot);
+	if (c) {
+		page = c->vm_pages;
+		__dma_clear_buffer(page, size);
+		*handle = page_to_dma(dev, page);
+		return (void *)c->vm_start;
+	}
 
 	/*
-	 * Invalidate any data that might be lurking in the
-	 * kernel direct-mapped region for device DMA.
+	 * Buffers beyond what the buddy allocator can reliably provide
+	 * come from the contiguous area when the caller can sleep.
 	 */
-	{
-		void *ptr = page_address(page);
-		memset(ptr, 0, size);
-		dmac_flush_range(ptr, ptr + size);
-		outer_flush_range(__pa(ptr), __pa(ptr) + size);
+	page = NULL;
+	if (order > PAGE_ALLOC_COSTLY_ORDER && (gfp & __GFP_WAIT) &&
+	    !(gfp & GFP_DMA) && dma_contiguous_usable(mask)) {
+		page = dma_alloc_from_contiguous(dev, count, order);
+		contig = page != NULL;
 	}
+	if (!page)
+		page = alloc_pages(gfp, order);
+	if (!page)
+		goto no_page;
+
+	__dma_clear_buffer(page, size);
 
 	/*
 	 * Allocate a virtual address in the consistent mapping region.
 	 */
-	c = arm_vm_region_alloc(&consistent_head, size,
-			    gfp & ~(__GFP_DMA | __GFP_HIGHMEM));
+	c = arm_vm_region_alloc(size, gfp & ~(__GFP_DMA | __GFP_HIGHMEM));
+	if (!c && (gfp & __GFP_WAIT) && !irqs_disabled()) {
+		/*
+		 * Parked chunks may be what is filling the area.  Tearing
+		 * them all down is unbounded work, so atomic callers fail
+		 * here and leave that to a caller that can sleep.
+		 */
+		dma_chunk_cache_shrink(INT_MAX, gfp);
+		c = arm_vm_region_alloc(size,
+					gfp & ~(__GFP_DMA | __GFP_HIGHMEM));
+	}
 	if (c) {
 		pte_t *pte;
-		struct page *end = page + (1 << order);
+		struct page *end = page + (contig ? count : 1 << order);
 		int idx = CONSISTENT_PTE_INDEX(c->vm_start);
 		u32 off = CONSISTENT_OFFSET(c->vm_start) & (PTRS_PER_PTE-1);
 
 		pte = consistent_pte[idx] + off;
 		c->vm_pages = page;
+		c->vm_prot = prot;
+		c->vm_contig = contig;
 
-		split_page(page, order);
+		if (!contig)
+			split_page(page, order);
 
 		/*
 		 * Set the "dma handle"
@@ -261,7 +587,9 @@ __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 		return (void *)c->vm_start;
 	}
 
-	if (page)
+	if (contig)
+		dma_release_from_contiguous(dev, page, count);
+	else
 		__free_pages(page, order);
  no_page:
 	*handle = ~0;
@@ -318,7 +646,7 @@ static int dma_mmap(struct device *dev, struct vm_area_struct *vma,
 	user_size = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
 
 	spin_lock_irqsave(&consistent_lock, flags);
-	c = arm_vm_region_find(&consistent_head, (unsigned long)cpu_addr);
+	c = arm_vm_region_find((unsigned long)cpu_addr);
 	spin_unlock_irqrestore(&consistent_lock, flags);
 
 	if (c) {
@@ -361,10 +689,7 @@ EXPORT_SYMBOL(dma_mmap_writecombine);
 void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr_t handle)
 {
 	struct arm_vm_region *c;
-	unsigned long flags, addr;
-	pte_t *ptep;
-	int idx;
-	u32 off;
+	unsigned long flags;
 
 	WARN_ON(irqs_disabled());
 
@@ -379,7 +704,7 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 	size = PAGE_ALIGN(size);
 
 	spin_lock_irqsave(&consistent_lock, flags);
-	c = arm_vm_region_find(&consistent_head, (unsigned long)cpu_addr);
+	c = arm_vm_region_find((unsigned long)cpu_addr);
 	if (!c)
 		goto no_area;
 
@@ -390,52 +715,10 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 		printk(KERN_ERR "%s: freeing wrong coherent size (%ld != %d)\n",
 		       __func__, c->vm_end - c->vm_start, size);
 		dump_stack();
-		size = c->vm_end - c->vm_start;
 	}
 
-	idx = CONSISTENT_PTE_INDEX(c->vm_start);
-	off = CONSISTENT_OFFSET(c->vm_start) & (PTRS_PER_PTE-1);
-	ptep = consistent_pte[idx] + off;
-	addr = c->vm_start;
-	do {
-		pte_t pte = ptep_get_and_clear(&init_mm, addr, ptep);
-		unsigned long pfn;
-
-		ptep++;
-		addr += PAGE_SIZE;
-		off++;
-		if (off >= PTRS_PER_PTE) {
-			off = 0;
-			ptep = consistent_pte[++idx];
-		}
-
-		if (!pte_none(pte) && pte_present(pte)) {
-			pfn = pte_pfn(pte);
-
-			if (pfn_valid(pfn)) {
-				struct page *page = pfn_to_page(pfn);
-
-				/*
-				 * x86 does not mark the pages reserved...
-				 */
-				ClearPageReserved(page);
-
-				__free_page(page);
-				continue;
-			}
-		}
-
-		printk(KERN_CRIT "%s: bad page in kernel page table\n",
-		       __func__);
-	} while (size -= PAGE_SIZE);
-
-	flush_tlb_kernel_range(c->vm_start, c->vm_end);
-
-	spin_lock_irqsave(&consistent_lock, flags);
-	list_del(&c->vm_list);
-	spin_unlock_irqrestore(&consistent_lock, flags);
-
-	kfree(c);
+	if (!dma_chunk_cache_put(c))
+		__dma_free_region(dev, c);
 	return;
 
  no_area:
@@ -451,12 +734,30 @@ EXPORT_SYMBOL(dma_free_coherent);
  */
 static int __init consistent_init(void)
 {
+	struct arm_vm_region *hole;
 	pgd_t *pgd;
 	pmd_t *pmd;
 	pte_t *pte;
 	int ret = 0, i = 0;
 	u32 base = CONSISTENT_BASE;
 
+	hole = kzalloc(sizeof(struct arm_vm_region), GFP_KERNEL);
+	if (!hole)
+		return -ENOMEM;
+	hole->vm_start = CONSISTENT_BASE;
+	hole->vm_end = CONSISTENT_END;
+	hole->vm_hole = 1;
+	INIT_LIST_HEAD(&hole->vm_list);
+	arm_vm_region_insert(hole);
+	arm_vm_hole_insert(hole);
+	consistent_free_bytes = CONSISTENT_END - CONSISTENT_BASE;
+	consistent_nr_holes = 1;
+
+	for (i = 0; i < DMA_CACHE_MAX_PAGES; i++)
+		INIT_LIST_HEAD(&dma_chunk_cache[i].list);
+	register_shrinker(&dma_chunk_shrinker);
+
+	i = 0;
 	do {
 		pgd = pgd_offset(&init_mm, base);
 		pmd = pmd_alloc(&init_mm, pgd, base);
@@ -483,6 +784,69 @@ static int __init consistent_init(void)
 
 core_initcall(consistent_init);
 
+#ifdef CONFIG_PROC_FS
+static int consistent_proc_show(struct seq_file *m, void *v)
+{
+	struct dma_chunk_cache cache[DMA_CACHE_MAX_PAGES];
+	unsigned long flags, free, largest = 0, used;
+	unsigned int holes, regions, frag = 0;
+	struct rb_node *n;
+	int i;
+
+	spin_lock_irqsave(&consistent_lock, flags);
+	free = consistent_free_bytes;
+	holes = consistent_nr_holes;
+	regions = consistent_nr_regions;
+	n = rb_last(&consistent_holes);
+	if (n)
+		largest = region_size(rb_entry(n, struct arm_vm_region,
+					       vm_size_rb));
+	memcpy(cache, dma_chunk_cache, sizeof(cache));
+	spin_unlock_irqrestore(&consistent_lock, flags);
+
+	used = CONSISTENT_END - CONSISTENT_BASE - free;
+	if (free)
+		frag = 100 - (largest >> 10) * 100 / (free >> 10);
+
+	seq_printf(m, "area:          0x%08lx-0x%08lx, %lu kB\n",
+		   (unsigned long)CONSISTENT_BASE,
+		   (unsigned long)CONSISTENT_END,
+		   (unsigned long)(CONSISTENT_END - CONSISTENT_BASE) >> 10);
+	seq_printf(m, "regions:       %u, %lu kB\n", regions, used >> 10);
+	seq_printf(m, "holes:         %u, %lu kB, largest %lu kB\n",
+		   holes, free >> 10, largest >> 10);
+	seq_printf(m, "fragmentation: %u%%\n", frag);
+	seq_printf(m, "\npages cached       hits     misses  hit%%\n");
+	for (i = 0; i < DMA_CACHE_MAX_PAGES; i++) {
+		unsigned long total = cache[i].hits + cache[i].misses;
+
+		seq_printf(m, "%5d %6u %10lu %10lu  %3llu\n", i + 1,
+			   cache[i].count, cache[i].hits, cache[i].misses,
+			   total ? div64_u64((u64)cache[i].hits * 100, total) : 0ULL);
+	}
+	return 0;
+}
+
+static int consistent_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, consistent_proc_show, NULL);
+}
+
+static const struct file_operations consistent_proc_fops = {
+	.open		= consistent_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init consistent_proc_init(void)
+{
+	proc_create("consistent_dma", 0444, NULL, &consistent_proc_fops);
+	return 0;
+}
+__initcall(consistent_proc_init);
+#endif
+
 /*
  * Make an area consistent for devices.
  * Note: Drivers should NOT use this function directly, as it will break
@@ -17,6 +17,7 @@
 #include <linux/initrd.h>
 #include <linux/highmem.h>
 
+#include <asm/dma-contiguous.h>
 #include <asm/mach-types.h>
 #include <asm/sections.h>
 #include <asm/setup.h>
@@ -395,6 +396,13 @@ void __init bootmem_init(void)
 		 */
 		if (node == initrd_node)
 			bootmem_reserve_initrd(node);
+
+		/*
+		 * Set aside the contiguous DMA area, once everything
+		 * that has a fixed address has been reserved.
+		 */
+		if (node == 0)
+			dma_contiguous_reserve(NODE_DATA(node), min, node_low);
 	}
 
 	/*
@@ -17,51 +17,342 @@
  * MA 02110-1301, USA.
  */
 
+/*
+ * On-chip RAM allocator.
+ *
+ * IRAM is handed out in 256 byte granules tracked in a bitmap.  Users
+ * register as named clients, each of which may have a quota (the most it
+ * may hold) and a reservation (what it is guaranteed to get, whoever asks
+ * first).  Space reserved for a client that has not claimed it yet is off
+ * limits to everybody else, which is how latency-critical users such as
+ * the VPU work RAM and audio ping-pong buffers get IRAM ahead of the rest.
+ * Callers of the old iram_alloc()/iram_free() are accounted to "other".
+ */
+
 #include <linux/kernel.h>
 #include <linux/io.h>
 #include <linux/module.h>
 #include <linux/spinlock.h>
-#include <linux/genalloc.h>
+#include <linux/bitops.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/iram_alloc.h>
+#include <asm/sizes.h>
+
+#define IRAM_GRANULE_SHIFT	8
+#define IRAM_GRANULE		(1 << IRAM_GRANULE_SHIFT)
+#define IRAM_MAX_SIZE		SZ_256K
+#define IRAM_MAX_GRANULES	(IRAM_MAX_SIZE >> IRAM_GRANULE_SHIFT)
+#define IRAM_MAX_CLIENTS	16
+
+struct iram_client {
+	char		name[16];
+	unsigned int	quota;
+	unsigned int	reserve;
+	unsigned int	used;
+	unsigned int	peak;
+	unsigned long	allocs;
+	unsigned long	fails;
+};
+
+static DEFINE_SPINLOCK(iram_lock);
 
 static unsigned long iram_phys_base;
 static __iomem void *iram_virt_base;
-static struct gen_pool *iram_pool;
+static unsigned int iram_granules;
+static unsigned int iram_free_bytes;
+
+/* granules in use, and the first granule of each allocation */
+static DECLARE_BITMAP(iram_map, IRAM_MAX_GRANULES);
+static DECLARE_BITMAP(iram_starts, IRAM_MAX_GRANULES);
+static u8 iram_owner[IRAM_MAX_GRANULES];
+
+static struct iram_client iram_clients[IRAM_MAX_CLIENTS] = {
+	[0] = { .name = "other" },
+};
+static int iram_nr_clients = 1;
 
 #define iram_phys_to_virt(p) (iram_virt_base + ((p) - iram_phys_base))
 
-void *iram_alloc(unsigned int size, unsigned long *dma_addr)
+/* Space still promised to clients other than @c; call with iram_lock */
+static unsigned int iram_reserved_for_others(struct iram_client *c)
 {
-	if (!iram_pool)
-		return NULL;
+	unsigned int sum = 0;
+	int i;
+
+	for (i = 0; i < iram_nr_clients; i++) {
+		struct iram_client *k = &iram_clients[i];
+
+		if (k != c && k->used < k->reserve)
+			sum += k->reserve - k->used;
+	}
+	return sum;
+}
+
+static unsigned int iram_find_area(unsigned int nr, unsigned int align_mask)
+{
+	unsigned int start = 0, index, end, i;
 
-	*dma_addr = gen_pool_alloc(iram_pool, size);
-	pr_debug("iram alloc - %dB@0x%p\n", size, (void *)*dma_addr);
+	for (;;) {
+		index = find_next_zero_bit(iram_map, iram_granules, start);
+		index = (index + align_mask) & ~align_mask;
+		end = index + nr;
+		if (end > iram_granules)
+			return iram_granules;
+		i = find_next_bit(iram_map, end, index);
+		if (i >= end)
+			return index;
+		start = i + 1;
+	}
+}
 
-	WARN_ON(!*dma_addr);
-	if (!*dma_addr)
+/**
+ * iram_client_register - look up or create a named IRAM client
+ * @name:    client name, as shown in debugfs
+ * @quota:   most the client may hold at once, 0 for no limit
+ * @reserve: amount set aside for the client, 0 for none
+ *
+ * Registering a name that already exists returns the existing client,
+ * updating its limits where @quota or @reserve are non-zero.  Platform
+ * code uses this to set up reservations before the drivers load.
+ */
+struct iram_client *iram_client_register(const char *name,
+					 unsigned int quota,
+					 unsigned int reserve)
+{
+	struct iram_client *c = NULL;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&iram_lock, flags);
+	for (i = 0; i < iram_nr_clients; i++) {
+		if (!strcmp(iram_clients[i].name, name)) {
+			c = &iram_clients[i];
+			break;
+		}
+	}
+	if (!c && iram_nr_clients < IRAM_MAX_CLIENTS) {
+		c = &iram_clients[iram_nr_clients++];
+		strlcpy(c->name, name, sizeof(c->name));
+	}
+	if (c) {
+		if (quota)
+			c->quota = ALIGN(quota, IRAM_GRANULE);
+		if (reserve)
+			c->reserve = ALIGN(reserve, IRAM_GRANULE);
+	}
+	spin_unlock_irqrestore(&iram_lock, flags);
+
+	if (!c)
+		pr_err("iram: no room to register client %s\n", name);
+	return c;
+}
+EXPORT_SYMBOL(iram_client_register);
+
+/**
+ * iram_client_alloc - allocate IRAM on behalf of a client
+ * @c:        client, or NULL for "other"
+ * @size:     bytes wanted
+ * @align:    alignment of the physical address, a power of two; 0 for
+ *            the granule size
+ * @dma_addr: filled in with the physical address, or 0 on failure
+ *
+ * Returns the kernel virtual address or NULL.  Fails rather than eating
+ * into another client's reservation or exceeding @c's quota.
+ */
+void *iram_client_alloc(struct iram_client *c, unsigned int size,
+			unsigned int align, unsigned long *dma_addr)
+{
+	unsigned int nr, bytes, index;
+	unsigned long flags;
+
+	*dma_addr = 0;
+	if (!iram_virt_base || !size)
+		return NULL;
+	if (!c)
+		c = &iram_clients[0];
+
+	if (align < IRAM_GRANULE)
+		align = IRAM_GRANULE;
+	if (WARN_ON(!is_power_of_2(align)))
 		return NULL;
 
+	nr = DIV_ROUND_UP(size, IRAM_GRANULE);
+	bytes = nr << IRAM_GRANULE_SHIFT;
+
+	spin_lock_irqsave(&iram_lock, flags);
+	if (c->quota && c->used + bytes > c->quota)
+		goto fail;
+	if (iram_free_bytes < bytes + iram_reserved_for_others(c))
+		goto fail;
+
+	index = iram_find_area(nr, (align >> IRAM_GRANULE_SHIFT) - 1);
+	if (index >= iram_granules)
+		goto fail;
+
+	__set_bit(index, iram_starts);
+	memset(iram_owner + index, c - iram_clients, nr);
+	for (; nr; nr--)
+		__set_bit(index + nr - 1, iram_map);
+
+	iram_free_bytes -= bytes;
+	c->used += bytes;
+	if (c->used > c->peak)
+		c->peak = c->used;
+	c->allocs++;
+	spin_unlock_irqrestore(&iram_lock, flags);
+
+	*dma_addr = iram_phys_base + (index << IRAM_GRANULE_SHIFT);
+	pr_debug("iram alloc - %s %dB@0x%p\n", c->name, size, (void *)*dma_addr);
 	return iram_phys_to_virt(*dma_addr);
+
+fail:
+	c->fails++;
+	spin_unlock_irqrestore(&iram_lock, flags);
+	pr_debug("iram alloc - %s %dB failed\n", c->name, size);
+	return NULL;
 }
-EXPORT_SYMBOL(iram_alloc);
+EXPORT_SYMBOL(iram_client_alloc);
 
-void iram_free(unsigned long addr, unsigned int size)
+/**
+ * iram_client_free - give back IRAM from iram_client_alloc()
+ * @c:        client the memory was allocated for, or NULL
+ * @dma_addr: physical address returned by the allocation
+ * @size:     size passed to the allocation
+ */
+void iram_client_free(struct iram_client *c, unsigned long dma_addr,
+		      unsigned int size)
 {
-	if (!iram_pool)
+	unsigned int index, nr, bytes, i;
+	struct iram_client *owner;
+	unsigned long flags;
+
+	if (!iram_virt_base || !dma_addr)
 		return;
 
-	gen_pool_free(iram_pool, addr, size);
+	index = (dma_addr - iram_phys_base) >> IRAM_GRANULE_SHIFT;
+	nr = DIV_ROUND_UP(size, IRAM_GRANULE);
+	bytes = nr << IRAM_GRANULE_SHIFT;
+
+	spin_lock_irqsave(&iram_lock, flags);
+	if (dma_addr < iram_phys_base || index + nr > iram_granules ||
+	    (dma_addr & (IRAM_GRANULE - 1)) || !test_bit(index, iram_starts)) {
+		spin_unlock_irqrestore(&iram_lock, flags);
+		pr_err("iram: bad free of %uB@0x%08lx\n", size, dma_addr);
+		WARN_ON(1);
+		return;
+	}
+
+	owner = &iram_clients[iram_owner[index]];
+	WARN_ON(c && c != owner);
+
+	__clear_bit(index, iram_starts);
+	for (i = index; i < index + nr; i++)
+		__clear_bit(i, iram_map);
+
+	iram_free_bytes += bytes;
+	owner->used -= min(owner->used, bytes);
+	spin_unlock_irqrestore(&iram_lock, flags);
+}
+EXPORT_SYMBOL(iram_client_free);
+
+void *iram_alloc(unsigned int size, unsigned long *dma_addr)
+{
+	void *virt;
+
+	if (!iram_virt_base)
+		return NULL;
+
+	/* callers of the old interface expect page aligned chunks */
+	virt = iram_client_alloc(NULL, size, PAGE_SIZE, dma_addr);
+	WARN_ON(!virt);
+	return virt;
+}
+EXPORT_SYMBOL(iram_alloc);
+
+void iram_free(unsigned long addr, unsigned int size)
+{
+	iram_client_free(NULL, addr, size);
 }
 EXPORT_SYMBOL(iram_free);
 
 int __init iram_init(unsigned long base, unsigned long size)
 {
-	iram_phys_base = base;
+	if (size > IRAM_MAX_SIZE) {
+		pr_warning("iram: only using %dKB of %ldKB\n",
+			   IRAM_MAX_SIZE / 1024, size / 1024);
+		size = IRAM_MAX_SIZE;
+	}
 
-	iram_pool = gen_pool_create(12, -1);
-	gen_pool_add(iram_pool, base, size, -1);
+	iram_phys_base = base;
+	iram_granules = size >> IRAM_GRANULE_SHIFT;
+	iram_free_bytes = iram_granules << IRAM_GRANULE_SHIFT;
 	iram_virt_base = ioremap(iram_phys_base, size);
 
 	pr_info("i.MX IRAM pool: %ld KB@0x%p\n", size / 1024, iram_virt_base);
 	return 0;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int iram_debugfs_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	unsigned int i, end;
+
+	spin_lock_irqsave(&iram_lock, flags);
+
+	seq_printf(m, "base 0x%08lx size %u granule %u\n", iram_phys_base,
+		   iram_granules << IRAM_GRANULE_SHIFT, IRAM_GRANULE);
+	seq_printf(m, "free %u reserved %u\n\n", iram_free_bytes,
+		   iram_reserved_for_others(NULL));
+
+	seq_printf(m, "%-16s %7s %7s %7s %7s %7s %7s\n", "client", "used",
+		   "peak", "quota", "reserve", "allocs", "fails");
+	for (i = 0; i < iram_nr_clients; i++) {
+		struct iram_client *c = &iram_clients[i];
+
+		seq_printf(m, "%-16s %7u %7u %7u %7u %7lu %7lu\n", c->name,
+			   c->used, c->peak, c->quota, c->reserve, c->allocs,
+			   c->fails);
+	}
+
+	seq_printf(m, "\n%-10s %7s %s\n", "address", "size", "client");
+	for (i = find_first_bit(iram_starts, iram_granules);
+	     i < iram_granules;
+	     i = find_next_bit(iram_starts, iram_granules, i + 1)) {
+		for (end = i + 1; end < iram_granules; end++)
+			if (!test_bit(end, iram_map) ||
+			    test_bit(end, iram_starts))
+				break;
+		seq_printf(m, "0x%08lx %7u %s\n",
+			   iram_phys_base + (i << IRAM_GRANULE_SHIFT),
+			   (end - i) << IRAM_GRANULE_SHIFT,
+			   iram_clients[iram_owner[i]].name);
+	}
+
+	spin_unlock_irqrestore(&iram_lock, flags);
+	return 0;
+}
+
+static int iram_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iram_debugfs_show, NULL);
+}
+
+static const struct file_operations iram_debugfs_fops = {
+	.open		= iram_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init iram_debugfs_init(void)
+{
+	if (iram_virt_base)
+		debugfs_create_file("iram", 0444, NULL, NULL,
+				    &iram_debugfs_fops);
+	return 0;
+}
+late_initcall(iram_debugfs_init);
+#endif
@@ -219,7 +219,8 @@ void __init init_sdma_pool(void)
 	pool = dma_pool_create("SDMA", NULL, SDMA_POOL_SIZE, 0, 0);
 
 #ifdef CONFIG_SDMA_IRAM
-	iram_vaddr = iram_alloc(SZ_4K, &iram_paddr);
+	iram_vaddr = iram_client_alloc(iram_client_register("sdma", SZ_4K, 0),
+				       SZ_4K, 0, &iram_paddr);
 	sdma_iram_pool = gen_pool_create(6, -1);
 	gen_pool_add(sdma_iram_pool, iram_paddr, SZ_4K, -1);
 #endif
@@ -446,6 +446,45 @@ out:
 	put_cpu();
 }
 
+#ifdef CONFIG_NEON
+#include <linux/hardirq.h>
+#include <asm/neon.h>
+
+/*
+ * Kernel-side NEON support.  The live VFP context, if any, is saved and
+ * dropped so that its owner reloads it on its next VFP instruction; the
+ * unit is then left enabled until kernel_neon_end().
+ */
+void kernel_neon_begin(void)
+{
+	unsigned int cpu;
+	u32 fpexc;
+
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	if (last_VFP_context[cpu]) {
+		vfp_save_state(last_VFP_context[cpu], fpexc);
+#ifdef CONFIG_SMP
+		last_VFP_context[cpu]->hard.cpu = cpu;
+#endif
+		last_VFP_context[cpu] = NULL;
+	}
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	/* disable again so that the next user access reloads its state */
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+#endif
+
 #include <linux/smp.h>
 
 #if defined(CONFIG_ARCH_MX51) && defined(CONFIG_NEON)
@@ -71,10 +71,18 @@ spufs_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void spufs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(spufs_inode_cache, SPUFS_I(inode));
+}
+
 static void
 spufs_destroy_inode(struct inode *inode)
 {
-	kmem_cache_free(spufs_inode_cache, SPUFS_I(inode));
+	call_rcu(&inode->i_rcu, spufs_i_callback);
 }
 
 static void
@@ -858,6 +866,7 @@ static void __exit spufs_exit(void)
 	spufs_exit_isolated_loader();
 	unregister_spu_syscalls(&spufs_calls);
 	unregister_filesystem(&spufs_type);
+	rcu_barrier();	/* wait for spufs_i_callback() */
 	kmem_cache_destroy(spufs_inode_cache);
 }
 module_exit(spufs_exit);
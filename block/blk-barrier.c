@@ -409,3 +409,85 @@ int blkdev_issue_discard(struct block_device *bdev,
 	return ret;
 }
 EXPORT_SYMBOL(blkdev_issue_discard);
+
+struct zeroout_batch {
+	atomic_t		pending;
+	int			error;
+	struct completion	done;
+};
+
+static void blkdev_zeroout_end_io(struct bio *bio, int err)
+{
+	struct zeroout_batch *zb = bio->bi_private;
+
+	if (err)
+		zb->error = err;
+	else if (!bio_flagged(bio, BIO_UPTODATE))
+		zb->error = -EIO;
+	if (atomic_dec_and_test(&zb->pending))
+		complete(&zb->done);
+	bio_put(bio);
+}
+
+/**
+ * blkdev_issue_zeroout - write zeroes to a range of sectors
+ * @bdev:	blockdev to write
+ * @sector:	start sector
+ * @nr_sects:	number of sectors to write
+ * @gfp_mask:	memory allocation flags (for bio_alloc)
+ *
+ * Description:
+ *    Write the zero page over the sectors in question, bypassing the page
+ *    cache, and wait for the writes to complete.  Unlike a discard the
+ *    range is guaranteed to read back as zeroes afterwards.
+ */
+int blkdev_issue_zeroout(struct block_device *bdev,
+			 sector_t sector, sector_t nr_sects, gfp_t gfp_mask)
+{
+	struct zeroout_batch zb;
+	struct bio *bio;
+	int ret = 0;
+
+	atomic_set(&zb.pending, 1);
+	zb.error = 0;
+	init_completion(&zb.done);
+
+	while (nr_sects) {
+		bio = bio_alloc(gfp_mask,
+				min_t(sector_t, nr_sects >> (PAGE_SHIFT - 9),
+				      BIO_MAX_PAGES) ?: 1);
+		if (!bio) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		bio->bi_sector = sector;
+		bio->bi_bdev = bdev;
+		bio->bi_end_io = blkdev_zeroout_end_io;
+		bio->bi_private = &zb;
+
+		while (nr_sects) {
+			unsigned int len = min_t(sector_t, nr_sects,
+						 PAGE_SIZE >> 9) << 9;
+
+			if (bio_add_page(bio, ZERO_PAGE(0), len, 0) < len)
+				break;
+			nr_sects -= len >> 9;
+			sector += len >> 9;
+		}
+		if (!bio->bi_size) {
+			bio_put(bio);
+			ret = -EIO;
+			break;
+		}
+
+		atomic_inc(&zb.pending);
+		submit_bio(WRITE, bio);
+	}
+
+	if (!atomic_dec_and_test(&zb.pending))
+		wait_for_completion(&zb.done);
+
+	return ret ? ret : zb.error;
+}
+EXPORT_SYMBOL(blkdev_issue_zeroout);
@@ -1153,6 +1153,53 @@ static inline bool queue_should_plug(struct request_queue *q)
 	return !(blk_queue_nonrot(q) && blk_queue_tagged(q));
 }
 
+/*
+ * Try to merge @bio into one of the requests sitting on the current task's
+ * plug list.  The list is private to the task, so no queue lock is needed.
+ */
+static bool attempt_plug_merge(struct request_queue *q, struct bio *bio)
+{
+	struct blk_plug *plug = current->plug;
+	unsigned int bytes = bio->bi_size;
+	struct request *req;
+
+	list_for_each_entry_reverse(req, &plug->list, queuelist) {
+		if (req->q != q || !elv_rq_merge_ok(req, bio))
+			continue;
+
+		if (blk_rq_pos(req) + blk_rq_sectors(req) == bio->bi_sector) {
+			if (!ll_back_merge_fn(q, req, bio))
+				return false;
+
+			trace_block_bio_backmerge(q, bio);
+
+			req->biotail->bi_next = bio;
+			req->biotail = bio;
+		} else if (bio->bi_sector + bio_sectors(bio) ==
+			   blk_rq_pos(req)) {
+			if (!ll_front_merge_fn(q, req, bio))
+				return false;
+
+			trace_block_bio_frontmerge(q, bio);
+
+			bio->bi_next = req->bio;
+			req->bio = bio;
+			req->buffer = bio_data(bio);
+			req->__sector = bio->bi_sector;
+		} else
+			continue;
+
+		req->__data_len += bytes;
+		req->ioprio = ioprio_best(req->ioprio, bio_prio(bio));
+		if (!blk_rq_cpu_valid(req))
+			req->cpu = bio->bi_comp_cpu;
+		drive_stat_acct(req, 0);
+		return true;
+	}
+
+	return false;
+}
+
 static int __make_request(struct request_queue *q, struct bio *bio)
 {
 	struct request *req;
@@ -1161,6 +1208,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	const unsigned short prio = bio_prio(bio);
 	const int sync = bio_sync(bio);
 	const int unplug = bio_unplug(bio);
+	struct blk_plug *plug;
 	int rw_flags;
 
 	if (bio_barrier(bio) && bio_has_data(bio) &&
@@ -1175,6 +1223,17 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	 */
 	blk_queue_bounce(q, &bio);
 
+	/*
+	 * Barriers are ordering points for everybody on the queue and so
+	 * never wait on a plug list.
+	 */
+	plug = current->plug;
+	if (unlikely(bio_barrier(bio)))
+		plug = NULL;
+
+	if (plug && attempt_plug_merge(q, bio))
+		return 0;
+
 	spin_lock_irq(q->queue_lock);
 
 	if (unlikely(bio_barrier(bio)) || elv_queue_empty(q))
@@ -1257,10 +1316,20 @@ get_rq:
 	 */
 	init_request_from_bio(req, bio);
 
-	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
 	    bio_flagged(bio, BIO_CPU_AFFINE))
-		req->cpu = blk_cpu_to_group(smp_processor_id());
+		req->cpu = blk_cpu_to_group(raw_smp_processor_id());
+
+	if (plug) {
+		/*
+		 * The queue lock is taken once per queue when the plug is
+		 * flushed, not here; unplug hints wait for that too.
+		 */
+		list_add_tail(&req->queuelist, &plug->list);
+		return 0;
+	}
+
+	spin_lock_irq(q->queue_lock);
 	if (queue_should_plug(q) && elv_queue_empty(q))
 		blk_plug_device(q);
 	add_request(q, req);
@@ -1271,6 +1340,75 @@ out:
 	return 0;
 }
 
+/**
+ * blk_start_plug - start holding back the current task's requests
+ * @plug:	The &struct blk_plug, normally on the caller's stack
+ *
+ * Description:
+ *   Requests built by the task from now on are kept on @plug, where
+ *   further bios can be merged into them without taking the queue lock,
+ *   until blk_finish_plug() is called or the task sleeps.  If the task
+ *   already has a plug, that one keeps collecting and @plug stays unused.
+ */
+void blk_start_plug(struct blk_plug *plug)
+{
+	INIT_LIST_HEAD(&plug->list);
+
+	if (!current->plug)
+		current->plug = plug;
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+/**
+ * blk_flush_plug_list - hand plugged requests to their queues
+ * @plug:	The &struct blk_plug to empty
+ *
+ * Description:
+ *   Inserts the requests into their io schedulers and runs each queue,
+ *   taking each queue lock once for all of that queue's requests.
+ */
+void blk_flush_plug_list(struct blk_plug *plug)
+{
+	struct request_queue *q;
+	struct request *rq, *n;
+	LIST_HEAD(list);
+
+	/*
+	 * Detach the list first: running a queue can get us back here via
+	 * schedule() only with an empty plug.
+	 */
+	list_splice_init(&plug->list, &list);
+
+	while (!list_empty(&list)) {
+		q = list_entry_rq(list.next)->q;
+
+		spin_lock_irq(q->queue_lock);
+		list_for_each_entry_safe(rq, n, &list, queuelist) {
+			if (rq->q != q)
+				continue;
+			list_del_init(&rq->queuelist);
+			add_request(q, rq);
+		}
+		trace_block_unplug_io(q);
+		__blk_run_queue(q);
+		spin_unlock_irq(q->queue_lock);
+	}
+}
+EXPORT_SYMBOL(blk_flush_plug_list);
+
+/**
+ * blk_finish_plug - issue the requests held back since blk_start_plug()
+ * @plug:	The &struct blk_plug passed to blk_start_plug()
+ */
+void blk_finish_plug(struct blk_plug *plug)
+{
+	blk_flush_plug_list(plug);
+
+	if (plug == current->plug)
+		current->plug = NULL;
+}
+EXPORT_SYMBOL(blk_finish_plug);
+
 /*
  * If bio->bi_dev is a partition, remap the location
  */
@@ -0,0 +1,481 @@
+/*
+ *  Flash i/o scheduler, for SD/MMC cards, eMMC and USB sticks.
+ *
+ *  Seek time means nothing on these devices.  What is expensive is writing
+ *  an erase block (SD allocation unit) piecemeal, interleaved with writes
+ *  elsewhere, which makes the card's translation layer copy and erase
+ *  behind our back.  So writes are dispatched in groups: all queued writes
+ *  falling in one erase-block sized window, in ascending sector order,
+ *  picking the fullest window first.  Reads always go before writes, unless
+ *  a write has been waiting longer than write_expire.
+ *
+ *  See Documentation/block/flash-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+static const int write_expire = 2 * HZ;	/* max time a write waits for reads */
+static const int default_window_kb = 4096; /* when the device gives no hint */
+
+/* write groups by fill of their window, in quarters; the last is "full" */
+#define FLASH_FILL_BUCKETS	5
+
+struct flash_data {
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * write group in progress: next request and end of its window
+	 */
+	struct request *next_write;
+	sector_t group_end;
+
+	/*
+	 * settings
+	 */
+	int fifo_expire;		/* writes */
+	int window_kb;			/* 0: device's optimal I/O size */
+
+	/*
+	 * statistics
+	 */
+	unsigned long groups;
+	unsigned long group_sectors;
+	unsigned long group_fill[FLASH_FILL_BUCKETS];
+	unsigned long expired_groups;
+	unsigned long preempted_groups;
+};
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static inline struct request *flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static inline void flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq) {
+		fd->next_write = flash_latter_request(rq);
+		if (fd->next_write && blk_rq_pos(fd->next_write) >= fd->group_end)
+			fd->next_write = NULL;
+	}
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * Window size in sectors: the tunable, else the device's optimal I/O size,
+ * which the MMC block driver sets to the card's erase unit.  Looked up each
+ * time because the driver sets it after the elevator has been attached.
+ */
+static unsigned int flash_window_sectors(struct request_queue *q,
+					 struct flash_data *fd)
+{
+	unsigned int kb = fd->window_kb;
+
+	if (!kb)
+		kb = queue_io_opt(q) >> 10;
+	if (!kb)
+		kb = default_window_kb;
+
+	return kb << 1;
+}
+
+static inline sector_t flash_window_start(sector_t sector, unsigned int size)
+{
+	sector_t start = sector;
+
+	/* sector_div() leaves the quotient in its first argument */
+	return start - sector_div(sector, size);
+}
+
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/* reads are served in arrival order, so only writes can expire */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	sector_t sector = bio->bi_sector + bio_sectors(bio);
+	struct request *__rq;
+
+	__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+	if (__rq) {
+		BUG_ON(sector != blk_rq_pos(__rq));
+
+		if (elv_rq_merge_ok(__rq, bio)) {
+			*req = __rq;
+			return ELEVATOR_FRONT_MERGE;
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	flash_remove_request(q, next);
+}
+
+static void flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * First queued write at or after @start
+ */
+static struct request *flash_find_write(struct flash_data *fd, sector_t start)
+{
+	struct rb_node *n = fd->sort_list[WRITE].rb_node;
+	struct request *rq, *found = NULL;
+
+	while (n) {
+		rq = rb_entry_rq(n);
+		if (blk_rq_pos(rq) >= start) {
+			found = rq;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Walk the sorted writes and return the first request of the window with
+ * the most queued sectors.  Bounded by nr_requests, and only done once per
+ * group.
+ */
+static struct request *flash_fullest_window(struct flash_data *fd,
+					    unsigned int size)
+{
+	struct request *rq, *first = NULL, *best = NULL;
+	unsigned long sum = 0, best_sum = 0;
+	sector_t window = 0, w;
+	struct rb_node *node;
+
+	for (node = rb_first(&fd->sort_list[WRITE]); node;
+	     node = rb_next(node)) {
+		rq = rb_entry_rq(node);
+		w = flash_window_start(blk_rq_pos(rq), size);
+		if (!first || w != window) {
+			if (first && sum > best_sum) {
+				best = first;
+				best_sum = sum;
+			}
+			first = rq;
+			window = w;
+			sum = 0;
+		}
+		sum += blk_rq_sectors(rq);
+	}
+	if (first && sum > best_sum)
+		best = first;
+
+	return best;
+}
+
+/*
+ * Start a write group on the window holding @rq and account for it
+ */
+static struct request *flash_start_group(struct flash_data *fd,
+					 struct request *rq, unsigned int size)
+{
+	sector_t start = flash_window_start(blk_rq_pos(rq), size);
+	unsigned long sectors = 0;
+	struct request *pos;
+	unsigned int fill;
+
+	fd->group_end = start + size;
+	rq = flash_find_write(fd, start);
+
+	for (pos = rq; pos && blk_rq_pos(pos) < fd->group_end;
+	     pos = flash_latter_request(pos))
+		sectors += blk_rq_sectors(pos);
+
+	fill = min_t(unsigned long, sectors * (FLASH_FILL_BUCKETS - 1) / size,
+		     FLASH_FILL_BUCKETS - 1);
+	fd->groups++;
+	fd->group_sectors += sectors;
+	fd->group_fill[fill]++;
+
+	return rq;
+}
+
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+	unsigned int size;
+	struct request *rq;
+	int expired;
+
+	if (!reads && !writes)
+		return 0;
+
+	expired = writes && time_after(jiffies, rq_fifo_time(
+			rq_entry_fifo(fd->fifo_list[WRITE].next)));
+
+	/*
+	 * reads first, unless a write has waited too long, in which case
+	 * the group it belongs to is allowed to run to the end
+	 */
+	if (reads && !expired) {
+		if (fd->next_write) {
+			fd->next_write = NULL;
+			fd->preempted_groups++;
+		}
+		rq = rq_entry_fifo(fd->fifo_list[READ].next);
+		flash_move_request(fd, rq);
+		return 1;
+	}
+
+	rq = fd->next_write;
+	if (!rq) {
+		size = flash_window_sectors(q, fd);
+		if (expired) {
+			rq = rq_entry_fifo(fd->fifo_list[WRITE].next);
+			fd->expired_groups++;
+		} else {
+			rq = flash_fullest_window(fd, size);
+		}
+		rq = flash_start_group(fd, rq, size);
+	}
+
+	fd->next_write = flash_latter_request(rq);
+	if (fd->next_write && blk_rq_pos(fd->next_write) >= fd->group_end)
+		fd->next_write = NULL;
+
+	flash_move_request(fd, rq);
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[WRITE])
+		&& list_empty(&fd->fifo_list[READ]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire = write_expire;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire, 1);
+SHOW_FUNCTION(flash_window_kb_show, fd->window_kb, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_window_kb_store, &fd->window_kb, 0, 1024 * 1024, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_window_stats_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	return sprintf(page,
+		       "groups %lu\n"
+		       "sectors %lu\n"
+		       "fill_0_25 %lu\n"
+		       "fill_25_50 %lu\n"
+		       "fill_50_75 %lu\n"
+		       "fill_75_100 %lu\n"
+		       "full %lu\n"
+		       "expired %lu\n"
+		       "preempted %lu\n",
+		       fd->groups, fd->group_sectors,
+		       fd->group_fill[0], fd->group_fill[1],
+		       fd->group_fill[2], fd->group_fill[3],
+		       fd->group_fill[4],
+		       fd->expired_groups, fd->preempted_groups);
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(write_expire),
+	FD_ATTR(window_kb),
+	__ATTR(window_stats, S_IRUGO, flash_window_stats_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -0,0 +1,265 @@
+/*
+ *  linux/block/plug_bench.c
+ *
+ *  On-stack plugging benchmark
+ *
+ *  Registers two RAM-less disks, plugbench0 and plugbench1, whose
+ *  request_fn completes every request at once, so the time spent is
+ *  submission cost only.  The same stream of sequential 4KiB write bios
+ *  (size_mb in total) is sent to plugbench0 one bio at a time and to
+ *  plugbench1 under blk_start_plug()/blk_finish_plug(), one plug per
+ *  window_kb as readahead and writeback do.  For each disk it reports
+ *  the time per MB, and the number of requests and request_fn runs per
+ *  MB, which are the points where the queue lock is taken for a batch.
+ *
+ *  Each queue has a lock of its own, so with CONFIG_LOCK_STAT the queue
+ *  lock acquisitions per MB are the "acquisitions" of plugbench_lock0
+ *  and plugbench_lock1 in /proc/lock_stat divided by size_mb.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/fs.h>
+#include <linux/genhd.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+
+#define PLUGBENCH_SECTORS	(1024 * 1024 * 2)	/* 1GB, wraps around */
+
+static unsigned int size_mb = 256;
+module_param(size_mb, uint, 0444);
+MODULE_PARM_DESC(size_mb, "MB written to each disk");
+
+static unsigned int window_kb = 128;
+module_param(window_kb, uint, 0444);
+MODULE_PARM_DESC(window_kb, "KiB submitted per plug");
+
+struct plugbench_dev {
+	struct gendisk		*disk;
+	struct request_queue	*queue;
+	struct block_device	*bdev;
+	unsigned long		nr_requests;
+	unsigned long		nr_runs;
+};
+
+/* one static lock per queue, so that lock_stat keeps them apart */
+static DEFINE_SPINLOCK(plugbench_lock0);
+static DEFINE_SPINLOCK(plugbench_lock1);
+
+static struct plugbench_dev plugbench_devs[2];
+static int plugbench_major;
+static struct page *plugbench_page;
+static atomic_t plugbench_inflight = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(plugbench_wait);
+
+static struct block_device_operations plugbench_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static void plugbench_request(struct request_queue *q)
+{
+	struct plugbench_dev *dev = q->queuedata;
+	struct request *req;
+
+	dev->nr_runs++;
+	while ((req = blk_fetch_request(q)) != NULL) {
+		/* reads by anybody else (udev, blkid) see zeroes */
+		if (rq_data_dir(req) == READ) {
+			struct req_iterator iter;
+			struct bio_vec *bvec;
+
+			rq_for_each_segment(bvec, req, iter) {
+				void *p = kmap_atomic(bvec->bv_page, KM_USER0);
+
+				memset(p + bvec->bv_offset, 0, bvec->bv_len);
+				kunmap_atomic(p, KM_USER0);
+			}
+		}
+		dev->nr_requests++;
+		__blk_end_request_all(req, 0);
+	}
+}
+
+static void plugbench_end_io(struct bio *bio, int err)
+{
+	bio_put(bio);
+	if (atomic_dec_and_test(&plugbench_inflight))
+		wake_up(&plugbench_wait);
+}
+
+static int plugbench_submit(struct plugbench_dev *dev, sector_t sector)
+{
+	struct bio *bio = bio_alloc(GFP_KERNEL, 1);
+
+	if (!bio)
+		return -ENOMEM;
+	bio->bi_bdev = dev->bdev;
+	bio->bi_sector = sector;
+	bio->bi_end_io = plugbench_end_io;
+	bio_add_page(bio, plugbench_page, PAGE_SIZE, 0);
+	atomic_inc(&plugbench_inflight);
+	submit_bio(WRITE, bio);
+	return 0;
+}
+
+/* Returns the nanoseconds taken to submit and complete size_mb */
+static s64 plugbench_run(struct plugbench_dev *dev, int plugged)
+{
+	unsigned long nr = ((unsigned long)size_mb << 20) >> PAGE_SHIFT;
+	unsigned long per_plug = max(1U, (window_kb << 10) >> PAGE_SHIFT);
+	sector_t sector = 0;
+	unsigned long i = 0;
+	ktime_t t0;
+
+	dev->nr_requests = dev->nr_runs = 0;
+	t0 = ktime_get();
+	while (i < nr) {
+		struct blk_plug plug;
+		unsigned long end = min(nr, i + per_plug);
+
+		if (plugged)
+			blk_start_plug(&plug);
+		for (; i < end; i++) {
+			if (plugbench_submit(dev, sector))
+				break;
+			sector += PAGE_SIZE >> 9;
+			if (sector >= PLUGBENCH_SECTORS)
+				sector = 0;
+		}
+		if (plugged)
+			blk_finish_plug(&plug);
+		else
+			blk_unplug(dev->queue);
+		if (i < end)
+			break;
+		cond_resched();
+	}
+	wait_event(plugbench_wait, !atomic_read(&plugbench_inflight));
+	return ktime_to_ns(ktime_sub(ktime_get(), t0));
+}
+
+static void plugbench_report(const char *what, struct plugbench_dev *dev,
+			     s64 ns)
+{
+	printk(KERN_INFO "plug_bench: %-9s %llu us/MB, %lu requests/MB, "
+	       "%lu request_fn runs/MB\n", what,
+	       div64_u64(ns, (u64)size_mb * 1000),
+	       dev->nr_requests / size_mb, dev->nr_runs / size_mb);
+}
+
+static void plugbench_remove(struct plugbench_dev *dev)
+{
+	if (dev->bdev)
+		blkdev_put(dev->bdev, FMODE_READ | FMODE_WRITE);
+	if (dev->disk) {
+		del_gendisk(dev->disk);
+		put_disk(dev->disk);
+	}
+	if (dev->queue)
+		blk_cleanup_queue(dev->queue);
+	memset(dev, 0, sizeof(*dev));
+}
+
+static int plugbench_add(struct plugbench_dev *dev, int i, spinlock_t *lock)
+{
+	struct block_device *bdev;
+	int err = -ENOMEM;
+
+	dev->queue = blk_init_queue(plugbench_request, lock);
+	if (!dev->queue)
+		goto out;
+	dev->queue->queuedata = dev;
+	blk_queue_max_sectors(dev->queue, 1024);
+
+	dev->disk = alloc_disk(1);
+	if (!dev->disk)
+		goto out;
+	dev->disk->major = plugbench_major;
+	dev->disk->first_minor = i;
+	dev->disk->fops = &plugbench_fops;
+	dev->disk->queue = dev->queue;
+	dev->disk->private_data = dev;
+	sprintf(dev->disk->disk_name, "plugbench%d", i);
+	set_capacity(dev->disk, PLUGBENCH_SECTORS);
+	add_disk(dev->disk);
+
+	bdev = bdget_disk(dev->disk, 0);
+	if (!bdev)
+		goto out;
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE);
+	if (err)
+		goto out;
+	dev->bdev = bdev;
+	return 0;
+
+out:
+	plugbench_remove(dev);
+	return err;
+}
+
+static int __init plug_bench_init(void)
+{
+	s64 unplugged, plugged;
+	int err;
+
+	if (!size_mb || !window_kb)
+		return -EINVAL;
+
+	plugbench_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	if (!plugbench_page)
+		return -ENOMEM;
+
+	err = plugbench_major = register_blkdev(0, "plugbench");
+	if (err < 0)
+		goto out_page;
+
+	err = plugbench_add(&plugbench_devs[0], 0, &plugbench_lock0);
+	if (err)
+		goto out_unregister;
+	err = plugbench_add(&plugbench_devs[1], 1, &plugbench_lock1);
+	if (err)
+		goto out_remove;
+
+	/* warm up the bio and request slabs */
+	plugbench_run(&plugbench_devs[0], 0);
+
+	unplugged = plugbench_run(&plugbench_devs[0], 0);
+	plugged = plugbench_run(&plugbench_devs[1], 1);
+
+	printk(KERN_INFO "plug_bench: %u MB of 4KiB writes, %u KiB per plug\n",
+	       size_mb, window_kb);
+	plugbench_report("unplugged", &plugbench_devs[0], unplugged);
+	plugbench_report("plugged", &plugbench_devs[1], plugged);
+	return 0;
+
+out_remove:
+	plugbench_remove(&plugbench_devs[0]);
+out_unregister:
+	unregister_blkdev(plugbench_major, "plugbench");
+out_page:
+	__free_page(plugbench_page);
+	return err;
+}
+
+static void __exit plug_bench_exit(void)
+{
+	plugbench_remove(&plugbench_devs[1]);
+	plugbench_remove(&plugbench_devs[0]);
+	unregister_blkdev(plugbench_major, "plugbench");
+	__free_page(plugbench_page);
+}
+
+module_init(plug_bench_init);
+module_exit(plug_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("On-stack plugging benchmark");
@@ -43,6 +43,9 @@
  * operations write_begin is not available on the backing filesystem.
  * Anton Altaparmakov, 16 Feb 2005
  *
+ * Optional direct mapping of fully allocated backing files onto the
+ * underlying block device, bypassing the page cache and the loop thread.
+ *
  * Still To Fix:
  * - Advisory locking is ignored here.
  * - Should use an own CAP_* category instead of CAP_SYS_ADMIN
@@ -74,6 +77,7 @@
 #include <linux/gfp.h>
 #include <linux/kthread.h>
 #include <linux/splice.h>
+#include <linux/vmalloc.h>
 
 #include <asm/uaccess.h>
 
@@ -505,6 +509,330 @@ out:
 	return ret;
 }
 
+/*
+ * Direct mapping (LO_FLAGS_DIRECT_MAP).
+ *
+ * As for a swap file, the backing file is translated once through ->bmap()
+ * into extents on the block device its filesystem lives on.  Bios are then
+ * remapped and sent there straight from loop_make_request(), as many at a
+ * time as the submitters like, instead of being copied through the file's
+ * page cache one at a time by the loop thread.  The file must be fully
+ * allocated, and is marked S_SWAPFILE meanwhile so that the filesystem
+ * does not truncate or move it underneath us.
+ */
+struct loop_direct_io {
+	struct loop_device	*lo;
+	struct bio		*bio;
+	atomic_t		remaining;
+	int			error;
+};
+
+#define LOOP_DIRECT_POOL_SIZE	16
+
+static int loop_flush(struct loop_device *lo);
+
+/*
+ * Fill @ext (if not NULL) with the extents backing the device and return
+ * how many there are, or -EINVAL if the file has holes.
+ */
+static int loop_map_extents(struct loop_device *lo, struct loop_extent *ext)
+{
+	struct inode *inode = lo->lo_backing_file->f_mapping->host;
+	unsigned int shift = inode->i_blkbits - 9;
+	sector_t first = lo->lo_offset >> inode->i_blkbits;
+	sector_t nr_blocks, block, phys, prev = 0;
+	int nr = 0;
+
+	nr_blocks = (get_capacity(lo->lo_disk) + (1 << shift) - 1) >> shift;
+
+	for (block = 0; block < nr_blocks; block++) {
+		phys = bmap(inode, first + block);
+		if (!phys)
+			return -EINVAL;
+
+		if (nr && phys == prev + 1) {
+			if (ext)
+				ext[nr - 1].nr_sects += 1 << shift;
+		} else {
+			if (ext) {
+				ext[nr].start = block << shift;
+				ext[nr].nr_sects = 1 << shift;
+				ext[nr].disk_start = phys << shift;
+			}
+			nr++;
+		}
+		prev = phys;
+
+		cond_resched();
+	}
+
+	return nr;
+}
+
+static struct loop_extent *loop_find_extent(struct loop_device *lo,
+					    sector_t sector)
+{
+	unsigned int l = 0, r = lo->lo_nr_extents, mid;
+	struct loop_extent *ext;
+
+	while (l < r) {
+		mid = (l + r) / 2;
+		ext = &lo->lo_extents[mid];
+
+		if (sector < ext->start)
+			r = mid;
+		else if (sector >= ext->start + ext->nr_sects)
+			l = mid + 1;
+		else
+			return ext;
+	}
+
+	return NULL;
+}
+
+static void loop_direct_put(struct loop_direct_io *dio)
+{
+	struct loop_device *lo = dio->lo;
+
+	if (!atomic_dec_and_test(&dio->remaining))
+		return;
+
+	bio_endio(dio->bio, dio->error);
+	mempool_free(dio, lo->lo_direct_pool);
+
+	if (atomic_dec_and_test(&lo->lo_direct_pending))
+		wake_up(&lo->lo_event);
+}
+
+static void loop_direct_end_io(struct bio *bio, int error)
+{
+	struct loop_direct_io *dio = bio->bi_private;
+
+	if (error)
+		dio->error = error;
+
+	bio_put(bio);
+	loop_direct_put(dio);
+}
+
+static struct bio *loop_direct_alloc(struct loop_direct_io *dio,
+				     struct loop_extent *ext, sector_t sector,
+				     int nr_vecs)
+{
+	struct bio *bio = dio->bio;
+	struct bio *clone;
+
+	/*
+	 * Not from fs_bio_set: the bio being remapped may well come from
+	 * there, and under memory pressure the clone would wait for its
+	 * reserve to be refilled by bios that cannot complete without it.
+	 */
+	clone = bio_alloc_bioset(GFP_NOIO, min(nr_vecs, BIO_MAX_PAGES),
+				 dio->lo->lo_direct_bio_set);
+	clone->bi_sector = ext->disk_start + (sector - ext->start);
+	clone->bi_bdev = dio->lo->lo_direct_bdev;
+	clone->bi_rw = bio->bi_rw;
+	clone->bi_end_io = loop_direct_end_io;
+	clone->bi_private = dio;
+
+	return clone;
+}
+
+static void loop_direct_send(struct loop_direct_io *dio, struct bio *clone)
+{
+	atomic_inc(&dio->remaining);
+	generic_make_request(clone);
+}
+
+/*
+ * Remap @bio onto the backing block device.  It is rebuilt page by page
+ * with bio_add_page(), so the pieces respect that device's limits and
+ * are split wherever the file is discontiguous on disk.
+ */
+static void loop_direct_submit(struct loop_device *lo, struct bio *bio)
+{
+	struct loop_direct_io *dio;
+	struct loop_extent *ext = NULL;
+	struct bio *clone = NULL;
+	struct bio_vec *bvec;
+	sector_t sector = bio->bi_sector;
+	sector_t end;
+	unsigned int off, len, n;
+	int i;
+
+	dio = mempool_alloc(lo->lo_direct_pool, GFP_NOIO);
+	dio->lo = lo;
+	dio->bio = bio;
+	dio->error = 0;
+	atomic_set(&dio->remaining, 1);
+
+	if (bio_empty_barrier(bio)) {
+		ext = &lo->lo_extents[0];
+		clone = loop_direct_alloc(dio, ext, ext->start, 0);
+		goto out;
+	}
+
+	bio_for_each_segment(bvec, bio, i) {
+		off = bvec->bv_offset;
+		len = bvec->bv_len;
+
+		while (len) {
+			if (!ext || sector >= ext->start + ext->nr_sects) {
+				ext = loop_find_extent(lo, sector);
+				if (!ext) {
+					dio->error = -EIO;
+					goto out;
+				}
+				if (clone) {
+					loop_direct_send(dio, clone);
+					clone = NULL;
+				}
+			}
+
+			n = len;
+			end = ext->start + ext->nr_sects;
+			if ((n >> 9) > end - sector)
+				n = (end - sector) << 9;
+
+			if (!clone)
+				clone = loop_direct_alloc(dio, ext, sector,
+							  bio->bi_vcnt - i);
+
+			if (bio_add_page(clone, bvec->bv_page, n, off) < n) {
+				if (!clone->bi_size) {
+					bio_put(clone);
+					clone = NULL;
+					dio->error = -EIO;
+					goto out;
+				}
+				loop_direct_send(dio, clone);
+				clone = NULL;
+				continue;
+			}
+
+			sector += n >> 9;
+			off += n;
+			len -= n;
+		}
+	}
+
+out:
+	if (clone)
+		loop_direct_send(dio, clone);
+	loop_direct_put(dio);
+}
+
+/*
+ * Switch the device to direct mapping.  Called with lo_ctl_mutex held
+ * and nobody else having the device open.
+ */
+static int loop_direct_start(struct loop_device *lo)
+{
+	struct file *file = lo->lo_backing_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct loop_extent *ext = NULL;
+	struct bio_set *bs;
+	mempool_t *pool;
+	int nr, err;
+
+	if (!S_ISREG(inode->i_mode) || !mapping->a_ops->bmap ||
+	    !inode->i_sb->s_bdev || lo->lo_encryption)
+		return -EINVAL;
+	if (lo->lo_offset & ((1 << inode->i_blkbits) - 1))
+		return -EINVAL;
+	if (lo->lo_refcnt > 1)
+		return -EBUSY;
+
+	pool = mempool_create_kmalloc_pool(LOOP_DIRECT_POOL_SIZE,
+					   sizeof(struct loop_direct_io));
+	if (!pool)
+		return -ENOMEM;
+	bs = bioset_create(LOOP_DIRECT_POOL_SIZE, 0);
+	if (!bs) {
+		mempool_destroy(pool);
+		return -ENOMEM;
+	}
+
+	/* nothing may be left in the thread when bios start to bypass it */
+	loop_flush(lo);
+
+	mutex_lock(&inode->i_mutex);
+	err = -EBUSY;
+	if (IS_SWAPFILE(inode))
+		goto out_unlock;
+
+	/* delayed allocation only assigns blocks at writeback */
+	err = filemap_write_and_wait(mapping);
+	if (err)
+		goto out_unlock;
+
+	err = nr = loop_map_extents(lo, NULL);
+	if (nr <= 0) {
+		if (!nr)
+			err = -EINVAL;
+		goto out_unlock;
+	}
+
+	err = -ENOMEM;
+	ext = vmalloc(nr * sizeof(*ext));
+	if (!ext)
+		goto out_unlock;
+	loop_map_extents(lo, ext);
+
+	inode->i_flags |= S_SWAPFILE;
+	mutex_unlock(&inode->i_mutex);
+
+	/* cached copies would go stale once writes bypass them */
+	invalidate_inode_pages2(mapping);
+
+	lo->lo_extents = ext;
+	lo->lo_nr_extents = nr;
+	lo->lo_direct_bdev = inode->i_sb->s_bdev;
+	lo->lo_direct_pool = pool;
+	lo->lo_direct_bio_set = bs;
+	atomic_set(&lo->lo_direct_pending, 0);
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_flags |= LO_FLAGS_DIRECT_MAP;
+	spin_unlock_irq(&lo->lo_lock);
+
+	return 0;
+
+out_unlock:
+	mutex_unlock(&inode->i_mutex);
+	bioset_free(bs);
+	mempool_destroy(pool);
+	return err;
+}
+
+static void loop_direct_stop(struct loop_device *lo)
+{
+	struct address_space *mapping = lo->lo_backing_file->f_mapping;
+	struct inode *inode = mapping->host;
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_MAP;
+	spin_unlock_irq(&lo->lo_lock);
+
+	wait_event(lo->lo_event, !atomic_read(&lo->lo_direct_pending));
+
+	mutex_lock(&inode->i_mutex);
+	inode->i_flags &= ~S_SWAPFILE;
+	mutex_unlock(&inode->i_mutex);
+
+	invalidate_inode_pages2(mapping);
+
+	bioset_free(lo->lo_direct_bio_set);
+	mempool_destroy(lo->lo_direct_pool);
+	vfree(lo->lo_extents);
+	lo->lo_direct_bio_set = NULL;
+	lo->lo_direct_pool = NULL;
+	lo->lo_extents = NULL;
+	lo->lo_nr_extents = 0;
+	lo->lo_direct_bdev = NULL;
+}
+
 /*
  * Add bio to back of pending list
  */
@@ -536,6 +864,12 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 		goto out;
 	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
 		goto out;
+	if (lo->lo_flags & LO_FLAGS_DIRECT_MAP) {
+		atomic_inc(&lo->lo_direct_pending);
+		spin_unlock_irq(&lo->lo_lock);
+		loop_direct_submit(lo, old_bio);
+		return 0;
+	}
 	loop_add_bio(lo, old_bio);
 	wake_up(&lo->lo_event);
 	spin_unlock_irq(&lo->lo_lock);
@@ -695,6 +1029,10 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 	if (!(lo->lo_flags & LO_FLAGS_READ_ONLY))
 		goto out;
 
+	/* and go through the loop thread */
+	if (lo->lo_flags & LO_FLAGS_DIRECT_MAP)
+		goto out;
+
 	error = -EBADF;
 	file = fget(arg);
 	if (!file)
@@ -924,6 +1262,9 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 
 	kthread_stop(lo->lo_thread);
 
+	if (lo->lo_flags & LO_FLAGS_DIRECT_MAP)
+		loop_direct_stop(lo);
+
 	lo->lo_queue->unplug_fn = NULL;
 	lo->lo_backing_file = NULL;
 
@@ -978,6 +1319,17 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
 
+	/* the extent map is only valid for the current offset and size */
+	if ((lo->lo_flags & LO_FLAGS_DIRECT_MAP) &&
+	    (!(info->lo_flags & LO_FLAGS_DIRECT_MAP) ||
+	     info->lo_encrypt_type ||
+	     lo->lo_offset != info->lo_offset ||
+	     lo->lo_sizelimit != info->lo_sizelimit)) {
+		if (lo->lo_refcnt > 1)
+			return -EBUSY;
+		loop_direct_stop(lo);
+	}
+
 	err = loop_release_xfer(lo);
 	if (err)
 		return err;
@@ -1028,6 +1380,10 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		lo->lo_key_owner = uid;
 	}	
 
+	if ((info->lo_flags & LO_FLAGS_DIRECT_MAP) &&
+	    !(lo->lo_flags & LO_FLAGS_DIRECT_MAP))
+		return loop_direct_start(lo);
+
 	return 0;
 }
 
@@ -1179,6 +1535,10 @@ static int loop_set_capacity(struct loop_device *lo, struct block_device *bdev)
 	err = -ENXIO;
 	if (unlikely(lo->lo_state != Lo_bound))
 		goto out;
+	/* the extent map would no longer cover the device */
+	err = -EBUSY;
+	if (lo->lo_flags & LO_FLAGS_DIRECT_MAP)
+		goto out;
 	err = figure_loop_size(lo);
 	if (unlikely(err))
 		goto out;
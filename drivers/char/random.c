@@ -240,6 +240,7 @@
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
 #include <linux/cryptohash.h>
+#include <linux/kthread.h>
 
 #ifdef CONFIG_GENERIC_HARDIRQS
 # include <linux/irq.h>
@@ -712,6 +713,26 @@ void add_disk_randomness(struct gendisk *disk)
 }
 #endif
 
+/*
+ * Mix a batch of hardware RNG output into the input pool and credit it
+ * with @entropy bits.  Meant for a feeder thread: it sleeps until the pool
+ * drops below the write wakeup threshold (or the thread is being stopped),
+ * so the hardware is only drained when the pool actually wants more.
+ */
+void add_hwgenerator_randomness(const char *buffer, size_t count,
+				size_t entropy)
+{
+	wait_event_interruptible(random_write_wait, kthread_should_stop() ||
+			input_pool.entropy_count < random_write_wakeup_thresh);
+	if (kthread_should_stop())
+		return;
+
+	DEBUG_ENT("hwrng batch of %zu bytes\n", count);
+	mix_pool_bytes(&input_pool, buffer, count);
+	credit_entropy_bits(&input_pool, entropy);
+}
+EXPORT_SYMBOL_GPL(add_hwgenerator_randomness);
+
 #define EXTRACT_SIZE 10
 
 /*********************************************************************
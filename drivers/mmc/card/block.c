@@ -61,6 +61,9 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+	unsigned int	flags;
+#define MMC_BLK_CMD23	(1 << 0)	/* card and host do SET_BLOCK_COUNT */
+#define MMC_BLK_REL_WR	(1 << 1)	/* FUA writes use reliable write */
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -139,6 +142,7 @@ static struct block_device_operations mmc_bdops = {
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
+	struct mmc_command	sbc;
 	struct mmc_command	cmd;
 	struct mmc_command	stop;
 	struct mmc_data		data;
@@ -234,12 +238,38 @@ static u32 get_card_status(struct mmc_card *card, struct request *req)
 	return cmd.resp[0];
 }
 
+static void mmc_blk_prepare_flush(struct request_queue *q,
+				  struct request *req)
+{
+	req->cmd_type = REQ_TYPE_LINUX_BLOCK;
+	req->cmd[0] = REQ_LB_OP_FLUSH;
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
 	struct mmc_blk_request brq;
 	int ret = 1, disable_multi = 0;
+	int do_rel_wr;
+
+	/*
+	 * The card has no volatile write cache: a write is on the media once
+	 * the card leaves programming state, so a barrier flush is a no-op.
+	 */
+	if (mmc_req_is_flush(req)) {
+		spin_lock_irq(&md->lock);
+		__blk_end_request_all(req, 0);
+		spin_unlock_irq(&md->lock);
+		return 1;
+	}
+
+	/*
+	 * Forced-unit-access writes are done as reliable writes: the card
+	 * then either commits the whole write or leaves the old data.
+	 */
+	do_rel_wr = (md->flags & MMC_BLK_REL_WR) &&
+		    rq_data_dir(req) == WRITE && blk_fua_rq(req);
 
 	mmc_claim_host(card->host);
 
@@ -277,7 +307,21 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		if (disable_multi && brq.data.blocks > 1)
 			brq.data.blocks = 1;
 
-		if (brq.data.blocks > 1) {
+		/*
+		 * Without WR_REL_PARAM_EN, a reliable write has to be one
+		 * aligned unit of rel_sectors, or a single sector.
+		 */
+		if (do_rel_wr &&
+		    !(card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN)) {
+			if ((u32)blk_rq_pos(req) % card->ext_csd.rel_sectors)
+				brq.data.blocks = 1;
+			else if (brq.data.blocks > card->ext_csd.rel_sectors)
+				brq.data.blocks = card->ext_csd.rel_sectors;
+			else if (brq.data.blocks < card->ext_csd.rel_sectors)
+				brq.data.blocks = 1;
+		}
+
+		if (brq.data.blocks > 1 || do_rel_wr) {
 			/* SPI multiblock writes terminate using a special
 			 * token, not a STOP_TRANSMISSION request.
 			 */
@@ -305,6 +349,28 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		brq.data.sg = mq->sg;
 		brq.data.sg_len = mmc_queue_map_sg(mq);
 
+		/*
+		 * If not all of the request fit the bounce buffer, send
+		 * what did and map the rest on the next pass.
+		 */
+		if (brq.data.blocks > mq->sg_bytes >> 9)
+			brq.data.blocks = mq->sg_bytes >> 9;
+
+		/*
+		 * Announce the length of multiblock transfers with CMD23
+		 * where card and host can, instead of ending them with
+		 * CMD12; the card can then plan the write up front.
+		 */
+		if (brq.mrq.stop && (md->flags & MMC_BLK_CMD23)) {
+			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
+			brq.sbc.arg = brq.data.blocks;
+			if (do_rel_wr)
+				brq.sbc.arg |= MMC_SBC_RELIABLE_WRITE;
+			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			brq.mrq.sbc = &brq.sbc;
+			brq.mrq.stop = NULL;
+		}
+
 		/*
 		 * Adjust the sg list so it is the same size as the
 		 * request.
@@ -330,6 +396,22 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 		mmc_queue_bounce_post(mq);
 
+		/*
+		 * A card that advertises CMD23 but rejects it gets
+		 * open-ended transfers from now on; nothing was
+		 * transferred, so just go again.
+		 */
+		if (brq.sbc.error) {
+			printk(KERN_WARNING "%s: error %d sending "
+			       "SET_BLOCK_COUNT, response %#x, falling back "
+			       "to STOP_TRANSMISSION\n",
+			       req->rq_disk->disk_name, brq.sbc.error,
+			       brq.sbc.resp[0]);
+			md->flags &= ~(MMC_BLK_CMD23 | MMC_BLK_REL_WR);
+			do_rel_wr = 0;
+			continue;
+		}
+
 		/*
 		 * Check for errors here, but don't jump to cmd_err
 		 * until later as we need to wait for the card to leave
@@ -508,6 +590,25 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
 
+	/*
+	 * CMD23 is mandatory from MMC 3.1 on; SD cards list it in the SCR.
+	 * Reliable writes need it, and an EXT_CSD saying how big they are.
+	 */
+	if (card->host->caps & MMC_CAP_CMD23) {
+		if ((mmc_card_mmc(card) &&
+		     card->csd.mmca_vsn >= CSD_SPEC_VER_3) ||
+		    (mmc_card_sd(card) &&
+		     (card->scr.cmds & SD_SCR_CMD23_SUPPORT)))
+			md->flags |= MMC_BLK_CMD23;
+
+		if (mmc_card_mmc(card) && card->ext_csd.rel_sectors &&
+		    (md->flags & MMC_BLK_CMD23) &&
+		    !blk_queue_ordered(md->queue.queue,
+				       QUEUE_ORDERED_DRAIN_FUA,
+				       mmc_blk_prepare_flush))
+			md->flags |= MMC_BLK_REL_WR;
+	}
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx << MMC_SHIFT;
 	md->disk->fops = &mmc_bdops;
@@ -14,6 +14,7 @@
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
+#include <linux/debugfs.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -22,6 +23,7 @@
 #define MMC_QUEUE_BOUNCESZ	65536
 
 #define MMC_QUEUE_SUSPENDED	(1 << 0)
+#define MMC_QUEUE_BOUNCE_SEGS	(1 << 1)
 
 /*
  * Prepare a MMC request. This just filters out odd stuff.
@@ -29,9 +31,10 @@
 static int mmc_prep_request(struct request_queue *q, struct request *req)
 {
 	/*
-	 * We only like normal block requests.
+	 * We only like normal block requests, and the barrier flushes
+	 * set up by mmc_blk_prepare_flush().
 	 */
-	if (!blk_fs_request(req)) {
+	if (!blk_fs_request(req) && !mmc_req_is_flush(req)) {
 		blk_dump_rq_flags(req, "MMC bad request");
 		return BLKPREP_KILL;
 	}
@@ -177,7 +180,39 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	}
 #endif
 
-	if (!mq->bounce_buf) {
+	/*
+	 * Hosts that do scatter-gather, but only from aligned segments,
+	 * get their real limits; segments that break the alignment are
+	 * copied one by one through a small buffer.
+	 */
+	if (host->seg_align && host->max_hw_segs > 1) {
+		unsigned int bouncesz;
+
+		bouncesz = MMC_QUEUE_BOUNCESZ;
+
+		if (bouncesz > host->max_seg_size)
+			bouncesz = host->max_seg_size;
+		if (bouncesz > (host->max_blk_count * 512))
+			bouncesz = host->max_blk_count * 512;
+
+		mq->bounce_buf = kmalloc(bouncesz, GFP_KERNEL);
+		if (!mq->bounce_buf) {
+			ret = -ENOMEM;
+			goto cleanup_queue;
+		}
+		mq->bounce_size = bouncesz;
+		mq->flags |= MMC_QUEUE_BOUNCE_SEGS;
+
+		mq->bounce_sg = kmalloc(sizeof(struct scatterlist) *
+			host->max_phys_segs, GFP_KERNEL);
+		if (!mq->bounce_sg) {
+			ret = -ENOMEM;
+			goto cleanup_queue;
+		}
+		sg_init_table(mq->bounce_sg, host->max_phys_segs);
+	}
+
+	if (!mq->bounce_buf || (mq->flags & MMC_QUEUE_BOUNCE_SEGS)) {
 		blk_queue_bounce_limit(mq->queue, limit);
 		blk_queue_max_sectors(mq->queue,
 			min(host->max_blk_count, host->max_req_size / 512));
@@ -194,6 +229,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 		sg_init_table(mq->sg, host->max_phys_segs);
 	}
 
+	/* lets the flash elevator and mkfs line writes up with erase units */
+	if (card->erase_size)
+		blk_queue_io_opt(mq->queue, card->erase_size << 9);
+
 	init_MUTEX(&mq->thread_sem);
 
 	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd");
@@ -202,6 +241,18 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 		goto free_bounce_sg;
 	}
 
+#ifdef CONFIG_DEBUG_FS
+	if (card->debugfs_root) {
+		mq->debugfs = debugfs_create_dir("queue", card->debugfs_root);
+		if (mq->debugfs) {
+			debugfs_create_u64("bounce_bytes", S_IRUSR,
+				mq->debugfs, &mq->bounce_bytes);
+			debugfs_create_u64("direct_bytes", S_IRUSR,
+				mq->debugfs, &mq->direct_bytes);
+		}
+	}
+#endif
+
 	return 0;
  free_bounce_sg:
  	if (mq->bounce_sg)
@@ -234,6 +285,9 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
 
+	debugfs_remove_recursive(mq->debugfs);
+	mq->debugfs = NULL;
+
  	if (mq->bounce_sg)
  		kfree(mq->bounce_sg);
  	mq->bounce_sg = NULL;
@@ -295,6 +349,68 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * Map the request in place, except for the segments the host cannot DMA
+ * from: those are pointed at the bounce buffer instead, and the original
+ * entry is kept at the same index in bounce_sg (which has a zero length
+ * for segments mapped in place).  If the bounced segments don't all fit,
+ * the list stops short and mq->sg_bytes tells the caller how much of the
+ * request it covers.
+ */
+static unsigned int mmc_queue_map_sg_segs(struct mmc_queue *mq)
+{
+	unsigned int align = mq->card->host->seg_align;
+	char *buf = mq->bounce_buf;
+	char *end = mq->bounce_buf + mq->bounce_size;
+	unsigned int sg_len, len, bytes = 0;
+	struct scatterlist *sg, *orig;
+	int i;
+
+	BUG_ON(!mq->bounce_sg);
+
+	sg_len = blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+
+	for_each_sg(mq->sg, sg, sg_len, i) {
+		orig = &mq->bounce_sg[i];
+
+		if (!(sg->offset & (align - 1))) {
+			orig->length = 0;
+			mq->direct_bytes += sg->length;
+			bytes += sg->length;
+			continue;
+		}
+
+		buf = PTR_ALIGN(buf, align);
+		len = sg->length;
+		if (buf + len > end) {
+			if (i) {
+				sg_len = i;
+				break;
+			}
+			len = (end - buf) & ~511;
+		}
+
+		*orig = *sg;
+		sg_set_buf(sg, buf, len);
+		buf += len;
+
+		mq->bounce_bytes += len;
+		bytes += len;
+
+		if (len < orig->length) {
+			sg_len = i + 1;
+			break;
+		}
+	}
+
+	sg_mark_end(&mq->sg[sg_len - 1]);
+
+	mq->bounce_sg_len = sg_len;
+	mq->sg_bytes = bytes;
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -305,8 +421,14 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
 	struct scatterlist *sg;
 	int i;
 
-	if (!mq->bounce_buf)
+	if (mq->flags & MMC_QUEUE_BOUNCE_SEGS)
+		return mmc_queue_map_sg_segs(mq);
+
+	if (!mq->bounce_buf) {
+		mq->sg_bytes = blk_rq_bytes(mq->req);
+		mq->direct_bytes += mq->sg_bytes;
 		return blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+	}
 
 	BUG_ON(!mq->bounce_sg);
 
@@ -320,9 +442,38 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
 
 	sg_init_one(mq->sg, mq->bounce_buf, buflen);
 
+	mq->sg_bytes = buflen;
+	mq->bounce_bytes += buflen;
+
 	return 1;
 }
 
+/*
+ * Copy the segments mmc_queue_map_sg_segs() bounced to or from the
+ * bounce buffer.  The caller may have trimmed the sg list since.
+ */
+static void mmc_queue_copy_segs(struct mmc_queue *mq, int to_buffer)
+{
+	struct scatterlist *sg, *orig;
+	unsigned long flags;
+	unsigned int len;
+	int i;
+
+	local_irq_save(flags);
+	for_each_sg(mq->sg, sg, mq->bounce_sg_len, i) {
+		orig = &mq->bounce_sg[i];
+		if (!orig->length)
+			continue;
+
+		len = min(sg->length, orig->length);
+		if (to_buffer)
+			sg_copy_to_buffer(orig, 1, sg_virt(sg), len);
+		else
+			sg_copy_from_buffer(orig, 1, sg_virt(sg), len);
+	}
+	local_irq_restore(flags);
+}
+
 /*
  * If writing, bounce the data to the buffer before the request
  * is sent to the host driver
@@ -337,6 +488,11 @@ void mmc_queue_bounce_pre(struct mmc_queue *mq)
 	if (rq_data_dir(mq->req) != WRITE)
 		return;
 
+	if (mq->flags & MMC_QUEUE_BOUNCE_SEGS) {
+		mmc_queue_copy_segs(mq, 1);
+		return;
+	}
+
 	local_irq_save(flags);
 	sg_copy_to_buffer(mq->bounce_sg, mq->bounce_sg_len,
 		mq->bounce_buf, mq->sg[0].length);
@@ -357,6 +513,11 @@ void mmc_queue_bounce_post(struct mmc_queue *mq)
 	if (rq_data_dir(mq->req) != READ)
 		return;
 
+	if (mq->flags & MMC_QUEUE_BOUNCE_SEGS) {
+		mmc_queue_copy_segs(mq, 0);
+		return;
+	}
+
 	local_irq_save(flags);
 	sg_copy_from_buffer(mq->bounce_sg, mq->bounce_sg_len,
 		mq->bounce_buf, mq->sg[0].length);
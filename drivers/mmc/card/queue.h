@@ -3,6 +3,7 @@
 
 struct request;
 struct task_struct;
+struct dentry;
 
 struct mmc_queue {
 	struct mmc_card		*card;
@@ -15,10 +16,20 @@ struct mmc_queue {
 	struct request_queue	*queue;
 	struct scatterlist	*sg;
 	char			*bounce_buf;
+	unsigned int		bounce_size;
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
+	unsigned int		sg_bytes;	/* bytes mapped to sg */
+	u64			bounce_bytes;	/* bytes copied via bounce_buf */
+	u64			direct_bytes;	/* bytes mapped in place */
+	struct dentry		*debugfs;
 };
 
+/* Barrier flush request, see mmc_blk_prepare_flush() */
+#define mmc_req_is_flush(req)					\
+	((req)->cmd_type == REQ_TYPE_LINUX_BLOCK &&		\
+	 (req)->cmd[0] == REQ_LB_OP_FLUSH)
+
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *);
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
@@ -255,14 +255,19 @@ int mmc_add_card(struct mmc_card *card)
 			type, card->rca);
 	}
 
-	ret = device_add(&card->dev);
-	if (ret)
-		return ret;
-
+	/* before device_add(), so the card driver can add its own entries */
 #ifdef CONFIG_DEBUG_FS
 	mmc_add_card_debugfs(card);
 #endif
 
+	ret = device_add(&card->dev);
+	if (ret) {
+#ifdef CONFIG_DEBUG_FS
+		mmc_remove_card_debugfs(card);
+#endif
+		return ret;
+	}
+
 	mmc_card_set_present(card);
 
 	return 0;
@@ -274,10 +279,6 @@ int mmc_add_card(struct mmc_card *card)
  */
 void mmc_remove_card(struct mmc_card *card)
 {
-#ifdef CONFIG_DEBUG_FS
-	mmc_remove_card_debugfs(card);
-#endif
-
 	if (mmc_card_present(card)) {
 		if (mmc_host_is_spi(card->host)) {
 			printk(KERN_INFO "%s: SPI card removed\n",
@@ -289,6 +290,10 @@ void mmc_remove_card(struct mmc_card *card)
 		device_del(&card->dev);
 	}
 
+#ifdef CONFIG_DEBUG_FS
+	mmc_remove_card_debugfs(card);
+#endif
+
 	put_device(&card->dev);
 }
 
@@ -103,6 +103,12 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 				mrq->data->bytes_xfered, mrq->data->error);
 		}
 
+		if (mrq->sbc) {
+			pr_debug("%s:     (CMD%u): %d: %08x\n",
+				mmc_hostname(host), mrq->sbc->opcode,
+				mrq->sbc->error, mrq->sbc->resp[0]);
+		}
+
 		if (mrq->stop) {
 			pr_debug("%s:     (CMD%u): %d: %08x %08x %08x %08x\n",
 				mmc_hostname(host), mrq->stop->opcode,
@@ -126,6 +132,12 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	struct scatterlist *sg;
 #endif
 
+	if (mrq->sbc) {
+		pr_debug("%s: starting CMD%u arg %08x flags %08x\n",
+			 mmc_hostname(host), mrq->sbc->opcode,
+			 mrq->sbc->arg, mrq->sbc->flags);
+	}
+
 	pr_debug("%s: starting CMD%u arg %08x flags %08x\n",
 		 mmc_hostname(host), mrq->cmd->opcode,
 		 mrq->cmd->arg, mrq->cmd->flags);
@@ -149,6 +161,11 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 
 	led_trigger_event(host->led, LED_FULL);
 
+	if (mrq->sbc) {
+		BUG_ON(!(host->caps & MMC_CAP_CMD23));
+		mrq->sbc->error = 0;
+		mrq->sbc->mrq = mrq;
+	}
 	mrq->cmd->error = 0;
 	mrq->cmd->mrq = mrq;
 	if (mrq->data) {
@@ -150,6 +150,11 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	/* ERASE_GRP_SIZE and ERASE_GRP_MULT, in write blocks */
+	card->erase_size = (UNSTUFF_BITS(resp, 42, 5) + 1) *
+			   (UNSTUFF_BITS(resp, 37, 5) + 1);
+	card->erase_size <<= csd->write_blkbits - 9;
+
 	return 0;
 }
 
@@ -226,6 +231,15 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			mmc_card_set_blockaddr(card);
 	}
 
+	/* high-capacity erase groups, in 512KB units: what eMMC really uses */
+	if (ext_csd_struct >= 3 && ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE])
+		card->erase_size = ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+
+	if (ext_csd_struct >= 3)
+		card->ext_csd.rel_sectors = ext_csd[EXT_CSD_REL_WR_SEC_C];
+	if (ext_csd_struct >= 5)
+		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
+
 	card->ext_csd.card_type = ext_csd[EXT_CSD_CARD_TYPE];
 
 	switch (ext_csd[EXT_CSD_CARD_TYPE]) {
@@ -118,6 +118,10 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = UNSTUFF_BITS(resp, 26, 3);
 		csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 		csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
+
+		/* SECTOR_SIZE: erasable unit, in write blocks */
+		card->erase_size = (UNSTUFF_BITS(resp, 39, 7) + 1) <<
+				   (csd->write_blkbits - 9);
 		break;
 	case 1:
 		/*
@@ -146,6 +150,7 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = 4; /* Unused */
 		csd->write_blkbits = 9;
 		csd->write_partial = 0;
+		card->erase_size = 128;	/* fixed 64KB, see the AU below */
 		break;
 	default:
 		printk(KERN_ERR "%s: unrecognised CSD structure version %d\n",
@@ -177,6 +182,7 @@ static int mmc_decode_scr(struct mmc_card *card)
 
 	scr->sda_vsn = UNSTUFF_BITS(resp, 56, 4);
 	scr->bus_widths = UNSTUFF_BITS(resp, 48, 4);
+	scr->cmds = UNSTUFF_BITS(resp, 32, 2);	/* reserved before 3.00 */
 
 	return 0;
 }
@@ -234,6 +240,44 @@ out:
 	return err;
 }
 
+/*
+ * Fetches the SD status and takes the allocation unit size from it.  The AU
+ * is the unit the card's translation layer manages writes in, so it is the
+ * erase size worth aligning and batching writes to.
+ */
+static int mmc_read_ssr(struct mmc_card *card)
+{
+	unsigned int au;
+	u8 *ssr;
+	int err;
+
+	if (card->scr.sda_vsn < SCR_SPEC_VER_1)
+		return 0;
+
+	ssr = kmalloc(64, GFP_KERNEL);
+	if (!ssr)
+		return -ENOMEM;
+
+	err = mmc_app_sd_status(card, ssr);
+	if (err) {
+		printk(KERN_WARNING "%s: problem reading SD Status "
+			"register, erase size unknown.\n",
+			mmc_hostname(card->host));
+		err = 0;
+		goto out;
+	}
+
+	/* AU_SIZE, bits 431:428: 16KB << (n - 1), up to 4MB */
+	au = ssr[10] >> 4;
+	if (au && au <= 9)
+		card->erase_size = 1 << (au + 4);
+
+out:
+	kfree(ssr);
+
+	return err;
+}
+
 /*
  * Test if the card supports high-speed mode and, if so, switch to it.
  */
@@ -446,6 +490,13 @@ static int mmc_sd_init_card(struct mmc_host *host, u32 ocr,
 		err = mmc_read_switch(card);
 		if (err)
 			goto free_card;
+
+		/*
+		 * Fetch the allocation unit size from card.
+		 */
+		err = mmc_read_ssr(card);
+		if (err)
+			goto free_card;
 	}
 
 	/*
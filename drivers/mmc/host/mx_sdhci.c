@@ -103,7 +103,16 @@ static unsigned int debug_quirks = SDHCI_QUIRK_ONLY_PIO;
 static unsigned int debug_quirks;
 #endif
 static unsigned int mxc_wml_value = 512;
-static unsigned int *adma_des_table;
+
+/* Set/tran descriptor pair per segment, plus a spare entry */
+#define ADMA_DES_TABLE_SIZE(mmc) \
+	((2 * (mmc)->max_phys_segs + 1) * sizeof(u32))
+
+/*
+ * The ADMA1 length field is 16 bits wide.  Segments must also start on a
+ * 4KiB boundary, so the largest one is the last 4KiB multiple below 64KiB.
+ */
+#define ADMA_MAX_SEG_SIZE	(SZ_64K - SZ_4K)
 
 #ifndef MXC_SDHCI_NUM
 #define MXC_SDHCI_NUM	4
@@ -553,35 +562,45 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		tsg = data->sg;
 		/* ADMA mode is used, create the descriptor table */
 		for (i = 0; i < count; i++) {
+			u32 *des = &host->adma_des_table[2 * i];
+
 			if (tsg->dma_address & 0xFFF) {
 				DBG(KERN_ERR "ADMA addr isn't 4K aligned.\n");
 				DBG(KERN_ERR "0x%x\n", tsg->dma_address);
 				DBG(KERN_ERR "Changed to Single DMA mode.\n");
-				goto Single_DMA;
+				break;
 			}
-			adma_des_table[2 * i] = tsg->length << 12;
-			adma_des_table[2 * i] |= FSL_ADMA_DES_ATTR_SET;
-			adma_des_table[2 * i] |= FSL_ADMA_DES_ATTR_VALID;
-			adma_des_table[2 * i + 1] = tsg->dma_address;
-			adma_des_table[2 * i + 1] |= FSL_ADMA_DES_ATTR_TRAN;
-			adma_des_table[2 * i + 1] |= FSL_ADMA_DES_ATTR_VALID;
+			des[0] = tsg->length << 12;
+			des[0] |= FSL_ADMA_DES_ATTR_SET;
+			des[0] |= FSL_ADMA_DES_ATTR_VALID;
+			des[1] = tsg->dma_address;
+			des[1] |= FSL_ADMA_DES_ATTR_TRAN;
+			des[1] |= FSL_ADMA_DES_ATTR_VALID;
 			if (count == (i + 1))
-				adma_des_table[2 * i + 1] |=
-				    FSL_ADMA_DES_ATTR_END;
+				des[1] |= FSL_ADMA_DES_ATTR_END;
 			tsg++;
 		}
 
-		/* Write the physical address to ADMA address reg */
-		writel(virt_to_phys(adma_des_table),
-		       host->ioaddr + SDHCI_ADMA_ADDRESS);
-	      Single_DMA:
-		/* Rollback to the Single DMA mode */
-		i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
-		i &= ~SDHCI_CTRL_ADMA;
-		writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
-		/* Single DMA mode is used */
-		writel(sg_dma_address(data->sg),
-		       host->ioaddr + SDHCI_DMA_ADDRESS);
+		if (i == count) {
+			/* Descriptors must be in memory before the address */
+			wmb();
+			writel(host->adma_des_dma,
+			       host->ioaddr + SDHCI_ADMA_ADDRESS);
+		} else {
+			/*
+			 * Single DMA takes one buffer only.  The block queue
+			 * bounces misaligned segments (mmc->seg_align), so
+			 * only single-entry requests can end up here.
+			 */
+			WARN_ON(count > 1);
+			/* Rollback to the Single DMA mode */
+			i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
+			i &= ~SDHCI_CTRL_ADMA;
+			writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
+			/* Single DMA mode is used */
+			writel(sg_dma_address(data->sg),
+			       host->ioaddr + SDHCI_DMA_ADDRESS);
+		}
 	} else if ((host->flags & SDHCI_USE_EXTERNAL_DMA) &&
 		   (data->blocks * data->blksz >= mxc_wml_value)) {
 		host->dma_size = data->blocks * data->blksz;
@@ -702,7 +721,10 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	/* Set up the transfer mode */
 	if (cmd->data != NULL) {
 		mode = SDHCI_TRNS_BLK_CNT_EN | SDHCI_TRNS_DPSEL;
-		if (cmd->data->blocks > 1) {
+		if (cmd->data->blocks > 1 && host->mrq->sbc) {
+			/* length given by CMD23, no stop command */
+			mode |= SDHCI_TRNS_MULTI;
+		} else if (cmd->data->blocks > 1) {
 			mode |= SDHCI_TRNS_MULTI | SDHCI_TRNS_ACMD12;
 			if (cmd->opcode == 0x35) {
 				tmp = readl(host->ioaddr + SDHCI_INT_ENABLE);
@@ -787,6 +809,13 @@ static void sdhci_finish_command(struct sdhci_host *host)
 
 	host->cmd->error = 0;
 
+	/* CMD23 went through, now issue the transfer it announced */
+	if (host->cmd == host->mrq->sbc) {
+		host->cmd = NULL;
+		sdhci_send_command(host, host->mrq->cmd);
+		return;
+	}
+
 	if (host->data && host->data_early)
 		sdhci_finish_data(host);
 
@@ -1029,7 +1058,9 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	if (!(host->flags & SDHCI_CD_PRESENT)) {
 		host->mrq->cmd->error = -ENOMEDIUM;
 		tasklet_schedule(&host->finish_tasklet);
-	} else
+	} else if (mrq->sbc)
+		sdhci_send_command(host, mrq->sbc);
+	else
 		sdhci_send_command(host, mrq->cmd);
 
 	if (!(host->flags & SDHCI_USE_EXTERNAL_DMA))
@@ -1271,7 +1302,7 @@ static void sdhci_tasklet_finish(unsigned long param)
 	 * The controller needs a reset of internal state machines
 	 * upon error conditions.
 	 */
-	if (mrq->cmd->error ||
+	if (mrq->cmd->error || (mrq->sbc && mrq->sbc->error) ||
 	    (mrq->data && (mrq->data->error ||
 			   (mrq->data->stop && mrq->data->stop->error))) ||
 	    (host->chip->quirks & SDHCI_QUIRK_RESET_AFTER_REQUEST)) {
@@ -1972,7 +2003,7 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	mmc->ops = &sdhci_ops;
 	mmc->f_min = host->min_clk;
 	mmc->f_max = host->max_clk;
-	mmc->caps = MMC_CAP_SDIO_IRQ;
+	mmc->caps = MMC_CAP_SDIO_IRQ | MMC_CAP_CMD23;
 	mmc->caps |= mmc_plat->caps;
 
 	if (caps & SDHCI_CAN_DO_HISPD)
@@ -1996,13 +2027,14 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	spin_lock_init(&host->lock);
 
 	/*
-	 * Maximum number of segments. Hardware cannot do scatter lists.
+	 * Maximum number of segments. The ADMA descriptor table takes one
+	 * entry per segment, but every segment has to start on a 4KiB
+	 * boundary; the block queue bounces those that don't.
 	 */
-	if (host->flags & SDHCI_USE_DMA)
-		mmc->max_hw_segs = 1;
-	else
-		mmc->max_hw_segs = 16;
+	mmc->max_hw_segs = 16;
 	mmc->max_phys_segs = 16;
+	if (host->flags & SDHCI_USE_DMA)
+		mmc->seg_align = 4096;
 
 	/*
 	 * Maximum number of sectors in one transfer. Limited by DMA boundary
@@ -2014,10 +2046,11 @@ static int __devinit sdhci_probe_slot(struct platform_device
 		mmc->max_req_size = 524288;
 
 	/*
-	 * Maximum segment size. Could be one segment with the maximum number
-	 * of bytes.
+	 * Maximum segment size. Bounded by what one ADMA descriptor can
+	 * describe.
 	 */
-	mmc->max_seg_size = mmc->max_req_size;
+	mmc->max_seg_size = min_t(unsigned int, mmc->max_req_size,
+				  ADMA_MAX_SEG_SIZE);
 
 	/*
 	 * Maximum block size. This varies from controller to controller and
@@ -2042,9 +2075,10 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	 * descriptor table.
 	 */
 	if (host->flags & SDHCI_USE_DMA) {
-		adma_des_table = kcalloc((2 * (mmc->max_phys_segs) + 1),
-					 sizeof(unsigned int), GFP_DMA);
-		if (adma_des_table == NULL) {
+		host->adma_des_table =
+		    dma_alloc_coherent(&pdev->dev, ADMA_DES_TABLE_SIZE(mmc),
+				       &host->adma_des_dma, GFP_KERNEL);
+		if (host->adma_des_table == NULL) {
 			printk(KERN_ERR "Cannot allocate ADMA memory\n");
 			ret = -ENOMEM;
 			goto out3;
@@ -2125,8 +2159,9 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	tasklet_kill(&host->card_tasklet);
 	tasklet_kill(&host->finish_tasklet);
       out3:
-	if (host->flags & SDHCI_USE_DMA)
-		kfree(adma_des_table);
+	if (host->adma_des_table)
+		dma_free_coherent(&pdev->dev, ADMA_DES_TABLE_SIZE(mmc),
+				  host->adma_des_table, host->adma_des_dma);
 	release_mem_region(host->res->start,
 			   host->res->end - host->res->start + 1);
       out2:
@@ -2173,8 +2208,9 @@ static void sdhci_remove_slot(struct platform_device *pdev, int slot)
 	tasklet_kill(&host->card_tasklet);
 	tasklet_kill(&host->finish_tasklet);
 
-	if (host->flags & SDHCI_USE_DMA)
-		kfree(adma_des_table);
+	if (host->adma_des_table)
+		dma_free_coherent(&pdev->dev, ADMA_DES_TABLE_SIZE(mmc),
+				  host->adma_des_table, host->adma_des_dma);
 	release_mem_region(host->res->start,
 			   host->res->end - host->res->start + 1);
 	clk_disable(host->clk);
@@ -266,6 +266,9 @@ struct sdhci_host {
 	int offset;		/* Offset into current sg */
 	int remain;		/* Bytes left in current */
 
+	u32 *adma_des_table;	/* ADMA descriptors, coherent */
+	dma_addr_t adma_des_dma;	/* Bus address of the table */
+
 	struct resource *res;	/* IO map memory */
 	int irq;		/* Device IRQ */
 	int detect_irq;		/* Card Detect IRQ number. */
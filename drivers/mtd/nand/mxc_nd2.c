@@ -245,18 +245,43 @@ static void wait_op_done(int maxRetries, bool useirq)
 	}
 }
 
-static inline void send_atomic_cmd(u16 cmd, bool useirq)
+/*
+ * Send out a command without waiting for it; the next wait_op_done()
+ * collects its completion.
+ */
+static inline void launch_atomic_cmd(u16 cmd)
 {
 	/* fill command */
 	raw_write(cmd, REG_NFC_FLASH_CMD);
 
 	/* send out command */
 	raw_write(NFC_CMD, REG_NFC_OPS);
+}
+
+static inline void send_atomic_cmd(u16 cmd, bool useirq)
+{
+	launch_atomic_cmd(cmd);
 
 	/* Wait for operation to complete */
 	wait_op_done(TROP_US_DELAY, useirq);
 }
 
+/*
+ * Fetch a page from the NAND device into NFC RAM buffer @buf_id with an
+ * atomic data output operation, in auto mode as well.
+ */
+static inline void send_atomic_output(u8 buf_id)
+{
+	/* set ram buffer id */
+	NFC_SET_RBA(buf_id);
+
+	/* transfer data from nand to NFC ram */
+	raw_write(NFC_OUTPUT, REG_NFC_OPS);
+
+	/* Wait for operation to complete */
+	wait_op_done(TROP_US_DELAY, true);
+}
+
 static void mxc_do_addr_cycle(struct mtd_info *mtd, int column, int page_addr);
 static int mxc_check_ecc_status(struct mtd_info *mtd);
 
@@ -466,14 +491,7 @@ static void send_read_page(u8 buf_id)
 #ifndef NFC_AUTO_MODE_ENABLE
 	DEBUG(MTD_DEBUG_LEVEL3, "%s(%d)\n", __FUNCTION__, buf_id);
 
-	/* set ram buffer id */
-	NFC_SET_RBA(buf_id);
-
-	/* transfer data from nand to NFC ram */
-	raw_write(NFC_OUTPUT, REG_NFC_OPS);
-
-	/* Wait for operation to complete */
-	wait_op_done(TROP_US_DELAY, true);
+	send_atomic_output(buf_id);
 #endif
 }
 
@@ -1040,6 +1058,116 @@ static int mxc_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 	return 0;
 }
 
+/*!
+ * This function sends the read command and address cycles for a page but
+ * does not fetch the data into the NFC RAM buffer. Only atomic operations
+ * are used, in auto mode (NFC v3.2) as well, so that the command can be
+ * split from the data fetch. READSTART is only launched: the NAND device
+ * starts its array-to-register transfer, and the completion is collected
+ * by mxc_nand_fetch_page(), after the CPU has done something useful.
+ *
+ * @param       mtd             MTD structure for the NAND Flash
+ * @param       page_addr       page to be read from NAND Flash
+ */
+static void mxc_nand_start_read(struct mtd_info *mtd, int page_addr)
+{
+	u32 page_mask = g_page_mask;
+
+	send_atomic_cmd(NAND_CMD_READ0, true);
+
+	/* column 0 */
+	send_addr(0, true);
+	if (IS_2K_PAGE_NAND || IS_4K_PAGE_NAND)
+		send_addr(0, true);
+
+	do {
+		send_addr(page_addr & 0xff, true);
+		page_mask >>= 8;
+		page_addr >>= 8;
+	} while (page_mask != 0);
+
+	if (IS_LARGE_PAGE_NAND)
+		launch_atomic_cmd(NAND_CMD_READSTART);
+}
+
+/*!
+ * This function fetches the page started by mxc_nand_start_read() into
+ * NFC RAM buffer 0.
+ *
+ * @param       mtd             MTD structure for the NAND Flash
+ */
+static void mxc_nand_fetch_page(struct mtd_info *mtd)
+{
+	/* READSTART, which may have lasted until R/B went ready */
+	if (IS_LARGE_PAGE_NAND)
+		wait_op_done(TROP_US_DELAY, true);
+
+	send_atomic_output(0);
+}
+
+/*!
+ * This function reads a run of whole pages. The read of each following
+ * page is started before the current one is copied out of the NFC RAM
+ * buffer, so the copy overlaps the device busy time instead of adding
+ * to it, whether the NFC signals READSTART done at once or only when
+ * R/B goes ready.
+ *
+ * @param       mtd             MTD structure for the NAND Flash
+ * @param       chip            NAND chip structure
+ * @param       buf             data buffer, numpages * writesize bytes
+ * @param       page            first page to be read
+ * @param       numpages        number of pages to read
+ */
+static int mxc_nand_read_pages(struct mtd_info *mtd, struct nand_chip *chip,
+			       uint8_t *buf, int page, int numpages)
+{
+	bool aligned = !((unsigned long)buf & 3);
+
+#ifdef NFC_AUTO_MODE_ENABLE
+	/*
+	 * With several chips the auto mode address carries the chip
+	 * select (see auto_cmd_interleave()); keep to the page-by-page
+	 * path there.
+	 */
+	if (chip->numchips > 1) {
+		while (numpages--) {
+			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page++);
+			mxc_nand_read_page(mtd, chip, buf);
+			buf += mtd->writesize;
+		}
+		return 0;
+	}
+#endif
+
+	g_nandfc_info.bStatusRequest = false;
+	g_nandfc_info.colAddr = 0;
+
+	mxc_nand_start_read(mtd, page);
+
+	while (numpages--) {
+		/* fetch the page into the NFC RAM buffer */
+		mxc_nand_fetch_page(mtd);
+
+		mxc_check_ecc_status(mtd);
+		mxc_nand_bi_swap(mtd);
+
+		/* the device reads the next page while this one is copied */
+		if (numpages)
+			mxc_nand_start_read(mtd, ++page);
+
+		/* NFC RAM buffer does not allow byte access */
+		if (aligned) {
+			nfc_memcpy(buf, MAIN_AREA0, mtd->writesize);
+		} else {
+			nfc_memcpy(data_buf, MAIN_AREA0, mtd->writesize);
+			memcpy(buf, data_buf, mtd->writesize);
+		}
+		buf += mtd->writesize;
+	}
+
+	return 0;
+}
+
 static void mxc_nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 				const uint8_t * buf)
 {
@@ -1438,6 +1566,7 @@ static int __init mxcnd_probe(struct platform_device *pdev)
 
 	if (hardware_ecc) {
 		this->ecc.read_page = mxc_nand_read_page;
+		this->ecc.read_pages = mxc_nand_read_pages;
 		this->ecc.write_page = mxc_nand_write_page;
 		this->ecc.read_oob = mxc_nand_read_oob;
 		this->ecc.layout = &nand_hw_eccoob_512;
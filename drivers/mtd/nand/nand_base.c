@@ -1093,7 +1093,7 @@ static uint8_t *nand_transfer_oob(struct nand_chip *chip, uint8_t *oob,
 int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			    struct mtd_oob_ops *ops)
 {
-	int chipnr, page, realpage, col, bytes, aligned;
+	int chipnr, page, realpage, col, bytes, aligned, npages;
 	struct nand_chip *chip = mtd->priv;
 	struct mtd_ecc_stats stats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
@@ -1119,9 +1119,29 @@ int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	while(1) {
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
+		npages = 0;
+
+		/* Hand runs of whole pages to the driver's multi-page read */
+		if (chip->ecc.read_pages && !col && !oob &&
+		    ops->mode != MTD_OOB_RAW) {
+			npages = min_t(int, readlen >> chip->page_shift,
+				       chip->pagemask - page + 1);
+			if (npages < 2)
+				npages = 0;
+		}
+
+		if (npages) {
+			ret = chip->ecc.read_pages(mtd, chip, buf, page,
+						   npages);
+			if (ret < 0)
+				break;
 
-		/* Is the current page in the buffer ? */
-		if (realpage != chip->pagebuf || oob) {
+			bytes = npages << chip->page_shift;
+			buf += bytes;
+			realpage += npages - 1;
+			sndcmd = 1;
+		} else if (realpage != chip->pagebuf || oob) {
+			/* The current page is not in the buffer */
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
 			if (likely(sndcmd)) {
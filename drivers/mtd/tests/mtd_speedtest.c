@@ -290,6 +290,12 @@ static long calc_speed(void)
 	return speed;
 }
 
+static void print_speed(const char *what, long speed)
+{
+	printk(PRINT_PREF "%s speed is %ld KiB/s (%ld.%02ld MB/s)\n", what,
+	       speed, speed / 1024, (speed % 1024) * 100 / 1024);
+}
+
 static int scan_for_bad_eraseblocks(void)
 {
 	int i, bad = 0;
@@ -379,7 +385,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "eraseblock write speed is %ld KiB/s\n", speed);
+	print_speed("eraseblock write", speed);
 
 	/* Read all eraseblocks, 1 eraseblock at a time */
 	printk(PRINT_PREF "testing eraseblock read speed\n");
@@ -394,7 +400,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "eraseblock read speed is %ld KiB/s\n", speed);
+	print_speed("eraseblock read", speed);
 
 	err = erase_whole_device();
 	if (err)
@@ -413,7 +419,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "page write speed is %ld KiB/s\n", speed);
+	print_speed("page write", speed);
 
 	/* Read all eraseblocks, 1 page at a time */
 	printk(PRINT_PREF "testing page read speed\n");
@@ -428,7 +434,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "page read speed is %ld KiB/s\n", speed);
+	print_speed("page read", speed);
 
 	err = erase_whole_device();
 	if (err)
@@ -447,7 +453,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "2 page write speed is %ld KiB/s\n", speed);
+	print_speed("2 page write", speed);
 
 	/* Read all eraseblocks, 2 pages at a time */
 	printk(PRINT_PREF "testing 2 page read speed\n");
@@ -462,7 +468,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "2 page read speed is %ld KiB/s\n", speed);
+	print_speed("2 page read", speed);
 
 	/* Erase all eraseblocks */
 	printk(PRINT_PREF "Testing erase speed\n");
@@ -477,7 +483,7 @@ static int __init mtd_speedtest_init(void)
 	}
 	stop_timing();
 	speed = calc_speed();
-	printk(PRINT_PREF "erase speed is %ld KiB/s\n", speed);
+	print_speed("erase", speed);
 
 	printk(PRINT_PREF "finished\n");
 out:
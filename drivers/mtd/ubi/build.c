@@ -567,14 +567,15 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * Note, if there is a valid checkpoint on the flash, 'ubi_scan()' builds the
+ * scanning information from it and scans only the physical eraseblocks which
+ * may have changed since the checkpoint was written. Full media scanning is
+ * the fall-back attaching method.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
+	unsigned long start = jiffies;
 	struct ubi_scan_info *si;
 
 	si = ubi_scan(ubi);
@@ -598,6 +599,10 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	if (err)
 		goto out_wl;
 
+	ubi_msg("attached by %s in %u ms, %d of %d PEBs scanned",
+		si->checkpoint ? "checkpoint" : "scanning",
+		jiffies_to_msecs(jiffies - start), si->scanned_pebs,
+		ubi->peb_count);
 	ubi_scan_destroy_si(si);
 	return 0;
 
@@ -828,6 +833,24 @@ static int autoresize(struct ubi_device *ubi, int vol_id)
 	return 0;
 }
 
+/**
+ * stop_and_checkpoint - write a checkpoint once the background thread is gone.
+ * @ubi: UBI device description object
+ *
+ * This function is called after the background thread has been stopped. A
+ * fresh checkpoint makes the next attach scan as few PEBs as possible. Failure
+ * to write it is not fatal, the next attach just has to scan more.
+ */
+static void stop_and_checkpoint(struct ubi_device *ubi)
+{
+	/* Nobody must wake up the stopped thread */
+	spin_lock(&ubi->wl_lock);
+	ubi->thread_enabled = 0;
+	spin_unlock(&ubi->wl_lock);
+
+	ubi_cp_write(ubi, 1);
+}
+
 /**
  * ubi_reboot_notifier - halt UBI transactions immediately prior to a reboot.
  * @n: reboot notifier object
@@ -852,6 +875,7 @@ static int ubi_reboot_notifier(struct notifier_block *n, unsigned long state,
 	ubi = container_of(n, struct ubi_device, reboot_notifier);
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
+	stop_and_checkpoint(ubi);
 	ubi_sync(ubi->ubi_num);
 	return NOTIFY_DONE;
 }
@@ -939,6 +963,11 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	mutex_init(&ubi->ckvol_mutex);
 	mutex_init(&ubi->device_mutex);
 	spin_lock_init(&ubi->volumes_lock);
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+	mutex_init(&ubi->cp_mutex);
+	init_rwsem(&ubi->cp_sem);
+	INIT_LIST_HEAD(&ubi->cp_deferred);
+#endif
 
 	ubi_msg("attaching mtd%d to ubi%d", mtd->index, ubi_num);
 
@@ -974,6 +1003,12 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 			goto out_detach;
 	}
 
+	/*
+	 * Make the next attach fast. If this fails, UBI just goes on without
+	 * a checkpoint.
+	 */
+	ubi_cp_write(ubi, 0);
+
 	err = uif_init(ubi);
 	if (err)
 		goto out_nofree;
@@ -1092,6 +1127,7 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	unregister_reboot_notifier(&ubi->reboot_notifier);
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
+	stop_and_checkpoint(ubi);
 
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
@@ -0,0 +1,801 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * This file implements UBI checkpoints. A checkpoint is an on-flash snapshot
+ * of the eraseblock association and wear-leveling state, which allows to
+ * attach an MTD device without scanning all of it. Attach time then depends
+ * on the pool size (see below) rather than on the flash size.
+ *
+ * The checkpoint is stored in the internal checkpoint volume. Its logical
+ * eraseblock 0, the anchor, is always one of the first %UBI_CP_MAX_START
+ * physical eraseblocks, so it is found by reading only those. The anchor
+ * starts with the super block (&struct ubi_cp_sb), which lists the other
+ * checkpoint PEBs. The checkpoint data records the state and erase counter of
+ * every PEB, and for used PEBs the LEB they are mapped to.
+ *
+ * When a checkpoint is written, a pool of free PEBs is set aside. Until the
+ * next checkpoint is written, new PEBs are only taken from the pool, both for
+ * user data and for wear-leveling, so the PEBs the checkpoint records as free
+ * really stay free. The pool PEBs are recorded as "to be scanned", and when
+ * attaching only them are scanned. Scanning finds any newer copies of LEBs,
+ * which win over the copies recorded in the checkpoint because their sequence
+ * numbers are higher.
+ *
+ * The PEBs the checkpoint records as used must keep their contents, so if one
+ * of them is put, its erasure is deferred until the checkpoint is gone (see
+ * 'cp_defer_erase()' in wl.c). Otherwise an unclean reboot could leave the
+ * checkpoint pointing to an erased PEB.
+ *
+ * When the pool is used up, a new checkpoint is written. The old one is
+ * invalidated first by synchronously erasing its anchor, then the new
+ * checkpoint data PEBs are written, and the new anchor is written last. So
+ * whatever happens, there is at most one valid anchor on the flash. If there
+ * is none, or it does not check out, UBI falls back to full scanning, which
+ * erases the checkpoint volume because it is "delete" compatible.
+ *
+ * Checkpoints are also written when the device is detached, or the system is
+ * rebooted, so that the next attach needs to scan only a few PEBs.
+ */
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include "ubi.h"
+
+/**
+ * cp_size - calculate the size of a checkpoint.
+ * @peb_count: count of physical eraseblocks
+ * @vol_count: count of volumes
+ *
+ * This function returns the size of the super block and the checkpoint data.
+ */
+static int cp_size(int peb_count, int vol_count)
+{
+	return UBI_CP_SB_SIZE + UBI_CP_HDR_SIZE + peb_count * UBI_CP_PEB_SIZE +
+	       vol_count * UBI_CP_VOL_SIZE;
+}
+
+/**
+ * ubi_cp_max_blocks - calculate how many PEBs a checkpoint may occupy.
+ * @ubi: UBI device description object
+ */
+int ubi_cp_max_blocks(const struct ubi_device *ubi)
+{
+	int size = cp_size(ubi->peb_count, UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT);
+
+	return DIV_ROUND_UP(size, ubi->leb_size);
+}
+
+/**
+ * find_anchor - find the checkpoint anchor.
+ * @ubi: UBI device description object
+ * @ec_hdr: buffer for EC headers
+ * @vid_hdr: buffer for VID headers
+ *
+ * The anchor is the PEB holding LEB 0 of the checkpoint volume with the
+ * highest sequence number among the first %UBI_CP_MAX_START PEBs. This
+ * function returns its number and its headers in @ec_hdr and @vid_hdr,
+ * %-ENOENT if there is no anchor, and other negative error codes in case of
+ * failure.
+ */
+static int find_anchor(struct ubi_device *ubi, struct ubi_ec_hdr *ec_hdr,
+		       struct ubi_vid_hdr *vid_hdr)
+{
+	int err, pnum, anchor = -ENOENT;
+	unsigned long long sqnum, max_sqnum = 0;
+
+	for (pnum = 0; pnum < UBI_CP_MAX_START && pnum < ubi->peb_count;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		else if (err)
+			continue;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ec_hdr, 0);
+		if (err < 0)
+			return err;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			return err;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_CP_VOLUME_ID ||
+		    be32_to_cpu(vid_hdr->lnum) != 0)
+			continue;
+
+		sqnum = be64_to_cpu(vid_hdr->sqnum);
+		dbg_bld("checkpoint anchor candidate PEB %d, sqnum %llu",
+			pnum, sqnum);
+		if (anchor < 0 || sqnum > max_sqnum) {
+			anchor = pnum;
+			max_sqnum = sqnum;
+		}
+	}
+
+	if (anchor < 0)
+		return anchor;
+
+	/* The buffers were overwritten by later candidates, re-read them */
+	err = ubi_io_read_ec_hdr(ubi, anchor, ec_hdr, 0);
+	if (err < 0)
+		return err;
+	err = ubi_io_read_vid_hdr(ubi, anchor, vid_hdr, 0);
+	if (err < 0)
+		return err;
+
+	return anchor;
+}
+
+/**
+ * read_cp - read the checkpoint and check it.
+ * @ubi: UBI device description object
+ * @anchor: the anchor PEB
+ * @vid_hdr: the VID header of the anchor, used as a buffer afterwards
+ * @sb: the super block is returned here
+ * @bufp: the checkpoint is returned here, in a buffer the caller has to free
+ *
+ * This function returns zero if the checkpoint was read and is consistent,
+ * %1 if it is not, and a negative error code in case of failure.
+ */
+static int read_cp(struct ubi_device *ubi, int anchor,
+		   struct ubi_vid_hdr *vid_hdr, struct ubi_cp_sb *sb,
+		   void **bufp)
+{
+	int err, i, pnum, len, size, nr_blocks, data_size;
+	uint32_t crc;
+	unsigned long long sqnum, sb_sqnum;
+	unsigned long long anchor_sqnum = be64_to_cpu(vid_hdr->sqnum);
+	const struct ubi_cp_hdr *hdr;
+	void *buf;
+
+	err = ubi_io_read_data(ubi, sb, anchor, 0, UBI_CP_SB_SIZE);
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_err;
+
+	crc = crc32(UBI_CRC32_INIT, sb, UBI_CP_SB_SIZE_CRC);
+	if (be32_to_cpu(sb->magic) != UBI_CP_SB_MAGIC ||
+	    sb->version != UBI_CP_FORMAT_VERSION ||
+	    crc != be32_to_cpu(sb->sb_crc)) {
+		dbg_bld("bad checkpoint super block");
+		return 1;
+	}
+
+	nr_blocks = be32_to_cpu(sb->nr_blocks);
+	data_size = be32_to_cpu(sb->data_size);
+	size = UBI_CP_SB_SIZE + data_size;
+	sb_sqnum = be64_to_cpu(sb->sqnum);
+	if (nr_blocks < 1 || nr_blocks > UBI_CP_MAX_BLOCKS ||
+	    data_size < UBI_CP_HDR_SIZE ||
+	    size > nr_blocks * ubi->leb_size ||
+	    be32_to_cpu(sb->block_pnum[0]) != anchor ||
+	    sb_sqnum >= anchor_sqnum) {
+		dbg_bld("inconsistent checkpoint super block");
+		return 1;
+	}
+
+	buf = vmalloc(nr_blocks * ubi->leb_size);
+	if (!buf)
+		return -ENOMEM;
+	*bufp = buf;
+
+	for (i = 0; i < nr_blocks; i++) {
+		pnum = be32_to_cpu(sb->block_pnum[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count)
+			return 1;
+
+		if (i > 0) {
+			err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+			if (err < 0)
+				return err;
+			else if (err && err != UBI_IO_BITFLIPS)
+				return 1;
+
+			sqnum = be64_to_cpu(vid_hdr->sqnum);
+			if (be32_to_cpu(vid_hdr->vol_id) != UBI_CP_VOLUME_ID ||
+			    be32_to_cpu(vid_hdr->lnum) != i ||
+			    sqnum <= sb_sqnum || sqnum >= anchor_sqnum) {
+				dbg_bld("PEB %d does not belong to the "
+					"checkpoint", pnum);
+				return 1;
+			}
+		}
+
+		len = min(size - i * ubi->leb_size, ubi->leb_size);
+		if (len <= 0)
+			continue;
+
+		err = ubi_io_read_data(ubi, buf + i * ubi->leb_size, pnum, 0,
+				       len);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_err;
+	}
+
+	crc = crc32(UBI_CRC32_INIT, buf + UBI_CP_SB_SIZE, data_size);
+	if (crc != be32_to_cpu(sb->data_crc)) {
+		dbg_bld("bad checkpoint data CRC %#08x, must be %#08x",
+			crc, be32_to_cpu(sb->data_crc));
+		return 1;
+	}
+
+	hdr = buf + UBI_CP_SB_SIZE;
+	if (be32_to_cpu(hdr->magic) != UBI_CP_HDR_MAGIC ||
+	    be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    be32_to_cpu(hdr->vol_count) > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    cp_size(ubi->peb_count, be32_to_cpu(hdr->vol_count)) != size) {
+		dbg_bld("bad checkpoint data header");
+		return 1;
+	}
+
+	return 0;
+
+out_err:
+	/* An ECC error just means the checkpoint is unusable */
+	if (err == -EBADMSG)
+		return 1;
+	return err;
+}
+
+/**
+ * find_vol - find a volume record in the checkpoint.
+ * @vols: the volume records
+ * @vol_count: count of @vols
+ * @vol_id: the volume ID to look for
+ * @last: index of the previously found record, updated
+ *
+ * Used PEBs mostly come in runs of the same volume, so @last is tried first.
+ * This function returns the volume record or %NULL if there is none.
+ */
+static const struct ubi_cp_vol *find_vol(const struct ubi_cp_vol *vols,
+					 int vol_count, int vol_id, int *last)
+{
+	int i;
+
+	if (*last < vol_count && be32_to_cpu(vols[*last].vol_id) == vol_id)
+		return &vols[*last];
+
+	for (i = 0; i < vol_count; i++)
+		if (be32_to_cpu(vols[i].vol_id) == vol_id) {
+			*last = i;
+			return &vols[i];
+		}
+
+	return NULL;
+}
+
+/**
+ * fill_si - fill the scanning information from the checkpoint.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ * @sb: the checkpoint super block
+ * @buf: the checkpoint
+ * @vid_hdr: buffer for faked VID headers
+ *
+ * This function returns zero in case of success, %1 if the checkpoint turned
+ * out to be inconsistent, and a negative error code in case of failure.
+ */
+static int fill_si(struct ubi_device *ubi, struct ubi_scan_info *si,
+		   const struct ubi_cp_sb *sb, void *buf,
+		   struct ubi_vid_hdr *vid_hdr)
+{
+	int err, i, pnum, ec, vol_id, last = 0, own = 0;
+	int nr_blocks = be32_to_cpu(sb->nr_blocks);
+	const struct ubi_cp_hdr *hdr = buf + UBI_CP_SB_SIZE;
+	const struct ubi_cp_peb *pebs = (void *)(hdr + 1);
+	const struct ubi_cp_vol *vols = (void *)(pebs + ubi->peb_count);
+	int vol_count = be32_to_cpu(hdr->vol_count);
+	const struct ubi_cp_vol *vol;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		ec = be32_to_cpu(pebs[pnum].ec);
+		if (ec < 0 || ec > UBI_MAX_ERASECOUNTER)
+			return 1;
+
+		switch (pebs[pnum].state) {
+		case UBI_CP_FREE:
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->free);
+			break;
+
+		case UBI_CP_USED:
+			vol_id = be32_to_cpu(pebs[pnum].vol_id);
+			vol = find_vol(vols, vol_count, vol_id, &last);
+			if (!vol) {
+				dbg_bld("no volume %d in the checkpoint",
+					vol_id);
+				return 1;
+			}
+
+			memset(vid_hdr, 0, UBI_VID_HDR_SIZE);
+			vid_hdr->vol_type = vol->vol_type;
+			vid_hdr->compat = vol->compat;
+			vid_hdr->vol_id = vol->vol_id;
+			vid_hdr->lnum = pebs[pnum].lnum;
+			vid_hdr->data_size = vol->last_data_size;
+			vid_hdr->used_ebs = vol->used_ebs;
+			vid_hdr->data_pad = vol->data_pad;
+			/*
+			 * Any copy of this LEB found in the pool is newer, so
+			 * the sequence number of this one does not matter.
+			 */
+			vid_hdr->sqnum = 0;
+
+			err = ubi_scan_add_used(ubi, si, pnum, ec, vid_hdr, 0);
+			if (err == -EINVAL)
+				return 1;
+			set_bit(pnum, ubi->cp_used);
+			break;
+
+		case UBI_CP_SCAN:
+			set_bit(pnum, ubi->cp_scan);
+			continue;
+
+		case UBI_CP_ERASE:
+		case UBI_CP_OTHER:
+			/* The PEB may have gone bad since */
+			err = ubi_io_is_bad(ubi, pnum);
+			if (err < 0)
+				return err;
+			else if (err) {
+				si->bad_peb_count += 1;
+				continue;
+			}
+
+			if (pebs[pnum].state == UBI_CP_OTHER) {
+				err = ubi_scan_add_to_list(si, pnum,
+							   UBI_SCAN_UNKNOWN_EC,
+							   &si->erase);
+				if (err)
+					return err;
+				continue;
+			}
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->erase);
+			break;
+
+		case UBI_CP_OWN:
+			for (i = 0; i < nr_blocks; i++)
+				if (be32_to_cpu(sb->block_pnum[i]) == pnum)
+					break;
+			if (i == nr_blocks)
+				return 1;
+			ubi->cp_ec[i] = ec;
+			own += 1;
+			err = 0;
+			break;
+
+		default:
+			dbg_bld("bad state %d of PEB %d in the checkpoint",
+				pebs[pnum].state, pnum);
+			return 1;
+		}
+
+		if (err)
+			return err;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	if (own != nr_blocks)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * ubi_cp_read - attach from the checkpoint.
+ * @ubi: UBI device description object
+ * @si: empty scanning information to fill
+ *
+ * This function looks for the checkpoint and, if there is a valid one, fills
+ * @si from it and sets up @ubi->cp_scan to tell which PEBs still have to be
+ * scanned. Returns zero if the checkpoint was used, %1 if there is no usable
+ * checkpoint, and a negative error code in case of failure. In the latter two
+ * cases @si has to be thrown away if @si->checkpoint was set.
+ */
+int ubi_cp_read(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, i, anchor;
+	unsigned long long sqnum;
+	size_t bitmap_size = BITS_TO_LONGS(ubi->peb_count) *
+			     sizeof(unsigned long);
+	struct ubi_ec_hdr *ec_hdr;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_cp_sb *sb;
+	void *buf = NULL;
+
+	err = -ENOMEM;
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ec_hdr)
+		return err;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		goto out_ec_hdr;
+
+	sb = kmalloc(UBI_CP_SB_SIZE, GFP_KERNEL);
+	if (!sb)
+		goto out_vid_hdr;
+
+	anchor = find_anchor(ubi, ec_hdr, vid_hdr);
+	if (anchor < 0) {
+		err = anchor == -ENOENT ? 1 : anchor;
+		goto out_sb;
+	}
+	sqnum = be64_to_cpu(vid_hdr->sqnum);
+
+	if (ec_hdr->version != UBI_VERSION ||
+	    be64_to_cpu(ec_hdr->ec) > UBI_MAX_ERASECOUNTER) {
+		err = 1;
+		goto out_invalid;
+	}
+
+	err = read_cp(ubi, anchor, vid_hdr, sb, &buf);
+	if (err)
+		goto out_invalid;
+
+	ubi->cp_used = kzalloc(bitmap_size, GFP_KERNEL);
+	ubi->cp_scan = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!ubi->cp_used || !ubi->cp_scan) {
+		err = -ENOMEM;
+		goto out_invalid;
+	}
+
+	si->checkpoint = 1;
+	err = fill_si(ubi, si, sb, buf, vid_hdr);
+	if (err)
+		goto out_invalid;
+
+	ubi->image_seq = be32_to_cpu(ec_hdr->image_seq);
+	si->image_seq_set = 1;
+	si->is_empty = 0;
+	/* The anchor's sequence number is the highest of the checkpoint */
+	if (si->max_sqnum < sqnum)
+		si->max_sqnum = sqnum;
+
+	ubi->cp_active = 1;
+	ubi->cp_nr_blocks = be32_to_cpu(sb->nr_blocks);
+	for (i = 0; i < ubi->cp_nr_blocks; i++)
+		ubi->cp_blocks[i] = be32_to_cpu(sb->block_pnum[i]);
+	ubi_msg("checkpoint found at PEB %d, %d PEBs", anchor,
+		ubi->cp_nr_blocks);
+	err = 0;
+	goto out_buf;
+
+out_invalid:
+	if (err > 0)
+		ubi_warn("checkpoint at PEB %d is not usable, scan the flash",
+			 anchor);
+	kfree(ubi->cp_used);
+	ubi->cp_used = NULL;
+	kfree(ubi->cp_scan);
+	ubi->cp_scan = NULL;
+out_buf:
+	vfree(buf);
+out_sb:
+	kfree(sb);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_ec_hdr:
+	kfree(ec_hdr);
+	return err;
+}
+
+/**
+ * ubi_cp_discard - discard the checkpoint the device was attached from.
+ * @ubi: UBI device description object
+ * @si: scanning information filled from the checkpoint
+ *
+ * This function is called when the flash contents turned out to contradict
+ * the checkpoint. The anchor is erased, so that the checkpoint is not used
+ * again, and @si has to be thrown away.
+ */
+void ubi_cp_discard(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err;
+
+	if (!ubi->ro_mode) {
+		err = ubi_scan_erase_peb(ubi, si, ubi->cp_blocks[0],
+					 ubi->cp_ec[0] + 1);
+		if (err)
+			ubi_warn("cannot erase checkpoint anchor PEB %d, "
+				 "error %d", ubi->cp_blocks[0], err);
+	}
+
+	kfree(ubi->cp_used);
+	ubi->cp_used = NULL;
+	kfree(ubi->cp_scan);
+	ubi->cp_scan = NULL;
+	ubi->cp_active = 0;
+	ubi->cp_nr_blocks = 0;
+}
+
+/**
+ * cp_invalidate - invalidate the on-flash checkpoint.
+ * @ubi: UBI device description object
+ *
+ * This function erases the anchor of the current checkpoint and schedules the
+ * other checkpoint PEBs for erasure. Returns zero in case of success and a
+ * negative error code in case of failure, in which case UBI is switched to
+ * read-only mode.
+ */
+static int cp_invalidate(struct ubi_device *ubi)
+{
+	int err, i;
+
+	err = ubi_wl_cp_erase_peb(ubi, ubi->cp_blocks[0]);
+	if (err) {
+		ubi_err("cannot erase checkpoint anchor PEB %d, error %d",
+			ubi->cp_blocks[0], err);
+		ubi_ro_mode(ubi);
+		return err;
+	}
+
+	ubi_wl_cp_deactivate(ubi);
+
+	for (i = 1; i < ubi->cp_nr_blocks; i++) {
+		err = ubi_wl_cp_put_peb(ubi, ubi->cp_blocks[i], 0);
+		if (err) {
+			ubi_ro_mode(ubi);
+			return err;
+		}
+	}
+
+	ubi->cp_nr_blocks = 0;
+	return 0;
+}
+
+/**
+ * write_block - write one checkpoint PEB.
+ * @ubi: UBI device description object
+ * @vid_hdr: VID header buffer
+ * @pnum: the physical eraseblock to write to
+ * @lnum: the logical eraseblock number in the checkpoint volume
+ * @buf: the data to write
+ * @len: how many bytes to write, may be zero or negative for no data
+ *
+ * This function returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+static int write_block(struct ubi_device *ubi, struct ubi_vid_hdr *vid_hdr,
+		       int pnum, int lnum, const void *buf, int len)
+{
+	int err;
+
+	vid_hdr->vol_type = UBI_CP_VOLUME_TYPE;
+	vid_hdr->vol_id = cpu_to_be32(UBI_CP_VOLUME_ID);
+	vid_hdr->compat = UBI_CP_VOLUME_COMPAT;
+	vid_hdr->lnum = cpu_to_be32(lnum);
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+
+	dbg_gen("write checkpoint LEB %d to PEB %d", lnum, pnum);
+	err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+	if (err || len <= 0)
+		return err;
+
+	return ubi_io_write_data(ubi, buf, pnum, 0,
+				 ALIGN(len, ubi->min_io_size));
+}
+
+/**
+ * fill_cp - take a snapshot of the device state for the checkpoint.
+ * @ubi: UBI device description object
+ * @blocks: PEBs of the new checkpoint
+ * @nr_blocks: count of @blocks
+ *
+ * This function fills @ubi->cp_buf with the checkpoint super block and data
+ * and returns the size of both. The caller has to hold @ubi->cp_sem for writing
+ * and @ubi->move_mutex.
+ */
+static int fill_cp(struct ubi_device *ubi, const int *blocks, int nr_blocks)
+{
+	int i, lnum, pnum, vol_count = 0, size;
+	struct ubi_cp_sb *sb = ubi->cp_buf;
+	struct ubi_cp_hdr *hdr = ubi->cp_buf + UBI_CP_SB_SIZE;
+	struct ubi_cp_peb *pebs = (void *)(hdr + 1);
+	struct ubi_cp_vol *vols = (void *)(pebs + ubi->peb_count);
+
+	memset(ubi->cp_buf, 0, cp_size(ubi->peb_count,
+				       UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT));
+
+	/* All LEBs written so far have lower sequence numbers */
+	sb->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+
+	ubi_wl_cp_snapshot(ubi, pebs, blocks, nr_blocks);
+
+	/*
+	 * The WL sub-system only knows which PEBs are used, the EBA tables
+	 * tell what is in them.
+	 */
+	spin_lock(&ubi->volumes_lock);
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+		struct ubi_cp_vol *rec;
+
+		if (!vol)
+			continue;
+
+		rec = &vols[vol_count++];
+		rec->vol_id = cpu_to_be32(vol->vol_id);
+		rec->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			rec->compat = UBI_LAYOUT_VOLUME_COMPAT;
+		if (vol->vol_type == UBI_STATIC_VOLUME) {
+			rec->vol_type = UBI_VID_STATIC;
+			rec->used_ebs = cpu_to_be32(vol->used_ebs);
+			rec->last_data_size = cpu_to_be32(vol->last_eb_bytes);
+		} else
+			rec->vol_type = UBI_VID_DYNAMIC;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0 || pebs[pnum].state != UBI_CP_USED)
+				continue;
+
+			pebs[pnum].vol_id = cpu_to_be32(vol->vol_id);
+			pebs[pnum].lnum = cpu_to_be32(lnum);
+			set_bit(pnum, ubi->cp_used);
+		}
+	}
+	spin_unlock(&ubi->volumes_lock);
+
+	/*
+	 * PEBs which are used but not mapped yet are being written to right
+	 * now, so they have to be scanned.
+	 */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		if (pebs[pnum].state == UBI_CP_USED &&
+		    !test_bit(pnum, ubi->cp_used))
+			pebs[pnum].state = UBI_CP_SCAN;
+
+	size = cp_size(ubi->peb_count, vol_count);
+	hdr->magic = cpu_to_be32(UBI_CP_HDR_MAGIC);
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->vol_count = cpu_to_be32(vol_count);
+
+	sb->magic = cpu_to_be32(UBI_CP_SB_MAGIC);
+	sb->version = UBI_CP_FORMAT_VERSION;
+	sb->nr_blocks = cpu_to_be32(nr_blocks);
+	sb->data_size = cpu_to_be32(size - UBI_CP_SB_SIZE);
+	sb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 size - UBI_CP_SB_SIZE));
+	for (i = 0; i < nr_blocks; i++)
+		sb->block_pnum[i] = cpu_to_be32(blocks[i]);
+	sb->sb_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, sb,
+				       UBI_CP_SB_SIZE_CRC));
+
+	return size;
+}
+
+/**
+ * ubi_cp_write - write a new checkpoint.
+ * @ubi: UBI device description object
+ * @force: write even if the current checkpoint still has free PEBs in its pool
+ *
+ * This function invalidates the current checkpoint, if any, and writes a new
+ * one. If the new checkpoint cannot be written, UBI just goes on without it
+ * and this function returns zero. A negative error code is returned only if
+ * the old checkpoint could not be invalidated or UBI is in read-only mode.
+ */
+int ubi_cp_write(struct ubi_device *ubi, int force)
+{
+	int err, i, pnum, size, len, bad_pnum = -1;
+	int nr_blocks = ubi->cp_max_blocks, blocks[UBI_CP_MAX_BLOCKS];
+	struct ubi_vid_hdr *vid_hdr;
+
+	mutex_lock(&ubi->cp_mutex);
+	if (!ubi->cp_enabled) {
+		/* Only possible in read-only mode */
+		err = ubi->cp_active ? -EROFS : 0;
+		goto out_unlock;
+	}
+
+	if (ubi->ro_mode) {
+		err = -EROFS;
+		goto out_unlock;
+	}
+
+	err = 0;
+	if (!force && ubi->cp_active) {
+		/* Somebody else has just written a new checkpoint */
+		spin_lock(&ubi->wl_lock);
+		i = ubi->cp_pool_count;
+		spin_unlock(&ubi->wl_lock);
+		if (i)
+			goto out_unlock;
+	}
+
+	if (ubi->cp_active) {
+		err = cp_invalidate(ubi);
+		if (err)
+			goto out_unlock;
+	}
+
+	err = ubi_wl_cp_produce(ubi, nr_blocks);
+	if (err) {
+		ubi_warn("no free PEBs for the checkpoint, error %d", err);
+		err = 0;
+		goto out_unlock;
+	}
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_NOFS);
+	if (!vid_hdr)
+		goto out_unlock;
+
+	down_write(&ubi->cp_sem);
+	mutex_lock(&ubi->move_mutex);
+
+	for (i = 0; i < nr_blocks; i++) {
+		pnum = ubi_wl_cp_get_peb(ubi, i == 0);
+		if (pnum < 0) {
+			if (i == 0)
+				ubi_warn("no free PEB among the first %d for "
+					 "the checkpoint", UBI_CP_MAX_START);
+			else
+				ubi_warn("no free PEB for the checkpoint");
+			nr_blocks = i;
+			goto out_put;
+		}
+		blocks[i] = pnum;
+	}
+
+	size = fill_cp(ubi, blocks, nr_blocks);
+
+	/* The anchor goes last, it makes the checkpoint valid */
+	for (i = nr_blocks - 1; i >= 0; i--) {
+		len = min(size - i * ubi->leb_size, ubi->leb_size);
+		err = write_block(ubi, vid_hdr, blocks[i], i,
+				  ubi->cp_buf + i * ubi->leb_size, len);
+		if (err) {
+			ubi_warn("cannot write checkpoint to PEB %d, error %d",
+				 blocks[i], err);
+			ubi_wl_cp_deactivate(ubi);
+			bad_pnum = blocks[i];
+			goto out_put;
+		}
+	}
+
+	ubi->cp_nr_blocks = nr_blocks;
+	for (i = 0; i < nr_blocks; i++)
+		ubi->cp_blocks[i] = blocks[i];
+	dbg_gen("checkpoint written, anchor PEB %d, %d PEBs, pool %d PEBs",
+		blocks[0], nr_blocks, ubi->cp_pool_count);
+	goto out_sem;
+
+out_put:
+	/* only the PEB that failed is suspect, the others are just erased */
+	for (i = 0; i < nr_blocks; i++) {
+		err = ubi_wl_cp_put_peb(ubi, blocks[i],
+					blocks[i] == bad_pnum);
+		if (err)
+			ubi_ro_mode(ubi);
+	}
+out_sem:
+	err = 0;
+	mutex_unlock(&ubi->move_mutex);
+	up_write(&ubi->cp_sem);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_unlock:
+	mutex_unlock(&ubi->cp_mutex);
+	return err;
+}
@@ -56,7 +56,7 @@ static struct ubi_ec_hdr *ech;
 static struct ubi_vid_hdr *vidh;
 
 /**
- * add_to_list - add physical eraseblock to a list.
+ * ubi_scan_add_to_list - add physical eraseblock to a list.
  * @si: scanning information
  * @pnum: physical eraseblock number to add
  * @ec: erase counter of the physical eraseblock
@@ -66,8 +66,8 @@ static struct ubi_vid_hdr *vidh;
  * alien lists. Returns zero in case of success and a negative error code in
  * case of failure.
  */
-static int add_to_list(struct ubi_scan_info *si, int pnum, int ec,
-		       struct list_head *list)
+int ubi_scan_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			 struct list_head *list)
 {
 	struct ubi_scan_leb *seb;
 
@@ -458,11 +458,11 @@ int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 				return err;
 
 			if (cmp_res & 4)
-				err = add_to_list(si, seb->pnum, seb->ec,
-						  &si->corr);
+				err = ubi_scan_add_to_list(si, seb->pnum,
+							   seb->ec, &si->corr);
 			else
-				err = add_to_list(si, seb->pnum, seb->ec,
-						  &si->erase);
+				err = ubi_scan_add_to_list(si, seb->pnum,
+							   seb->ec, &si->erase);
 			if (err)
 				return err;
 
@@ -482,9 +482,11 @@ int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 			 * previously.
 			 */
 			if (cmp_res & 4)
-				return add_to_list(si, pnum, ec, &si->corr);
+				return ubi_scan_add_to_list(si, pnum, ec,
+							    &si->corr);
 			else
-				return add_to_list(si, pnum, ec, &si->erase);
+				return ubi_scan_add_to_list(si, pnum, ec,
+							    &si->erase);
 		}
 	}
 
@@ -742,7 +744,8 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	else if (err == UBI_IO_BITFLIPS)
 		bitflips = 1;
 	else if (err == UBI_IO_PEB_EMPTY)
-		return add_to_list(si, pnum, UBI_SCAN_UNKNOWN_EC, &si->erase);
+		return ubi_scan_add_to_list(si, pnum, UBI_SCAN_UNKNOWN_EC,
+					    &si->erase);
 	else if (err == UBI_IO_BAD_EC_HDR) {
 		/*
 		 * We have to also look at the VID header, possibly it is not
@@ -815,13 +818,13 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	else if (err == UBI_IO_BAD_VID_HDR ||
 		 (err == UBI_IO_PEB_FREE && ec_corr)) {
 		/* VID header is corrupted */
-		err = add_to_list(si, pnum, ec, &si->corr);
+		err = ubi_scan_add_to_list(si, pnum, ec, &si->corr);
 		if (err)
 			return err;
 		goto adjust_mean_ec;
 	} else if (err == UBI_IO_PEB_FREE) {
 		/* No VID header - the physical eraseblock is free */
-		err = add_to_list(si, pnum, ec, &si->free);
+		err = ubi_scan_add_to_list(si, pnum, ec, &si->free);
 		if (err)
 			return err;
 		goto adjust_mean_ec;
@@ -836,7 +839,7 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		case UBI_COMPAT_DELETE:
 			ubi_msg("\"delete\" compatible internal volume %d:%d"
 				" found, remove it", vol_id, lnum);
-			err = add_to_list(si, pnum, ec, &si->corr);
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->corr);
 			if (err)
 				return err;
 			break;
@@ -851,7 +854,7 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		case UBI_COMPAT_PRESERVE:
 			ubi_msg("\"preserve\" compatible internal volume %d:%d"
 				" found", vol_id, lnum);
-			err = add_to_list(si, pnum, ec, &si->alien);
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->alien);
 			if (err)
 				return err;
 			si->alien_peb_count += 1;
@@ -882,32 +885,78 @@ adjust_mean_ec:
 	return 0;
 }
 
+/**
+ * alloc_si - allocate empty scanning information.
+ */
+static struct ubi_scan_info *alloc_si(void)
+{
+	struct ubi_scan_info *si;
+
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si)
+		return NULL;
+
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	si->is_empty = 1;
+	return si;
+}
+
+/**
+ * scan_pebs - scan physical eraseblocks.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * This function scans all physical eraseblocks, or only those the checkpoint
+ * asks for if @si was built from the checkpoint. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+static int scan_pebs(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, pnum;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		cond_resched();
+
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+		if (si->checkpoint && !test_bit(pnum, ubi->cp_scan))
+			continue;
+#endif
+
+		dbg_gen("process PEB %d", pnum);
+		err = process_eb(ubi, si, pnum);
+		if (err < 0)
+			return err;
+		si->scanned_pebs += 1;
+	}
+
+	return 0;
+}
+
 /**
  * ubi_scan - scan an MTD device.
  * @ubi: UBI device description object
  *
  * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * information about it. If there is a valid checkpoint on the flash, most of
+ * the information is taken from it and only a few physical eraseblocks are
+ * scanned. In case of failure, an error code is returned.
  */
 struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 {
-	int err, pnum;
+	int err;
 	struct rb_node *rb1, *rb2;
 	struct ubi_scan_volume *sv;
 	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
 
-	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	si = alloc_si();
 	if (!si)
 		return ERR_PTR(-ENOMEM);
 
-	INIT_LIST_HEAD(&si->corr);
-	INIT_LIST_HEAD(&si->free);
-	INIT_LIST_HEAD(&si->erase);
-	INIT_LIST_HEAD(&si->alien);
-	si->volumes = RB_ROOT;
-	si->is_empty = 1;
-
 	err = -ENOMEM;
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
 	if (!ech)
@@ -917,12 +966,31 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	if (!vidh)
 		goto out_ech;
 
-	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+	err = ubi_cp_read(ubi, si);
+	if (err < 0)
+		goto out_vidh;
+	if (err == 0) {
+		err = scan_pebs(ubi, si);
+		if (err) {
+			ubi_warn("checkpoint does not match the flash (error "
+				 "%d), scan the whole flash", err);
+			ubi_cp_discard(ubi, si);
+		}
+	}
 
-		dbg_gen("process PEB %d", pnum);
-		err = process_eb(ubi, si, pnum);
-		if (err < 0)
+	if (err) {
+		/* No usable checkpoint, scan everything from scratch */
+		if (si->checkpoint) {
+			ubi_scan_destroy_si(si);
+			si = alloc_si();
+			if (!si) {
+				err = -ENOMEM;
+				goto out_vidh;
+			}
+		}
+
+		err = scan_pebs(ubi, si);
+		if (err)
 			goto out_vidh;
 	}
 
@@ -958,11 +1026,17 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 		if (seb->ec == UBI_SCAN_UNKNOWN_EC)
 			seb->ec = si->mean_ec;
 
-	err = paranoid_check_si(ubi, si);
-	if (err) {
-		if (err > 0)
-			err = -EINVAL;
-		goto out_vidh;
+	/*
+	 * The checks read every PEB, and PEBs taken from the checkpoint carry
+	 * no sequence numbers, so they only make sense after full scanning.
+	 */
+	if (!si->checkpoint) {
+		err = paranoid_check_si(ubi, si);
+		if (err) {
+			if (err > 0)
+				err = -EINVAL;
+			goto out_vidh;
+		}
 	}
 
 	ubi_free_vid_hdr(ubi, vidh);
@@ -975,7 +1049,8 @@ out_vidh:
 out_ech:
 	kfree(ech);
 out_si:
-	ubi_scan_destroy_si(si);
+	if (si)
+		ubi_scan_destroy_si(si);
 	return ERR_PTR(err);
 }
 
@@ -103,6 +103,8 @@ struct ubi_scan_volume {
  * @ec_sum: a temporary variable used when calculating @mean_ec
  * @ec_count: a temporary variable used when calculating @mean_ec
  * @image_seq_set: indicates @ubi->image_seq is known
+ * @checkpoint: if the information was built from the on-flash checkpoint
+ * @scanned_pebs: how many physical eraseblocks were actually read
  *
  * This data structure contains the result of scanning and may be used by other
  * UBI sub-systems to build final UBI data structures, further error-recovery
@@ -126,6 +128,8 @@ struct ubi_scan_info {
 	uint64_t ec_sum;
 	int ec_count;
 	int image_seq_set;
+	int checkpoint;
+	int scanned_pebs;
 };
 
 struct ubi_device;
@@ -146,6 +150,8 @@ static inline void ubi_scan_move_to_list(struct ubi_scan_volume *sv,
 		list_add_tail(&seb->u.list, list);
 }
 
+int ubi_scan_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			 struct list_head *list);
 int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 		      int pnum, int ec, const struct ubi_vid_hdr *vid_hdr,
 		      int bitflips);
@@ -312,6 +312,15 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The checkpoint volume contains a snapshot of the eraseblock association and
+ * wear-leveling state (see cp.c). It is "delete" compatible, so UBI
+ * implementations which do not know about it simply erase it.
+ */
+#define UBI_CP_VOLUME_ID     (UBI_INTERNAL_VOL_START + 1)
+#define UBI_CP_VOLUME_TYPE   UBI_VID_DYNAMIC
+#define UBI_CP_VOLUME_COMPAT UBI_COMPAT_DELETE
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -375,4 +384,136 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* Checkpoint super block magic number (ASCII "UBIC") */
+#define UBI_CP_SB_MAGIC 0x55424943
+/* Checkpoint data header magic number (ASCII "UBIc") */
+#define UBI_CP_HDR_MAGIC 0x55424963
+
+/* The checkpoint on-flash format version */
+#define UBI_CP_FORMAT_VERSION 1
+
+/* The checkpoint anchor always lives in one of the first 64 PEBs */
+#define UBI_CP_MAX_START 64
+
+/* Maximum number of PEBs a checkpoint may occupy, the anchor included */
+#define UBI_CP_MAX_BLOCKS 32
+
+/*
+ * Physical eraseblock states recorded in the checkpoint.
+ *
+ * @UBI_CP_FREE: the PEB is erased and contains only an EC header
+ * @UBI_CP_USED: the PEB is mapped to the LEB recorded in the checkpoint
+ * @UBI_CP_SCAN: the PEB may have been written after the checkpoint and has to
+ *               be scanned when attaching
+ * @UBI_CP_ERASE: the PEB has to be erased
+ * @UBI_CP_OWN: the PEB belongs to this checkpoint
+ * @UBI_CP_OTHER: the PEB is bad or its state is not known, it is erased if
+ *                it is good
+ */
+enum {
+	UBI_CP_FREE = 1,
+	UBI_CP_USED,
+	UBI_CP_SCAN,
+	UBI_CP_ERASE,
+	UBI_CP_OWN,
+	UBI_CP_OTHER,
+};
+
+/* Sizes of the checkpoint structures */
+#define UBI_CP_SB_SIZE   sizeof(struct ubi_cp_sb)
+#define UBI_CP_HDR_SIZE  sizeof(struct ubi_cp_hdr)
+#define UBI_CP_VOL_SIZE  sizeof(struct ubi_cp_vol)
+#define UBI_CP_PEB_SIZE  sizeof(struct ubi_cp_peb)
+
+/* Size of the checkpoint super block without the ending CRC */
+#define UBI_CP_SB_SIZE_CRC (UBI_CP_SB_SIZE - sizeof(__be32))
+
+/**
+ * struct ubi_cp_sb - checkpoint super block.
+ * @magic: checkpoint super block magic number (%UBI_CP_SB_MAGIC)
+ * @version: checkpoint format version (%UBI_CP_FORMAT_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @nr_blocks: how many PEBs the checkpoint occupies, the anchor included
+ * @data_size: how many bytes of checkpoint data follow the super block
+ * @data_crc: CRC32 checksum of the checkpoint data
+ * @sqnum: the global sequence number when the checkpoint was taken
+ * @block_pnum: the PEBs holding the checkpoint data, in order
+ * @padding2: reserved for future, zeroes
+ * @sb_crc: super block CRC checksum
+ *
+ * The super block is stored at the beginning of logical eraseblock 0 of the
+ * checkpoint volume, which is called the anchor. It is immediately followed by
+ * the checkpoint data, which continues from the beginning of logical
+ * eraseblocks 1, 2, etc, stored in the PEBs listed in @block_pnum.
+ *
+ * The checkpoint data is a &struct ubi_cp_hdr object, followed by @peb_count
+ * &struct ubi_cp_peb objects indexed by physical eraseblock number, followed
+ * by @vol_count &struct ubi_cp_vol objects.
+ */
+struct ubi_cp_sb {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  nr_blocks;
+	__be32  data_size;
+	__be32  data_crc;
+	__be64  sqnum;
+	__be32  block_pnum[UBI_CP_MAX_BLOCKS];
+	__u8    padding2[32];
+	__be32  sb_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_cp_hdr - checkpoint data header.
+ * @magic: checkpoint data header magic number (%UBI_CP_HDR_MAGIC)
+ * @peb_count: count of physical eraseblocks on the MTD device
+ * @vol_count: count of volume records
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_cp_hdr {
+	__be32  magic;
+	__be32  peb_count;
+	__be32  vol_count;
+	__u8    padding[4];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_cp_vol - checkpoint volume record.
+ * @vol_id: volume ID
+ * @used_ebs: the @used_ebs field of the volume's VID headers
+ * @last_data_size: the @data_size field of the VID header of the last LEB
+ * @data_pad: how many bytes at the end of PEBs are not used
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility flags of the volume
+ * @padding: reserved for future, zeroes
+ *
+ * The fields mirror the per-volume fields of the VID header, which are the
+ * same in all PEBs of a volume.
+ */
+struct ubi_cp_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  last_data_size;
+	__be32  data_pad;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[6];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_cp_peb - checkpoint physical eraseblock record.
+ * @ec: erase counter
+ * @vol_id: volume ID of the LEB this PEB is mapped to (%UBI_CP_USED only)
+ * @lnum: the LEB this PEB is mapped to (%UBI_CP_USED only)
+ * @state: physical eraseblock state (%UBI_CP_FREE, %UBI_CP_USED, etc)
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_cp_peb {
+	__be32  ec;
+	__be32  vol_id;
+	__be32  lnum;
+	__u8    state;
+	__u8    padding[3];
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
@@ -81,6 +81,13 @@
  */
 #define UBI_PROT_QUEUE_LEN 10
 
+/*
+ * Maximum count of free PEBs set aside when a checkpoint is written. New data
+ * only goes to these PEBs until the next checkpoint, and only these PEBs have
+ * to be scanned when attaching.
+ */
+#define UBI_CP_MAX_POOL 256
+
 /*
  * Error codes returned by the I/O sub-system.
  *
@@ -335,7 +342,8 @@ struct ubi_wl_entry;
  * @pq_head: protection queue head
  * @wl_lock: protects the @used, @free, @pq, @pq_head, @lookuptbl, @move_from,
  * 	     @move_to, @move_to_put @erase_pending, @wl_scheduled, @works,
- * 	     @erroneous, and @erroneous_peb_count fields
+ * 	     @erroneous, @erroneous_peb_count, @cp_active, @cp_pool,
+ * 	     @cp_pool_count and @cp_deferred fields
  * @move_mutex: serializes eraseblock moves
  * @work_sem: synchronizes the WL worker with use tasks
  * @wl_scheduled: non-zero if the wear-leveling was scheduled
@@ -351,6 +359,24 @@ struct ubi_wl_entry;
  * @bgt_name: background thread name
  * @reboot_notifier: notifier to terminate background thread before rebooting
  *
+ * @cp_mutex: serializes checkpoint writing
+ * @cp_sem: taken for reading around EBA table updates which put the old PEB,
+ *          and for writing while a checkpoint is taken
+ * @cp_enabled: if checkpoints are written on this device
+ * @cp_active: if the on-flash checkpoint is valid and has to be kept valid
+ * @cp_max_blocks: how many PEBs a checkpoint of this device may occupy
+ * @cp_nr_blocks: how many PEBs the on-flash checkpoint occupies
+ * @cp_blocks: PEBs of the on-flash checkpoint, the anchor first
+ * @cp_ec: erase counters of @cp_blocks, only valid when attaching
+ * @cp_pool: free PEBs which may be used while the checkpoint is valid
+ * @cp_pool_count: how many PEBs are left in @cp_pool
+ * @cp_pool_max: how many PEBs are put to @cp_pool when a checkpoint is written
+ * @cp_used: bitmap of PEBs recorded as used in the on-flash checkpoint
+ * @cp_scan: bitmap of PEBs which have to be scanned, only valid when attaching
+ * @cp_deferred: erase works of PEBs in @cp_used which were put after the
+ *               checkpoint was written
+ * @cp_buf: buffer for the checkpoint being written, protected by @cp_mutex
+ *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
  * @peb_size: physical eraseblock size
@@ -437,6 +463,25 @@ struct ubi_device {
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
 	struct notifier_block reboot_notifier;
 
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+	/* Checkpoint stuff */
+	struct mutex cp_mutex;
+	struct rw_semaphore cp_sem;
+	int cp_enabled;
+	int cp_active;
+	int cp_max_blocks;
+	int cp_nr_blocks;
+	int cp_blocks[UBI_CP_MAX_BLOCKS];
+	int cp_ec[UBI_CP_MAX_BLOCKS];
+	struct ubi_wl_entry *cp_pool[UBI_CP_MAX_POOL];
+	int cp_pool_count;
+	int cp_pool_max;
+	unsigned long *cp_used;
+	unsigned long *cp_scan;
+	struct list_head cp_deferred;
+	void *cp_buf;
+#endif
+
 	/* I/O sub-system's stuff */
 	long long flash_size;
 	int peb_count;
@@ -523,6 +568,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -532,6 +578,35 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+int ubi_wl_cp_get_peb(struct ubi_device *ubi, int anchor);
+int ubi_wl_cp_put_peb(struct ubi_device *ubi, int pnum, int torture);
+int ubi_wl_cp_erase_peb(struct ubi_device *ubi, int pnum);
+int ubi_wl_cp_produce(struct ubi_device *ubi, int need);
+void ubi_wl_cp_snapshot(struct ubi_device *ubi, struct ubi_cp_peb *pebs,
+			const int *blocks, int nr_blocks);
+void ubi_wl_cp_deactivate(struct ubi_device *ubi);
+
+/* cp.c */
+int ubi_cp_max_blocks(const struct ubi_device *ubi);
+int ubi_cp_read(struct ubi_device *ubi, struct ubi_scan_info *si);
+void ubi_cp_discard(struct ubi_device *ubi, struct ubi_scan_info *si);
+int ubi_cp_write(struct ubi_device *ubi, int force);
+#else
+static inline int ubi_cp_read(struct ubi_device *ubi,
+			      struct ubi_scan_info *si)
+{
+	return 1;
+}
+static inline void ubi_cp_discard(struct ubi_device *ubi,
+				  struct ubi_scan_info *si)
+{
+}
+static inline int ubi_cp_write(struct ubi_device *ubi, int force)
+{
+	return 0;
+}
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -658,6 +733,38 @@ static inline void ubi_ro_mode(struct ubi_device *ubi)
 	}
 }
 
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+/**
+ * ubi_cp_eba_lock - lock out checkpoint writing.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before changing an EBA table entry and
+ * putting the physical eraseblock it referred to, so that the checkpoint never
+ * sees one without the other.
+ */
+static inline void ubi_cp_eba_lock(struct ubi_device *ubi)
+{
+	down_read(&ubi->cp_sem);
+}
+
+/**
+ * ubi_cp_eba_unlock - allow checkpoint writing again.
+ * @ubi: UBI device description object
+ */
+static inline void ubi_cp_eba_unlock(struct ubi_device *ubi)
+{
+	up_read(&ubi->cp_sem);
+}
+#else
+static inline void ubi_cp_eba_lock(struct ubi_device *ubi)
+{
+}
+
+static inline void ubi_cp_eba_unlock(struct ubi_device *ubi)
+{
+}
+#endif
+
 /**
  * vol_id2idx - get table index by volume ID.
  * @ubi: UBI device description object
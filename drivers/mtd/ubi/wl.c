@@ -141,6 +141,9 @@
  */
 #define WL_MAX_FAILURES 32
 
+/* Minimum count of free PEBs set aside when a checkpoint is written */
+#define CP_POOL_MIN 8
+
 /**
  * struct ubi_work - UBI work description data structure.
  * @list: a link in the list of pending works
@@ -376,6 +379,165 @@ static struct ubi_wl_entry *find_wl_entry(struct rb_root *root, int max)
 	return e;
 }
 
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+
+/**
+ * cp_pool_active - check if new PEBs have to come from the checkpoint pool.
+ * @ubi: UBI device description object
+ *
+ * While the on-flash checkpoint is valid, free PEBs it does not ask to scan
+ * must stay untouched, so new PEBs are only taken from the pool. Note,
+ * @ubi->wl_lock has to be locked.
+ */
+static inline int cp_pool_active(const struct ubi_device *ubi)
+{
+	return ubi->cp_active;
+}
+
+/**
+ * cp_pool_pick - pick a physical eraseblock in the checkpoint pool.
+ * @ubi: UBI device description object
+ * @dtype: type of data which will be stored in this physical eraseblock
+ *
+ * This function returns the @ubi->cp_pool index of the PEB with the highest
+ * erase counter for long term data, of the PEB with the lowest erase counter
+ * for short term data, and of any PEB for unknown data. Returns %-1 if the
+ * pool is empty. Note, @ubi->wl_lock has to be locked.
+ */
+static int cp_pool_pick(const struct ubi_device *ubi, int dtype)
+{
+	int i, n = 0;
+
+	if (!ubi->cp_pool_count)
+		return -1;
+
+	for (i = 1; i < ubi->cp_pool_count; i++) {
+		int ec = ubi->cp_pool[i]->ec;
+
+		if ((dtype == UBI_LONGTERM && ec > ubi->cp_pool[n]->ec) ||
+		    (dtype == UBI_SHORTTERM && ec < ubi->cp_pool[n]->ec))
+			n = i;
+	}
+
+	return n;
+}
+
+/**
+ * cp_pool_get - take a physical eraseblock from the checkpoint pool.
+ * @ubi: UBI device description object
+ * @dtype: type of data which will be stored in this physical eraseblock
+ *
+ * This function returns %NULL if the pool is empty. Note, @ubi->wl_lock has
+ * to be locked.
+ */
+static struct ubi_wl_entry *cp_pool_get(struct ubi_device *ubi, int dtype)
+{
+	int n = cp_pool_pick(ubi, dtype);
+	struct ubi_wl_entry *e;
+
+	if (n < 0)
+		return NULL;
+
+	e = ubi->cp_pool[n];
+	ubi->cp_pool_count -= 1;
+	ubi->cp_pool[n] = ubi->cp_pool[ubi->cp_pool_count];
+	return e;
+}
+
+/**
+ * cp_pool_peek - find the most worn out physical eraseblock in the pool.
+ * @ubi: UBI device description object
+ *
+ * This function returns %NULL if the pool is empty. Note, @ubi->wl_lock has
+ * to be locked.
+ */
+static struct ubi_wl_entry *cp_pool_peek(const struct ubi_device *ubi)
+{
+	int n = cp_pool_pick(ubi, UBI_LONGTERM);
+
+	return n < 0 ? NULL : ubi->cp_pool[n];
+}
+
+/**
+ * cp_pool_del - remove a physical eraseblock from the checkpoint pool.
+ * @ubi: UBI device description object
+ * @e: the physical eraseblock to remove
+ *
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static void cp_pool_del(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	int n;
+
+	for (n = 0; n < ubi->cp_pool_count; n++)
+		if (ubi->cp_pool[n] == e) {
+			ubi->cp_pool_count -= 1;
+			ubi->cp_pool[n] = ubi->cp_pool[ubi->cp_pool_count];
+			return;
+		}
+
+	ubi_assert(0);
+}
+
+#else
+
+static inline int cp_pool_active(const struct ubi_device *ubi)
+{
+	return 0;
+}
+
+static inline struct ubi_wl_entry *cp_pool_get(struct ubi_device *ubi,
+					       int dtype)
+{
+	return NULL;
+}
+
+static inline struct ubi_wl_entry *cp_pool_peek(const struct ubi_device *ubi)
+{
+	return NULL;
+}
+
+static inline void cp_pool_del(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+}
+
+#endif /* CONFIG_MTD_UBI_CHECKPOINT */
+
+/**
+ * find_wl_target - find a free physical eraseblock to move data to.
+ * @ubi: UBI device description object
+ *
+ * This function returns %NULL if there are no free physical eraseblocks.
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static struct ubi_wl_entry *find_wl_target(struct ubi_device *ubi)
+{
+	if (cp_pool_active(ubi))
+		return cp_pool_peek(ubi);
+
+	if (!ubi->free.rb_node)
+		return NULL;
+	return find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+}
+
+/**
+ * take_wl_target - take the physical eraseblock found by 'find_wl_target()'.
+ * @ubi: UBI device description object
+ * @e: the physical eraseblock to take
+ *
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static void take_wl_target(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	if (cp_pool_active(ubi)) {
+		cp_pool_del(ubi, e);
+		return;
+	}
+
+	paranoid_check_in_wl_tree(e, &ubi->free);
+	rb_erase(&e->u.rb, &ubi->free);
+}
+
 /**
  * ubi_wl_get_peb - get a physical eraseblock.
  * @ubi: UBI device description object
@@ -394,6 +556,24 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 
 retry:
 	spin_lock(&ubi->wl_lock);
+	if (cp_pool_active(ubi)) {
+		e = cp_pool_get(ubi, dtype);
+		if (!e) {
+			spin_unlock(&ubi->wl_lock);
+
+			/*
+			 * The pool is used up. Writing a new checkpoint
+			 * refills it, or makes the free PEBs usable again if
+			 * the checkpoint cannot be written.
+			 */
+			err = ubi_cp_write(ubi, 0);
+			if (err)
+				return err;
+			goto retry;
+		}
+		goto protect;
+	}
+
 	if (!ubi->free.rb_node) {
 		if (ubi->works_count == 0) {
 			ubi_assert(list_empty(&ubi->works));
@@ -456,6 +636,7 @@ retry:
 	 * be protected from being moved for some time.
 	 */
 	rb_erase(&e->u.rb, &ubi->free);
+protect:
 	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
 	prot_queue_add(ubi, e);
 	spin_unlock(&ubi->wl_lock);
@@ -681,8 +862,8 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	ubi_assert(!ubi->move_from && !ubi->move_to);
 	ubi_assert(!ubi->move_to_put);
 
-	if (!ubi->free.rb_node ||
-	    (!ubi->used.rb_node && !ubi->scrub.rb_node)) {
+	e2 = find_wl_target(ubi);
+	if (!e2 || (!ubi->used.rb_node && !ubi->scrub.rb_node)) {
 		/*
 		 * No free physical eraseblocks? Well, they must be waiting in
 		 * the queue to be erased. Cancel movement - it will be
@@ -694,7 +875,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		 * triggered again.
 		 */
 		dbg_wl("cancel WL, a list is empty: free %d, used %d",
-		       !ubi->free.rb_node, !ubi->used.rb_node);
+		       !e2, !ubi->used.rb_node);
 		goto out_cancel;
 	}
 
@@ -705,7 +886,6 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		 * counters differ much enough, start wear-leveling.
 		 */
 		e1 = rb_entry(rb_first(&ubi->used), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
 
 		if (!(e2->ec - e1->ec >= UBI_WL_THRESHOLD)) {
 			dbg_wl("no WL needed: min used EC %d, max free EC %d",
@@ -720,14 +900,12 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		/* Perform scrubbing */
 		scrubbing = 1;
 		e1 = rb_entry(rb_first(&ubi->scrub), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
 		paranoid_check_in_wl_tree(e1, &ubi->scrub);
 		rb_erase(&e1->u.rb, &ubi->scrub);
 		dbg_wl("scrub PEB %d to PEB %d", e1->pnum, e2->pnum);
 	}
 
-	paranoid_check_in_wl_tree(e2, &ubi->free);
-	rb_erase(&e2->u.rb, &ubi->free);
+	take_wl_target(ubi, e2);
 	ubi->move_from = e1;
 	ubi->move_to = e2;
 	spin_unlock(&ubi->wl_lock);
@@ -948,7 +1126,8 @@ static int ensure_wear_leveling(struct ubi_device *ubi)
 	 * the WL worker has to be scheduled anyway.
 	 */
 	if (!ubi->scrub.rb_node) {
-		if (!ubi->used.rb_node || !ubi->free.rb_node)
+		e2 = find_wl_target(ubi);
+		if (!ubi->used.rb_node || !e2)
 			/* No physical eraseblocks - no deal */
 			goto out_unlock;
 
@@ -959,7 +1138,6 @@ static int ensure_wear_leveling(struct ubi_device *ubi)
 		 * %UBI_WL_THRESHOLD.
 		 */
 		e1 = rb_entry(rb_first(&ubi->used), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
 
 		if (!(e2->ec - e1->ec >= UBI_WL_THRESHOLD))
 			goto out_unlock;
@@ -988,6 +1166,65 @@ out_unlock:
 	return err;
 }
 
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+/**
+ * cp_defer_erase - keep a PEB the checkpoint relies on from being erased.
+ * @ubi: UBI device description object
+ * @wl_wrk: the erase work
+ *
+ * Attaching from the checkpoint relies on the contents of the PEBs it records
+ * as used, so such PEBs are not erased until the next checkpoint is written.
+ * Instead, the erase work is put to the @ubi->cp_deferred list. This function
+ * returns %1 if the erasure was deferred and %0 if not.
+ */
+static int cp_defer_erase(struct ubi_device *ubi, struct ubi_work *wl_wrk)
+{
+	int pnum = wl_wrk->e->pnum, defer;
+
+	spin_lock(&ubi->wl_lock);
+	defer = ubi->cp_active && test_bit(pnum, ubi->cp_used);
+	if (defer)
+		list_add_tail(&wl_wrk->list, &ubi->cp_deferred);
+	spin_unlock(&ubi->wl_lock);
+
+	if (defer)
+		dbg_wl("PEB %d is used by the checkpoint, defer erasure", pnum);
+	return defer;
+}
+
+/**
+ * cp_flush_deferred - make sure no erasure is deferred.
+ * @ubi: UBI device description object
+ *
+ * Deferred erasures are only done once the checkpoint which needs the PEBs is
+ * gone, so a new checkpoint is written if there are any. This function returns
+ * zero in case of success and a negative error code in case of failure.
+ */
+static int cp_flush_deferred(struct ubi_device *ubi)
+{
+	int empty;
+
+	spin_lock(&ubi->wl_lock);
+	empty = list_empty(&ubi->cp_deferred);
+	spin_unlock(&ubi->wl_lock);
+
+	if (empty)
+		return 0;
+	return ubi_cp_write(ubi, 1);
+}
+#else
+static inline int cp_defer_erase(struct ubi_device *ubi,
+				 struct ubi_work *wl_wrk)
+{
+	return 0;
+}
+
+static inline int cp_flush_deferred(struct ubi_device *ubi)
+{
+	return 0;
+}
+#endif
+
 /**
  * erase_worker - physical eraseblock erase worker function.
  * @ubi: UBI device description object
@@ -1012,6 +1249,9 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 		return 0;
 	}
 
+	if (cp_defer_erase(ubi, wl_wrk))
+		return 0;
+
 	dbg_wl("erase PEB %d EC %d", pnum, e->ec);
 
 	err = sync_erase(ubi, e, wl_wrk->torture);
@@ -1266,6 +1506,10 @@ int ubi_wl_flush(struct ubi_device *ubi)
 {
 	int err;
 
+	err = cp_flush_deferred(ubi);
+	if (err)
+		return err;
+
 	/*
 	 * Erase while the pending works queue is not empty, but not more than
 	 * the number of currently pending works.
@@ -1403,6 +1647,450 @@ static void cancel_pending(struct ubi_device *ubi)
 	}
 }
 
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+
+/**
+ * ubi_wl_cp_get_peb - get a free physical eraseblock for the checkpoint.
+ * @ubi: UBI device description object
+ * @anchor: non-zero if the PEB is for the checkpoint anchor
+ *
+ * The anchor PEB has to be one of the first %UBI_CP_MAX_START PEBs, other
+ * checkpoint PEBs are preferably taken from the rest of the flash to leave
+ * room for future anchors. The least worn out suitable PEB is taken. This
+ * function returns the PEB number or %-ENOSPC if there is no suitable free PEB.
+ * The PEB stays out of the WL trees until it is passed to
+ * 'ubi_wl_cp_put_peb()'.
+ */
+int ubi_wl_cp_get_peb(struct ubi_device *ubi, int anchor)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e = NULL;
+
+	spin_lock(&ubi->wl_lock);
+	for (rb = rb_first(&ubi->free); rb; rb = rb_next(rb)) {
+		struct ubi_wl_entry *e1;
+
+		e1 = rb_entry(rb, struct ubi_wl_entry, u.rb);
+		if (!anchor == !(e1->pnum < UBI_CP_MAX_START)) {
+			e = e1;
+			break;
+		}
+	}
+	if (!e && !anchor && ubi->free.rb_node)
+		e = rb_entry(rb_first(&ubi->free), struct ubi_wl_entry, u.rb);
+	if (e)
+		rb_erase(&e->u.rb, &ubi->free);
+	spin_unlock(&ubi->wl_lock);
+
+	if (!e)
+		return -ENOSPC;
+
+	dbg_wl("checkpoint PEB %d EC %d", e->pnum, e->ec);
+	return e->pnum;
+}
+
+/**
+ * ubi_wl_cp_put_peb - schedule a checkpoint physical eraseblock for erasure.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock
+ * @torture: if this physical eraseblock has to be tortured
+ *
+ * This function returns zero in case of success and %-ENOMEM in case of
+ * failure.
+ */
+int ubi_wl_cp_put_peb(struct ubi_device *ubi, int pnum, int torture)
+{
+	return schedule_erase(ubi, ubi->lookuptbl[pnum], torture);
+}
+
+/**
+ * ubi_wl_cp_erase_peb - synchronously erase a checkpoint physical eraseblock.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock
+ *
+ * This function is used to invalidate the on-flash checkpoint by erasing its
+ * anchor. The erased PEB is added to the free tree. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubi_wl_cp_erase_peb(struct ubi_device *ubi, int pnum)
+{
+	int err;
+	struct ubi_wl_entry *e = ubi->lookuptbl[pnum];
+
+	err = sync_erase(ubi, e, 0);
+	if (err)
+		return err;
+
+	spin_lock(&ubi->wl_lock);
+	wl_tree_add(e, &ubi->free);
+	spin_unlock(&ubi->wl_lock);
+	return 0;
+}
+
+/**
+ * cp_evict_anchor - make room for the checkpoint anchor.
+ * @ubi: UBI device description object
+ *
+ * This function schedules one of the used PEBs among the first
+ * %UBI_CP_MAX_START PEBs for scrubbing, so that its data is moved elsewhere
+ * and it becomes free. Returns %1 if a PEB was scheduled, %0 if there is no
+ * suitable PEB, and a negative error code in case of failure.
+ */
+static int cp_evict_anchor(struct ubi_device *ubi)
+{
+	int err;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e, *victim = NULL;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->used, u.rb)
+		if (e->pnum < UBI_CP_MAX_START) {
+			victim = e;
+			break;
+		}
+	if (victim) {
+		rb_erase(&victim->u.rb, &ubi->used);
+		wl_tree_add(victim, &ubi->scrub);
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	if (!victim)
+		return 0;
+
+	dbg_wl("move PEB %d out of the checkpoint anchor area", victim->pnum);
+	err = ensure_wear_leveling(ubi);
+	if (err)
+		return err;
+	return 1;
+}
+
+/**
+ * ubi_wl_cp_produce - make sure there are enough free physical eraseblocks.
+ * @ubi: UBI device description object
+ * @nr_blocks: how many PEBs the checkpoint needs
+ *
+ * This function synchronously executes pending works until there are enough
+ * free PEBs for the checkpoint and a pool of at least %CP_POOL_MIN PEBs, and
+ * one of them may be used as the anchor. If all the first %UBI_CP_MAX_START
+ * PEBs are used, the data of one of them is moved away. Returns zero in case
+ * of success, %-ENOSPC if there is no more work to do and there are still not
+ * enough free PEBs, and other negative error codes in case of failure.
+ */
+int ubi_wl_cp_produce(struct ubi_device *ubi, int nr_blocks)
+{
+	int err, count, anchor, evicted = 0, need = nr_blocks + CP_POOL_MIN;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	for (;;) {
+		spin_lock(&ubi->wl_lock);
+		count = anchor = 0;
+		ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb) {
+			count += 1;
+			if (e->pnum < UBI_CP_MAX_START)
+				anchor = 1;
+		}
+		if (count >= need && anchor) {
+			spin_unlock(&ubi->wl_lock);
+			return 0;
+		}
+		spin_unlock(&ubi->wl_lock);
+
+		if (!anchor && !evicted) {
+			err = cp_evict_anchor(ubi);
+			if (err < 0)
+				return err;
+			evicted = 1;
+		}
+
+		spin_lock(&ubi->wl_lock);
+		if (ubi->works_count == 0) {
+			spin_unlock(&ubi->wl_lock);
+			return -ENOSPC;
+		}
+		spin_unlock(&ubi->wl_lock);
+
+		err = do_work(ubi);
+		if (err)
+			return err;
+	}
+}
+
+/**
+ * cp_record - record the state of a physical eraseblock in the checkpoint.
+ * @pebs: the checkpoint physical eraseblock records
+ * @e: the physical eraseblock
+ * @state: its state
+ */
+static void cp_record(struct ubi_cp_peb *pebs, const struct ubi_wl_entry *e,
+		      int state)
+{
+	pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	pebs[e->pnum].state = state;
+}
+
+/**
+ * ubi_wl_cp_snapshot - record the WL state of all PEBs and start the pool.
+ * @ubi: UBI device description object
+ * @pebs: the checkpoint physical eraseblock records to fill
+ * @blocks: physical eraseblocks of the new checkpoint
+ * @nr_blocks: count of @blocks
+ *
+ * This function fills the checkpoint pool with free PEBs and records the state
+ * of every PEB: free, used, in the pool (to be scanned), to be erased, or
+ * belonging to the checkpoint. PEBs the WL sub-system does not know about,
+ * like bad PEBs, are recorded as %UBI_CP_OTHER. Used PEBs are refined by the
+ * caller using the EBA tables.
+ *
+ * From now on new PEBs are taken from the pool only, so the recorded free PEBs
+ * stay free. The caller has to hold @ubi->move_mutex, so that no PEB is being
+ * moved, and @ubi->cp_sem for writing, so that no PEB is being put.
+ */
+void ubi_wl_cp_snapshot(struct ubi_device *ubi, struct ubi_cp_peb *pebs,
+			const int *blocks, int nr_blocks)
+{
+	int i;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+	struct ubi_work *wrk;
+
+	for (i = 0; i < ubi->peb_count; i++)
+		pebs[i].state = UBI_CP_OTHER;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_assert(!ubi->move_from && !ubi->move_to);
+
+	while (ubi->cp_pool_count < ubi->cp_pool_max && ubi->free.rb_node) {
+		e = rb_entry(rb_first(&ubi->free), struct ubi_wl_entry, u.rb);
+		rb_erase(&e->u.rb, &ubi->free);
+		ubi->cp_pool[ubi->cp_pool_count++] = e;
+	}
+
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		cp_record(pebs, e, UBI_CP_FREE);
+	ubi_rb_for_each_entry(rb, e, &ubi->used, u.rb)
+		cp_record(pebs, e, UBI_CP_USED);
+	ubi_rb_for_each_entry(rb, e, &ubi->scrub, u.rb)
+		cp_record(pebs, e, UBI_CP_USED);
+	ubi_rb_for_each_entry(rb, e, &ubi->erroneous, u.rb)
+		cp_record(pebs, e, UBI_CP_USED);
+	for (i = 0; i < UBI_PROT_QUEUE_LEN; i++)
+		list_for_each_entry(e, &ubi->pq[i], u.list)
+			cp_record(pebs, e, UBI_CP_USED);
+
+	for (i = 0; i < ubi->cp_pool_count; i++)
+		cp_record(pebs, ubi->cp_pool[i], UBI_CP_SCAN);
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func == &erase_worker)
+			cp_record(pebs, wrk->e, UBI_CP_ERASE);
+	list_for_each_entry(wrk, &ubi->cp_deferred, list)
+		cp_record(pebs, wrk->e, UBI_CP_ERASE);
+
+	for (i = 0; i < nr_blocks; i++)
+		cp_record(pebs, ubi->lookuptbl[blocks[i]], UBI_CP_OWN);
+
+	ubi->cp_active = 1;
+	spin_unlock(&ubi->wl_lock);
+}
+
+/**
+ * ubi_wl_cp_deactivate - stop keeping the on-flash checkpoint valid.
+ * @ubi: UBI device description object
+ *
+ * This function is called when there is no valid checkpoint on the flash
+ * any more. It returns the pool PEBs to the free tree and schedules the
+ * deferred erasures.
+ */
+void ubi_wl_cp_deactivate(struct ubi_device *ubi)
+{
+	struct ubi_work *wrk;
+
+	spin_lock(&ubi->wl_lock);
+	ubi->cp_active = 0;
+	bitmap_zero(ubi->cp_used, ubi->peb_count);
+
+	while (ubi->cp_pool_count) {
+		ubi->cp_pool_count -= 1;
+		wl_tree_add(ubi->cp_pool[ubi->cp_pool_count], &ubi->free);
+	}
+
+	list_for_each_entry(wrk, &ubi->cp_deferred, list)
+		ubi->works_count += 1;
+	list_splice_tail_init(&ubi->cp_deferred, &ubi->works);
+	if (ubi->thread_enabled)
+		wake_up_process(ubi->bgt_thread);
+	spin_unlock(&ubi->wl_lock);
+}
+
+/**
+ * cp_init - initialize the checkpoint part of the WL sub-system.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * This function decides whether checkpoints are written on this device and
+ * reserves PEBs for them. If the device was attached from a checkpoint, it
+ * also puts the checkpoint's PEBs under WL control and puts the pool PEBs
+ * which are still free back to the pool. Returns zero in case of success and
+ * a negative error code in case of failure.
+ */
+static int cp_init(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int i, err, pnum, reserve;
+	struct ubi_wl_entry *e;
+
+	for (i = 0; i < ubi->cp_nr_blocks; i++) {
+		e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!e)
+			return -ENOMEM;
+
+		e->pnum = ubi->cp_blocks[i];
+		e->ec = ubi->cp_ec[i];
+		ubi->lookuptbl[e->pnum] = e;
+	}
+
+	ubi->cp_max_blocks = ubi_cp_max_blocks(ubi);
+	reserve = 2 * ubi->cp_max_blocks;
+	if (ubi->ro_mode)
+		ubi->cp_enabled = 0;
+	else if (si->alien_peb_count) {
+		ubi_warn("alien PEBs present, checkpoint disabled");
+		ubi->cp_enabled = 0;
+	} else if (ubi->cp_max_blocks > UBI_CP_MAX_BLOCKS) {
+		ubi_warn("checkpoint would need %d PEBs, max. is %d, disabled",
+			 ubi->cp_max_blocks, UBI_CP_MAX_BLOCKS);
+		ubi->cp_enabled = 0;
+	} else if (ubi->avail_pebs < reserve) {
+		ubi_warn("not enough PEBs for checkpoint (%d, need %d), "
+			 "disabled", ubi->avail_pebs, reserve);
+		ubi->cp_enabled = 0;
+	} else
+		ubi->cp_enabled = 1;
+
+	if (ubi->cp_enabled) {
+		/*
+		 * While a new checkpoint is written, the PEBs of the old one
+		 * may still be waiting for erasure.
+		 */
+		ubi->avail_pebs -= reserve;
+		ubi->rsvd_pebs += reserve;
+		ubi->cp_pool_max = clamp_t(int, ubi->peb_count / 20,
+					   CP_POOL_MIN, UBI_CP_MAX_POOL);
+
+		if (!ubi->cp_used) {
+			ubi->cp_used = kzalloc(BITS_TO_LONGS(ubi->peb_count) *
+					       sizeof(unsigned long),
+					       GFP_KERNEL);
+			if (!ubi->cp_used)
+				return -ENOMEM;
+		}
+
+		/*
+		 * Checkpoints are written when a PEB is needed, possibly on
+		 * the write-back path, so do not allocate memory then.
+		 */
+		ubi->cp_buf = vmalloc(ubi->cp_max_blocks * ubi->leb_size);
+		if (!ubi->cp_buf)
+			return -ENOMEM;
+	} else if (ubi->cp_active && !ubi->ro_mode) {
+		/*
+		 * The checkpoint cannot be kept valid, so it has to be gone
+		 * before anything on the flash changes.
+		 */
+		int nr_blocks = ubi->cp_nr_blocks;
+
+		e = ubi->lookuptbl[ubi->cp_blocks[0]];
+		err = sync_erase(ubi, e, 0);
+		if (err)
+			return err;
+		wl_tree_add(e, &ubi->free);
+		ubi->cp_nr_blocks = 0;
+		ubi->cp_active = 0;
+
+		for (i = 1; i < nr_blocks; i++) {
+			e = ubi->lookuptbl[ubi->cp_blocks[i]];
+			err = schedule_erase(ubi, e, 0);
+			if (err)
+				break;
+		}
+		if (err) {
+			for (; i < nr_blocks; i++) {
+				e = ubi->lookuptbl[ubi->cp_blocks[i]];
+				kmem_cache_free(ubi_wl_entry_slab, e);
+			}
+			return err;
+		}
+	}
+
+	if (ubi->cp_active && ubi->cp_enabled) {
+		for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+			if (ubi->cp_pool_count == ubi->cp_pool_max)
+				break;
+			if (!test_bit(pnum, ubi->cp_scan))
+				continue;
+
+			e = ubi->lookuptbl[pnum];
+			if (e && in_wl_tree(e, &ubi->free)) {
+				rb_erase(&e->u.rb, &ubi->free);
+				ubi->cp_pool[ubi->cp_pool_count++] = e;
+			}
+		}
+		dbg_wl("%d PEBs back in the checkpoint pool",
+		       ubi->cp_pool_count);
+	}
+
+	kfree(ubi->cp_scan);
+	ubi->cp_scan = NULL;
+	return 0;
+}
+
+/**
+ * cp_close - free the checkpoint part of the WL sub-system.
+ * @ubi: UBI device description object
+ */
+static void cp_close(struct ubi_device *ubi)
+{
+	int i;
+
+	while (!list_empty(&ubi->cp_deferred)) {
+		struct ubi_work *wrk;
+
+		wrk = list_entry(ubi->cp_deferred.next, struct ubi_work, list);
+		list_del(&wrk->list);
+		wrk->func(ubi, wrk, 1);
+	}
+
+	for (i = 0; i < ubi->cp_pool_count; i++)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->cp_pool[i]);
+	ubi->cp_pool_count = 0;
+
+	for (i = 0; i < ubi->cp_nr_blocks; i++)
+		if (ubi->lookuptbl[ubi->cp_blocks[i]])
+			kmem_cache_free(ubi_wl_entry_slab,
+					ubi->lookuptbl[ubi->cp_blocks[i]]);
+	ubi->cp_nr_blocks = 0;
+
+	kfree(ubi->cp_used);
+	ubi->cp_used = NULL;
+	kfree(ubi->cp_scan);
+	ubi->cp_scan = NULL;
+	vfree(ubi->cp_buf);
+	ubi->cp_buf = NULL;
+}
+
+#else
+
+static inline int cp_init(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	return 0;
+}
+
+static inline void cp_close(struct ubi_device *ubi)
+{
+}
+
+#endif /* CONFIG_MTD_UBI_CHECKPOINT */
+
 /**
  * ubi_wl_init_scan - initialize the WL sub-system using scanning information.
  * @ubi: UBI device description object
@@ -1514,6 +2202,10 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	ubi->avail_pebs -= WL_RESERVED_PEBS;
 	ubi->rsvd_pebs += WL_RESERVED_PEBS;
 
+	err = cp_init(ubi, si);
+	if (err)
+		goto out_free;
+
 	/* Schedule wear-leveling if needed */
 	err = ensure_wear_leveling(ubi);
 	if (err)
@@ -1523,6 +2215,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 
 out_free:
 	cancel_pending(ubi);
+	cp_close(ubi);
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
@@ -1555,6 +2248,7 @@ void ubi_wl_close(struct ubi_device *ubi)
 {
 	dbg_wl("close the WL sub-system");
 	cancel_pending(ubi);
+	cp_close(ubi);
 	protection_queue_destroy(ubi);
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->erroneous);
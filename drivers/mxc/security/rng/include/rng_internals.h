@@ -650,6 +650,11 @@ static fsl_shw_return_t rng_drain_fifo(uint32_t * random_p, int count_words);
 static os_error_code rng_grab_config_values(void);
 static void rng_cleanup(void);
 
+#ifdef RNG_HWRNG
+static void rng_hwrng_start(void);
+static void rng_hwrng_stop(void);
+#endif
+
 #ifdef FSL_HAVE_RNGA
 static void rng_sec_failure(void);
 #endif
@@ -52,6 +52,14 @@
 #include "fsl_shw.h"
 #include "rng_internals.h"
 
+#ifdef RNG_HWRNG
+#include <linux/hw_random.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/proc_fs.h>
+#include <linux/random.h>
+#endif
+
 #ifdef FSL_HAVE_SCC2
 #include <linux/mxc_scc2_driver.h>
 #else
@@ -149,6 +157,48 @@ static unsigned task_started = FALSE;
  */
 static DECLARE_COMPLETION(rng_self_testing);
 static DECLARE_COMPLETION(rng_seed_done);
+
+/*!
+ * Serializes readers of the output FIFO, so that the level read back from the
+ * status register still holds when the words are pulled.  Reading an empty
+ * FIFO in High Assurance mode fails the RNG.
+ */
+static DEFINE_SPINLOCK(rng_fifo_lock);
+
+#ifdef RNG_HWRNG
+/*! Words pulled from the FIFO per hand-off to the input pool. */
+#define RNG_HWRNG_BATCH_WORDS 128
+
+/*! Words in the startup health test sample (20000 bits, per FIPS 140-2). */
+#define RNG_HWRNG_TEST_WORDS 625
+
+/*!
+ * Entropy credited to the input pool per 1024 bits of RNG output.  The RNGC
+ * output is post-processed by its own hash, so a conservative half is used.
+ */
+static unsigned short rng_hwrng_quality = 512;
+module_param_named(hwrng_quality, rng_hwrng_quality, ushort, 0644);
+MODULE_PARM_DESC(hwrng_quality,
+		 "Entropy credited per 1024 bits of RNG output (0 - 1024)");
+
+/*! Feeder thread moving FIFO output into the input pool. */
+static struct task_struct *rng_hwrng_thread;
+
+/*! Set once #rng_hwrng has been registered with the hw_random core. */
+static int rng_hwrng_registered = FALSE;
+
+/*! Counters reported through /proc/driver/rng_hwrng. */
+static struct {
+	unsigned long long bytes;	/*!< Bytes handed to the input pool. */
+	unsigned long batches;	/*!< Batches handed to the input pool. */
+	unsigned long fifo_empty;	/*!< Times the FIFO was found empty. */
+	unsigned long errors;	/*!< Error interrupts seen. */
+	unsigned long long drain_ns;	/*!< Time spent pulling the FIFO. */
+	unsigned long start;	/*!< jiffies when feeding started. */
+	int health;		/*!< 1 passed, -1 failed, 0 not run. */
+} rng_hwrng_stats;
+#endif				/* RNG_HWRNG */
+
 /*!
  *  Object for blocking-mode callers of RNG driver to sleep.
  */
@@ -292,6 +342,11 @@ OS_DEV_INIT(rng_init)
 			wait_for_completion(&rng_seed_done);
 #endif
 		} while (RNG_CHECK_SEED_ERR());
+#ifdef RNG_HWRNG
+		/* The entropy feeder drains continuously; let the RNG reseed
+		 * itself rather than stalling the FIFO on RNG_RESEED(). */
+		RNG_AUTO_SEED();
+#endif
 #ifndef RNG_NO_FORCE_HIGH_ASSURANCE
 		RNG_SET_HIGH_ASSURANCE();
 #endif
@@ -362,6 +417,9 @@ OS_DEV_INIT(rng_init)
 	    && (rng_availability == RNG_STATUS_CHECKING)) {
 		RNG_PUT_RNG_TO_SLEEP();
 		rng_availability = RNG_STATUS_OK;	/* RNG & driver are ready */
+#ifdef RNG_HWRNG
+		rng_hwrng_start();
+#endif
 	} else if (return_code != OS_ERROR_OK_S) {
 		os_printk(KERN_ALERT "Driver initialization failed. %d",
 			  return_code);
@@ -415,6 +473,9 @@ static void rng_cleanup(void)
 {
 	struct clk *clk;
 
+#ifdef RNG_HWRNG
+	rng_hwrng_stop();
+#endif
 #ifdef FSL_HAVE_RNGA
 	scc_stop_monitoring_security_failure(rng_sec_failure);
 #endif
@@ -827,6 +888,9 @@ OS_DEV_ISR(rng_irq)
 	}
 	/* Look to see whether RNG needs attention */
 	if (RNG_HAS_ERROR()) {
+#ifdef RNG_HWRNG
+		rng_hwrng_stats.errors++;
+#endif
 		if (RNG_GET_HIGH_ASSURANCE()) {
 			RNG_SLEEP();
 			rng_availability = RNG_STATUS_FAILED;
@@ -971,6 +1035,7 @@ static fsl_shw_return_t rng_drain_fifo(uint32_t * random_p, int count_words)
 #endif
 	/* Copy all of them in.  Stop if pool fills. */
 	while ((rng_availability == RNG_STATUS_OK) && (count_words > 0)) {
+		spin_lock_bh(&rng_fifo_lock);
 		/* Ask RNG how many words currently in FIFO */
 		words_in_rng = RNG_GET_WORDS_IN_FIFO();
 		if (words_in_rng == 0) {
@@ -983,6 +1048,7 @@ static fsl_shw_return_t rng_drain_fifo(uint32_t * random_p, int count_words)
 				LOG_KDIAG_ARGS("FIFO staying empty (%d)",
 					       words_in_rng);
 				code = FSL_RETURN_NO_RESOURCE_S;
+				spin_unlock_bh(&rng_fifo_lock);
 				break;
 			}
 		} else {
@@ -1006,6 +1072,7 @@ static fsl_shw_return_t rng_drain_fifo(uint32_t * random_p, int count_words)
 			*random_p++ = RNG_READ_FIFO();
 			count_words--;
 		}
+		spin_unlock_bh(&rng_fifo_lock);
 	}			/* while words still needed */
 
 	if (count_words == 0) {
@@ -1019,6 +1086,309 @@ static fsl_shw_return_t rng_drain_fifo(uint32_t * random_p, int count_words)
 	return code;
 }				/* rng_drain_fifo */
 
+#ifdef RNG_HWRNG
+/*****************************************************************************/
+/* fn rng_hwrng_fill()                                                       */
+/*****************************************************************************/
+/*!
+ * Copy up to @a count_words words from the output FIFO, never reading more
+ * than the FIFO claims to hold.  Unlike rng_drain_fifo() an empty FIFO is not
+ * an error: the caller sleeps a tick after #RNG_MAX_TRIES empty polls and
+ * tries again, until the RNG fails or the feeder is stopped.
+ *
+ * @param random_p    Location to copy random data
+ * @param count_words Number of words wanted
+ *
+ * @return Number of words copied.
+ */
+static int rng_hwrng_fill(uint32_t * random_p, int count_words)
+{
+	int copied = 0;
+	int sequential_count = 0;
+	ktime_t start = ktime_get();
+
+	while ((rng_availability == RNG_STATUS_OK) && (copied < count_words)
+	       && !kthread_should_stop()) {
+		int words_in_rng;
+
+		spin_lock_bh(&rng_fifo_lock);
+		words_in_rng = RNG_GET_WORDS_IN_FIFO();
+		if (words_in_rng > count_words - copied) {
+			words_in_rng = count_words - copied;
+		}
+		copied += words_in_rng;
+		while (words_in_rng-- > 0) {
+			*random_p++ = RNG_READ_FIFO();
+		}
+		spin_unlock_bh(&rng_fifo_lock);
+
+		if (copied < count_words) {
+			rng_hwrng_stats.fifo_empty++;
+			if (++sequential_count >= RNG_MAX_TRIES) {
+				sequential_count = 0;
+				schedule_timeout_interruptible(1);
+			} else {
+				cpu_relax();
+			}
+		}
+	}
+	rng_hwrng_stats.drain_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return copied;
+}				/* rng_hwrng_fill */
+
+/*****************************************************************************/
+/* fn rng_hwrng_health_test()                                                */
+/*****************************************************************************/
+/*!
+ * Startup health test on 20000 bits of output: the FIPS 140-2 monobit and
+ * poker tests, plus a continuous test that no word repeats its predecessor.
+ *
+ * @return 0 if the sample passed, non-zero otherwise.
+ */
+static int rng_hwrng_health_test(void)
+{
+	uint32_t *sample;
+	unsigned int nibbles[16];
+	unsigned int ones = 0;
+	unsigned long poker = 0;
+	int failed = -1;
+	int i, j;
+
+	sample = kmalloc(RNG_HWRNG_TEST_WORDS * sizeof(uint32_t), GFP_KERNEL);
+	if (sample == NULL) {
+		return -ENOMEM;
+	}
+	if (rng_hwrng_fill(sample, RNG_HWRNG_TEST_WORDS) !=
+	    RNG_HWRNG_TEST_WORDS) {
+		goto out;
+	}
+
+	memset(nibbles, 0, sizeof(nibbles));
+	for (i = 0; i < RNG_HWRNG_TEST_WORDS; i++) {
+		if ((i != 0) && (sample[i] == sample[i - 1])) {
+			LOG_KDIAG_ARGS("RNG: repeated word at %d", i);
+			goto out;
+		}
+		ones += hweight32(sample[i]);
+		for (j = 0; j < 32; j += 4) {
+			nibbles[(sample[i] >> j) & 0xf]++;
+		}
+	}
+
+	/* Monobit: 9725 < ones < 10275 */
+	if ((ones <= 9725) || (ones >= 10275)) {
+		LOG_KDIAG_ARGS("RNG: monobit test failed (%u ones)", ones);
+		goto out;
+	}
+
+	/* Poker: 2.16 < X < 46.17, X = (16 / 5000) * sum(f^2) - 5000 */
+	for (i = 0; i < 16; i++) {
+		poker += nibbles[i] * nibbles[i];
+	}
+	poker = poker * 16 - 5000 * 5000;
+	if ((poker <= 10800) || (poker >= 230850)) {
+		LOG_KDIAG_ARGS("RNG: poker test failed (%lu)", poker);
+		goto out;
+	}
+
+	failed = 0;
+      out:
+	memset(sample, 0, RNG_HWRNG_TEST_WORDS * sizeof(uint32_t));
+	kfree(sample);
+
+	return failed;
+}				/* rng_hwrng_health_test */
+
+static int rng_hwrng_data_present(struct hwrng *rng, int wait)
+{
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		if (rng_availability != RNG_STATUS_OK) {
+			return 0;
+		}
+		if (RNG_GET_WORDS_IN_FIFO() != 0) {
+			return 1;
+		}
+		if (!wait) {
+			break;
+		}
+		udelay(10);
+	}
+
+	return 0;
+}
+
+static int rng_hwrng_data_read(struct hwrng *rng, u32 * data)
+{
+	int bytes = 0;
+
+	spin_lock_bh(&rng_fifo_lock);
+	if ((rng_availability == RNG_STATUS_OK)
+	    && (RNG_GET_WORDS_IN_FIFO() != 0)) {
+		*data = RNG_READ_FIFO();
+		bytes = sizeof(u32);
+	}
+	spin_unlock_bh(&rng_fifo_lock);
+
+	return bytes;
+}
+
+/*! Exposes the RNG through /dev/hwrng. */
+static struct hwrng rng_hwrng = {
+	.name = RNG_DRIVER_NAME,
+	.data_present = rng_hwrng_data_present,
+	.data_read = rng_hwrng_data_read,
+};
+
+/*****************************************************************************/
+/* fn rng_hwrng_feeder()                                                     */
+/*****************************************************************************/
+/*!
+ * Feeder thread.  After the startup health test passes, pulls the FIFO in
+ * batches of #RNG_HWRNG_BATCH_WORDS and hands each batch to
+ * add_hwgenerator_randomness(), which sleeps until the input pool falls below
+ * its write wakeup threshold.  The RNGC has no FIFO level interrupt, so the
+ * pool's demand is what paces the thread; an error interrupt moves
+ * #rng_availability out of #RNG_STATUS_OK, which stops the feed.
+ */
+static int rng_hwrng_feeder(void *unused)
+{
+	uint32_t *batch;
+	int words;
+
+	batch = kmalloc(RNG_HWRNG_BATCH_WORDS * sizeof(uint32_t), GFP_KERNEL);
+	if (batch == NULL) {
+		goto idle;
+	}
+
+	if (rng_hwrng_health_test() != 0) {
+		rng_hwrng_stats.health = -1;
+		os_printk(KERN_ALERT
+			  "RNG: startup health test failed, not feeding "
+			  "the entropy pool\n");
+		goto idle;
+	}
+	rng_hwrng_stats.health = 1;
+
+	if (hwrng_register(&rng_hwrng) == 0) {
+		rng_hwrng_registered = TRUE;
+	}
+
+	rng_hwrng_stats.start = jiffies;
+	while (!kthread_should_stop() && (rng_availability == RNG_STATUS_OK)) {
+		words = rng_hwrng_fill(batch, RNG_HWRNG_BATCH_WORDS);
+		if (words == 0) {
+			continue;
+		}
+		add_hwgenerator_randomness((const char *)batch,
+					   words * sizeof(uint32_t),
+					   (words * 32 * rng_hwrng_quality)
+					   >> 10);
+		rng_hwrng_stats.bytes += words * sizeof(uint32_t);
+		rng_hwrng_stats.batches++;
+	}
+	if (rng_availability != RNG_STATUS_OK) {
+		os_printk(KERN_ALERT "RNG: failed, entropy feed stopped\n");
+	}
+
+      idle:
+	if (batch != NULL) {
+		memset(batch, 0, RNG_HWRNG_BATCH_WORDS * sizeof(uint32_t));
+		kfree(batch);
+	}
+	/* kthread_stop() must find the thread still alive */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop()) {
+			schedule();
+		}
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return 0;
+}				/* rng_hwrng_feeder */
+
+static int rng_hwrng_read_proc(char *page, char **start, off_t off,
+			       int count, int *eof, void *data)
+{
+	unsigned long secs = (jiffies - rng_hwrng_stats.start) / HZ;
+	unsigned long long delivered = rng_hwrng_stats.bytes;
+	unsigned long long drain_rate = 0;
+	int len;
+
+	if (rng_hwrng_stats.start == 0) {
+		secs = 0;
+	}
+	if (rng_hwrng_stats.drain_ns != 0) {
+		drain_rate = div64_u64(delivered * NSEC_PER_SEC,
+				       rng_hwrng_stats.drain_ns);
+	}
+	if (secs != 0) {
+		do_div(delivered, secs);
+	}
+
+	len = sprintf(page,
+		      "health test: %s\n"
+		      "bytes:       %llu\n"
+		      "batches:     %lu\n"
+		      "fifo empty:  %lu\n"
+		      "errors:      %lu\n"
+		      "pool rate:   %llu B/s\n"
+		      "fifo rate:   %llu B/s\n",
+		      rng_hwrng_stats.health > 0 ? "passed" :
+		      rng_hwrng_stats.health < 0 ? "FAILED" : "pending",
+		      rng_hwrng_stats.bytes, rng_hwrng_stats.batches,
+		      rng_hwrng_stats.fifo_empty, rng_hwrng_stats.errors,
+		      delivered, drain_rate);
+	*eof = 1;
+
+	return len;
+}
+
+/*****************************************************************************/
+/* fn rng_hwrng_start()                                                      */
+/*****************************************************************************/
+/*!
+ * Start feeding the kernel entropy pool.  Failure here leaves the rest of the
+ * driver working.
+ */
+static void rng_hwrng_start(void)
+{
+	memset(&rng_hwrng_stats, 0, sizeof(rng_hwrng_stats));
+
+	rng_hwrng_thread = kthread_run(rng_hwrng_feeder, NULL, "rng_feed");
+	if (IS_ERR(rng_hwrng_thread)) {
+		os_printk(KERN_ALERT "RNG: could not start entropy feeder\n");
+		rng_hwrng_thread = NULL;
+		return;
+	}
+	create_proc_read_entry("driver/rng_hwrng", 0444, NULL,
+			       rng_hwrng_read_proc, NULL);
+}				/* rng_hwrng_start */
+
+/*****************************************************************************/
+/* fn rng_hwrng_stop()                                                       */
+/*****************************************************************************/
+/*!
+ * Undo rng_hwrng_start().
+ */
+static void rng_hwrng_stop(void)
+{
+	if (rng_hwrng_thread == NULL) {
+		return;
+	}
+	remove_proc_entry("driver/rng_hwrng", NULL);
+	kthread_stop(rng_hwrng_thread);
+	rng_hwrng_thread = NULL;
+	if (rng_hwrng_registered) {
+		hwrng_unregister(&rng_hwrng);
+		rng_hwrng_registered = FALSE;
+	}
+}				/* rng_hwrng_stop */
+#endif				/* RNG_HWRNG */
+
 /*****************************************************************************/
 /* fn rng_entropy_task()                                                     */
 /*****************************************************************************/
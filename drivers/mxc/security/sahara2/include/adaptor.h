@@ -108,6 +108,20 @@ fsl_shw_return_t sah_deregister(fsl_shw_uco_t * user_ctx);
 fsl_shw_return_t get_capabilities(fsl_shw_uco_t * user_ctx,
 							fsl_shw_pco_t *capabilities);
 
+#ifdef SAHARA_CRYPTO_API
+int sah_crypto_init(void);
+void sah_crypto_exit(void);
+#else
+static inline int sah_crypto_init(void)
+{
+	return 0;
+}
+
+static inline void sah_crypto_exit(void)
+{
+}
+#endif
+
 #endif				/* ADAPTOR_H */
 
 /* End of adaptor.h */
@@ -0,0 +1,945 @@
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*!
+ * @file sah_crypto.c
+ *
+ * @brief Linux Crypto API glue for Sahara.
+ *
+ * Registers cbc(aes) and ctr(aes) as asynchronous block ciphers and sha1
+ * and sha256 as asynchronous hashes.  Requests are turned into descriptor
+ * chains whose data links point straight at the DMA-mapped scatterlist
+ * entries (#SAH_PREPHYS_DATA), so nothing is bounced through the driver.
+ * The chains go through the normal non-blocking path into the Queue
+ * Manager, and requests are completed from the Sahara bottom half via the
+ * user context callback.
+ *
+ * At most #SAH_CRYPTO_MAX_INFLIGHT requests are handed to the Queue Manager
+ * at any one time; the rest wait on a crypto_queue, which also provides the
+ * backlog semantics the Crypto API expects.
+ *
+ * Requests shorter than #SAH_CRYPTO_FALLBACK_LEN are done synchronously by
+ * the generic software implementation instead.
+ */
+
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-mapping.h>
+#include <linux/spinlock.h>
+#include <crypto/algapi.h>
+#include <crypto/aes.h>
+#include <crypto/sha.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/internal/hash.h>
+#include <crypto/hash.h>
+
+#include <linux/mxc_sahara.h>
+#include "sf_util.h"
+#include "adaptor.h"
+
+/*! Number of chains handed to the Queue Manager at once */
+#define SAH_CRYPTO_MAX_INFLIGHT  16
+
+/*! Requests that may wait on the software queue */
+#define SAH_CRYPTO_QUEUE_LEN     64
+
+/*! Results pulled from the result pool per sah_get_results() call */
+#define SAH_CRYPTO_RESULTS       8
+
+/*! Sahara picks these over the generic C implementations */
+#define SAH_CRYPTO_PRIORITY      300
+
+/*!
+ * Below this many bytes, building the chain, mapping the scatterlists and
+ * taking the completion interrupt costs more than doing the work on the CPU.
+ */
+#define SAH_CRYPTO_FALLBACK_LEN  256
+
+/*! Largest MDHA context register (SHA-256 digest plus message length) */
+#define SAH_HASH_CONTEXT_LEN     36
+
+#define SAH_HASH_BLOCK_SIZE      64
+
+/* Hash request state */
+#define SAH_HASH_STARTED         0x01	/*!< MDHA context is in @a context */
+#define SAH_HASH_FINAL           0x02	/*!< pad the message and return digest */
+#define SAH_HASH_ONESHOT         0x04	/*!< whole message is in the request */
+
+struct sah_cipher_ctx {
+	fsl_shw_sko_t key;
+	struct crypto_blkcipher *fallback;
+};
+
+struct sah_cipher_reqctx {
+	fsl_shw_sym_mode_t mode;
+	int encrypt;
+	int src_nents;
+	int dst_nents;
+	/* Written by Sahara; keep it in a cache line of its own */
+	uint8_t iv[AES_BLOCK_SIZE] ____cacheline_aligned;
+};
+
+struct sah_hash_ctx {
+	fsl_shw_hash_alg_t algorithm;
+	unsigned context_len;
+	struct crypto_shash *fallback;
+};
+
+struct sah_hash_reqctx {
+	unsigned flags;
+	unsigned buflen;	/*!< bytes waiting in @a buf */
+	unsigned taillen;	/*!< bytes in @a tail once this round finishes */
+	int nents;		/*!< mapped entries of req->src, or 0 */
+	uint8_t buf[SAH_HASH_BLOCK_SIZE];
+	uint8_t tail[SAH_HASH_BLOCK_SIZE];
+	/* Written by Sahara; keep it in a cache line of its own */
+	uint8_t context[SAH_HASH_CONTEXT_LEN] ____cacheline_aligned;
+	/* followed by the fallback's shash_desc, see sah_hash_cra_init() */
+};
+
+static fsl_shw_uco_t sah_crypto_uco;
+static struct crypto_queue sah_crypto_queue;
+static unsigned sah_crypto_inflight;
+static DEFINE_SPINLOCK(sah_crypto_lock);
+static int sah_crypto_registered;
+
+static inline int sah_crypto_errno(fsl_shw_return_t code)
+{
+	switch (code) {
+	case FSL_RETURN_OK_S:
+		return 0;
+	case FSL_RETURN_NO_RESOURCE_S:
+	case FSL_RETURN_MEMORY_ERROR_S:
+		return -ENOMEM;
+	default:
+		return -EIO;
+	}
+}
+
+/*!
+ * Count the scatterlist entries needed to cover @a nbytes.
+ */
+static int sah_sg_count(struct scatterlist *sg, unsigned nbytes)
+{
+	int nents = 0;
+
+	while (sg != NULL && nbytes != 0) {
+		nents++;
+		if (sg->length >= nbytes)
+			break;
+		nbytes -= sg->length;
+		sg = sg_next(sg);
+	}
+
+	return nents;
+}
+
+/*!
+ * Append one link per mapped scatterlist entry to the chain at @a head,
+ * covering @a nbytes.  The links carry bus addresses, so the Memory Mapper
+ * neither translates them nor does any cache maintenance on them.
+ */
+static fsl_shw_return_t sah_sg_links(sah_Link ** head, struct scatterlist *sg,
+				     int nents, unsigned nbytes,
+				     sah_Link_Flags flags)
+{
+	const sah_Mem_Util *mu = sah_crypto_uco.mem_util;
+	fsl_shw_return_t ret = FSL_RETURN_OK_S;
+	sah_Link *tail = *head;
+	struct scatterlist *s;
+	int i;
+
+	while (tail != NULL && tail->next != NULL)
+		tail = tail->next;
+
+	for_each_sg(sg, s, nents, i) {
+		unsigned len = min(nbytes, (unsigned)sg_dma_len(s));
+		sah_Link *link;
+
+		if (len == 0)
+			break;
+		ret = sah_Create_Link(mu, &link, (uint8_t *) sg_dma_address(s),
+				      len, flags | SAH_PREPHYS_DATA);
+		if (ret != FSL_RETURN_OK_S)
+			break;
+		if (tail == NULL)
+			*head = link;
+		else
+			tail->next = link;
+		tail = link;
+		nbytes -= len;
+	}
+
+	return ret;
+}
+
+/*!
+ * Hand a finished chain to the Queue Manager.  The user context is shared
+ * by all requests, so its reference is set and copied into the chain head
+ * under the driver lock.
+ */
+static fsl_shw_return_t sah_crypto_submit(sah_Head_Desc * desc_chain,
+					  struct crypto_async_request *req)
+{
+	fsl_shw_return_t ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sah_crypto_lock, flags);
+	fsl_shw_uco_set_reference(&sah_crypto_uco, (uint32_t) req);
+	ret = sah_Descriptor_Chain_Execute(desc_chain, &sah_crypto_uco);
+	spin_unlock_irqrestore(&sah_crypto_lock, flags);
+
+	return ret;
+}
+
+static void sah_cipher_unmap(struct ablkcipher_request *req)
+{
+	struct sah_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	if (req->src == req->dst) {
+		dma_unmap_sg(NULL, req->src, rctx->src_nents,
+			     DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(NULL, req->src, rctx->src_nents, DMA_TO_DEVICE);
+		dma_unmap_sg(NULL, req->dst, rctx->dst_nents, DMA_FROM_DEVICE);
+	}
+}
+
+/*!
+ * Build and submit the chain for a cbc(aes) or ctr(aes) request:
+ *
+ * - set mode, load IV and key
+ * - run the scatterlists through SKHA
+ * - read the chaining value back for req->info
+ */
+static int sah_cipher_start(struct ablkcipher_request *req)
+{
+	struct sah_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct sah_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+	fsl_shw_uco_t *user_ctx = &sah_crypto_uco;
+	fsl_shw_return_t ret;
+	sah_Head_Desc *desc_chain = NULL;
+	sah_Link *in = NULL;
+	sah_Link *out = NULL;
+	uint32_t header;
+
+	rctx->src_nents = sah_sg_count(req->src, req->nbytes);
+	if (req->src == req->dst) {
+		dma_map_sg(NULL, req->src, rctx->src_nents, DMA_BIDIRECTIONAL);
+		rctx->dst_nents = rctx->src_nents;
+	} else {
+		rctx->dst_nents = sah_sg_count(req->dst, req->nbytes);
+		dma_map_sg(NULL, req->src, rctx->src_nents, DMA_TO_DEVICE);
+		dma_map_sg(NULL, req->dst, rctx->dst_nents, DMA_FROM_DEVICE);
+	}
+
+	memcpy(rctx->iv, req->info, AES_BLOCK_SIZE);
+
+	header = SAH_HDR_SKHA_SET_MODE_IV_KEY
+	    ^ sah_insert_skha_mode[rctx->mode]
+	    ^ sah_insert_skha_algorithm[FSL_KEY_ALG_AES];
+	if (rctx->encrypt) {
+		header ^= sah_insert_skha_encrypt;
+	}
+	if (rctx->mode == FSL_SYM_MODE_CTR) {
+		header ^= sah_insert_skha_modulus[FSL_CTR_MOD_128];
+	}
+	DESC_IN_KEY(header, AES_BLOCK_SIZE, rctx->iv, &ctx->key);
+
+	ret = sah_sg_links(&in, req->src, rctx->src_nents, req->nbytes,
+			   SAH_USES_LINK_DATA);
+	if (ret == FSL_RETURN_OK_S) {
+		ret = sah_sg_links(&out, req->dst, rctx->dst_nents,
+				   req->nbytes,
+				   SAH_USES_LINK_DATA | SAH_OUTPUT_LINK);
+	}
+	if (ret == FSL_RETURN_OK_S) {
+		/* On failure the links are released along with the desc. */
+		ret = sah_Append_Desc(user_ctx->mem_util, &desc_chain,
+				      SAH_HDR_SKHA_ENC_DEC, in, out);
+		in = out = NULL;
+	}
+	if (ret != FSL_RETURN_OK_S) {
+		goto out;
+	}
+
+	DESC_OUT_OUT(SAH_HDR_SKHA_READ_CONTEXT_IV, 0, NULL,
+		     AES_BLOCK_SIZE, rctx->iv);
+
+	ret = sah_crypto_submit(desc_chain, &req->base);
+
+      out:
+	if (ret != FSL_RETURN_OK_S) {
+		if (in != NULL) {
+			sah_Destroy_Link(user_ctx->mem_util, in);
+		}
+		if (out != NULL) {
+			sah_Destroy_Link(user_ctx->mem_util, out);
+		}
+		if (desc_chain != NULL) {
+			sah_Descriptor_Chain_Destroy(user_ctx->mem_util,
+						     &desc_chain);
+		}
+		sah_cipher_unmap(req);
+	}
+
+	return sah_crypto_errno(ret);
+}
+
+static void sah_cipher_finish(struct ablkcipher_request *req, int err)
+{
+	struct sah_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	sah_cipher_unmap(req);
+	if (err == 0) {
+		memcpy(req->info, rctx->iv, AES_BLOCK_SIZE);
+	}
+}
+
+/*!
+ * Build and submit the chain for one round of a hash request.
+ *
+ * Everything but the final round feeds MDHA a whole number of blocks and
+ * keeps 1-64 bytes back in @a buf, so the final round always has data to
+ * pad.  The first round starts MDHA from its initial value (INIT); later
+ * rounds reload the saved context and then hash, as fsl_shw_hash() does.
+ */
+static int sah_hash_start(struct ahash_request *req)
+{
+	struct sah_hash_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+	fsl_shw_uco_t *user_ctx = &sah_crypto_uco;
+	unsigned digest_len =
+	    crypto_ahash_digestsize(crypto_ahash_reqtfm(req));
+	fsl_shw_return_t ret = FSL_RETURN_OK_S;
+	sah_Head_Desc *desc_chain = NULL;
+	sah_Link *data = NULL;
+	sah_Link *result = NULL;
+	unsigned sg_len;
+	unsigned out_len;
+	uint32_t header;
+
+	if (rctx->flags & SAH_HASH_ONESHOT) {
+		sg_len = req->nbytes;
+		rctx->taillen = 0;
+	} else if (rctx->flags & SAH_HASH_FINAL) {
+		sg_len = 0;
+		rctx->taillen = 0;
+	} else {
+		unsigned total = rctx->buflen + req->nbytes;
+		unsigned hash_len = (total - 1) & ~(SAH_HASH_BLOCK_SIZE - 1);
+
+		sg_len = hash_len - rctx->buflen;
+		rctx->taillen = total - hash_len;
+		scatterwalk_map_and_copy(rctx->tail, req->src,
+					 req->nbytes - rctx->taillen,
+					 rctx->taillen, 0);
+	}
+
+	rctx->nents = 0;
+	if (sg_len != 0) {
+		rctx->nents = sah_sg_count(req->src, sg_len);
+		dma_map_sg(NULL, req->src, rctx->nents, DMA_TO_DEVICE);
+	}
+
+	if (rctx->buflen != 0) {
+		ret = sah_Create_Link(user_ctx->mem_util, &data, rctx->buf,
+				      rctx->buflen, SAH_USES_LINK_DATA);
+	}
+	if ((ret == FSL_RETURN_OK_S) && (sg_len != 0)) {
+		ret = sah_sg_links(&data, req->src, rctx->nents, sg_len,
+				   SAH_USES_LINK_DATA);
+	}
+	if (ret != FSL_RETURN_OK_S) {
+		goto out;
+	}
+
+	out_len = (rctx->flags & SAH_HASH_FINAL) ? digest_len
+	    : ctx->context_len;
+	ret = sah_Create_Link(user_ctx->mem_util, &result, rctx->context,
+			      out_len, SAH_USES_LINK_DATA | SAH_OUTPUT_LINK);
+	if (ret != FSL_RETURN_OK_S) {
+		goto out;
+	}
+
+	if (!(rctx->flags & SAH_HASH_STARTED)) {
+		header = SAH_HDR_MDHA_SET_MODE_HASH
+		    ^ sah_insert_mdha_init
+		    ^ sah_insert_mdha_algorithm[ctx->algorithm];
+		if (rctx->flags & SAH_HASH_FINAL) {
+			header ^= sah_insert_mdha_pdata;
+		}
+	} else {
+		header = SAH_HDR_MDHA_SET_MODE_MD_KEY
+		    ^ sah_insert_mdha_algorithm[ctx->algorithm];
+		if (rctx->flags & SAH_HASH_FINAL) {
+			header ^= sah_insert_mdha_pdata;
+		}
+		DESC_IN_IN(header, ctx->context_len, rctx->context, 0, NULL);
+		header = SAH_HDR_MDHA_HASH;
+	}
+
+	/* On failure the links are released along with the desc. */
+	ret = sah_Append_Desc(user_ctx->mem_util, &desc_chain, header,
+			      data, result);
+	data = result = NULL;
+	if (ret != FSL_RETURN_OK_S) {
+		goto out;
+	}
+
+	ret = sah_crypto_submit(desc_chain, &req->base);
+
+      out:
+	if (ret != FSL_RETURN_OK_S) {
+		if (data != NULL) {
+			sah_Destroy_Link(user_ctx->mem_util, data);
+		}
+		if (result != NULL) {
+			sah_Destroy_Link(user_ctx->mem_util, result);
+		}
+		if (desc_chain != NULL) {
+			sah_Descriptor_Chain_Destroy(user_ctx->mem_util,
+						     &desc_chain);
+		}
+		if (rctx->nents != 0) {
+			dma_unmap_sg(NULL, req->src, rctx->nents,
+				     DMA_TO_DEVICE);
+		}
+	}
+
+	return sah_crypto_errno(ret);
+}
+
+static void sah_hash_finish(struct ahash_request *req, int err)
+{
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	if (rctx->nents != 0) {
+		dma_unmap_sg(NULL, req->src, rctx->nents, DMA_TO_DEVICE);
+	}
+	if (err != 0) {
+		return;
+	}
+
+	if (rctx->flags & SAH_HASH_FINAL) {
+		memcpy(req->result, rctx->context,
+		       crypto_ahash_digestsize(crypto_ahash_reqtfm(req)));
+	} else {
+		memcpy(rctx->buf, rctx->tail, rctx->taillen);
+		rctx->buflen = rctx->taillen;
+		rctx->flags |= SAH_HASH_STARTED;
+	}
+}
+
+static int sah_crypto_start(struct crypto_async_request *req)
+{
+	if (crypto_tfm_alg_type(req->tfm) == CRYPTO_ALG_TYPE_ABLKCIPHER) {
+		return sah_cipher_start(ablkcipher_request_cast(req));
+	}
+	return sah_hash_start(ahash_request_cast(req));
+}
+
+static void sah_crypto_finish(struct crypto_async_request *req, int err)
+{
+	if (crypto_tfm_alg_type(req->tfm) == CRYPTO_ALG_TYPE_ABLKCIPHER) {
+		sah_cipher_finish(ablkcipher_request_cast(req), err);
+	} else {
+		sah_hash_finish(ahash_request_cast(req), err);
+	}
+}
+
+/*!
+ * Move requests from the software queue to the Queue Manager until the
+ * in-flight limit is reached.
+ */
+static void sah_crypto_dispatch(void)
+{
+	struct crypto_async_request *req;
+	struct crypto_async_request *backlog;
+	unsigned long flags;
+	int err;
+
+	for (;;) {
+		spin_lock_irqsave(&sah_crypto_lock, flags);
+		if (sah_crypto_inflight >= SAH_CRYPTO_MAX_INFLIGHT) {
+			spin_unlock_irqrestore(&sah_crypto_lock, flags);
+			break;
+		}
+		backlog = crypto_get_backlog(&sah_crypto_queue);
+		req = crypto_dequeue_request(&sah_crypto_queue);
+		if (req != NULL) {
+			sah_crypto_inflight++;
+		}
+		spin_unlock_irqrestore(&sah_crypto_lock, flags);
+
+		if (req == NULL) {
+			break;
+		}
+		if (backlog != NULL) {
+			backlog->complete(backlog, -EINPROGRESS);
+		}
+
+		err = sah_crypto_start(req);
+		if (err != 0) {
+			spin_lock_irqsave(&sah_crypto_lock, flags);
+			sah_crypto_inflight--;
+			spin_unlock_irqrestore(&sah_crypto_lock, flags);
+			req->complete(req, err);
+		}
+	}
+}
+
+static int sah_crypto_enqueue(struct crypto_async_request *req)
+{
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&sah_crypto_lock, flags);
+	err = crypto_enqueue_request(&sah_crypto_queue, req);
+	spin_unlock_irqrestore(&sah_crypto_lock, flags);
+
+	sah_crypto_dispatch();
+
+	return err;
+}
+
+/*!
+ * User context callback, run from the Sahara bottom half each time one of
+ * our chains completes.  Drains every finished chain, completes the
+ * matching requests and refills the Queue Manager.
+ */
+static void sah_crypto_callback(fsl_shw_uco_t * uco)
+{
+	fsl_shw_result_t results[SAH_CRYPTO_RESULTS];
+	sah_results res;
+	unsigned actual;
+	unsigned long flags;
+	unsigned i;
+
+	do {
+		res.requested = SAH_CRYPTO_RESULTS;
+		res.actual = &actual;
+		res.results = results;
+		actual = 0;
+
+		if (sah_get_results(&res, uco) != FSL_RETURN_OK_S) {
+			break;
+		}
+
+		for (i = 0; i < actual; i++) {
+			struct crypto_async_request *req =
+			    (struct crypto_async_request *)results[i].user_ref;
+			int err = sah_crypto_errno(results[i].code);
+
+			sah_crypto_finish(req, err);
+
+			spin_lock_irqsave(&sah_crypto_lock, flags);
+			sah_crypto_inflight--;
+			spin_unlock_irqrestore(&sah_crypto_lock, flags);
+
+			req->complete(req, err);
+		}
+	} while (actual == SAH_CRYPTO_RESULTS);
+
+	sah_crypto_dispatch();
+}
+
+static int sah_aes_setkey(struct crypto_ablkcipher *cipher, const u8 * key,
+			  unsigned int keylen)
+{
+	struct sah_cipher_ctx *ctx = crypto_ablkcipher_ctx(cipher);
+	int err;
+
+	if ((keylen != AES_KEYSIZE_128) && (keylen != AES_KEYSIZE_192)
+	    && (keylen != AES_KEYSIZE_256)) {
+		crypto_ablkcipher_set_flags(cipher,
+					    CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+
+	crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(ctx->fallback,
+				   crypto_ablkcipher_get_flags(cipher) &
+				   CRYPTO_TFM_REQ_MASK);
+	err = crypto_blkcipher_setkey(ctx->fallback, key, keylen);
+	if (err != 0) {
+		crypto_ablkcipher_set_flags(cipher,
+					    crypto_blkcipher_get_flags
+					    (ctx->fallback) &
+					    CRYPTO_TFM_RES_MASK);
+		return err;
+	}
+
+	fsl_shw_sko_init(&ctx->key, FSL_KEY_ALG_AES);
+	fsl_shw_sko_set_key(&ctx->key, key, keylen);
+
+	return 0;
+}
+
+/*!
+ * Run a short request through the software implementation.  req->info is
+ * updated in place, just as sah_cipher_finish() does.
+ */
+static int sah_aes_fallback(struct ablkcipher_request *req, int encrypt)
+{
+	struct sah_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct blkcipher_desc desc;
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (encrypt) {
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+	}
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
+static int sah_aes_crypt(struct ablkcipher_request *req,
+			 fsl_shw_sym_mode_t mode, int encrypt)
+{
+	struct sah_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	if ((mode == FSL_SYM_MODE_CBC) && (req->nbytes % AES_BLOCK_SIZE)) {
+		crypto_ablkcipher_set_flags(crypto_ablkcipher_reqtfm(req),
+					    CRYPTO_TFM_RES_BAD_BLOCK_LEN);
+		return -EINVAL;
+	}
+	if (req->nbytes == 0) {
+		return 0;
+	}
+	if (req->nbytes < SAH_CRYPTO_FALLBACK_LEN) {
+		return sah_aes_fallback(req, encrypt);
+	}
+
+	rctx->mode = mode;
+	rctx->encrypt = encrypt;
+
+	return sah_crypto_enqueue(&req->base);
+}
+
+static int sah_aes_cbc_encrypt(struct ablkcipher_request *req)
+{
+	return sah_aes_crypt(req, FSL_SYM_MODE_CBC, 1);
+}
+
+static int sah_aes_cbc_decrypt(struct ablkcipher_request *req)
+{
+	return sah_aes_crypt(req, FSL_SYM_MODE_CBC, 0);
+}
+
+static int sah_aes_ctr_encrypt(struct ablkcipher_request *req)
+{
+	return sah_aes_crypt(req, FSL_SYM_MODE_CTR, 1);
+}
+
+static int sah_aes_ctr_decrypt(struct ablkcipher_request *req)
+{
+	return sah_aes_crypt(req, FSL_SYM_MODE_CTR, 0);
+}
+
+static int sah_cipher_cra_init(struct crypto_tfm *tfm)
+{
+	struct sah_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = tfm->__crt_alg->cra_name;
+
+	ctx->fallback = crypto_alloc_blkcipher(name, 0, CRYPTO_ALG_ASYNC |
+					       CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		printk(KERN_ERR "SAHARA: no fallback for %s\n", name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	tfm->crt_ablkcipher.reqsize = sizeof(struct sah_cipher_reqctx);
+	return 0;
+}
+
+static void sah_cipher_cra_exit(struct crypto_tfm *tfm)
+{
+	struct sah_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_blkcipher(ctx->fallback);
+}
+
+/*!
+ * Hash @a len bytes at @a data in software.  Used for one-shot digests
+ * shorter than #SAH_CRYPTO_FALLBACK_LEN and for messages that never left
+ * the request buffer, including the empty one, which MDHA cannot pad.
+ */
+static int sah_hash_fallback(struct ahash_request *req, const uint8_t * data,
+			     unsigned len)
+{
+	struct sah_hash_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct shash_desc *desc =
+	    (struct shash_desc *)((struct sah_hash_reqctx *)
+				  ahash_request_ctx(req) + 1);
+
+	desc->tfm = ctx->fallback;
+	desc->flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	return crypto_shash_digest(desc, data, len, req->result);
+}
+
+static int sah_hash_init(struct ahash_request *req)
+{
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->flags = 0;
+	rctx->buflen = 0;
+	rctx->taillen = 0;
+	rctx->nents = 0;
+
+	return 0;
+}
+
+static int sah_hash_update(struct ahash_request *req)
+{
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	if (req->nbytes == 0) {
+		return 0;
+	}
+
+	/* Not enough for a block beyond what is held back; just buffer it */
+	if (rctx->buflen + req->nbytes <= SAH_HASH_BLOCK_SIZE) {
+		scatterwalk_map_and_copy(rctx->buf + rctx->buflen, req->src,
+					 0, req->nbytes, 0);
+		rctx->buflen += req->nbytes;
+		return 0;
+	}
+
+	return sah_crypto_enqueue(&req->base);
+}
+
+static int sah_hash_final(struct ahash_request *req)
+{
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	/* The whole message is still in buf */
+	if (!(rctx->flags & SAH_HASH_STARTED)) {
+		return sah_hash_fallback(req, rctx->buf, rctx->buflen);
+	}
+
+	rctx->flags |= SAH_HASH_FINAL;
+
+	return sah_crypto_enqueue(&req->base);
+}
+
+static int sah_hash_digest(struct ahash_request *req)
+{
+	struct sah_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	sah_hash_init(req);
+	if (req->nbytes < SAH_CRYPTO_FALLBACK_LEN) {
+		uint8_t data[SAH_CRYPTO_FALLBACK_LEN];
+
+		scatterwalk_map_and_copy(data, req->src, 0, req->nbytes, 0);
+		return sah_hash_fallback(req, data, req->nbytes);
+	}
+
+	rctx->flags = SAH_HASH_FINAL | SAH_HASH_ONESHOT;
+
+	return sah_crypto_enqueue(&req->base);
+}
+
+static int sah_hash_cra_init(struct crypto_tfm *tfm,
+			     fsl_shw_hash_alg_t algorithm, unsigned context_len)
+{
+	struct sah_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = tfm->__crt_alg->cra_name;
+
+	ctx->fallback = crypto_alloc_shash(name, 0, CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		printk(KERN_ERR "SAHARA: no fallback for %s\n", name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	ctx->algorithm = algorithm;
+	ctx->context_len = context_len;
+	tfm->crt_ahash.reqsize = sizeof(struct sah_hash_reqctx) +
+	    sizeof(struct shash_desc) + crypto_shash_descsize(ctx->fallback);
+
+	return 0;
+}
+
+static void sah_hash_cra_exit(struct crypto_tfm *tfm)
+{
+	struct sah_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(ctx->fallback);
+}
+
+static int sah_sha1_cra_init(struct crypto_tfm *tfm)
+{
+	return sah_hash_cra_init(tfm, FSL_HASH_ALG_SHA1, SHA1_DIGEST_SIZE + 4);
+}
+
+static int sah_sha256_cra_init(struct crypto_tfm *tfm)
+{
+	return sah_hash_cra_init(tfm, FSL_HASH_ALG_SHA256,
+				 SHA256_DIGEST_SIZE + 4);
+}
+
+static struct crypto_alg sah_crypto_algs[] = {
+	{
+		.cra_name = "cbc(aes)",
+		.cra_driver_name = "cbc-aes-sahara",
+		.cra_priority = SAH_CRYPTO_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+		    CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = AES_BLOCK_SIZE,
+		.cra_ctxsize = sizeof(struct sah_cipher_ctx),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_ablkcipher_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = sah_cipher_cra_init,
+		.cra_exit = sah_cipher_cra_exit,
+		.cra_u.ablkcipher = {
+			.min_keysize = AES_MIN_KEY_SIZE,
+			.max_keysize = AES_MAX_KEY_SIZE,
+			.ivsize = AES_BLOCK_SIZE,
+			.setkey = sah_aes_setkey,
+			.encrypt = sah_aes_cbc_encrypt,
+			.decrypt = sah_aes_cbc_decrypt,
+		},
+	},
+	{
+		.cra_name = "ctr(aes)",
+		.cra_driver_name = "ctr-aes-sahara",
+		.cra_priority = SAH_CRYPTO_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+		    CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = 1,
+		.cra_ctxsize = sizeof(struct sah_cipher_ctx),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_ablkcipher_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = sah_cipher_cra_init,
+		.cra_exit = sah_cipher_cra_exit,
+		.cra_u.ablkcipher = {
+			.min_keysize = AES_MIN_KEY_SIZE,
+			.max_keysize = AES_MAX_KEY_SIZE,
+			.ivsize = AES_BLOCK_SIZE,
+			.setkey = sah_aes_setkey,
+			.encrypt = sah_aes_ctr_encrypt,
+			.decrypt = sah_aes_ctr_decrypt,
+		},
+	},
+	{
+		.cra_name = "sha1",
+		.cra_driver_name = "sha1-sahara",
+		.cra_priority = SAH_CRYPTO_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_AHASH | CRYPTO_ALG_ASYNC |
+		    CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = SHA1_BLOCK_SIZE,
+		.cra_ctxsize = sizeof(struct sah_hash_ctx),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_ahash_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = sah_sha1_cra_init,
+		.cra_exit = sah_hash_cra_exit,
+		.cra_u.ahash = {
+			.init = sah_hash_init,
+			.update = sah_hash_update,
+			.final = sah_hash_final,
+			.digest = sah_hash_digest,
+			.digestsize = SHA1_DIGEST_SIZE,
+		},
+	},
+	{
+		.cra_name = "sha256",
+		.cra_driver_name = "sha256-sahara",
+		.cra_priority = SAH_CRYPTO_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_AHASH | CRYPTO_ALG_ASYNC |
+		    CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = SHA256_BLOCK_SIZE,
+		.cra_ctxsize = sizeof(struct sah_hash_ctx),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_ahash_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = sah_sha256_cra_init,
+		.cra_exit = sah_hash_cra_exit,
+		.cra_u.ahash = {
+			.init = sah_hash_init,
+			.update = sah_hash_update,
+			.final = sah_hash_final,
+			.digest = sah_hash_digest,
+			.digestsize = SHA256_DIGEST_SIZE,
+		},
+	},
+};
+
+/*!
+ * Register a callback-mode user context with the driver and the
+ * algorithms with the Crypto API.  Called from sah_init() once the Queue
+ * Manager and interrupt handler are up.
+ *
+ * @return 0 on success, or a negative errno.
+ */
+int sah_crypto_init(void)
+{
+	int err = 0;
+	int i;
+
+	crypto_init_queue(&sah_crypto_queue, SAH_CRYPTO_QUEUE_LEN);
+
+	fsl_shw_uco_init(&sah_crypto_uco, SAH_CRYPTO_MAX_INFLIGHT);
+	fsl_shw_uco_clear_flags(&sah_crypto_uco, FSL_UCO_BLOCKING_MODE);
+	fsl_shw_uco_set_flags(&sah_crypto_uco, FSL_UCO_CALLBACK_MODE);
+	fsl_shw_uco_set_callback(&sah_crypto_uco, sah_crypto_callback);
+
+	if (sah_register(&sah_crypto_uco) != FSL_RETURN_OK_S) {
+		printk(KERN_ERR "SAHARA: crypto user registration failed\n");
+		return -ENODEV;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sah_crypto_algs); i++) {
+		err = crypto_register_alg(&sah_crypto_algs[i]);
+		if (err != 0) {
+			printk(KERN_ERR "SAHARA: could not register %s\n",
+				  sah_crypto_algs[i].cra_driver_name);
+			break;
+		}
+	}
+
+	if (err != 0) {
+		while (--i >= 0) {
+			crypto_unregister_alg(&sah_crypto_algs[i]);
+		}
+		sah_deregister(&sah_crypto_uco);
+		return err;
+	}
+
+	sah_crypto_registered = 1;
+
+	return 0;
+}
+
+/*!
+ * Undo sah_crypto_init().  Safe to call if it never ran or failed.
+ */
+void sah_crypto_exit(void)
+{
+	int i;
+
+	if (!sah_crypto_registered) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sah_crypto_algs); i++) {
+		crypto_unregister_alg(&sah_crypto_algs[i]);
+	}
+	sah_deregister(&sah_crypto_uco);
+	sah_crypto_registered = 0;
+}
+
+/* End of sah_crypto.c */
@@ -361,6 +361,11 @@ OS_DEV_INIT(sah_init)
 		}
 	}
 
+	if (os_error_code == OS_ERROR_OK_S) {
+		/* Offer the kernel Crypto API our ciphers and hashes */
+		os_error_code = sah_crypto_init();
+	}
+
 	if (os_error_code != OS_ERROR_OK_S) {
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0))
 		cleanup_module();
@@ -406,6 +411,9 @@ OS_DEV_SHUTDOWN(sah_cleanup)
 
 	printk(KERN_ALERT "Sahara going into cleanup\n");
 
+	/* Stop taking Crypto API requests before anything else goes away */
+	sah_crypto_exit();
+
 	/* clear out the system keystore */
 	fsl_shw_release_keystore(NULL, &system_keystore);
 
@@ -88,8 +88,20 @@ static struct gen_pool *vpu_pool;
 
 #define vpu_phys_to_virt(p) (vpu_reserved_virt + ((p) - vpu_reserved_phy))
 
+/*
+ * With CMA the board need not carve out vpu_reserved_mem; buffers the pool
+ * would have held are then allocated like the others, and large ones come
+ * from the contiguous DMA area, which lies outside ZONE_DMA.
+ */
+#ifdef CONFIG_CMA
+#define VPU_DMA_GFP	GFP_KERNEL
+#else
+#define VPU_DMA_GFP	(GFP_DMA | GFP_KERNEL)
+#endif
+
 /* IRAM setting */
 static struct iram_setting iram;
+static struct iram_client *vpu_iram_client;
 
 /* implement the blocking ioctl */
 static int codec_done;
@@ -155,7 +167,7 @@ static u32 dis_flag_regsave[4];
  */
 static int vpu_alloc_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
 {
-	if (gen_pool) {
+	if (gen_pool && vpu_pool) {
 		mem->cpu_addr = gen_pool_alloc(vpu_pool, mem->size);
 		pr_debug("vpu alloc - %dB@0x%p\n", mem->size, (void *)mem->cpu_addr);
 		WARN_ON(!mem->cpu_addr);
@@ -169,7 +181,7 @@ static int vpu_alloc_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
 		mem->cpu_addr = (unsigned long)
 		    dma_alloc_coherent(NULL, PAGE_ALIGN(mem->size),
 				       (dma_addr_t *) (&mem->phy_addr),
-				       GFP_DMA | GFP_KERNEL);
+				       VPU_DMA_GFP);
 		pr_debug("[ALLOC] mem alloc cpu_addr = 0x%x\n", mem->cpu_addr);
 		pr_debug("vpu alloc - %dB@0x%p (0x%p)\n", mem->size, (void *)mem->cpu_addr, (void*)mem->phy_addr);
 		if ((void *)(mem->cpu_addr) == NULL) {
@@ -185,7 +197,7 @@ static int vpu_alloc_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
  */
 static void vpu_free_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
 {
-	if (gen_pool) {
+	if (gen_pool && vpu_pool) {
 		pr_debug("vpu free - 0x%p/0x%p\n", (void*)mem->cpu_addr, (void*)mem->phy_addr);
 		if (mem->cpu_addr != 0)
 			gen_pool_free(vpu_pool, mem->cpu_addr, mem->size);
@@ -563,8 +575,10 @@ static int vpu_dev_probe(struct platform_device *pdev)
 
 	vpu_plat = pdev->dev.platform_data;
 
-	if (VPU_IRAM_SIZE)
-		iram_alloc(VPU_IRAM_SIZE, &addr);
+	if (VPU_IRAM_SIZE) {
+		vpu_iram_client = iram_client_register("vpu", 0, 0);
+		iram_client_alloc(vpu_iram_client, VPU_IRAM_SIZE, SZ_4K, &addr);
+	}
 
 	if (addr == 0)
 		iram.start = iram.end = 0;
@@ -622,9 +636,14 @@ static int vpu_dev_probe(struct platform_device *pdev)
 		goto err_out_class;
 
 	res = platform_get_resource_byname(pdev, IORESOURCE_MEM, "vpu_reserved_mem");
-	if (!res) {
+	if (!res || !res->start) {
+#ifdef CONFIG_CMA
+		printk(KERN_INFO "i.MX VPU: no reserved memory, using CMA\n");
+		goto no_pool;
+#else
 		printk(KERN_ERR "vpu: unable to find vpu reserved memory\n");
 		return -ENODEV;
+#endif
 	}
 	vpu_reserved_phy = res->start;
 	vpu_reserved_phy_size = res->end - res->start + 1;
@@ -634,6 +653,9 @@ static int vpu_dev_probe(struct platform_device *pdev)
 	gen_pool_add(vpu_pool, vpu_reserved_virt, vpu_reserved_phy_size, -1);
 
 	printk("i.MX VPU pool: %ld KB@0x%p (0x%p)\n", vpu_reserved_phy_size / 1024, vpu_reserved_phy, vpu_reserved_virt);
+#ifdef CONFIG_CMA
+no_pool:
+#endif
 
 	vpu_data.workqueue = create_workqueue("vpu_wq");
 	INIT_WORK(&vpu_data.work, vpu_worker_callback);
@@ -661,7 +683,7 @@ static int vpu_dev_remove(struct platform_device *pdev)
 	iounmap(vpu_base);
 
 	if (VPU_IRAM_SIZE)
-		iram_free(iram.start, VPU_IRAM_SIZE);
+		iram_client_free(vpu_iram_client, iram.start, VPU_IRAM_SIZE);
 
 	return 0;
 }
@@ -138,6 +138,10 @@
 #define PKT_MINBUF_SIZE		64
 #define PKT_MAXBLR_SIZE		1520
 
+/* Received frames are copied into skbs recycled through this pool */
+#define FEC_RX_SKB_SIZE		(PKT_MAXBUF_SIZE + NET_IP_ALIGN)
+#define FEC_RX_POOL_DEPTH	64
+
 
 /*
  * The 5270/5271/5280/5282/532x RX control register also contains maximum frame
@@ -556,7 +560,7 @@ fec_enet_rx(struct net_device *dev)
 		 * include that when passing upstream as it messes up
 		 * bridging applications.
 		 */
-		skb = dev_alloc_skb(pkt_len - 4 + NET_IP_ALIGN);
+		skb = netdev_alloc_skb_recycle(dev, pkt_len - 4 + NET_IP_ALIGN);
 
 		if (unlikely(!skb)) {
 			printk("%s: Memory squeeze, dropping packet.\n",
@@ -1010,10 +1014,12 @@ fec_enet_open(struct net_device *dev)
 	ret = fec_enet_alloc_buffers(dev);
 	if (ret)
 		return ret;
+	skb_recycle_pool_attach(dev, FEC_RX_SKB_SIZE, FEC_RX_POOL_DEPTH);
 
 	/* Probe and connect to PHY when open the interface */
 	ret = fec_enet_mii_probe(dev);
 	if (ret) {
+	       skb_recycle_pool_detach(dev);
 	       fec_enet_free_buffers(dev);
 	       return ret;
 	}
@@ -1039,6 +1045,7 @@ fec_enet_close(struct net_device *dev)
 		phy_disconnect(fep->phy_dev);
 	}
         fec_enet_free_buffers(dev);
+	skb_recycle_pool_detach(dev);
 	clk_disable(fep->clk);
 
 	return 0;
@@ -56,6 +56,10 @@
 #define SMSC_MDIONAME		"smsc911x-mdio"
 #define SMSC_DRV_VERSION	"2008-10-21"
 
+/* Receive skbs are recycled through a pool of this size and depth */
+#define SMSC_RX_SKB_SIZE	1536
+#define SMSC_RX_POOL_DEPTH	64
+
 MODULE_LICENSE("GPL");
 MODULE_VERSION(SMSC_DRV_VERSION);
 
@@ -1040,7 +1044,7 @@ static int smsc911x_poll(struct napi_struct *napi, int budget)
 			continue;
 		}
 
-		skb = netdev_alloc_skb(dev, pktlength + NET_IP_ALIGN);
+		skb = netdev_alloc_skb_recycle(dev, pktlength + NET_IP_ALIGN);
 		if (unlikely(!skb)) {
 			SMSC_WARNING(RX_ERR,
 				"Unable to allocate skb for rx packet");
@@ -1277,6 +1281,8 @@ static int smsc911x_open(struct net_device *dev)
 	/* set RX Data offset to 2 bytes for alignment */
 	smsc911x_reg_write(pdata, RX_CFG, (2 << 8));
 
+	skb_recycle_pool_attach(dev, SMSC_RX_SKB_SIZE, SMSC_RX_POOL_DEPTH);
+
 	/* enable NAPI polling before enabling RX interrupts */
 	napi_enable(&pdata->napi);
 
@@ -1312,6 +1318,7 @@ static int smsc911x_stop(struct net_device *dev)
 	napi_disable(&pdata->napi);
 
 	/* At this point all Rx and Tx activity is stopped */
+	skb_recycle_pool_detach(dev);
 	dev->stats.rx_dropped += smsc911x_reg_read(pdata, RX_DROP);
 	smsc911x_tx_update_txcounters(dev);
 
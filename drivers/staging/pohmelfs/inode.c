@@ -839,6 +839,14 @@ const struct address_space_operations pohmelfs_aops = {
  * ->detroy_inode() callback. Deletes inode from the caches
  *  and frees private data.
  */
+static void pohmelfs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(pohmelfs_inode_cache, POHMELFS_I(inode));
+}
+
 static void pohmelfs_destroy_inode(struct inode *inode)
 {
 	struct super_block *sb = inode->i_sb;
@@ -851,7 +859,7 @@ static void pohmelfs_destroy_inode(struct inode *inode)
 
 	dprintk("%s: pi: %p, inode: %p, ino: %llu.\n",
 		__func__, pi, &pi->vfs_inode, pi->ino);
-	kmem_cache_free(pohmelfs_inode_cache, pi);
+	call_rcu(&inode->i_rcu, pohmelfs_i_callback);
 	atomic_long_dec(&psb->total_inodes);
 }
 
@@ -1992,6 +2000,7 @@ static int __init pohmelfs_init_inodecache(void)
 
 static void pohmelfs_destroy_inodecache(void)
 {
+	rcu_barrier();	/* wait for pohmelfs_i_callback() */
 	kmem_cache_destroy(pohmelfs_inode_cache);
 }
 
@@ -123,6 +123,7 @@ void __exit afs_fs_exit(void)
 		BUG();
 	}
 
+	rcu_barrier();	/* wait for afs_i_callback() */
 	kmem_cache_destroy(afs_inode_cachep);
 	_leave("");
 }
@@ -499,6 +500,14 @@ static struct inode *afs_alloc_inode(struct super_block *sb)
 /*
  * destroy an AFS inode struct
  */
+static void afs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(afs_inode_cachep, AFS_FS_I(inode));
+}
+
 static void afs_destroy_inode(struct inode *inode)
 {
 	struct afs_vnode *vnode = AFS_FS_I(inode);
@@ -509,7 +518,7 @@ static void afs_destroy_inode(struct inode *inode)
 
 	ASSERTCMP(vnode->server, ==, NULL);
 
-	kmem_cache_free(afs_inode_cachep, vnode);
+	call_rcu(&inode->i_rcu, afs_i_callback);
 	atomic_dec(&afs_count_active_inodes);
 }
 
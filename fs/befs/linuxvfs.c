@@ -284,10 +284,18 @@ befs_alloc_inode(struct super_block *sb)
         return &bi->vfs_inode;
 }
 
+static void befs_i_callback(struct rcu_head *head)
+{
+        struct inode *inode = container_of(head, struct inode, i_rcu);
+
+        INIT_LIST_HEAD(&inode->i_dentry);
+        kmem_cache_free(befs_inode_cachep, BEFS_I(inode));
+}
+
 static void
 befs_destroy_inode(struct inode *inode)
 {
-        kmem_cache_free(befs_inode_cachep, BEFS_I(inode));
+        call_rcu(&inode->i_rcu, befs_i_callback);
 }
 
 static void init_once(void *foo)
@@ -450,6 +458,7 @@ befs_init_inodecache(void)
 static void
 befs_destroy_inodecache(void)
 {
+	rcu_barrier();	/* wait for befs_i_callback() */
 	kmem_cache_destroy(befs_inode_cachep);
 }
 
@@ -416,12 +416,20 @@ static struct inode *bdev_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void bdev_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(bdev_cachep, BDEV_I(inode));
+}
+
 static void bdev_destroy_inode(struct inode *inode)
 {
 	struct bdev_inode *bdi = BDEV_I(inode);
 
 	bdi->bdev.bd_inode_backing_dev_info = NULL;
-	kmem_cache_free(bdev_cachep, bdi);
+	call_rcu(&inode->i_rcu, bdev_i_callback);
 }
 
 static void init_once(void *foo)
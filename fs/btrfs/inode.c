@@ -4647,6 +4647,14 @@ struct inode *btrfs_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void btrfs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(btrfs_inode_cachep, BTRFS_I(inode));
+}
+
 void btrfs_destroy_inode(struct inode *inode)
 {
 	struct btrfs_ordered_extent *ordered;
@@ -4690,7 +4698,7 @@ void btrfs_destroy_inode(struct inode *inode)
 	}
 	inode_tree_del(inode);
 	btrfs_drop_extent_cache(inode, 0, (u64)-1, 0);
-	kmem_cache_free(btrfs_inode_cachep, BTRFS_I(inode));
+	call_rcu(&inode->i_rcu, btrfs_i_callback);
 }
 
 static void init_once(void *foo)
@@ -4703,6 +4711,7 @@ static void init_once(void *foo)
 void btrfs_destroy_cachep(void)
 {
 	if (btrfs_inode_cachep)
+		rcu_barrier();	/* wait for btrfs_i_callback() */
 		kmem_cache_destroy(btrfs_inode_cachep);
 	if (btrfs_trans_handle_cachep)
 		kmem_cache_destroy(btrfs_trans_handle_cachep);
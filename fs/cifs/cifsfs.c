@@ -326,10 +326,18 @@ cifs_alloc_inode(struct super_block *sb)
 	return &cifs_inode->vfs_inode;
 }
 
+static void cifs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(cifs_inode_cachep, CIFS_I(inode));
+}
+
 static void
 cifs_destroy_inode(struct inode *inode)
 {
-	kmem_cache_free(cifs_inode_cachep, CIFS_I(inode));
+	call_rcu(&inode->i_rcu, cifs_i_callback);
 }
 
 static void
@@ -857,6 +865,7 @@ cifs_init_inodecache(void)
 static void
 cifs_destroy_inodecache(void)
 {
+	rcu_barrier();	/* wait for cifs_i_callback() */
 	kmem_cache_destroy(cifs_inode_cachep);
 }
 
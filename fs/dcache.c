@@ -95,6 +95,16 @@ static void d_free(struct dentry *dentry)
 		call_rcu(&dentry->d_u.d_rcu, d_callback);
 }
 
+/*
+ * Make an RCU path walk that sampled d_seq before a change of
+ * dentry->d_inode retry.  The caller holds dentry->d_lock.
+ */
+static inline void dentry_rcuwalk_barrier(struct dentry *dentry)
+{
+	write_seqcount_begin(&dentry->d_seq);
+	write_seqcount_end(&dentry->d_seq);
+}
+
 /*
  * Release the dentry's inode, using the filesystem
  * d_iput() operation if defined.
@@ -106,6 +116,7 @@ static void dentry_iput(struct dentry * dentry)
 	struct inode *inode = dentry->d_inode;
 	if (inode) {
 		dentry->d_inode = NULL;
+		dentry_rcuwalk_barrier(dentry);
 		list_del_init(&dentry->d_alias);
 		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
@@ -941,6 +952,7 @@ struct dentry *d_alloc(struct dentry * parent, const struct qstr *name)
 	atomic_set(&dentry->d_count, 1);
 	dentry->d_flags = DCACHE_UNHASHED;
 	spin_lock_init(&dentry->d_lock);
+	seqcount_init(&dentry->d_seq);
 	dentry->d_inode = NULL;
 	dentry->d_parent = NULL;
 	dentry->d_sb = NULL;
@@ -981,9 +993,12 @@ struct dentry *d_alloc_name(struct dentry *parent, const char *name)
 /* the caller must hold dcache_lock */
 static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 {
+	spin_lock(&dentry->d_lock);
 	if (inode)
 		list_add(&dentry->d_alias, &inode->i_dentry);
 	dentry->d_inode = inode;
+	dentry_rcuwalk_barrier(dentry);
+	spin_unlock(&dentry->d_lock);
 	fsnotify_d_instantiate(dentry, inode);
 }
 
@@ -1417,6 +1432,52 @@ next:
  	return found;
 }
 
+/**
+ * __d_lookup_rcu - lockless dcache lookup for the RCU path walk
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ * @seq: returns the d_seq sample of the dentry found
+ *
+ * Like __d_lookup(), but takes neither d_lock nor a reference on the
+ * result.  The caller holds rcu_read_lock() and has to check @seq with
+ * read_seqcount_retry() before trusting anything it reads from the dentry.
+ * A racing rename may make this miss, so %NULL only means "use the locked
+ * walk".  Parents with their own ->d_compare() are not handled here.
+ */
+struct dentry *__d_lookup_rcu(struct dentry *parent, struct qstr *name,
+			      unsigned *seq)
+{
+	unsigned int len = name->len;
+	unsigned int hash = name->hash;
+	const unsigned char *str = name->name;
+	struct hlist_head *head = d_hash(parent, hash);
+	struct hlist_node *node;
+	struct dentry *dentry;
+
+	hlist_for_each_entry_rcu(dentry, node, head, d_hash) {
+		unsigned s;
+
+		if (dentry->d_name.hash != hash)
+			continue;
+seqretry:
+		s = read_seqcount_begin(&dentry->d_seq);
+		if (dentry->d_parent != parent)
+			continue;
+		if (d_unhashed(dentry))
+			continue;
+		if (dentry->d_name.len != len)
+			continue;
+		if (memcmp(dentry->d_name.name, str, len))
+			continue;
+		/* the name might have changed under the compare */
+		if (read_seqcount_retry(&dentry->d_seq, s))
+			goto seqretry;
+		*seq = s;
+		return dentry;
+	}
+	return NULL;
+}
+
 /**
  * d_hash_and_lookup - hash the qstr then search for a dentry
  * @dir: Directory to search in
@@ -1646,6 +1707,12 @@ static void d_move_locked(struct dentry * dentry, struct dentry * target)
 		spin_lock_nested(&target->d_lock, DENTRY_D_LOCK_NESTED);
 	}
 
+	/* Unhash the target: dput() will then get rid of it */
+	__d_drop(target);
+
+	write_seqcount_begin(&dentry->d_seq);
+	write_seqcount_begin(&target->d_seq);
+
 	/* Move the dentry to the target hash queue, if on different bucket */
 	if (d_unhashed(dentry))
 		goto already_unhashed;
@@ -1656,9 +1723,6 @@ already_unhashed:
 	list = d_hash(target->d_parent, target->d_name.hash);
 	__d_rehash(dentry, list);
 
-	/* Unhash the target: dput() will then get rid of it */
-	__d_drop(target);
-
 	list_del(&dentry->d_u.d_child);
 	list_del(&target->d_u.d_child);
 
@@ -1679,6 +1743,8 @@ already_unhashed:
 	}
 
 	list_add(&dentry->d_u.d_child, &dentry->d_parent->d_subdirs);
+	write_seqcount_end(&target->d_seq);
+	write_seqcount_end(&dentry->d_seq);
 	spin_unlock(&target->d_lock);
 	fsnotify_d_move(dentry);
 	spin_unlock(&dentry->d_lock);
@@ -1772,6 +1838,7 @@ static void __d_materialise_dentry(struct dentry *dentry, struct dentry *anon)
 {
 	struct dentry *dparent, *aparent;
 
+	write_seqcount_begin(&anon->d_seq);
 	switch_names(dentry, anon);
 	swap(dentry->d_name.hash, anon->d_name.hash);
 
@@ -1793,6 +1860,7 @@ static void __d_materialise_dentry(struct dentry *dentry, struct dentry *anon)
 		INIT_LIST_HEAD(&anon->d_u.d_child);
 
 	anon->d_flags &= ~DCACHE_DISCONNECTED;
+	write_seqcount_end(&anon->d_seq);
 }
 
 /**
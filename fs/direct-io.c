@@ -936,6 +936,7 @@ direct_io_worker(int rw, struct kiocb *iocb, struct inode *inode,
 {
 	unsigned long user_addr; 
 	unsigned long flags;
+	struct blk_plug plug;
 	int seg;
 	ssize_t ret = 0;
 	ssize_t ret2;
@@ -972,6 +973,8 @@ direct_io_worker(int rw, struct kiocb *iocb, struct inode *inode,
 				- user_addr/PAGE_SIZE);
 	}
 
+	blk_start_plug(&plug);
+
 	for (seg = 0; seg < nr_segs; seg++) {
 		user_addr = (unsigned long)iov[seg].iov_base;
 		dio->size += bytes = iov[seg].iov_len;
@@ -1029,6 +1032,7 @@ direct_io_worker(int rw, struct kiocb *iocb, struct inode *inode,
 		dio_bio_submit(dio);
 
 	/* All IO is now issued, send it on its way */
+	blk_finish_plug(&plug);
 	blk_run_address_space(inode->i_mapping);
 
 	/*
@@ -735,6 +735,7 @@ static void ecryptfs_free_kmem_caches(void)
 {
 	int i;
 
+	rcu_barrier();	/* wait for ecryptfs_i_callback() */
 	for (i = 0; i < ARRAY_SIZE(ecryptfs_cache_infos); i++) {
 		struct ecryptfs_cache_info *info;
 
@@ -153,11 +153,19 @@ static struct inode *exofs_alloc_inode(struct super_block *sb)
 /*
  * Remove an inode from the cache
  */
-static void exofs_destroy_inode(struct inode *inode)
+static void exofs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
 	kmem_cache_free(exofs_inode_cachep, exofs_i(inode));
 }
 
+static void exofs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, exofs_i_callback);
+}
+
 /*
  * Initialize the inode
  */
@@ -187,6 +195,7 @@ static int init_inodecache(void)
  */
 static void destroy_inodecache(void)
 {
+	rcu_barrier();	/* wait for exofs_i_callback() */
 	kmem_cache_destroy(exofs_inode_cachep);
 }
 
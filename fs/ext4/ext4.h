@@ -410,6 +410,7 @@ struct ext4_mount_options {
 	gid_t s_resgid;
 	unsigned long s_commit_interval;
 	u32 s_min_batch_time, s_max_batch_time;
+	unsigned int s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	int s_jquota_fmt;
 	char *s_qf_names[MAXQUOTAS];
@@ -750,6 +751,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
+#define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Zero itables lazily */
 
 #define clear_opt(o, opt)		o &= ~EXT4_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT4_MOUNT_##opt
@@ -1016,6 +1018,11 @@ struct ext4_sb_info {
 
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
+
+	/* lazy inode table initialization */
+	spinlock_t s_li_lock;		/* protects s_li_task */
+	struct task_struct *s_li_task;
+	unsigned int s_li_wait_mult;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1171,6 +1178,12 @@ static inline void ext4_clear_inode_state(struct inode *inode, int bit)
 
 #define EXT4_DEF_INODE_READAHEAD_BLKS	32
 
+/*
+ * The lazy inode table init thread sleeps this many times as long as it
+ * took to zero a group before doing the next one.
+ */
+#define EXT4_DEF_LI_WAIT_MULT		10
+
 /*
  * Default mount options
  */
@@ -1410,6 +1423,8 @@ extern unsigned ext4_init_inode_bitmap(struct super_block *sb,
 				       ext4_group_t group,
 				       struct ext4_group_desc *desc);
 extern void mark_bitmap_end(int start_bit, int end_bit, char *bitmap);
+extern int ext4_init_inode_table(struct super_block *sb,
+				 ext4_group_t group, int barrier);
 
 /* mballoc.c */
 extern long ext4_mb_stats;
@@ -724,8 +724,19 @@ static int ext4_claim_inode(struct super_block *sb,
 {
 	int free = 0, retval = 0, count;
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp = ext4_get_group_info(sb, group);
 	struct ext4_group_desc *gdp = ext4_get_group_desc(sb, group, NULL);
+	int zeroing = 0;
 
+	/*
+	 * Moving bg_itable_unused past inode table blocks that
+	 * ext4_init_inode_table() is zeroing has to wait for it.
+	 */
+	if (EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_GDT_CSUM) &&
+	    !(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED))) {
+		down_read(&grp->alloc_sem);
+		zeroing = 1;
+	}
 	ext4_lock_group(sb, group);
 	if (ext4_set_bit(ino, inode_bitmap_bh->b_data)) {
 		/* not a free inode */
@@ -736,6 +747,8 @@ static int ext4_claim_inode(struct super_block *sb,
 	if ((group == 0 && ino < EXT4_FIRST_INO(sb)) ||
 			ino > EXT4_INODES_PER_GROUP(sb)) {
 		ext4_unlock_group(sb, group);
+		if (zeroing)
+			up_read(&grp->alloc_sem);
 		ext4_error(sb, __func__,
 			   "reserved inode or inode > inodes count - "
 			   "block_group = %u, inode=%lu", group,
@@ -785,6 +798,8 @@ static int ext4_claim_inode(struct super_block *sb,
 	gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
 err_ret:
 	ext4_unlock_group(sb, group);
+	if (zeroing)
+		up_read(&grp->alloc_sem);
 	return retval;
 }
 
@@ -1225,3 +1240,77 @@ unsigned long ext4_count_dirs(struct super_block * sb)
 	}
 	return count;
 }
+
+/*
+ * Zero the part of a group's inode table that no inode has been handed
+ * out from yet, then mark the group EXT4_BG_INODE_ZEROED.  Called from
+ * the lazy inode table init thread for filesystems made with
+ * lazy_itable_init, whose inode tables were never written by mke2fs.
+ *
+ * grp->alloc_sem is held for write across the zeroing so that
+ * ext4_claim_inode() cannot allocate from the range meanwhile.  No
+ * journal handle is held at that point: inode allocation takes the
+ * semaphore inside its handle.
+ */
+int ext4_init_inode_table(struct super_block *sb, ext4_group_t group,
+			  int barrier)
+{
+	struct ext4_group_info *grp = ext4_get_group_info(sb, group);
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *group_desc_bh;
+	handle_t *handle;
+	ext4_fsblk_t blk;
+	int num, used_blks = 0;
+	int ret = 0, err;
+
+	gdp = ext4_get_group_desc(sb, group, &group_desc_bh);
+	if (!gdp)
+		return -EIO;
+	if (gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED))
+		return 0;
+
+	down_write(&grp->alloc_sem);
+	if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_UNINIT)))
+		used_blks = DIV_ROUND_UP(EXT4_INODES_PER_GROUP(sb) -
+					 ext4_itable_unused_count(sb, gdp),
+					 sbi->s_inodes_per_block);
+	if (used_blks < 0 || used_blks > sbi->s_itb_per_group) {
+		up_write(&grp->alloc_sem);
+		ext4_error(sb, __func__, "group %u: bg_itable_unused %u "
+			   "is out of range", group,
+			   ext4_itable_unused_count(sb, gdp));
+		return -EIO;
+	}
+
+	blk = ext4_inode_table(sb, gdp) + used_blks;
+	num = sbi->s_itb_per_group - used_blks;
+	if (num) {
+		ret = sb_issue_zeroout(sb, blk, num, GFP_NOFS);
+		if (!ret && barrier)
+			blkdev_issue_flush(sb->s_bdev, NULL);
+	}
+	up_write(&grp->alloc_sem);
+	if (ret)
+		return ret;
+
+	handle = ext4_journal_start_sb(sb, 1);
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	BUFFER_TRACE(group_desc_bh, "get_write_access");
+	ret = ext4_journal_get_write_access(handle, group_desc_bh);
+	if (!ret) {
+		ext4_lock_group(sb, group);
+		gdp->bg_flags |= cpu_to_le16(EXT4_BG_INODE_ZEROED);
+		gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+		ext4_unlock_group(sb, group);
+
+		BUFFER_TRACE(group_desc_bh, "call ext4_handle_dirty_metadata");
+		ret = ext4_handle_dirty_metadata(handle, NULL, group_desc_bh);
+	}
+	err = ext4_journal_stop(handle);
+	if (!ret)
+		ret = err;
+	return ret;
+}
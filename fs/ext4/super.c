@@ -39,6 +39,7 @@
 #include <linux/ctype.h>
 #include <linux/log2.h>
 #include <linux/crc16.h>
+#include <linux/kthread.h>
 #include <asm/uaccess.h>
 
 #include "ext4.h"
@@ -71,6 +72,8 @@ static int ext4_sync_fs(struct super_block *sb, int wait);
 static const char *ext4_decode_error(struct super_block *sb, int errno,
 				     char nbuf[16]);
 static int ext4_remount(struct super_block *sb, int *flags, char *data);
+static void ext4_start_lazyinit(struct super_block *sb);
+static void ext4_stop_lazyinit(struct super_block *sb);
 static int ext4_statfs(struct dentry *dentry, struct kstatfs *buf);
 static int ext4_unfreeze(struct super_block *sb);
 static void ext4_write_super(struct super_block *sb);
@@ -602,6 +605,7 @@ static void ext4_put_super(struct super_block *sb)
 	struct ext4_super_block *es = sbi->s_es;
 	int i, err;
 
+	ext4_stop_lazyinit(sb);
 	flush_workqueue(sbi->dio_unwritten_wq);
 	destroy_workqueue(sbi->dio_unwritten_wq);
 
@@ -722,6 +726,14 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	return &ei->vfs_inode;
 }
 
+static void ext4_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(ext4_inode_cachep, EXT4_I(inode));
+}
+
 static void ext4_destroy_inode(struct inode *inode)
 {
 	if (!list_empty(&(EXT4_I(inode)->i_orphan))) {
@@ -733,7 +745,7 @@ static void ext4_destroy_inode(struct inode *inode)
 				true);
 		dump_stack();
 	}
-	kmem_cache_free(ext4_inode_cachep, EXT4_I(inode));
+	call_rcu(&inode->i_rcu, ext4_i_callback);
 }
 
 static void init_once(void *foo)
@@ -762,6 +774,7 @@ static int init_inodecache(void)
 
 static void destroy_inodecache(void)
 {
+	rcu_barrier();	/* wait for ext4_i_callback() */
 	kmem_cache_destroy(ext4_inode_cachep);
 }
 
@@ -907,6 +920,11 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_printf(seq, ",inode_readahead_blks=%u",
 			   sbi->s_inode_readahead_blks);
 
+	if (!test_opt(sb, INIT_INODE_TABLE))
+		seq_puts(seq, ",noinit_itable");
+	else if (sbi->s_li_wait_mult != EXT4_DEF_LI_WAIT_MULT)
+		seq_printf(seq, ",init_itable=%u", sbi->s_li_wait_mult);
+
 	if (test_opt(sb, DATA_ERR_ABORT))
 		seq_puts(seq, ",data_err=abort");
 
@@ -1103,6 +1121,7 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_discard, Opt_nodiscard,
+	Opt_init_inode_table, Opt_noinit_inode_table,
 };
 
 static const match_table_t tokens = {
@@ -1166,6 +1185,9 @@ static const match_table_t tokens = {
 	{Opt_noblock_validity, "noblock_validity"},
 	{Opt_inode_readahead_blks, "inode_readahead_blks=%u"},
 	{Opt_journal_ioprio, "journal_ioprio=%u"},
+	{Opt_init_inode_table, "init_itable=%u"},
+	{Opt_init_inode_table, "init_itable"},
+	{Opt_noinit_inode_table, "noinit_itable"},
 	{Opt_auto_da_alloc, "auto_da_alloc=%u"},
 	{Opt_auto_da_alloc, "auto_da_alloc"},
 	{Opt_noauto_da_alloc, "noauto_da_alloc"},
@@ -1224,6 +1246,8 @@ static int parse_options(char *options, struct super_block *sb,
 		if (!*p)
 			continue;
 
+		/* so that "init_itable" can be told from "init_itable=%u" */
+		args[0].to = args[0].from = NULL;
 		token = match_token(p, tokens, args);
 		switch (token) {
 		case Opt_bsd_df:
@@ -1594,6 +1618,20 @@ set_qf_format:
 			*journal_ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE,
 							    option);
 			break;
+		case Opt_init_inode_table:
+			set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			if (args[0].from) {
+				if (match_int(&args[0], &option))
+					return 0;
+			} else
+				option = EXT4_DEF_LI_WAIT_MULT;
+			if (option < 0)
+				return 0;
+			sbi->s_li_wait_mult = option;
+			break;
+		case Opt_noinit_inode_table:
+			clear_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			break;
 		case Opt_noauto_da_alloc:
 			set_opt(sbi->s_mount_opt,NO_AUTO_DA_ALLOC);
 			break;
@@ -2356,6 +2394,126 @@ static int ext4_feature_set_ok(struct super_block *sb, int readonly)
 	return 1;
 }
 
+/*
+ * Lazy inode table initialization.
+ *
+ * With uninit_bg, "mke2fs -E lazy_itable_init=1" skips writing the inode
+ * tables and leaves EXT4_BG_INODE_ZEROED clear.  Until a table has been
+ * zeroed, only bg_itable_unused keeps e2fsck from taking stale data there
+ * for inodes.  So after mount a thread zeroes the tables one group at a
+ * time.  Each group is marked in its descriptor as soon as it is done,
+ * and the next mount picks up the groups that are still left.
+ *
+ * After each group the thread sleeps s_li_wait_mult times as long as the
+ * zeroing took.  That keeps it to about 1/(s_li_wait_mult + 1) of the
+ * device's write bandwidth.
+ */
+static int ext4_lazyinit_thread(void *data)
+{
+	struct super_block *sb = data;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t group, ngroups = ext4_get_groups_count(sb);
+	int err = 0;
+
+	for (group = 0; group < ngroups; group++) {
+		struct ext4_group_desc *gdp;
+		unsigned long start, timeout;
+
+		if (kthread_should_stop())
+			break;
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp ||
+		    (gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			continue;
+
+		start = jiffies;
+		err = ext4_init_inode_table(sb, group, test_opt(sb, BARRIER));
+		if (err) {
+			ext4_msg(sb, KERN_WARNING, "lazy inode table init "
+				 "stopped at group %u (%d)", group, err);
+			break;
+		}
+
+		timeout = (jiffies - start) * sbi->s_li_wait_mult;
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule_timeout(timeout);
+		__set_current_state(TASK_RUNNING);
+	}
+	if (group == ngroups)
+		ext4_msg(sb, KERN_INFO, "inode tables initialized");
+
+	spin_lock(&sbi->s_li_lock);
+	sbi->s_li_task = NULL;
+	spin_unlock(&sbi->s_li_lock);
+	return err;
+}
+
+static int ext4_has_uninit_itable(struct super_block *sb)
+{
+	ext4_group_t group, ngroups = ext4_get_groups_count(sb);
+
+	for (group = 0; group < ngroups; group++) {
+		struct ext4_group_desc *gdp = ext4_get_group_desc(sb, group,
+								  NULL);
+
+		if (gdp &&
+		    !(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Start the lazy init thread unless it is running, disabled, the
+ * filesystem is read-only, or there is nothing left to zero.  Without
+ * uninit_bg, bg_itable_unused cannot be trusted to tell which parts of
+ * an inode table are in use, so nothing is done then either.
+ */
+static void ext4_start_lazyinit(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct task_struct *task;
+
+	if (!test_opt(sb, INIT_INODE_TABLE) || (sb->s_flags & MS_RDONLY) ||
+	    !EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_GDT_CSUM) ||
+	    sbi->s_li_task || !ext4_has_uninit_itable(sb))
+		return;
+
+	task = kthread_create(ext4_lazyinit_thread, sb, "ext4li-%s",
+			      sb->s_id);
+	if (IS_ERR(task)) {
+		ext4_msg(sb, KERN_WARNING, "failed to start lazy inode "
+			 "table init thread (%ld)", PTR_ERR(task));
+		return;
+	}
+	spin_lock(&sbi->s_li_lock);
+	sbi->s_li_task = task;
+	spin_unlock(&sbi->s_li_lock);
+	wake_up_process(task);
+}
+
+/*
+ * The thread clears s_li_task itself when it is done, so take a
+ * reference under s_li_lock before stopping it.
+ */
+static void ext4_stop_lazyinit(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct task_struct *task;
+
+	spin_lock(&sbi->s_li_lock);
+	task = sbi->s_li_task;
+	if (task)
+		get_task_struct(task);
+	spin_unlock(&sbi->s_li_lock);
+
+	if (task) {
+		kthread_stop(task);
+		put_task_struct(task);
+	}
+}
+
 static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				__releases(kernel_lock)
 				__acquires(kernel_lock)
@@ -2396,6 +2554,9 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	sbi->s_resuid = EXT4_DEF_RESUID;
 	sbi->s_resgid = EXT4_DEF_RESGID;
 	sbi->s_inode_readahead_blks = EXT4_DEF_INODE_READAHEAD_BLKS;
+	set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+	sbi->s_li_wait_mult = EXT4_DEF_LI_WAIT_MULT;
+	spin_lock_init(&sbi->s_li_lock);
 	sbi->s_sb_block = sb_block;
 	sbi->s_sectors_written_start = part_stat_read(sb->s_bdev->bd_part,
 						      sectors[1]);
@@ -2976,6 +3137,8 @@ no_journal:
 
 	ext4_msg(sb, KERN_INFO, "mounted filesystem with%s", descr);
 
+	ext4_start_lazyinit(sb);
+
 	lock_kernel();
 	return 0;
 
@@ -3464,6 +3627,9 @@ static int ext4_freeze(struct super_block *sb)
 
 	journal = EXT4_SB(sb)->s_journal;
 
+	/* The itable zeroing writes to the device behind the journal */
+	ext4_stop_lazyinit(sb);
+
 	/* Now we set up the journal barrier. */
 	jbd2_journal_lock_updates(journal);
 
@@ -3475,6 +3641,7 @@ static int ext4_freeze(struct super_block *sb)
 	if (error < 0) {
 	out:
 		jbd2_journal_unlock_updates(journal);
+		ext4_start_lazyinit(sb);
 		return error;
 	}
 
@@ -3501,6 +3668,7 @@ static int ext4_unfreeze(struct super_block *sb)
 	ext4_commit_super(sb, 1);
 	unlock_super(sb);
 	jbd2_journal_unlock_updates(EXT4_SB(sb)->s_journal);
+	ext4_start_lazyinit(sb);
 	return 0;
 }
 
@@ -3529,11 +3697,14 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	old_opts.s_commit_interval = sbi->s_commit_interval;
 	old_opts.s_min_batch_time = sbi->s_min_batch_time;
 	old_opts.s_max_batch_time = sbi->s_max_batch_time;
+	old_opts.s_li_wait_mult = sbi->s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	old_opts.s_jquota_fmt = sbi->s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++)
 		old_opts.s_qf_names[i] = sbi->s_qf_names[i];
 #endif
+	/* restarted below with the new options and flags */
+	ext4_stop_lazyinit(sb);
 	if (sbi->s_journal && sbi->s_journal->j_task->io_context)
 		journal_ioprio = sbi->s_journal->j_task->io_context->ioprio;
 
@@ -3648,6 +3819,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		    old_opts.s_qf_names[i] != sbi->s_qf_names[i])
 			kfree(old_opts.s_qf_names[i]);
 #endif
+	ext4_start_lazyinit(sb);
 	unlock_super(sb);
 	unlock_kernel();
 	return 0;
@@ -3660,6 +3832,7 @@ restore_opts:
 	sbi->s_commit_interval = old_opts.s_commit_interval;
 	sbi->s_min_batch_time = old_opts.s_min_batch_time;
 	sbi->s_max_batch_time = old_opts.s_max_batch_time;
+	sbi->s_li_wait_mult = old_opts.s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	sbi->s_jquota_fmt = old_opts.s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++) {
@@ -3669,6 +3842,7 @@ restore_opts:
 		sbi->s_qf_names[i] = old_opts.s_qf_names[i];
 	}
 #endif
+	ext4_start_lazyinit(sb);
 	unlock_super(sb);
 	unlock_kernel();
 	return err;
@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/spinlock.h>
 #include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
 #include <linux/writeback.h>
@@ -25,43 +27,24 @@
 #include <linux/buffer_head.h>
 #include "internal.h"
 
-
-/**
- * writeback_acquire - attempt to get exclusive writeback access to a device
- * @bdi: the device's backing_dev_info structure
- *
- * It is a waste of resources to have more than one pdflush thread blocked on
- * a single request queue.  Exclusion at the request_queue level is obtained
- * via a flag in the request_queue's backing_dev_info.state.
- *
- * Non-request_queue-backed address_spaces will share default_backing_dev_info,
- * unless they implement their own.  Which is somewhat inefficient, as this
- * may prevent concurrent writeback against multiple devices.
+/*
+ * The maximum number of pages to writeout in a single flusher pass.  We do
+ * this so we don't hold I_SYNC against an inode for enormous amounts of
+ * time, which would block a userspace task which has been forced to throttle
+ * against that inode.  Also, the code reevaluates the dirty each time it has
+ * written this many pages.
  */
-static int writeback_acquire(struct backing_dev_info *bdi)
-{
-	return !test_and_set_bit(BDI_pdflush, &bdi->state);
-}
+#define MAX_WRITEBACK_PAGES	1024
 
 /**
  * writeback_in_progress - determine whether there is writeback in progress
  * @bdi: the device's backing_dev_info structure.
  *
- * Determine whether there is writeback in progress against a backing device.
+ * Determine whether the device's flusher thread is writing it back.
  */
 int writeback_in_progress(struct backing_dev_info *bdi)
 {
-	return test_bit(BDI_pdflush, &bdi->state);
-}
-
-/**
- * writeback_release - relinquish exclusive writeback access against a device.
- * @bdi: the device's backing_dev_info structure
- */
-static void writeback_release(struct backing_dev_info *bdi)
-{
-	BUG_ON(!writeback_in_progress(bdi));
-	clear_bit(BDI_pdflush, &bdi->state);
+	return test_bit(BDI_writeback_running, &bdi->state);
 }
 
 static noinline void block_dump___mark_inode_dirty(struct inode *inode)
@@ -171,6 +154,7 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 		if (!was_dirty) {
 			inode->dirtied_when = jiffies;
 			list_move(&inode->i_list, &sb->s_dirty);
+			bdi_inode_dirtied(inode->i_mapping->backing_dev_info);
 		}
 	}
 out:
@@ -235,7 +219,7 @@ static bool inode_dirtied_after(struct inode *inode, unsigned long t)
 	 * For inodes being constantly redirtied, dirtied_when can get stuck.
 	 * It _appears_ to be in the future, but is actually in distant past.
 	 * This test is necessary to prevent such wrapped-around relative times
-	 * from permanently stopping the whole pdflush writeback.
+	 * from permanently stopping the whole flusher writeback.
 	 */
 	ret = ret && time_before_eq(inode->dirtied_when, jiffies);
 #endif
@@ -440,9 +424,6 @@ writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
  * If older_than_this is non-NULL, then only write out inodes which
  * had their first dirtying at a time earlier than *older_than_this.
  *
- * If we're a pdflush thread, then implement pdflush collision avoidance
- * against the entire list.
- *
  * If `bdi' is non-zero then we're being asked to writeback a specific queue.
  * This function assumes that the blockdev superblock's inodes are backed by
  * a variety of queues, so all inodes are searched.  For other superblocks,
@@ -519,16 +500,10 @@ void generic_sync_sb_inodes(struct super_block *sb,
 		if (inode_dirtied_after(inode, start))
 			break;
 
-		/* Is another pdflush already flushing this queue? */
-		if (current_is_pdflush() && !writeback_acquire(bdi))
-			break;
-
 		BUG_ON(inode->i_state & (I_FREEING | I_CLEAR));
 		__iget(inode);
 		pages_skipped = wbc->pages_skipped;
 		writeback_single_inode(inode, wbc);
-		if (current_is_pdflush())
-			writeback_release(bdi);
 		if (wbc->pages_skipped != pages_skipped) {
 			/*
 			 * writeback is not making progress due to locked
@@ -653,6 +628,215 @@ restart:
 	spin_unlock(&sb_lock);
 }
 
+/*
+ * Write back at least `min_pages' pages of the device, and keep going while
+ * the amount of dirty memory is over the background threshold, or until the
+ * device is all clean.
+ */
+static long wb_background_writeout(struct backing_dev_info *bdi,
+				   long min_pages)
+{
+	long wrote = 0;
+	struct writeback_control wbc = {
+		.bdi		= bdi,
+		.sync_mode	= WB_SYNC_NONE,
+		.older_than_this = NULL,
+		.nr_to_write	= 0,
+		.nonblocking	= 1,
+		.range_cyclic	= 1,
+	};
+
+	for ( ; ; ) {
+		unsigned long background_thresh;
+		unsigned long dirty_thresh;
+
+		get_dirty_limits(&background_thresh, &dirty_thresh, NULL, NULL);
+		if (global_page_state(NR_FILE_DIRTY) +
+			global_page_state(NR_UNSTABLE_NFS) < background_thresh
+				&& min_pages <= 0)
+			break;
+		wbc.more_io = 0;
+		wbc.encountered_congestion = 0;
+		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
+		wbc.pages_skipped = 0;
+		writeback_inodes(&wbc);
+		min_pages -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		wrote += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		if (wbc.nr_to_write > 0 || wbc.pages_skipped > 0) {
+			/* Wrote less than expected */
+			if (wbc.encountered_congestion || wbc.more_io)
+				congestion_wait(BLK_RW_ASYNC, HZ/10);
+			else
+				break;
+		}
+	}
+
+	return wrote;
+}
+
+/*
+ * Periodic writeback of "old" data.
+ *
+ * Define "old": the first time one of an inode's pages is dirtied, we mark the
+ * dirtying-time in the inode's address_space.  So this periodic writeback code
+ * just walks the superblock inode list, writing back any inodes of the device
+ * which are older than a specific point in time.
+ *
+ * older_than_this takes precedence over nr_to_write.  So we'll only write back
+ * all dirty pages if they are all attached to "old" mappings.
+ */
+static long wb_kupdate(struct backing_dev_info *bdi)
+{
+	unsigned long oldest_jif;
+	long nr_to_write;
+	long wrote = 0;
+	struct writeback_control wbc = {
+		.bdi		= bdi,
+		.sync_mode	= WB_SYNC_NONE,
+		.older_than_this = &oldest_jif,
+		.nr_to_write	= 0,
+		.nonblocking	= 1,
+		.for_kupdate	= 1,
+		.range_cyclic	= 1,
+	};
+
+	oldest_jif = jiffies - msecs_to_jiffies(dirty_expire_interval * 10);
+	nr_to_write = bdi_stat(bdi, BDI_RECLAIMABLE) +
+			(inodes_stat.nr_inodes - inodes_stat.nr_unused);
+	while (nr_to_write > 0) {
+		wbc.more_io = 0;
+		wbc.encountered_congestion = 0;
+		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
+		writeback_inodes(&wbc);
+		wrote += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		if (wbc.nr_to_write > 0) {
+			if (wbc.encountered_congestion || wbc.more_io)
+				congestion_wait(BLK_RW_ASYNC, HZ/10);
+			else
+				break;	/* All the old data is written */
+		}
+		nr_to_write -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+	}
+
+	return wrote;
+}
+
+/**
+ * wb_do_writeback - run the writeback queued for a device
+ * @bdi: the device's backing_dev_info structure
+ * @kupdate: also write back the device's old dirty inodes
+ *
+ * Returns the number of pages written.  Called by the device's flusher
+ * thread, or by the forker when the flusher could not be started.
+ */
+long wb_do_writeback(struct backing_dev_info *bdi, int kupdate)
+{
+	long nr_pages, wrote = 0;
+	int wanted;
+
+	spin_lock_bh(&bdi->wb_lock);
+	wanted = test_and_clear_bit(BDI_wb_wanted, &bdi->state);
+	nr_pages = bdi->wb_nr_pages;
+	bdi->wb_nr_pages = 0;
+	spin_unlock_bh(&bdi->wb_lock);
+
+	if (!wanted && !kupdate)
+		return 0;
+
+	set_bit(BDI_writeback_running, &bdi->state);
+	if (wanted) {
+		wrote += wb_background_writeout(bdi, nr_pages);
+		bdi->wb_background++;
+	}
+	if (kupdate) {
+		wrote += wb_kupdate(bdi);
+		bdi->wb_kupdate++;
+	}
+	clear_bit(BDI_writeback_running, &bdi->state);
+
+	bdi->wb_written += wrote;
+	return wrote;
+}
+
+/**
+ * bdi_writeback_task - main loop of a device's flusher thread
+ * @bdi: the device's backing_dev_info structure
+ *
+ * Runs the background writeout queued by bdi_start_writeback(), and does
+ * kupdate style writeback every dirty_writeback_interval.  Only inodes
+ * backed by @bdi are written, so a slow device cannot hold up the others.
+ * Returns when the thread is stopped or has been idle long enough to exit.
+ */
+int bdi_writeback_task(struct backing_dev_info *bdi)
+{
+	unsigned long last_active = jiffies;
+	unsigned long next_kupdate = jiffies +
+			msecs_to_jiffies(dirty_writeback_interval * 10);
+
+	while (!kthread_should_stop()) {
+		unsigned long start = jiffies;
+		int kupdate = 0;
+		long timeout;
+
+		if (!dirty_writeback_interval)
+			next_kupdate = start;
+		else if (time_after_eq(start, next_kupdate))
+			kupdate = 1;
+
+		if (wb_do_writeback(bdi, kupdate))
+			last_active = jiffies;
+		else if (bdi_flusher_may_exit(bdi, last_active))
+			break;
+
+		/*
+		 * If a kupdate run takes longer than a dirty_writeback_interval
+		 * interval, then leave a one-second gap.
+		 */
+		if (kupdate) {
+			next_kupdate = start +
+				msecs_to_jiffies(dirty_writeback_interval * 10);
+			if (time_before(next_kupdate, jiffies + HZ))
+				next_kupdate = jiffies + HZ;
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!test_bit(BDI_wb_wanted, &bdi->state) &&
+		    !kthread_should_stop()) {
+			if (!dirty_writeback_interval)
+				timeout = MAX_SCHEDULE_TIMEOUT;
+			else if (time_before(jiffies, next_kupdate))
+				timeout = next_kupdate - jiffies;
+			else
+				timeout = 0;
+			schedule_timeout(timeout);
+		}
+		__set_current_state(TASK_RUNNING);
+		try_to_freeze();
+	}
+
+	return 0;
+}
+
+/*
+ * Start writeback of `nr_pages' pages on every device with dirty data.  If
+ * `nr_pages' is zero, write back the whole world.
+ */
+void wakeup_flusher_threads(long nr_pages)
+{
+	struct backing_dev_info *bdi;
+
+	if (nr_pages == 0)
+		nr_pages = global_page_state(NR_FILE_DIRTY) +
+				global_page_state(NR_UNSTABLE_NFS);
+
+	spin_lock_bh(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_list, bdi_list) {
+		if (bdi->wb_task || bdi_stat(bdi, BDI_RECLAIMABLE))
+			bdi_start_writeback(bdi, nr_pages);
+	}
+	spin_unlock_bh(&bdi_lock);
+}
+
 /*
  * writeback and wait upon the filesystem's dirty inodes.  The caller will
  * do this in two passes - one to write, and one to wait.
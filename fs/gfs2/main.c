@@ -168,6 +168,7 @@ static void __exit exit_gfs2_fs(void)
 	kmem_cache_destroy(gfs2_quotad_cachep);
 	kmem_cache_destroy(gfs2_rgrpd_cachep);
 	kmem_cache_destroy(gfs2_bufdata_cachep);
+	rcu_barrier();	/* wait for gfs2_i_callback() */
 	kmem_cache_destroy(gfs2_inode_cachep);
 	kmem_cache_destroy(gfs2_glock_cachep);
 
@@ -308,6 +308,14 @@ static void hostfs_delete_inode(struct inode *inode)
 	clear_inode(inode);
 }
 
+static void hostfs_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kfree(HOSTFS_I(inode));
+}
+
 static void hostfs_destroy_inode(struct inode *inode)
 {
 	kfree(HOSTFS_I(inode)->host_filename);
@@ -321,7 +329,7 @@ static void hostfs_destroy_inode(struct inode *inode)
 		printk(KERN_DEBUG "Closing host fd in .destroy_inode\n");
 	}
 
-	kfree(HOSTFS_I(inode));
+	call_rcu(&inode->i_rcu, hostfs_i_callback);
 }
 
 static int hostfs_show_options(struct seq_file *seq, struct vfsmount *vfs)
@@ -1049,6 +1057,7 @@ static int __init init_hostfs(void)
 static void __exit exit_hostfs(void)
 {
 	unregister_filesystem(&hostfs_type);
+	rcu_barrier();	/* wait for hostfs_i_callback() */
 }
 
 module_init(init_hostfs)
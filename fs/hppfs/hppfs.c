@@ -631,11 +631,19 @@ void hppfs_delete_inode(struct inode *ino)
 	clear_inode(ino);
 }
 
-static void hppfs_destroy_inode(struct inode *inode)
+static void hppfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
 	kfree(HPPFS_I(inode));
 }
 
+static void hppfs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, hppfs_i_callback);
+}
+
 static const struct super_operations hppfs_sbops = {
 	.alloc_inode	= hppfs_alloc_inode,
 	.destroy_inode	= hppfs_destroy_inode,
@@ -764,6 +772,7 @@ static int __init init_hppfs(void)
 static void __exit exit_hppfs(void)
 {
 	unregister_filesystem(&hppfs_type);
+	rcu_barrier();	/* wait for hppfs_i_callback() */
 }
 
 module_init(init_hppfs)
@@ -26,6 +26,7 @@
 #include <linux/mount.h>
 #include <linux/async.h>
 #include <linux/posix_acl.h>
+#include <linux/ccache.h>
 
 /*
  * This is needed for the following functions:
@@ -244,13 +245,29 @@ void __destroy_inode(struct inode *inode)
 }
 EXPORT_SYMBOL(__destroy_inode);
 
+static void i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	/* i_rcu overlaid it; slab constructors only run once */
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(inode_cachep, inode);
+}
+
+/*
+ * The RCU path walk in fs/namei.c looks at ->d_inode of dentries it holds
+ * no reference on, so the inode memory has to stay around for a grace
+ * period.  Filesystems with their own ->destroy_inode() must free the
+ * inode through call_rcu() on ->i_rcu as well, and rcu_barrier() before
+ * destroying their inode cache.
+ */
 void destroy_inode(struct inode *inode)
 {
 	__destroy_inode(inode);
 	if (inode->i_sb->s_op->destroy_inode)
 		inode->i_sb->s_op->destroy_inode(inode);
 	else
-		kmem_cache_free(inode_cachep, (inode));
+		call_rcu(&inode->i_rcu, i_callback);
 }
 
 /*
@@ -320,6 +337,8 @@ void clear_inode(struct inode *inode)
 	BUG_ON(inode->i_data.nrpages);
 	BUG_ON(!(inode->i_state & I_FREEING));
 	BUG_ON(inode->i_state & I_CLEAR);
+	/* the mapping's address may be reused by the next inode */
+	ccache_flush_inode(&inode->i_data);
 	inode_sync_wait(inode);
 	vfs_dq_drop(inode);
 	if (inode->i_sb->s_op->clear_inode)
@@ -33,6 +33,7 @@
 #include <linux/fcntl.h>
 #include <linux/device_cgroup.h>
 #include <linux/fs_struct.h>
+#include <linux/sysctl.h>
 #include <asm/uaccess.h>
 
 #define ACC_MODE(x) ("\000\004\002\006"[(x)&O_ACCMODE])
@@ -424,7 +425,8 @@ static struct dentry * cached_lookup(struct dentry * parent, struct qstr * name,
 
 /*
  * Short-cut version of permission(), for calling by
- * path_walk(), when dcache lock is held.  Combines parts
+ * path_walk(), including under rcu_read_lock() from
+ * path_walk_rcu(), so it must not sleep.  Combines parts
  * of permission() and generic_permission(), and tests ONLY for
  * MAY_EXEC permission.
  *
@@ -1027,6 +1029,167 @@ return_err:
 	return err;
 }
 
+/*
+ * RCU path walk.
+ *
+ * Resolve the whole path under rcu_read_lock() without taking d_lock or
+ * a reference on any intermediate dentry.  Each dentry found is checked
+ * against its d_seq, and the parent's d_seq is rechecked once the child
+ * is found, so a concurrent rename, unlink or d_drop makes us bail out.
+ * Only the final dentry gets a reference, taken under its d_lock.
+ *
+ * Anything out of the ordinary - "..", symlinks, mountpoints, ->d_revalidate,
+ * ->d_hash or ->d_compare, ->permission, LOOKUP_PARENT - is left to the
+ * locked walk as well.  Since we never leave nd->path.mnt, nothing has to
+ * be done about vfsmounts.
+ *
+ * Returns 0 with nd->path moved to the result, -ENOENT with nd->path
+ * dropped (like __link_path_walk()), or -EAGAIN with nd untouched, in
+ * which case the caller redoes the lookup with path_walk().
+ */
+static int path_walk_rcu(const char *name, struct nameidata *nd)
+{
+	struct dentry *parent = nd->path.dentry;
+	struct dentry *dentry;
+	struct inode *inode;
+	unsigned int lookup_flags = nd->flags;
+	unsigned seq, nseq;
+
+	if (lookup_flags & (LOOKUP_PARENT | LOOKUP_REVAL))
+		return -EAGAIN;
+
+	while (*name == '/')
+		name++;
+	if (!*name)
+		return -EAGAIN;
+
+	rcu_read_lock();
+	seq = read_seqcount_begin(&parent->d_seq);
+	inode = parent->d_inode;
+
+	for (;;) {
+		unsigned long hash;
+		struct qstr this;
+		unsigned int c;
+		int last = 0;
+
+		if (!inode || exec_permission_lite(inode))
+			goto fallback;
+
+		this.name = name;
+		c = *(const unsigned char *)name;
+
+		hash = init_name_hash();
+		do {
+			name++;
+			hash = partial_name_hash(c, hash);
+			c = *(const unsigned char *)name;
+		} while (c && (c != '/'));
+		this.len = name - (const char *) this.name;
+		this.hash = end_name_hash(hash);
+
+		if (!c)
+			last = 1;
+		else {
+			while (*++name == '/');
+			if (!*name) {
+				lookup_flags |= LOOKUP_FOLLOW | LOOKUP_DIRECTORY;
+				last = 1;
+			}
+		}
+
+		if (this.name[0] == '.') {
+			if (this.len == 1 && !last)
+				continue;
+			if (this.len == 1 ||
+			    (this.len == 2 && this.name[1] == '.'))
+				goto fallback;
+		}
+
+		if (parent->d_op &&
+		    (parent->d_op->d_hash || parent->d_op->d_compare))
+			goto fallback;
+
+		dentry = __d_lookup_rcu(parent, &this, &nseq);
+		if (!dentry)
+			goto fallback;
+		inode = dentry->d_inode;
+		if (read_seqcount_retry(&parent->d_seq, seq))
+			goto fallback;
+		parent = dentry;
+		seq = nseq;
+
+		if (dentry->d_op && dentry->d_op->d_revalidate)
+			goto fallback;
+		if (!inode)
+			goto negative;
+		if (d_mountpoint(dentry))
+			goto fallback;
+
+		if (last)
+			break;
+		if (inode->i_op->follow_link || !inode->i_op->lookup)
+			goto fallback;
+	}
+
+	if (follow_on_final(inode, lookup_flags))
+		goto fallback;
+	if ((lookup_flags & LOOKUP_DIRECTORY) && !inode->i_op->lookup)
+		goto fallback;
+
+	spin_lock(&dentry->d_lock);
+	if (read_seqcount_retry(&dentry->d_seq, seq) || d_unhashed(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		goto fallback;
+	}
+	atomic_inc(&dentry->d_count);
+	spin_unlock(&dentry->d_lock);
+	rcu_read_unlock();
+
+	dput(nd->path.dentry);
+	nd->path.dentry = dentry;
+	return 0;
+
+negative:
+	if (read_seqcount_retry(&dentry->d_seq, seq))
+		goto fallback;
+	rcu_read_unlock();
+	path_put(&nd->path);
+	return -ENOENT;
+
+fallback:
+	rcu_read_unlock();
+	return -EAGAIN;
+}
+
+/*
+ * RCU walks attempted and how many of them fell back to the locked walk,
+ * reported in /proc/sys/fs/rcu-walk-stat.
+ */
+static DEFINE_PER_CPU(unsigned long [2], rcu_walk_count);
+unsigned long rcu_walk_stat[2];
+
+#if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
+int proc_rcu_walk_stat(ctl_table *table, int write, struct file *filp,
+		       void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	int cpu;
+
+	rcu_walk_stat[0] = rcu_walk_stat[1] = 0;
+	for_each_possible_cpu(cpu) {
+		rcu_walk_stat[0] += per_cpu(rcu_walk_count, cpu)[0];
+		rcu_walk_stat[1] += per_cpu(rcu_walk_count, cpu)[1];
+	}
+	return proc_doulongvec_minmax(table, write, filp, buffer, lenp, ppos);
+}
+#else
+int proc_rcu_walk_stat(ctl_table *table, int write, struct file *filp,
+		       void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	return -ENOSYS;
+}
+#endif
+
 static int path_walk(const char *name, struct nameidata *nd)
 {
 	current->total_link_count = 0;
@@ -1090,8 +1253,18 @@ static int do_path_lookup(int dfd, const char *name,
 				unsigned int flags, struct nameidata *nd)
 {
 	int retval = path_init(dfd, name, flags, nd);
-	if (!retval)
-		retval = path_walk(name, nd);
+	if (!retval) {
+		unsigned long *count;
+
+		retval = path_walk_rcu(name, nd);
+		count = get_cpu_var(rcu_walk_count);
+		count[0]++;
+		if (retval == -EAGAIN)
+			count[1]++;
+		put_cpu_var(rcu_walk_count);
+		if (retval == -EAGAIN)
+			retval = path_walk(name, nd);
+	}
 	if (unlikely(!retval && !audit_dummy_context() && nd->path.dentry &&
 				nd->path.dentry->d_inode))
 		audit_inode(name, nd->path.dentry);
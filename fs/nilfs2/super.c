@@ -152,11 +152,19 @@ struct inode *nilfs_alloc_inode(struct super_block *sb)
 	return nilfs_alloc_inode_common(NILFS_SB(sb)->s_nilfs);
 }
 
-void nilfs_destroy_inode(struct inode *inode)
+static void nilfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
 	kmem_cache_free(nilfs_inode_cachep, NILFS_I(inode));
 }
 
+void nilfs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, nilfs_i_callback);
+}
+
 static void init_once(void *obj)
 {
 	struct nilfs_inode_info *ii = obj;
@@ -182,6 +190,7 @@ static int nilfs_init_inode_cache(void)
 
 static inline void nilfs_destroy_inode_cache(void)
 {
+	rcu_barrier();	/* wait for nilfs_i_callback() */
 	kmem_cache_destroy(nilfs_inode_cachep);
 }
 
@@ -899,11 +899,19 @@ static struct inode *unionfs_alloc_inode(struct super_block *sb)
 	return &i->vfs_inode;
 }
 
-static void unionfs_destroy_inode(struct inode *inode)
+static void unionfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
 	kmem_cache_free(unionfs_inode_cachep, UNIONFS_I(inode));
 }
 
+static void unionfs_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, unionfs_i_callback);
+}
+
 /* unionfs inode cache constructor */
 static void init_once(void *obj)
 {
@@ -929,6 +937,7 @@ int unionfs_init_inode_cache(void)
 void unionfs_destroy_inode_cache(void)
 {
 	if (unionfs_inode_cachep)
+		rcu_barrier();	/* wait for unionfs_i_callback() */
 		kmem_cache_destroy(unionfs_inode_cachep);
 }
 
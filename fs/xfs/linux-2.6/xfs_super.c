@@ -1758,6 +1758,7 @@ STATIC void
 xfs_destroy_zones(void)
 {
 	kmem_zone_destroy(xfs_ili_zone);
+	rcu_barrier();	/* wait for xfs_inode_free_callback() */
 	kmem_zone_destroy(xfs_inode_zone);
 	kmem_zone_destroy(xfs_efi_zone);
 	kmem_zone_destroy(xfs_efd_zone);
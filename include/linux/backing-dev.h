@@ -13,19 +13,24 @@
 #include <linux/proportions.h>
 #include <linux/kernel.h>
 #include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
 #include <asm/atomic.h>
 
 struct page;
 struct device;
 struct dentry;
+struct task_struct;
 
 /*
  * Bits in backing_dev_info.state
  */
 enum bdi_state {
-	BDI_pdflush,		/* A pdflush thread is working this device */
+	BDI_writeback_running,	/* The flusher is writing this device back */
 	BDI_async_congested,	/* The async (write) queue is getting full */
 	BDI_sync_congested,	/* The sync queue is getting full */
+	BDI_wb_wanted,		/* Work is queued for the flusher thread */
+	BDI_pending,		/* The flusher thread is being created */
 	BDI_unused,		/* Available bits start here */
 };
 
@@ -34,6 +39,8 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_RA_HIT,		/* read-ahead pages later accessed */
+	BDI_RA_WASTED,		/* read-ahead pages dropped unaccessed */
 	NR_BDI_STAT_ITEMS
 };
 
@@ -41,6 +48,12 @@ enum bdi_stat_item {
 
 struct backing_dev_info {
 	unsigned long ra_pages;	/* max readahead in PAGE_CACHE_SIZE units */
+	unsigned int ra_adaptive; /* scale ra_pages to the device's speed */
+	unsigned long ra_max_pages; /* adapted ra_pages, 0 until measured */
+	unsigned long read_bw;	/* measured read bandwidth, KB/s */
+	unsigned long ra_stamp;	/* jiffies of the last adaptation */
+	unsigned long ra_sectors, ra_ticks; /* disk stats at ra_stamp */
+	unsigned long ra_hit, ra_wasted; /* BDI_RA_* at ra_stamp */
 	unsigned long state;	/* Always use atomic bitops on this */
 	unsigned int capabilities; /* Device capabilities */
 	congested_fn *congested_fn; /* Function pointer if device is md/dm */
@@ -58,6 +71,16 @@ struct backing_dev_info {
 
 	struct device *dev;
 
+	struct list_head bdi_list;	/* on bdi_list while registered */
+	spinlock_t wb_lock;		/* protects the wb_ fields below */
+	struct task_struct *wb_task;	/* flusher thread, NULL when idle */
+	long wb_nr_pages;		/* pages of writeout asked for */
+	unsigned long wb_dirtied;	/* jiffies an inode was last dirtied */
+	unsigned long wb_written;	/* pages written by the flusher */
+	unsigned long wb_background;	/* background writeout runs */
+	unsigned long wb_kupdate;	/* kupdate writeout runs */
+	unsigned long wb_spawned;	/* times the flusher was started */
+
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debug_dir;
 	struct dentry *debug_stats;
@@ -71,6 +94,13 @@ int bdi_register(struct backing_dev_info *bdi, struct device *parent,
 		const char *fmt, ...);
 int bdi_register_dev(struct backing_dev_info *bdi, dev_t dev);
 void bdi_unregister(struct backing_dev_info *bdi);
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages);
+void bdi_inode_dirtied(struct backing_dev_info *bdi);
+int bdi_writeback_task(struct backing_dev_info *bdi);
+long wb_do_writeback(struct backing_dev_info *bdi, int kupdate);
+int bdi_flusher_may_exit(struct backing_dev_info *bdi,
+			 unsigned long last_active);
+void bdi_wakeup_flushers(void);
 
 static inline void __add_bdi_stat(struct backing_dev_info *bdi,
 		enum bdi_stat_item item, s64 amount)
@@ -202,6 +232,8 @@ int bdi_set_max_ratio(struct backing_dev_info *bdi, unsigned int max_ratio);
 #endif
 
 extern struct backing_dev_info default_backing_dev_info;
+extern spinlock_t bdi_lock;
+extern struct list_head bdi_list;
 void default_unplug_io_fn(struct backing_dev_info *bdi, struct page *page);
 
 int writeback_in_progress(struct backing_dev_info *bdi);
@@ -809,6 +809,35 @@ extern void blk_execute_rq_nowait(struct request_queue *, struct gendisk *,
 				  struct request *, int, rq_end_io_fn *);
 extern void blk_unplug(struct request_queue *q);
 
+/*
+ * blk_plug lets a task collect the requests it is about to issue on its
+ * own stack, merge them there without touching the queue lock, and hand
+ * them to each queue in one go when it is done (or when it goes to sleep).
+ *
+ *	struct blk_plug plug;
+ *
+ *	blk_start_plug(&plug);
+ *	... submit_bio() ...
+ *	blk_finish_plug(&plug);
+ *
+ * Plugs nest: only the outermost one collects requests.
+ */
+struct blk_plug {
+	struct list_head list;
+};
+
+extern void blk_start_plug(struct blk_plug *);
+extern void blk_finish_plug(struct blk_plug *);
+extern void blk_flush_plug_list(struct blk_plug *);
+
+static inline void blk_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	if (plug && !list_empty(&plug->list))
+		blk_flush_plug_list(plug);
+}
+
 static inline struct request_queue *bdev_get_queue(struct block_device *bdev)
 {
 	return bdev->bd_disk->queue;
@@ -987,6 +1016,16 @@ static inline int sb_issue_discard(struct super_block *sb,
 	nr_blocks <<= (sb->s_blocksize_bits - 9);
 	return blkdev_issue_discard(sb->s_bdev, block, nr_blocks, GFP_KERNEL);
 }
+extern int blkdev_issue_zeroout(struct block_device *,
+				sector_t sector, sector_t nr_sects, gfp_t);
+
+static inline int sb_issue_zeroout(struct super_block *sb, sector_t block,
+				   sector_t nr_blocks, gfp_t gfp_mask)
+{
+	block <<= (sb->s_blocksize_bits - 9);
+	nr_blocks <<= (sb->s_blocksize_bits - 9);
+	return blkdev_issue_zeroout(sb->s_bdev, block, nr_blocks, gfp_mask);
+}
 
 extern int blk_verify_command(unsigned char *cmd, fmode_t has_write_perm);
 
@@ -1231,6 +1270,21 @@ static inline long nr_blockdev_pages(void)
 	return 0;
 }
 
+struct blk_plug {
+};
+
+static inline void blk_start_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_finish_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_flush_plug(struct task_struct *tsk)
+{
+}
+
 #endif /* CONFIG_BLOCK */
 
 #endif
@@ -0,0 +1,70 @@
+#ifndef _LINUX_CCACHE_H
+#define _LINUX_CCACHE_H
+/*
+ * Compressed cache for clean page-cache pages
+ *
+ * Clean file pages dropped by vmscan are kept LZO-compressed in a bounded
+ * pool, keyed by (mapping, index), and handed back to the filesystem's
+ * readpage path before it goes to the block device.  See mm/ccache.c.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm_types.h>
+
+#ifdef CONFIG_COMPRESSED_PAGECACHE
+
+/* Gauges reported in /proc/vmstat after the zoned counters */
+enum ccache_stat_item {
+	CCACHE_NR_PAGES,	/* pages held */
+	CCACHE_POOL_BYTES,	/* memory used by the pool */
+	CCACHE_COMPR_PERCENT,	/* compressed size as a percentage */
+	NR_CCACHE_STAT_ITEMS
+};
+
+extern void ccache_put_page(struct address_space *mapping, struct page *page);
+extern int ccache_get_page(struct page *page);
+extern void ccache_flush_page(struct address_space *mapping, pgoff_t index);
+extern void ccache_flush_range(struct address_space *mapping,
+			       pgoff_t start, pgoff_t end);
+extern void ccache_stats(unsigned long *v);
+
+static inline void ccache_flush_inode(struct address_space *mapping)
+{
+	ccache_flush_range(mapping, 0, ~0UL);
+}
+
+#else
+
+#define NR_CCACHE_STAT_ITEMS	0
+
+static inline void ccache_put_page(struct address_space *mapping,
+				   struct page *page)
+{
+}
+
+static inline int ccache_get_page(struct page *page)
+{
+	return -ENOENT;
+}
+
+static inline void ccache_flush_page(struct address_space *mapping,
+				     pgoff_t index)
+{
+}
+
+static inline void ccache_flush_range(struct address_space *mapping,
+				      pgoff_t start, pgoff_t end)
+{
+}
+
+static inline void ccache_stats(unsigned long *v)
+{
+}
+
+static inline void ccache_flush_inode(struct address_space *mapping)
+{
+}
+
+#endif /* CONFIG_COMPRESSED_PAGECACHE */
+
+#endif /* _LINUX_CCACHE_H */
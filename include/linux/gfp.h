@@ -311,6 +311,26 @@ extern struct page *alloc_page_vma(gfp_t gfp_mask,
 #endif
 #define alloc_page(gfp_mask) alloc_pages(gfp_mask, 0)
 
+extern unsigned long __alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+					struct list_head *page_list,
+					struct page **page_array);
+
+/* Add up to @nr_pages order-0 pages to @list, linked through page->lru */
+static inline unsigned long
+alloc_pages_bulk_list(gfp_t gfp_mask, unsigned long nr_pages,
+		      struct list_head *list)
+{
+	return __alloc_pages_bulk(gfp_mask, nr_pages, list, NULL);
+}
+
+/* Store up to @nr_pages order-0 pages in @array */
+static inline unsigned long
+alloc_pages_bulk_array(gfp_t gfp_mask, unsigned long nr_pages,
+		       struct page **array)
+{
+	return __alloc_pages_bulk(gfp_mask, nr_pages, NULL, array);
+}
+
 extern unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order);
 extern unsigned long get_zeroed_page(gfp_t gfp_mask);
 
@@ -336,6 +356,13 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp);
 void drain_all_pages(void);
 void drain_local_pages(void *dummy);
 
+#ifdef CONFIG_CMA
+/* The range must lie within one zone and be pageblock aligned by the caller */
+extern int alloc_contig_range(unsigned long start, unsigned long end);
+extern void free_contig_range(unsigned long pfn, unsigned long nr_pages);
+extern void init_cma_reserved_pageblock(struct page *page);
+#endif
+
 extern bool oom_killer_disabled;
 
 static inline void oom_killer_disable(void)
@@ -17,6 +17,8 @@
  * MA 02110-1301, USA.
  */
 
+struct iram_client;
+
 #ifdef CONFIG_IRAM_ALLOC
 int __init iram_init(unsigned long base, unsigned long size);
 void *iram_alloc(unsigned int size, unsigned long *dma_addr);
@@ -33,3 +35,31 @@ static inline void *iram_alloc(unsigned int size, unsigned long *dma_addr)
 static inline void iram_free(unsigned long base, unsigned long size) {}
 #endif
 
+#if defined(CONFIG_IRAM_ALLOC) && defined(CONFIG_ARCH_MXC)
+struct iram_client *iram_client_register(const char *name,
+					 unsigned int quota,
+					 unsigned int reserve);
+void *iram_client_alloc(struct iram_client *client, unsigned int size,
+			unsigned int align, unsigned long *dma_addr);
+void iram_client_free(struct iram_client *client, unsigned long dma_addr,
+		      unsigned int size);
+#else
+/* platforms without client accounting fall back to the plain pool */
+static inline struct iram_client *iram_client_register(const char *name,
+						       unsigned int quota,
+						       unsigned int reserve)
+{
+	return NULL;
+}
+static inline void *iram_client_alloc(struct iram_client *client,
+				      unsigned int size, unsigned int align,
+				      unsigned long *dma_addr)
+{
+	return iram_alloc(size, dma_addr);
+}
+static inline void iram_client_free(struct iram_client *client,
+				    unsigned long dma_addr, unsigned int size)
+{
+	iram_free(dma_addr, size);
+}
+#endif
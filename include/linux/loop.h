@@ -18,6 +18,7 @@
 #include <linux/blkdev.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/mempool.h>
 
 /* Possible states of device */
 enum {
@@ -28,6 +29,13 @@ enum {
 
 struct loop_func_table;
 
+/* A run of loop sectors that is contiguous on the backing block device */
+struct loop_extent {
+	sector_t		start;		/* first loop sector */
+	sector_t		nr_sects;
+	sector_t		disk_start;	/* where it is on lo_direct_bdev */
+};
+
 struct loop_device {
 	int		lo_number;
 	int		lo_refcnt;
@@ -65,6 +73,14 @@ struct loop_device {
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 	struct list_head	lo_list;
+
+	/* LO_FLAGS_DIRECT_MAP state */
+	struct block_device	*lo_direct_bdev;
+	struct loop_extent	*lo_extents;
+	unsigned int		lo_nr_extents;
+	mempool_t		*lo_direct_pool;
+	struct bio_set		*lo_direct_bio_set;
+	atomic_t		lo_direct_pending;
 };
 
 #endif /* __KERNEL__ */
@@ -76,6 +92,7 @@ enum {
 	LO_FLAGS_READ_ONLY	= 1,
 	LO_FLAGS_USE_AOPS	= 2,
 	LO_FLAGS_AUTOCLEAR	= 4,
+	LO_FLAGS_DIRECT_MAP	= 8,
 };
 
 #include <asm/posix_types.h>	/* for __kernel_old_dev_t */
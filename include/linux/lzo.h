@@ -27,6 +27,13 @@ int lzo1x_1_compress(const unsigned char *src, size_t src_len,
 int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
 			unsigned char *dst, size_t *dst_len);
 
+/*
+ * decompression without input or lookbehind checks, only for data the
+ * kernel compressed itself and kept out of reach of anyone else
+ */
+int lzo1x_decompress_unsafe(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+
 /*
  * Return values (< 0 = Error)
  */
@@ -44,6 +44,8 @@ struct mmc_ext_csd {
 	unsigned int		sectors;
 	unsigned int		card_type;
 #define MMC_DDR_MODE_MASK 	(0x3<<2)
+	unsigned int		rel_sectors;	/* reliable write unit */
+	unsigned char		rel_param;	/* WR_REL_PARAM */
 };
 
 struct sd_scr {
@@ -51,6 +53,9 @@ struct sd_scr {
 	unsigned char		bus_widths;
 #define SD_SCR_BUS_WIDTH_1	(1<<0)
 #define SD_SCR_BUS_WIDTH_4	(1<<2)
+	unsigned char		cmds;
+#define SD_SCR_CMD20_SUPPORT	(1<<0)
+#define SD_SCR_CMD23_SUPPORT	(1<<1)
 };
 
 struct sd_switch_caps {
@@ -105,6 +110,7 @@ struct mmc_card {
 	struct mmc_ext_csd	ext_csd;	/* mmc v4 extended card specific */
 	struct sd_scr		scr;		/* extra SD information */
 	struct sd_switch_caps	sw_caps;	/* switch (CMD6) caps */
+	unsigned int		erase_size;	/* AU / erase group, sectors */
 
 	unsigned int		sdio_funcs;	/* number of SDIO functions */
 	struct sdio_cccr	cccr;		/* common card info */
@@ -120,6 +120,7 @@ struct mmc_host {
 #define MMC_CAP_NEEDS_POLL	(1 << 5)	/* Needs polling for card-detection */
 #define MMC_CAP_8_BIT_DATA	(1 << 6)	/* Can the host do 8 bit transfers */
 #define MMC_CAP_DATA_DDR	(1 << 7)	/* Can the host do ddr transfers */
+#define MMC_CAP_CMD23		(1 << 8)	/* Can send mrq->sbc before cmd */
 
 	/* host specific block data */
 	unsigned int		max_seg_size;	/* see blk_queue_max_segment_size */
@@ -129,6 +130,7 @@ struct mmc_host {
 	unsigned int		max_req_size;	/* maximum number of bytes in one req */
 	unsigned int		max_blk_size;	/* maximum size of one mmc block */
 	unsigned int		max_blk_count;	/* maximum number of blocks in one req */
+	unsigned int		seg_align;	/* DMA start alignment of sg entries, 0 if any */
 
 	/* private data */
 	spinlock_t		lock;		/* lock for claim and bus ops */
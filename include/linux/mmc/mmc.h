@@ -249,11 +249,14 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_WR_REL_PARAM	166	/* RO */
 #define EXT_CSD_BUS_WIDTH	183	/* R/W */
 #define EXT_CSD_HS_TIMING	185	/* R/W */
 #define EXT_CSD_CARD_TYPE	196	/* RO */
 #define EXT_CSD_REV		192	/* RO */
 #define EXT_CSD_SEC_CNT		212	/* RO, 4 bytes */
+#define EXT_CSD_REL_WR_SEC_C	222	/* RO */
+#define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 
 /*
  * EXT_CSD field definitions
@@ -273,6 +276,14 @@ struct _mmc_csd {
 #define EXT_CSD_BUS_WIDTH_4_DDR	5	/* Card is in 4 bit ddr mode */
 #define EXT_CSD_BUS_WIDTH_8_DDR	6	/* Card is in 8 bit ddr mode */
 
+#define EXT_CSD_WR_REL_PARAM_EN	(1<<2)	/* Any size reliable write */
+
+/*
+ * SET_BLOCK_COUNT argument
+ */
+
+#define MMC_SBC_RELIABLE_WRITE	(1<<31)	/* Reliable write request */
+
 /*
  * MMC_SWITCH access modes
  */
@@ -250,6 +250,9 @@ struct nand_hw_control {
  * @read_page:	function to read a page according to the ecc generator requirements
  * @read_subpage:	function to read parts of the page covered by ECC.
  * @write_page:	function to write a page according to the ecc generator requirements
+ * @read_pages:	optional function to read a run of whole pages with ECC,
+ *		issuing the read commands itself so that it can overlap
+ *		the transfers; the run never crosses a chip boundary
  * @read_oob:	function to read chip OOB data
  * @write_oob:	function to write chip OOB data
  */
@@ -285,6 +288,10 @@ struct nand_ecc_ctrl {
 	void			(*write_page)(struct mtd_info *mtd,
 					      struct nand_chip *chip,
 					      const uint8_t *buf);
+	int			(*read_pages)(struct mtd_info *mtd,
+					      struct nand_chip *chip,
+					      uint8_t *buf, int page,
+					      int numpages);
 	int			(*read_oob)(struct mtd_info *mtd,
 					    struct nand_chip *chip,
 					    int page,
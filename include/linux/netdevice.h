@@ -187,10 +187,24 @@ struct netif_rx_stats
 	unsigned dropped;
 	unsigned time_squeeze;
 	unsigned cpu_collision;
+	unsigned received_rps;
 };
 
 DECLARE_PER_CPU(struct netif_rx_stats, netdev_rx_stat);
 
+#ifdef CONFIG_RPS
+/*
+ * Receive packet steering map: the CPUs among which a device's received
+ * packets are spread by flow hash.  Replaced as a whole under RCU.
+ */
+struct rps_map {
+	unsigned int	len;
+	struct rcu_head	rcu;
+	u16		cpus[0];
+};
+#define RPS_MAP_SIZE(_num) (sizeof(struct rps_map) + ((_num) * sizeof(u16)))
+#endif
+
 struct dev_addr_list
 {
 	struct dev_addr_list	*next;
@@ -821,6 +835,15 @@ struct net_device
 
 	struct netdev_queue	rx_queue;
 
+#ifdef CONFIG_RPS
+	/* CPUs received packets are steered to, see get_rps_cpu() */
+	struct rps_map		*rps_map;
+#endif
+#ifdef CONFIG_NET_SKB_RECYCLE
+	/* Receive skbs handed back by the stack, see skb_recycle_pool_attach() */
+	struct skb_recycle_pool	*skb_pool;
+#endif
+
 	struct netdev_queue	*_tx ____cacheline_aligned_in_smp;
 
 	/* Number of TX queues allocated at alloc_netdev_mq() time  */
@@ -1208,6 +1231,11 @@ struct softnet_data
 	struct sk_buff		*completion_queue;
 
 	struct napi_struct	backlog;
+
+#ifdef CONFIG_RPS
+	/* IPI used by other CPUs to kick this CPU's backlog */
+	struct call_single_data	csd ____cacheline_aligned_in_smp;
+#endif
 };
 
 DECLARE_PER_CPU(struct softnet_data,softnet_data);
@@ -201,11 +201,20 @@ static inline void page_unfreeze_refs(struct page *page, int count)
 
 #ifdef CONFIG_NUMA
 extern struct page *__page_cache_alloc(gfp_t gfp);
+extern unsigned long __page_cache_alloc_bulk(gfp_t gfp, unsigned long nr,
+					     struct list_head *list);
 #else
 static inline struct page *__page_cache_alloc(gfp_t gfp)
 {
 	return alloc_pages(gfp, 0);
 }
+
+static inline unsigned long __page_cache_alloc_bulk(gfp_t gfp,
+						    unsigned long nr,
+						    struct list_head *list)
+{
+	return alloc_pages_bulk_list(gfp, nr, list);
+}
 #endif
 
 static inline struct page *page_cache_alloc(struct address_space *x)
@@ -218,6 +227,14 @@ static inline struct page *page_cache_alloc_cold(struct address_space *x)
 	return __page_cache_alloc(mapping_gfp_mask(x)|__GFP_COLD);
 }
 
+/* Add up to @nr cold pages for @x to @list; returns the number added */
+static inline unsigned long page_cache_alloc_cold_bulk(struct address_space *x,
+						       unsigned long nr,
+						       struct list_head *list)
+{
+	return __page_cache_alloc_bulk(mapping_gfp_mask(x)|__GFP_COLD, nr, list);
+}
+
 typedef int filler_t(void *, struct page *);
 
 extern struct page * find_get_page(struct address_space *mapping,
@@ -309,6 +309,8 @@ typedef unsigned char *sk_buff_data_t;
  *		done by skb DMA functions
  *	@secmark: security marking
  *	@vlan_tci: vlan tag control information
+ *	@rxhash: flow hash of a received packet, used for receive steering
+ *	@recycle_pool: receive buffer pool the skb goes back to when freed
  */
 
 struct sk_buff {
@@ -397,6 +399,12 @@ struct sk_buff {
 	__u32			mark;
 
 	__u16			vlan_tci;
+#ifdef CONFIG_RPS
+	__u32			rxhash;
+#endif
+#ifdef CONFIG_NET_SKB_RECYCLE
+	struct skb_recycle_pool	*recycle_pool;
+#endif
 
 	sk_buff_data_t		transport_header;
 	sk_buff_data_t		network_header;
@@ -444,6 +452,7 @@ static inline struct rtable *skb_rtable(const struct sk_buff *skb)
 extern void kfree_skb(struct sk_buff *skb);
 extern void consume_skb(struct sk_buff *skb);
 extern void	       __kfree_skb(struct sk_buff *skb);
+extern void	       __kfree_skb_list(struct sk_buff *skb);
 extern struct sk_buff *__alloc_skb(unsigned int size,
 				   gfp_t priority, int fclone, int node);
 static inline struct sk_buff *alloc_skb(unsigned int size,
@@ -460,6 +469,23 @@ static inline struct sk_buff *alloc_skb_fclone(unsigned int size,
 
 extern int skb_recycle_check(struct sk_buff *skb, int skb_size);
 
+#ifdef CONFIG_NET_SKB_RECYCLE
+/*
+ * Per-device pool of receive skbs, see netdev_alloc_skb_recycle().
+ * The counters are protected by list.lock.
+ */
+struct skb_recycle_pool {
+	struct sk_buff_head	list;
+	unsigned int		skb_size;	/* buffer size, excluding pad */
+	unsigned int		depth;		/* skbs kept at most */
+	atomic_t		refcnt;		/* device + skbs in flight */
+	unsigned long		hits;		/* allocations from the pool */
+	unsigned long		misses;		/* allocations from slab */
+	unsigned long		recycled;	/* skbs returned to the pool */
+	unsigned long		rejected;	/* skbs freed instead */
+};
+#endif
+
 extern struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src);
 extern struct sk_buff *skb_clone(struct sk_buff *skb,
 				 gfp_t priority);
@@ -1493,6 +1519,30 @@ static inline struct sk_buff *netdev_alloc_skb(struct net_device *dev,
 	return __netdev_alloc_skb(dev, length, GFP_ATOMIC);
 }
 
+#ifdef CONFIG_NET_SKB_RECYCLE
+extern void skb_recycle_pool_attach(struct net_device *dev,
+				    unsigned int skb_size, unsigned int depth);
+extern void skb_recycle_pool_detach(struct net_device *dev);
+extern struct sk_buff *netdev_alloc_skb_recycle(struct net_device *dev,
+						unsigned int length);
+#else
+static inline void skb_recycle_pool_attach(struct net_device *dev,
+					   unsigned int skb_size,
+					   unsigned int depth)
+{
+}
+
+static inline void skb_recycle_pool_detach(struct net_device *dev)
+{
+}
+
+static inline struct sk_buff *netdev_alloc_skb_recycle(struct net_device *dev,
+						       unsigned int length)
+{
+	return netdev_alloc_skb(dev, length);
+}
+#endif
+
 extern struct page *__netdev_alloc_page(struct net_device *dev, gfp_t gfp_mask);
 
 /**
@@ -32,14 +32,27 @@ enum stat_item {
 	DEACTIVATE_TO_TAIL,	/* Cpu slab was moved to the tail of partials */
 	DEACTIVATE_REMOTE_FREES,/* Slab contained remotely freed objects */
 	ORDER_FALLBACK,		/* Number of times fallback was necessary */
+	ALLOC_MAGAZINE,		/* Allocation from the cpu magazine */
+	FREE_MAGAZINE,		/* Free to the cpu magazine */
+	MAGAZINE_FLUSH,		/* Magazine full, oldest half freed to slabs */
 	NR_SLUB_STAT_ITEMS };
 
+/*
+ * Objects freed on a cpu whose current slab they do not belong to are kept
+ * in a small per cpu magazine and handed out again by the next allocations,
+ * instead of going through the slab lock each way.
+ */
+#define SLUB_MAG_SIZE	16
+
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to first free per cpu object */
 	struct page *page;	/* The slab from which we are allocating */
 	int node;		/* The node of the page (or -1 for debug) */
 	unsigned int offset;	/* Freepointer offset (in word units) */
 	unsigned int objsize;	/* Size of an object (from kmem_cache) */
+	unsigned int mag_count;	/* Objects in the magazine */
+	unsigned int mag_size;	/* Magazine capacity (0 if disabled) */
+	void *mag[SLUB_MAG_SIZE];
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
@@ -52,6 +52,11 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		UNEVICTABLE_PGCLEARED,	/* on COW, page truncate */
 		UNEVICTABLE_PGSTRANDED,	/* unable to isolate on unlock */
 		UNEVICTABLE_MLOCKFREED,
+		RA_HIT, RA_MISS, RA_WASTED,
+#ifdef CONFIG_COMPRESSED_PAGECACHE
+		CCACHE_STORE, CCACHE_REJECT, CCACHE_EVICT,
+		CCACHE_HIT, CCACHE_MISS,
+#endif
 		NR_VM_EVENT_ITEMS
 };
 
@@ -0,0 +1,81 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM readahead
+
+#if !defined(_TRACE_READAHEAD_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_READAHEAD_H
+
+#include <linux/backing-dev.h>
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(readahead,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t offset,
+		 unsigned long req_size, pgoff_t start, unsigned int size,
+		 unsigned int async_size, const char *pattern),
+
+	TP_ARGS(mapping, offset, req_size, start, size, async_size, pattern),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		dev		)
+		__field(	ino_t,		ino		)
+		__field(	pgoff_t,	offset		)
+		__field(	unsigned long,	req_size	)
+		__field(	pgoff_t,	start		)
+		__field(	unsigned int,	size		)
+		__field(	unsigned int,	async_size	)
+		__string(	pattern,	pattern		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= mapping->host->i_sb->s_dev;
+		__entry->ino		= mapping->host->i_ino;
+		__entry->offset		= offset;
+		__entry->req_size	= req_size;
+		__entry->start		= start;
+		__entry->size		= size;
+		__entry->async_size	= async_size;
+		__assign_str(pattern, pattern);
+	),
+
+	TP_printk("dev %d,%d ino %lu %s offset %lu req %lu ra %lu+%u async %u",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  (unsigned long) __entry->ino, __get_str(pattern),
+		  (unsigned long) __entry->offset, __entry->req_size,
+		  (unsigned long) __entry->start, __entry->size,
+		  __entry->async_size)
+);
+
+TRACE_EVENT(readahead_adapt,
+
+	TP_PROTO(struct backing_dev_info *bdi, unsigned long hit,
+		 unsigned long wasted),
+
+	TP_ARGS(bdi, hit, wasted),
+
+	TP_STRUCT__entry(
+		__string(	name,	bdi->dev ? dev_name(bdi->dev) : "none")
+		__field(	unsigned long,	read_bw		)
+		__field(	unsigned long,	hit		)
+		__field(	unsigned long,	wasted		)
+		__field(	unsigned long,	ra_max_pages	)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, bdi->dev ? dev_name(bdi->dev) : "none");
+		__entry->read_bw	= bdi->read_bw;
+		__entry->hit		= hit;
+		__entry->wasted		= wasted;
+		__entry->ra_max_pages	= bdi->ra_max_pages;
+	),
+
+	TP_printk("bdi %s read_bw %lu KB/s hit %lu wasted %lu max %lu pages",
+		  __get_str(name), __entry->read_bw, __entry->hit,
+		  __entry->wasted, __entry->ra_max_pages)
+);
+
+#endif /* _TRACE_READAHEAD_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -5520,6 +5520,13 @@ asmlinkage void __sched schedule(void)
 	struct rq *rq;
 	int cpu;
 
+	/*
+	 * Whatever we are about to wait for may be stuck behind requests
+	 * we have plugged ourselves, so send them on first.
+	 */
+	if (current->state && !(preempt_count() & PREEMPT_ACTIVE))
+		blk_flush_plug(current);
+
 need_resched:
 	preempt_disable();
 	cpu = smp_processor_id();
@@ -1394,6 +1394,14 @@ static struct ctl_table fs_table[] = {
 		.mode		= 0444,
 		.proc_handler	= &proc_nr_files,
 	},
+	{
+		.ctl_name	= CTL_UNNUMBERED,
+		.procname	= "rcu-walk-stat",
+		.data		= &rcu_walk_stat,
+		.maxlen		= sizeof(rcu_walk_stat),
+		.mode		= 0444,
+		.proc_handler	= &proc_rcu_walk_stat,
+	},
 	{
 		.ctl_name	= FS_MAXFILE,
 		.procname	= "file-max",
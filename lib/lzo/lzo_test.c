@@ -0,0 +1,507 @@
+/*
+ *  LZO1X decompressor test and benchmark
+ *
+ *  Checks lzo1x_decompress_safe() and lzo1x_decompress_unsafe() against
+ *  the byte-oriented MiniLZO decoder they replaced, which is kept below
+ *  as the reference.  Random buffers of varying compressibility are
+ *  round-tripped through all three, then corrupted and truncated streams
+ *  are fed to the safe decoders, which must agree with each other and
+ *  never write past the output buffer.  Finally the decompression speed
+ *  of all three is reported on page sized blocks.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; version 2
+ *  of the License.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <asm/unaligned.h>
+#include "lzodefs.h"
+
+#define TEST_MAX_LEN	(64 * 1024)
+#define TEST_GUARD	64
+#define TEST_POISON	0x5a
+#define TEST_COMP_LEN	\
+	((TEST_MAX_LEN / PAGE_SIZE) * lzo1x_worst_compress(PAGE_SIZE))
+
+/* never returned by the decoders themselves */
+#define TEST_E_CLOBBERED	1
+
+static unsigned int rounds = 200;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Number of random buffers to round-trip");
+
+static unsigned int fuzz = 50;
+module_param(fuzz, uint, 0444);
+MODULE_PARM_DESC(fuzz, "Corrupted streams to try per buffer");
+
+static unsigned int bench_mb = 16;
+module_param(bench_mb, uint, 0444);
+MODULE_PARM_DESC(bench_mb, "Megabytes to decompress per benchmark run");
+
+static unsigned int seed;
+module_param(seed, uint, 0444);
+MODULE_PARM_DESC(seed, "Random seed (0 picks one)");
+
+/*
+ * Reference: the decoder as it was before the bulk copy rewrite.
+ */
+#define HAVE_IP(x, ip_end, ip) ((size_t)(ip_end - ip) < (x))
+#define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
+#define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
+
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+
+static int ref_decompress(const unsigned char *in, size_t in_len,
+			unsigned char *out, size_t *out_len)
+{
+	const unsigned char * const ip_end = in + in_len;
+	unsigned char * const op_end = out + *out_len;
+	const unsigned char *ip = in, *m_pos;
+	unsigned char *op = out;
+	size_t t;
+
+	*out_len = 0;
+
+	if (*ip > 17) {
+		t = *ip++ - 17;
+		if (t < 4)
+			goto match_next;
+		if (HAVE_OP(t, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 1, ip_end, ip))
+			goto input_overrun;
+		do {
+			*op++ = *ip++;
+		} while (--t > 0);
+		goto first_literal_run;
+	}
+
+	while ((ip < ip_end)) {
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		if (t == 0) {
+			if (HAVE_IP(1, ip_end, ip))
+				goto input_overrun;
+			while (*ip == 0) {
+				t += 255;
+				ip++;
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
+			}
+			t += 15 + *ip++;
+		}
+		if (HAVE_OP(t + 3, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 4, ip_end, ip))
+			goto input_overrun;
+
+		COPY4(op, ip);
+		op += 4;
+		ip += 4;
+		if (--t > 0) {
+			if (t >= 4) {
+				do {
+					COPY4(op, ip);
+					op += 4;
+					ip += 4;
+					t -= 4;
+				} while (t >= 4);
+				if (t > 0) {
+					do {
+						*op++ = *ip++;
+					} while (--t > 0);
+				}
+			} else {
+				do {
+					*op++ = *ip++;
+				} while (--t > 0);
+			}
+		}
+
+first_literal_run:
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		m_pos = op - (1 + M2_MAX_OFFSET);
+		m_pos -= t >> 2;
+		m_pos -= *ip++ << 2;
+
+		if (HAVE_LB(m_pos, out, op))
+			goto lookbehind_overrun;
+
+		if (HAVE_OP(3, op_end, op))
+			goto output_overrun;
+		*op++ = *m_pos++;
+		*op++ = *m_pos++;
+		*op++ = *m_pos;
+
+		goto match_done;
+
+		do {
+match:
+			if (t >= 64) {
+				m_pos = op - 1;
+				m_pos -= (t >> 2) & 7;
+				m_pos -= *ip++ << 3;
+				t = (t >> 5) - 1;
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(t + 3 - 1, op_end, op))
+					goto output_overrun;
+				goto copy_match;
+			} else if (t >= 32) {
+				t &= 31;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 31 + *ip++;
+				}
+				m_pos = op - 1;
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+			} else if (t >= 16) {
+				m_pos = op;
+				m_pos -= (t & 8) << 11;
+
+				t &= 7;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 7 + *ip++;
+				}
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+				if (m_pos == op)
+					goto eof_found;
+				m_pos -= 0x4000;
+			} else {
+				m_pos = op - 1;
+				m_pos -= t >> 2;
+				m_pos -= *ip++ << 2;
+
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(2, op_end, op))
+					goto output_overrun;
+
+				*op++ = *m_pos++;
+				*op++ = *m_pos;
+				goto match_done;
+			}
+
+			if (HAVE_LB(m_pos, out, op))
+				goto lookbehind_overrun;
+			if (HAVE_OP(t + 3 - 1, op_end, op))
+				goto output_overrun;
+
+			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
+				COPY4(op, m_pos);
+				op += 4;
+				m_pos += 4;
+				t -= 4 - (3 - 1);
+				do {
+					COPY4(op, m_pos);
+					op += 4;
+					m_pos += 4;
+					t -= 4;
+				} while (t >= 4);
+				if (t > 0)
+					do {
+						*op++ = *m_pos++;
+					} while (--t > 0);
+			} else {
+copy_match:
+				*op++ = *m_pos++;
+				*op++ = *m_pos++;
+				do {
+					*op++ = *m_pos++;
+				} while (--t > 0);
+			}
+match_done:
+			t = ip[-2] & 3;
+			if (t == 0)
+				break;
+match_next:
+			if (HAVE_OP(t, op_end, op))
+				goto output_overrun;
+			if (HAVE_IP(t + 1, ip_end, ip))
+				goto input_overrun;
+
+			*op++ = *ip++;
+			if (t > 1) {
+				*op++ = *ip++;
+				if (t > 2)
+					*op++ = *ip++;
+			}
+
+			t = *ip++;
+		} while (ip < ip_end);
+	}
+
+	*out_len = op - out;
+	return LZO_E_EOF_NOT_FOUND;
+
+eof_found:
+	*out_len = op - out;
+	return (ip == ip_end ? LZO_E_OK :
+		(ip < ip_end ? LZO_E_INPUT_NOT_CONSUMED : LZO_E_INPUT_OVERRUN));
+input_overrun:
+	*out_len = op - out;
+	return LZO_E_INPUT_OVERRUN;
+
+output_overrun:
+	*out_len = op - out;
+	return LZO_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*out_len = op - out;
+	return LZO_E_LOOKBEHIND_OVERRUN;
+}
+
+typedef int (*decompress_fn)(const unsigned char *, size_t,
+			     unsigned char *, size_t *);
+
+static const struct {
+	const char *name;
+	decompress_fn fn;
+} decoders[] = {
+	{ "reference",	ref_decompress },
+	{ "safe",	lzo1x_decompress_safe },
+	{ "unsafe",	lzo1x_decompress_unsafe },
+};
+
+static unsigned char *orig, *comp, *fuzzed, *out, *wrkmem;
+
+static u32 test_rand(u32 max)
+{
+	return max ? random32() % max : 0;
+}
+
+/* Fill buf with literals, short overlapping runs and far back-references */
+static void test_fill(unsigned char *buf, unsigned int len)
+{
+	unsigned int pos = 0, n, dist, alphabet;
+
+	alphabet = 1 + test_rand(256);
+	while (pos < len) {
+		n = 1 + test_rand(300);
+		if (n > len - pos)
+			n = len - pos;
+
+		switch (test_rand(4)) {
+		case 0:
+			while (n--)
+				buf[pos++] = test_rand(alphabet);
+			break;
+		case 1:
+			dist = 1 + test_rand(8);
+			if (dist > pos)
+				goto literal;
+			while (n--) {
+				buf[pos] = buf[pos - dist];
+				pos++;
+			}
+			break;
+		default:
+			if (!pos)
+				goto literal;
+			dist = 1 + test_rand(min(pos, (unsigned int)M4_MAX_OFFSET));
+			while (n--) {
+				buf[pos] = buf[pos - dist];
+				pos++;
+			}
+			break;
+		literal:
+			buf[pos++] = test_rand(alphabet);
+			break;
+		}
+	}
+}
+
+/* Decompress into out[] and check nothing past the buffer was touched */
+static int test_decompress(int i, const unsigned char *src, size_t src_len,
+			   size_t *out_len)
+{
+	size_t size = *out_len;
+	unsigned int j;
+	int ret;
+
+	memset(out, TEST_POISON, size + TEST_GUARD);
+	ret = decoders[i].fn(src, src_len, out, out_len);
+	for (j = 0; j < TEST_GUARD; j++) {
+		if (out[size + j] != TEST_POISON) {
+			printk(KERN_ERR "lzo_test: %s decoder wrote past "
+			       "the output buffer\n", decoders[i].name);
+			return TEST_E_CLOBBERED;
+		}
+	}
+	return ret;
+}
+
+static int test_roundtrip(unsigned int len)
+{
+	size_t clen = TEST_COMP_LEN, olen, ref_len;
+	unsigned int i, j, flen, fails = 0;
+	int ret, ref_ret;
+
+	test_fill(orig, len);
+	ret = lzo1x_1_compress(orig, len, comp, &clen, wrkmem);
+	if (ret != LZO_E_OK) {
+		printk(KERN_ERR "lzo_test: compression failed (%d)\n", ret);
+		return 1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(decoders); i++) {
+		olen = len;
+		ret = test_decompress(i, comp, clen, &olen);
+		if (ret != LZO_E_OK || olen != len || memcmp(out, orig, len)) {
+			printk(KERN_ERR "lzo_test: %s decoder failed round "
+			       "trip of %u bytes (%d)\n", decoders[i].name,
+			       len, ret);
+			fails++;
+		}
+	}
+
+	/*
+	 * The reference may read a few bytes past a corrupted input, so the
+	 * streams are decoded out of a buffer with slack behind them.  The
+	 * rewritten decoder is stricter about the end-of-stream marker, so
+	 * only its successes have to be confirmed by the reference.
+	 */
+	for (j = 0; j < fuzz; j++) {
+		flen = test_rand(4) ? clen : 1 + test_rand(clen);
+		memcpy(fuzzed, comp, flen);
+		for (i = test_rand(4); i > 0; i--)
+			fuzzed[test_rand(flen)] = test_rand(256);
+
+		ref_len = len;
+		ref_ret = test_decompress(0, fuzzed, flen, &ref_len);
+		memcpy(orig + len, out, ref_len);
+
+		olen = len;
+		ret = test_decompress(1, fuzzed, flen, &olen);
+		if (ret == TEST_E_CLOBBERED ||
+		    (ret == LZO_E_OK &&
+		     (ref_ret != LZO_E_OK || olen != ref_len ||
+		      memcmp(out, orig + len, olen)))) {
+			printk(KERN_ERR "lzo_test: safe decoder disagrees with "
+			       "reference on corrupted input (%d vs %d)\n",
+			       ret, ref_ret);
+			fails++;
+		}
+	}
+	return fails;
+}
+
+static void test_bench(void)
+{
+	unsigned int i, pages, p, total;
+	size_t clen, olen;
+	unsigned int *offs;
+	ktime_t start;
+	s64 ns;
+
+	/* page sized blocks, as ramzswap and the crypto users see them */
+	pages = TEST_MAX_LEN / PAGE_SIZE;
+	offs = (unsigned int *)wrkmem;
+	test_fill(orig, TEST_MAX_LEN);
+	for (p = 0, total = 0; p < pages; p++) {
+		clen = TEST_COMP_LEN - total;
+		lzo1x_1_compress(orig + p * PAGE_SIZE, PAGE_SIZE,
+				 comp + total, &clen, wrkmem + PAGE_SIZE);
+		offs[p] = total;
+		total += clen;
+	}
+	offs[pages] = total;
+	printk(KERN_INFO "lzo_test: benchmark ratio %u%%\n",
+	       total * 100 / TEST_MAX_LEN);
+
+	for (i = 0; i < ARRAY_SIZE(decoders); i++) {
+		unsigned int loops = bench_mb * (1024 * 1024 / TEST_MAX_LEN);
+		unsigned int n;
+
+		start = ktime_get();
+		for (n = 0; n < loops; n++) {
+			for (p = 0; p < pages; p++) {
+				olen = PAGE_SIZE;
+				decoders[i].fn(comp + offs[p],
+					       offs[p + 1] - offs[p], out, &olen);
+			}
+			cond_resched();
+		}
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		printk(KERN_INFO "lzo_test: %-9s %llu KB/s\n", decoders[i].name,
+		       ns ? div64_u64((u64)bench_mb * 1024 * NSEC_PER_SEC, ns)
+			  : 0ULL);
+	}
+}
+
+static int __init lzo_test_init(void)
+{
+	unsigned int i, fails = 0;
+	int ret = -ENOMEM;
+
+	if (!seed)
+		get_random_bytes(&seed, sizeof(seed));
+	srandom32(seed);
+
+	orig = vmalloc(2 * TEST_MAX_LEN);
+	comp = vmalloc(TEST_COMP_LEN);
+	fuzzed = vmalloc(TEST_COMP_LEN + TEST_GUARD);
+	out = vmalloc(TEST_MAX_LEN + TEST_GUARD);
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS + PAGE_SIZE);
+	if (!orig || !comp || !fuzzed || !out || !wrkmem)
+		goto out;
+
+	for (i = 0; i < rounds; i++) {
+		fails += test_roundtrip(1 + test_rand(TEST_MAX_LEN));
+		cond_resched();
+	}
+	printk(KERN_INFO "lzo_test: %u failures in %u rounds (seed %u)\n",
+	       fails, rounds, seed);
+
+	test_bench();
+	ret = fails ? -EINVAL : 0;
+out:
+	vfree(wrkmem);
+	vfree(out);
+	vfree(fuzzed);
+	vfree(comp);
+	vfree(orig);
+	return ret;
+}
+
+static void __exit lzo_test_exit(void)
+{
+}
+
+module_init(lzo_test_init);
+module_exit(lzo_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X decompressor test and benchmark");
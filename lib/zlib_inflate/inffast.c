@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -29,6 +30,67 @@
 #  define PUP(a) *++(a)
 #endif
 
+/*
+   On machines that handle unaligned loads and stores in hardware, refill the
+   bit buffer with a single 32-bit load and copy matches a word at a time.
+   The byte-at-a-time code below remains the reference for everyone else.
+ */
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+#  define INFLATE_WORD_ACCESS
+#endif
+
+#ifdef INFLATE_WORD_ACCESS
+/* plain word accesses here, but the compiler must not assume alignment */
+#  define LOAD32(p)      get_unaligned((const u32 *)(p))
+#  define STORE32(p, v)  put_unaligned((v), (u32 *)(p))
+
+union inflate_pattern {
+    u32 w;
+    unsigned char b[4];
+};
+
+/*
+   Copy len bytes from from to out, both in the PUP() convention.  If the
+   source lies at least four bytes behind the destination (or in a separate
+   buffer) whole words can be moved even though the regions overlap, since
+   every word read has already been written.  Distances of one and two
+   replicate into a word pattern; a distance of three stays bytewise.
+ */
+static inline unsigned char *inflate_copy(unsigned char *out,
+                                          const unsigned char *from,
+                                          unsigned len)
+{
+    union inflate_pattern pat;
+    unsigned long dist = (unsigned long)(out - from);
+
+    if (dist >= 4) {
+        while (len >= 4) {
+            STORE32(out + OFF, LOAD32(from + OFF));
+            out += 4;
+            from += 4;
+            len -= 4;
+        }
+    }
+    else if (dist != 3 && len >= 4) {
+        pat.b[0] = from[OFF];
+        pat.b[1] = from[OFF + dist - 1];
+        pat.b[2] = pat.b[0];
+        pat.b[3] = pat.b[1];
+        do {
+            STORE32(out + OFF, pat.w);
+            out += 4;
+            len -= 4;
+        } while (len >= 4);
+        from = out - dist;
+    }
+    while (len) {
+        PUP(out) = PUP(from);
+        len--;
+    }
+    return out;
+}
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -119,10 +181,20 @@ void inflate_fast(z_streamp strm, unsigned start)
        input data or output space */
     do {
         if (bits < 15) {
+#ifdef INFLATE_WORD_ACCESS
+            /* top up to 24..31 bits; at least six input bytes remain here,
+               so the four byte load cannot run past the end of the input */
+            op = (31 - bits) >> 3;
+            hold += (unsigned long)(get_unaligned_le32(in + OFF) &
+                                    ((1U << (op << 3)) - 1)) << bits;
+            in += op;
+            bits += op << 3;
+#else
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
+#endif
         }
         this = lcode[hold & lmask];
       dolen:
@@ -226,6 +298,9 @@ void inflate_fast(z_streamp strm, unsigned start)
                             from = out - dist;  /* rest from output */
                         }
                     }
+#ifdef INFLATE_WORD_ACCESS
+                    out = inflate_copy(out, from, len);
+#else
                     while (len > 2) {
                         PUP(out) = PUP(from);
                         PUP(out) = PUP(from);
@@ -237,9 +312,13 @@ void inflate_fast(z_streamp strm, unsigned start)
                         if (len > 1)
                             PUP(out) = PUP(from);
                     }
+#endif
                 }
                 else {
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_WORD_ACCESS
+                    out = inflate_copy(out, from, len);
+#else
                     do {                        /* minimum length is three */
                         PUP(out) = PUP(from);
                         PUP(out) = PUP(from);
@@ -251,6 +330,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         if (len > 1)
                             PUP(out) = PUP(from);
                     }
+#endif
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -0,0 +1,195 @@
+/*
+ * Randomised round-trip test for the zlib inflate fast path
+ *
+ * Generates buffers with a mix of literals, short-distance runs and long
+ * back-references, compresses them with zlib_deflate and decompresses them
+ * again with the input and output handed to zlib_inflate in random sized
+ * chunks, so that inflate_fast() is exercised both on direct copies from
+ * the output buffer and on copies out of the sliding window.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+
+#define TEST_MAX_LEN	(128 * 1024)
+
+static unsigned int rounds = 500;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Number of random buffers to round-trip");
+
+static unsigned int seed;
+module_param(seed, uint, 0444);
+MODULE_PARM_DESC(seed, "Random seed (0 picks one)");
+
+static struct z_stream_s def_strm, inf_strm;
+static unsigned char *orig, *comp, *decomp;
+
+static u32 test_rand(u32 max)
+{
+	return max ? random32() % max : 0;
+}
+
+/* Fill buf with data that compresses to every kind of match distance */
+static void test_fill(unsigned char *buf, unsigned int len)
+{
+	unsigned int pos = 0, n, dist, alphabet;
+
+	alphabet = 1 + test_rand(256);
+	while (pos < len) {
+		n = 1 + test_rand(300);
+		if (n > len - pos)
+			n = len - pos;
+
+		switch (test_rand(4)) {
+		case 0:			/* literals */
+			while (n--)
+				buf[pos++] = test_rand(alphabet);
+			break;
+		case 1:			/* runs with distance 1..4 */
+			dist = 1 + test_rand(4);
+			if (dist > pos)
+				goto literal;
+			while (n--) {
+				buf[pos] = buf[pos - dist];
+				pos++;
+			}
+			break;
+		default:		/* back-reference anywhere in the window */
+			if (!pos)
+				goto literal;
+			dist = 1 + test_rand(min(pos, 32768U));
+			while (n--) {
+				buf[pos] = buf[pos - dist];
+				pos++;
+			}
+			break;
+		literal:
+			buf[pos++] = test_rand(alphabet);
+			break;
+		}
+	}
+}
+
+static int test_deflate(unsigned int len, unsigned int *clen)
+{
+	int ret;
+
+	ret = zlib_deflateInit2(&def_strm, test_rand(10), Z_DEFLATED,
+				-MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	def_strm.next_in = orig;
+	def_strm.avail_in = len;
+	def_strm.next_out = comp;
+	def_strm.avail_out = 2 * TEST_MAX_LEN;
+	ret = zlib_deflate(&def_strm, Z_FINISH);
+	*clen = def_strm.total_out;
+	zlib_deflateEnd(&def_strm);
+
+	return ret == Z_STREAM_END ? 0 : -EINVAL;
+}
+
+static int test_inflate(unsigned int clen, unsigned int len)
+{
+	unsigned int in_pos = 0, out_pos = 0, chunk;
+	int ret;
+
+	ret = zlib_inflateInit2(&inf_strm, -MAX_WBITS);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	memset(decomp, 0xa5, TEST_MAX_LEN);
+	do {
+		/* small chunks force window copies, large ones the fast path */
+		chunk = test_rand(2) ? 1 + test_rand(64) : 1 + test_rand(16384);
+
+		inf_strm.next_in = comp + in_pos;
+		inf_strm.avail_in = min(chunk, clen - in_pos);
+		inf_strm.next_out = decomp + out_pos;
+		inf_strm.avail_out = min(chunk, TEST_MAX_LEN - out_pos);
+		ret = zlib_inflate(&inf_strm, Z_SYNC_FLUSH);
+		in_pos = inf_strm.next_in - comp;
+		out_pos = inf_strm.next_out - decomp;
+	} while (ret == Z_OK || (ret == Z_BUF_ERROR && in_pos < clen &&
+				 out_pos < TEST_MAX_LEN));
+	zlib_inflateEnd(&inf_strm);
+
+	if (ret != Z_STREAM_END) {
+		printk(KERN_ERR "inflate_test: inflate returned %d at %u/%u\n",
+		       ret, in_pos, clen);
+		return -EINVAL;
+	}
+	if (out_pos != len || memcmp(orig, decomp, len)) {
+		printk(KERN_ERR "inflate_test: mismatch, %u bytes out, "
+		       "%u expected\n", out_pos, len);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int __init inflate_test_init(void)
+{
+	unsigned int i, len, clen, failed = 0;
+	int ret = -ENOMEM;
+
+	if (!seed)
+		get_random_bytes(&seed, sizeof(seed));
+	srandom32(seed);
+
+	orig = vmalloc(TEST_MAX_LEN);
+	comp = vmalloc(2 * TEST_MAX_LEN);
+	decomp = vmalloc(TEST_MAX_LEN);
+	def_strm.workspace = vmalloc(zlib_deflate_workspacesize());
+	inf_strm.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!orig || !comp || !decomp || !def_strm.workspace ||
+	    !inf_strm.workspace)
+		goto out;
+
+	for (i = 0; i < rounds; i++) {
+		len = 1 + test_rand(TEST_MAX_LEN);
+		test_fill(orig, len);
+
+		ret = test_deflate(len, &clen);
+		if (ret) {
+			printk(KERN_ERR "inflate_test: deflate failed\n");
+			goto out;
+		}
+		if (test_inflate(clen, len))
+			failed++;
+		cond_resched();
+	}
+
+	printk(KERN_INFO "inflate_test: %u of %u round trips failed "
+	       "(seed %u)\n", failed, rounds, seed);
+	ret = failed ? -EINVAL : 0;
+out:
+	vfree(inf_strm.workspace);
+	vfree(def_strm.workspace);
+	vfree(decomp);
+	vfree(comp);
+	vfree(orig);
+	return ret;
+}
+
+static void __exit inflate_test_exit(void)
+{
+}
+
+module_init(inflate_test_init);
+module_exit(inflate_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zlib inflate round-trip test");
@@ -7,6 +7,8 @@
 #include <linux/module.h>
 #include <linux/writeback.h>
 #include <linux/device.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 void default_unplug_io_fn(struct backing_dev_info *bdi, struct page *page)
 {
@@ -23,6 +25,22 @@ EXPORT_SYMBOL_GPL(default_backing_dev_info);
 
 static struct class *bdi_class;
 
+/*
+ * Registered bdis, each of which may have a flusher thread.  The flusher
+ * threads are started on demand by bdi_forker_task, which also syncs the
+ * superblocks every dirty_writeback_interval.
+ */
+DEFINE_SPINLOCK(bdi_lock);
+LIST_HEAD(bdi_list);
+
+static struct task_struct *bdi_forker_task;
+
+/*
+ * There is no pdflush anymore; the count is kept for the read-only
+ * /proc/sys/vm/nr_pdflush_threads.
+ */
+int nr_pdflush_threads;
+
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
@@ -49,12 +67,30 @@ static int bdi_debug_stats_show(struct seq_file *m, void *v)
 		   "BdiReclaimable:   %8lu kB\n"
 		   "BdiDirtyThresh:   %8lu kB\n"
 		   "DirtyThresh:      %8lu kB\n"
-		   "BackgroundThresh: %8lu kB\n",
+		   "BackgroundThresh: %8lu kB\n"
+		   "ReadaheadHit:     %8lu kB\n"
+		   "ReadaheadWasted:  %8lu kB\n"
+		   "ReadaheadMax:     %8lu kB\n"
+		   "ReadBandwidth:    %8lu kB/s\n"
+		   "FlusherActive:    %8u\n"
+		   "FlusherStarted:   %8lu\n"
+		   "FlusherWritten:   %8lu kB\n"
+		   "FlusherBackground:%8lu\n"
+		   "FlusherKupdate:   %8lu\n",
 		   (unsigned long) K(bdi_stat(bdi, BDI_WRITEBACK)),
 		   (unsigned long) K(bdi_stat(bdi, BDI_RECLAIMABLE)),
 		   K(bdi_thresh),
 		   K(dirty_thresh),
-		   K(background_thresh));
+		   K(background_thresh),
+		   (unsigned long) K(bdi_stat(bdi, BDI_RA_HIT)),
+		   (unsigned long) K(bdi_stat(bdi, BDI_RA_WASTED)),
+		   K(bdi->ra_max_pages ? bdi->ra_max_pages : bdi->ra_pages),
+		   bdi->read_bw,
+		   bdi->wb_task != NULL,
+		   bdi->wb_spawned,
+		   K(bdi->wb_written),
+		   bdi->wb_background,
+		   bdi->wb_kupdate);
 #undef K
 
 	return 0;
@@ -127,6 +163,28 @@ static ssize_t name##_show(struct device *dev,				\
 
 BDI_SHOW(read_ahead_kb, K(bdi->ra_pages))
 
+static ssize_t read_ahead_adaptive_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	char *end;
+	unsigned long adaptive;
+	ssize_t ret = -EINVAL;
+
+	adaptive = simple_strtoul(buf, &end, 10);
+	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0'))) {
+		bdi->ra_adaptive = !!adaptive;
+		bdi->ra_max_pages = 0;
+		ret = count;
+	}
+	return ret;
+}
+BDI_SHOW(read_ahead_adaptive, bdi->ra_adaptive)
+
+BDI_SHOW(read_ahead_max_kb,
+	 K(bdi->ra_max_pages ? bdi->ra_max_pages : bdi->ra_pages))
+BDI_SHOW(read_bandwidth_kb, bdi->read_bw)
+
 static ssize_t min_ratio_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count)
 {
@@ -167,6 +225,9 @@ BDI_SHOW(max_ratio, bdi->max_ratio)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
+	__ATTR_RW(read_ahead_adaptive),
+	__ATTR(read_ahead_max_kb, 0444, read_ahead_max_kb_show, NULL),
+	__ATTR(read_bandwidth_kb, 0444, read_bandwidth_kb_show, NULL),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
 	__ATTR_NULL,
@@ -181,10 +242,249 @@ static __init int bdi_class_init(void)
 }
 postcore_initcall(bdi_class_init);
 
+static void bdi_wakeup_forker(void)
+{
+	if (bdi_forker_task)
+		wake_up_process(bdi_forker_task);
+}
+
+/**
+ * bdi_start_writeback - queue background writeout for a device
+ * @bdi: the device's backing_dev_info structure
+ * @nr_pages: minimum number of pages to write, may be zero
+ *
+ * Hands the work to the device's flusher thread, which writes back at least
+ * @nr_pages and then keeps going while the system is over the background
+ * dirty threshold.  The flusher is started if it is not running.
+ */
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
+{
+	if (!bdi_cap_writeback_dirty(bdi))
+		return;
+
+	spin_lock_bh(&bdi->wb_lock);
+	bdi->wb_nr_pages += nr_pages;
+	set_bit(BDI_wb_wanted, &bdi->state);
+	if (bdi->wb_task)
+		wake_up_process(bdi->wb_task);
+	else
+		bdi_wakeup_forker();
+	spin_unlock_bh(&bdi->wb_lock);
+}
+
+/**
+ * bdi_inode_dirtied - note that an inode went onto a dirty list
+ * @bdi: the backing_dev_info of the inode's mapping
+ *
+ * Makes sure the device has a flusher to do kupdate style writeback of the
+ * inode.  This runs for every inode that goes from clean to dirty, so it
+ * stays off wb_lock and fences against the flusher's exit with a barrier
+ * instead; see bdi_flusher_may_exit().
+ */
+void bdi_inode_dirtied(struct backing_dev_info *bdi)
+{
+	if (!bdi_cap_writeback_dirty(bdi))
+		return;
+
+	bdi->wb_dirtied = jiffies;
+	smp_mb();
+	if (!bdi->wb_task && !test_and_set_bit(BDI_wb_wanted, &bdi->state))
+		bdi_wakeup_forker();
+}
+
+/*
+ * An idle flusher exits after this long without writing anything and
+ * without any inode of its device being dirtied.
+ */
+#define BDI_FLUSHER_IDLE	(300 * HZ)
+
+/**
+ * bdi_flusher_may_exit - decide whether an idle flusher thread can exit
+ * @bdi: the device's backing_dev_info structure
+ * @last_active: jiffies the flusher last wrote something
+ *
+ * Called by the flusher itself when it found nothing to write.  Returns 1
+ * if it has given up bdi->wb_task and must exit without touching @bdi
+ * again, 0 if it has to keep running.
+ */
+int bdi_flusher_may_exit(struct backing_dev_info *bdi,
+			 unsigned long last_active)
+{
+	if (time_before(jiffies, last_active + BDI_FLUSHER_IDLE))
+		return 0;
+
+	spin_lock_bh(&bdi->wb_lock);
+	if (bdi->wb_task != current ||
+	    test_bit(BDI_wb_wanted, &bdi->state) ||
+	    time_before(jiffies, bdi->wb_dirtied + BDI_FLUSHER_IDLE)) {
+		spin_unlock_bh(&bdi->wb_lock);
+		return 0;
+	}
+	bdi->wb_task = NULL;
+
+	/*
+	 * Pairs with the barrier in bdi_inode_dirtied(): either it sees the
+	 * NULL wb_task and wakes the forker, or we see its wb_dirtied.
+	 */
+	smp_mb();
+	if (time_before(jiffies, bdi->wb_dirtied + BDI_FLUSHER_IDLE) &&
+	    !test_and_set_bit(BDI_wb_wanted, &bdi->state))
+		bdi_wakeup_forker();
+	spin_unlock_bh(&bdi->wb_lock);
+
+	return 1;
+}
+
+static int bdi_start_fn(void *ptr)
+{
+	struct backing_dev_info *bdi = ptr;
+
+	current->flags |= PF_FLUSHER | PF_SWAPWRITE;
+	set_freezable();
+
+	return bdi_writeback_task(bdi);
+}
+
+/*
+ * Start a flusher for @bdi.  If that fails, do its work from the forker so
+ * that the writeback is not lost.
+ */
+static void bdi_fork_flusher(struct backing_dev_info *bdi)
+{
+	struct task_struct *task;
+
+	task = kthread_run(bdi_start_fn, bdi, "flush-%s",
+			   bdi->dev ? dev_name(bdi->dev) : "anon");
+	if (IS_ERR(task)) {
+		printk(KERN_WARNING "bdi: cannot start flusher for %s: %ld\n",
+		       bdi->dev ? dev_name(bdi->dev) : "anon", PTR_ERR(task));
+		wb_do_writeback(bdi, 1);
+		return;
+	}
+
+	spin_lock_bh(&bdi->wb_lock);
+	bdi->wb_task = task;
+	bdi->wb_spawned++;
+	spin_unlock_bh(&bdi->wb_lock);
+}
+
+static int bdi_forker_thread(void *ptr)
+{
+	unsigned long next_sync;
+
+	current->flags |= PF_FLUSHER | PF_SWAPWRITE;
+	set_freezable();
+
+	next_sync = jiffies + msecs_to_jiffies(dirty_writeback_interval * 10);
+	while (!kthread_should_stop()) {
+		struct backing_dev_info *bdi, *found = NULL;
+		long timeout;
+
+		if (dirty_writeback_interval &&
+		    time_after_eq(jiffies, next_sync)) {
+			sync_supers();
+			next_sync = jiffies +
+				msecs_to_jiffies(dirty_writeback_interval * 10);
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		spin_lock_bh(&bdi_lock);
+		list_for_each_entry(bdi, &bdi_list, bdi_list) {
+			if (bdi->wb_task ||
+			    !test_bit(BDI_wb_wanted, &bdi->state))
+				continue;
+			set_bit(BDI_pending, &bdi->state);
+			found = bdi;
+			break;
+		}
+		spin_unlock_bh(&bdi_lock);
+
+		if (found) {
+			__set_current_state(TASK_RUNNING);
+			bdi_fork_flusher(found);
+			clear_bit(BDI_pending, &found->state);
+			smp_mb__after_clear_bit();
+			wake_up_bit(&found->state, BDI_pending);
+			continue;
+		}
+
+		if (!dirty_writeback_interval)
+			timeout = MAX_SCHEDULE_TIMEOUT;
+		else if (time_before(jiffies, next_sync))
+			timeout = next_sync - jiffies;
+		else
+			timeout = 0;
+		schedule_timeout(timeout);
+		try_to_freeze();
+	}
+
+	return 0;
+}
+
+/**
+ * bdi_wakeup_flushers - kick every flusher thread and the forker
+ *
+ * Used when dirty_writeback_interval changes, so that sleepers pick up the
+ * new period.
+ */
+void bdi_wakeup_flushers(void)
+{
+	struct backing_dev_info *bdi;
+
+	spin_lock_bh(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_list, bdi_list) {
+		spin_lock(&bdi->wb_lock);
+		if (bdi->wb_task)
+			wake_up_process(bdi->wb_task);
+		spin_unlock(&bdi->wb_lock);
+	}
+	spin_unlock_bh(&bdi_lock);
+
+	bdi_wakeup_forker();
+}
+
+static int bdi_sched_wait(void *word)
+{
+	schedule();
+	return 0;
+}
+
+/*
+ * Take @bdi off bdi_list and stop its flusher, if it has one.
+ */
+static void bdi_wb_shutdown(struct backing_dev_info *bdi)
+{
+	struct task_struct *task;
+
+	spin_lock_bh(&bdi_lock);
+	list_del_init(&bdi->bdi_list);
+	spin_unlock_bh(&bdi_lock);
+
+	/* The forker may be starting a flusher for us right now */
+	wait_on_bit(&bdi->state, BDI_pending, bdi_sched_wait,
+		    TASK_UNINTERRUPTIBLE);
+
+	spin_lock_bh(&bdi->wb_lock);
+	task = bdi->wb_task;
+	bdi->wb_task = NULL;
+	if (task)
+		get_task_struct(task);
+	spin_unlock_bh(&bdi->wb_lock);
+
+	if (task) {
+		kthread_stop(task);
+		put_task_struct(task);
+	}
+}
+
 static int __init default_bdi_init(void)
 {
 	int err;
 
+	bdi_forker_task = kthread_run(bdi_forker_thread, NULL, "bdi-default");
+	BUG_ON(IS_ERR(bdi_forker_task));
+
 	err = bdi_init(&default_backing_dev_info);
 	if (!err)
 		bdi_register(&default_backing_dev_info, NULL, "default");
@@ -214,6 +514,10 @@ int bdi_register(struct backing_dev_info *bdi, struct device *parent,
 	bdi->dev = dev;
 	bdi_debug_register(bdi, dev_name(dev));
 
+	spin_lock_bh(&bdi_lock);
+	list_add_tail(&bdi->bdi_list, &bdi_list);
+	spin_unlock_bh(&bdi_lock);
+
 exit:
 	return ret;
 }
@@ -228,6 +532,7 @@ EXPORT_SYMBOL(bdi_register_dev);
 void bdi_unregister(struct backing_dev_info *bdi)
 {
 	if (bdi->dev) {
+		bdi_wb_shutdown(bdi);
 		bdi_debug_unregister(bdi);
 		device_unregister(bdi->dev);
 		bdi->dev = NULL;
@@ -242,6 +547,22 @@ int bdi_init(struct backing_dev_info *bdi)
 
 	bdi->dev = NULL;
 
+	INIT_LIST_HEAD(&bdi->bdi_list);
+	spin_lock_init(&bdi->wb_lock);
+	bdi->wb_task = NULL;
+	bdi->wb_nr_pages = 0;
+	bdi->wb_dirtied = jiffies;
+	bdi->wb_written = 0;
+	bdi->wb_background = bdi->wb_kupdate = 0;
+	bdi->wb_spawned = 0;
+
+	bdi->ra_adaptive = 1;
+	bdi->ra_max_pages = 0;
+	bdi->read_bw = 0;
+	bdi->ra_stamp = jiffies;
+	bdi->ra_sectors = bdi->ra_ticks = 0;
+	bdi->ra_hit = bdi->ra_wasted = 0;
+
 	bdi->min_ratio = 0;
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = PROP_FRAC_BASE;
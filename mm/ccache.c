@@ -0,0 +1,479 @@
+/*
+ *  linux/mm/ccache.c
+ *
+ *  Compressed cache for clean page-cache pages
+ *
+ *  When vmscan drops a clean, uptodate page of a regular file on a block
+ *  device, the page is LZO-compressed and kept in a pool bounded to a
+ *  percentage of RAM, keyed by (mapping, index).  When the page is needed
+ *  again, the filesystem's readpage path asks here before building a bio
+ *  and gets the page back without touching the device.
+ *
+ *  Entries are exclusive: a hit removes the entry, and a page leaving the
+ *  page cache by any path other than reclaim (truncation, invalidation,
+ *  drop_caches) takes its entry with it, so a stale copy can never be
+ *  handed out after the file has changed.  Reclaim replaces the entry with
+ *  the contents of the page being dropped.  When the pool is over its
+ *  limit, or a shrinker asks for memory back, the least recently stored
+ *  entries are discarded.
+ *
+ *  Hit rate, compression ratio and pool size are in /proc/vmstat.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ccache.h>
+#include <linux/highmem.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/radix-tree.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+
+/* Pages that do not shrink to this size are not worth keeping */
+#define CCACHE_MAX_LEN		(PAGE_SIZE * 3 / 4)
+
+/* Entries freed per lock hold when flushing a range */
+#define CCACHE_FLUSH_BATCH	16
+
+/*
+ * Stores happen from reclaim, usually with PF_MEMALLOC set: never dip into
+ * the emergency reserves for what is only a cache.
+ */
+#define CCACHE_GFP		(GFP_NOWAIT | __GFP_NOMEMALLOC | __GFP_NOWARN)
+
+struct ccache_mapping {
+	struct rb_node		node;
+	struct address_space	*mapping;
+	struct radix_tree_root	tree;
+	unsigned long		nr;
+};
+
+struct ccache_entry {
+	struct list_head	lru;
+	struct ccache_mapping	*cm;
+	pgoff_t			index;
+	unsigned int		len;
+	unsigned char		data[0];
+};
+
+static int ccache_enabled = 1;
+module_param_named(enabled, ccache_enabled, bool, 0644);
+MODULE_PARM_DESC(enabled, "Store pages dropped by reclaim");
+
+static unsigned int ccache_max_percent = 10;
+module_param_named(max_percent, ccache_max_percent, uint, 0644);
+MODULE_PARM_DESC(max_percent, "Pool limit as a percentage of RAM");
+
+/*
+ * ccache_lock nests inside mapping->tree_lock (see __remove_from_page_cache)
+ * and the tree_lock is taken from interrupt context on writeback completion,
+ * so it is always taken with interrupts disabled.
+ */
+static DEFINE_SPINLOCK(ccache_lock);
+static struct rb_root ccache_mappings = RB_ROOT;
+static LIST_HEAD(ccache_lru);
+static unsigned long ccache_nr_pages;
+static unsigned long ccache_pool_bytes;
+static unsigned long ccache_compr_bytes;
+
+static struct kmem_cache *ccache_mapping_cachep;
+static DEFINE_PER_CPU(void *, ccache_workmem);
+static DEFINE_PER_CPU(unsigned char *, ccache_buffer);
+static int ccache_ready;
+
+/*
+ * Only regular files on a block device: their contents can change only
+ * through the page cache, direct I/O and truncation, all of which flush.
+ */
+static inline int ccache_mapping_ok(struct address_space *mapping)
+{
+	struct inode *host = mapping->host;
+
+	return host && host->i_sb->s_bdev && S_ISREG(host->i_mode);
+}
+
+static unsigned long ccache_limit(void)
+{
+	return (totalram_pages / 100 * ccache_max_percent) << PAGE_SHIFT;
+}
+
+static struct ccache_mapping *ccache_lookup_mapping(
+		struct address_space *mapping, int create)
+{
+	struct rb_node **p = &ccache_mappings.rb_node;
+	struct rb_node *parent = NULL;
+	struct ccache_mapping *cm;
+
+	while (*p) {
+		parent = *p;
+		cm = rb_entry(parent, struct ccache_mapping, node);
+		if (mapping < cm->mapping)
+			p = &parent->rb_left;
+		else if (mapping > cm->mapping)
+			p = &parent->rb_right;
+		else
+			return cm;
+	}
+
+	if (!create)
+		return NULL;
+
+	cm = kmem_cache_alloc(ccache_mapping_cachep, CCACHE_GFP);
+	if (!cm)
+		return NULL;
+	cm->mapping = mapping;
+	INIT_RADIX_TREE(&cm->tree, CCACHE_GFP);
+	cm->nr = 0;
+	rb_link_node(&cm->node, parent, p);
+	rb_insert_color(&cm->node, &ccache_mappings);
+	return cm;
+}
+
+static void ccache_put_mapping(struct ccache_mapping *cm)
+{
+	if (cm->nr)
+		return;
+	rb_erase(&cm->node, &ccache_mappings);
+	kmem_cache_free(ccache_mapping_cachep, cm);
+}
+
+static void ccache_account(struct ccache_entry *e, int sign)
+{
+	ccache_nr_pages += sign;
+	ccache_pool_bytes += sign * (long)ksize(e);
+	ccache_compr_bytes += sign * (long)e->len;
+}
+
+/* Unhook @e from its mapping and the LRU; caller frees it unlocked */
+static void ccache_remove(struct ccache_entry *e)
+{
+	struct ccache_mapping *cm = e->cm;
+
+	radix_tree_delete(&cm->tree, e->index);
+	list_del(&e->lru);
+	ccache_account(e, -1);
+	cm->nr--;
+	ccache_put_mapping(cm);
+}
+
+/* Move the least recently stored entry to @victims */
+static void ccache_evict_oldest(struct list_head *victims)
+{
+	struct ccache_entry *e;
+
+	e = list_entry(ccache_lru.prev, struct ccache_entry, lru);
+	ccache_remove(e);
+	list_add(&e->lru, victims);
+}
+
+static void ccache_shrink(struct list_head *victims)
+{
+	unsigned long limit = ccache_limit();
+	unsigned long nr = 0;
+
+	while (ccache_pool_bytes > limit && !list_empty(&ccache_lru)) {
+		ccache_evict_oldest(victims);
+		nr++;
+	}
+	if (nr)
+		count_vm_events(CCACHE_EVICT, nr);
+}
+
+static void ccache_free_list(struct list_head *list)
+{
+	struct ccache_entry *e, *next;
+
+	list_for_each_entry_safe(e, next, list, lru)
+		kfree(e);
+}
+
+/*
+ * The pool limit only caps the pool; under memory pressure it also gives
+ * back its oldest entries like the other caches do.
+ */
+static int ccache_shrink_memory(int nr_to_scan, gfp_t gfp_mask)
+{
+	LIST_HEAD(victims);
+	unsigned long flags;
+	int nr = 0;
+
+	if (nr_to_scan) {
+		spin_lock_irqsave(&ccache_lock, flags);
+		while (nr < nr_to_scan && !list_empty(&ccache_lru)) {
+			ccache_evict_oldest(&victims);
+			nr++;
+		}
+		spin_unlock_irqrestore(&ccache_lock, flags);
+		ccache_free_list(&victims);
+		if (nr)
+			count_vm_events(CCACHE_EVICT, nr);
+	}
+	return min_t(unsigned long, ccache_nr_pages, INT_MAX);
+}
+
+static struct shrinker ccache_shrinker = {
+	.shrink = ccache_shrink_memory,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int ccache_insert(struct address_space *mapping, struct ccache_entry *e)
+{
+	struct ccache_mapping *cm;
+	struct ccache_entry *old;
+	LIST_HEAD(victims);
+	unsigned long flags;
+	void **slot;
+	int ret = 0;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	cm = ccache_lookup_mapping(mapping, 1);
+	if (!cm) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	slot = radix_tree_lookup_slot(&cm->tree, e->index);
+	if (slot) {
+		old = radix_tree_deref_slot(slot);
+		radix_tree_replace_slot(slot, e);
+		list_move(&old->lru, &victims);
+		ccache_account(old, -1);
+	} else {
+		ret = radix_tree_insert(&cm->tree, e->index, e);
+		if (ret) {
+			ccache_put_mapping(cm);
+			goto out;
+		}
+		cm->nr++;
+	}
+
+	e->cm = cm;
+	list_add(&e->lru, &ccache_lru);
+	ccache_account(e, 1);
+	ccache_shrink(&victims);
+out:
+	spin_unlock_irqrestore(&ccache_lock, flags);
+	ccache_free_list(&victims);
+	return ret;
+}
+
+/**
+ * ccache_put_page - keep a compressed copy of a page dropped by reclaim
+ * @mapping: mapping the page has just been removed from
+ * @page:    the page, still locked and with its contents intact
+ *
+ * Called by vmscan right after __remove_from_page_cache(), with the
+ * mapping's tree_lock still held.  The page can no longer be dirtied,
+ * a truncation walking the range flushes it again once the walk is done,
+ * and the inode cannot reach clear_inode() before the entry is in place,
+ * so no store can slip in after the last flush.
+ *
+ * Best effort: pages that do not compress well, or that would need
+ * memory the allocator cannot give without waiting, are simply not
+ * stored.
+ */
+void ccache_put_page(struct address_space *mapping, struct page *page)
+{
+	struct ccache_entry *e = NULL;
+	unsigned char *buf;
+	size_t len;
+	void *src;
+	int ret;
+
+	if (!ccache_enabled || !ccache_ready || !PageUptodate(page) ||
+	    !ccache_mapping_ok(mapping))
+		return;
+
+	buf = get_cpu_var(ccache_buffer);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, buf, &len,
+			       __get_cpu_var(ccache_workmem));
+	kunmap_atomic(src, KM_USER0);
+
+	if (ret == LZO_E_OK && len <= CCACHE_MAX_LEN) {
+		e = kmalloc(sizeof(*e) + len, CCACHE_GFP);
+		if (e) {
+			memcpy(e->data, buf, len);
+			e->len = len;
+			e->index = page->index;
+		}
+	}
+	put_cpu_var(ccache_buffer);
+
+	if (!e || ccache_insert(mapping, e)) {
+		kfree(e);
+		count_vm_event(CCACHE_REJECT);
+		return;
+	}
+	count_vm_event(CCACHE_STORE);
+}
+
+/**
+ * ccache_get_page - fill a page from the compressed cache
+ * @page: locked, !uptodate page-cache page about to be read
+ *
+ * Returns 0 if the page has been filled, in which case the caller marks it
+ * uptodate and skips the I/O, or a negative errno if it must be read from
+ * the device as usual.
+ */
+int ccache_get_page(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	struct ccache_entry *e = NULL;
+	struct ccache_mapping *cm;
+	size_t len = PAGE_SIZE;
+	unsigned long flags;
+	void *dst;
+	int ret;
+
+	VM_BUG_ON(!PageLocked(page));
+
+	if (!ccache_mapping_ok(mapping))
+		return -ENOENT;
+
+	if (ccache_nr_pages) {
+		spin_lock_irqsave(&ccache_lock, flags);
+		cm = ccache_lookup_mapping(mapping, 0);
+		if (cm) {
+			e = radix_tree_lookup(&cm->tree, page->index);
+			if (e)
+				ccache_remove(e);
+		}
+		spin_unlock_irqrestore(&ccache_lock, flags);
+	}
+
+	if (!e) {
+		count_vm_event(CCACHE_MISS);
+		return -ENOENT;
+	}
+
+	/* we compressed this page ourselves, skip the input checks */
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_unsafe(e->data, e->len, dst, &len);
+	kunmap_atomic(dst, KM_USER0);
+	kfree(e);
+
+	if (unlikely(ret != LZO_E_OK || len != PAGE_SIZE)) {
+		printk(KERN_ERR "ccache: page %lu of inode %lu failed to "
+		       "decompress (%d)\n", page->index, mapping->host->i_ino,
+		       ret);
+		count_vm_event(CCACHE_MISS);
+		return -EIO;
+	}
+
+	flush_dcache_page(page);
+	count_vm_event(CCACHE_HIT);
+	return 0;
+}
+
+/**
+ * ccache_flush_range - drop the entries of a range of a mapping
+ * @mapping: the mapping
+ * @start:   first page index
+ * @end:     last page index, inclusive
+ *
+ * May be called with the mapping's tree_lock held.
+ */
+void ccache_flush_range(struct address_space *mapping, pgoff_t start,
+			pgoff_t end)
+{
+	struct ccache_entry *batch[CCACHE_FLUSH_BATCH];
+	struct ccache_mapping *cm;
+	LIST_HEAD(victims);
+	unsigned long flags;
+	unsigned int i, nr;
+
+	if (!ccache_nr_pages || !ccache_mapping_ok(mapping))
+		return;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	while (start <= end) {
+		cm = ccache_lookup_mapping(mapping, 0);
+		if (!cm)
+			break;
+		nr = radix_tree_gang_lookup(&cm->tree, (void **)batch, start,
+					    CCACHE_FLUSH_BATCH);
+		if (!nr)
+			break;
+		for (i = 0; i < nr && batch[i]->index <= end; i++) {
+			ccache_remove(batch[i]);
+			list_add(&batch[i]->lru, &victims);
+		}
+		if (i < nr)
+			break;
+		start = batch[nr - 1]->index + 1;
+		if (!start)
+			break;
+
+		/* let interrupts in between batches of a large flush */
+		spin_unlock_irqrestore(&ccache_lock, flags);
+		ccache_free_list(&victims);
+		INIT_LIST_HEAD(&victims);
+		spin_lock_irqsave(&ccache_lock, flags);
+	}
+	spin_unlock_irqrestore(&ccache_lock, flags);
+	ccache_free_list(&victims);
+}
+
+void ccache_flush_page(struct address_space *mapping, pgoff_t index)
+{
+	ccache_flush_range(mapping, index, index);
+}
+
+/* Gauges for /proc/vmstat, in enum ccache_stat_item order */
+void ccache_stats(unsigned long *v)
+{
+	unsigned long flags;
+	unsigned long nr, compr;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	nr = ccache_nr_pages;
+	v[CCACHE_POOL_BYTES] = ccache_pool_bytes;
+	compr = ccache_compr_bytes;
+	spin_unlock_irqrestore(&ccache_lock, flags);
+
+	v[CCACHE_NR_PAGES] = nr;
+	v[CCACHE_COMPR_PERCENT] = nr ? (unsigned long)div64_u64(
+			(u64)compr * 100, (u64)nr << PAGE_SHIFT) : 0;
+}
+
+static int __init ccache_init(void)
+{
+	int cpu;
+
+	ccache_mapping_cachep = KMEM_CACHE(ccache_mapping, SLAB_PANIC);
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(ccache_workmem, cpu) = kmalloc(LZO1X_MEM_COMPRESS,
+						       GFP_KERNEL);
+		per_cpu(ccache_buffer, cpu) =
+			kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		if (!per_cpu(ccache_workmem, cpu) ||
+		    !per_cpu(ccache_buffer, cpu))
+			goto nomem;
+	}
+
+	register_shrinker(&ccache_shrinker);
+	ccache_ready = 1;
+	return 0;
+
+nomem:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(ccache_workmem, cpu));
+		kfree(per_cpu(ccache_buffer, cpu));
+	}
+	printk(KERN_ERR "ccache: no memory for compression buffers, "
+	       "disabled\n");
+	return -ENOMEM;
+}
+module_init(ccache_init);
@@ -33,6 +33,7 @@
 #include <linux/cpuset.h>
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
+#include <linux/ccache.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
 #include "internal.h"
 
@@ -117,11 +118,20 @@ void __remove_from_page_cache(struct page *page)
 	struct address_space *mapping = page->mapping;
 
 	radix_tree_delete(&mapping->page_tree, page->index);
+	ccache_flush_page(mapping, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	BUG_ON(page_mapped(page));
 
+	/* read ahead for nothing */
+	if (TestClearPagePrefetched(page)) {
+		__count_vm_event(RA_WASTED);
+		if (mapping->backing_dev_info->ra_adaptive)
+			__inc_bdi_stat(mapping->backing_dev_info,
+				       BDI_RA_WASTED);
+	}
+
 	/*
 	 * Some filesystems seem to re-dirty the page even after
 	 * the VM has canceled the dirty bit (eg ext3 journaling).
@@ -135,6 +145,21 @@ void __remove_from_page_cache(struct page *page)
 	}
 }
 
+/*
+ * First access to a page that readahead brought in.
+ */
+static inline void page_ra_hit(struct address_space *mapping,
+			       struct page *page)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+
+	if (PagePrefetched(page) && TestClearPagePrefetched(page)) {
+		count_vm_event(RA_HIT);
+		if (bdi->ra_adaptive)
+			inc_bdi_stat(bdi, BDI_RA_HIT);
+	}
+}
+
 void remove_from_page_cache(struct page *page)
 {
 	struct address_space *mapping = page->mapping;
@@ -526,6 +551,23 @@ struct page *__page_cache_alloc(gfp_t gfp)
 	return alloc_pages(gfp, 0);
 }
 EXPORT_SYMBOL(__page_cache_alloc);
+
+unsigned long __page_cache_alloc_bulk(gfp_t gfp, unsigned long nr,
+				      struct list_head *list)
+{
+	struct page *page;
+
+	/* Spread pages one at a time, as __page_cache_alloc() does */
+	if (cpuset_do_page_mem_spread()) {
+		page = __page_cache_alloc(gfp);
+		if (!page)
+			return 0;
+		list_add_tail(&page->lru, list);
+		return 1;
+	}
+	return alloc_pages_bulk_list(gfp, nr, list);
+}
+EXPORT_SYMBOL(__page_cache_alloc_bulk);
 #endif
 
 static int __sleep_on_page_lock(void *word)
@@ -1061,6 +1103,7 @@ find_page:
 					ra, filp, page,
 					index, last_index - index);
 		}
+		page_ra_hit(mapping, page);
 		if (!PageUptodate(page)) {
 			if (inode->i_blkbits == PAGE_CACHE_SHIFT ||
 					!mapping->a_ops->is_partially_uptodate)
@@ -1576,6 +1619,7 @@ retry_find:
 		if (!page)
 			goto no_cached_page;
 	}
+	page_ra_hit(mapping, page);
 
 	/*
 	 * We have a locked page in the page cache, now we need to check
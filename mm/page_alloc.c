@@ -48,6 +48,7 @@
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
+#include <linux/migrate.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -706,12 +707,22 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
+#ifdef CONFIG_CMA
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE, MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE, MIGRATE_RESERVE },
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,     MIGRATE_RESERVE, MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE,     MIGRATE_RESERVE,     MIGRATE_RESERVE, MIGRATE_RESERVE }, /* Never used */
+};
+#else
+static int fallbacks[MIGRATE_TYPES][3] = {
 	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
 	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
 	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
 	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
 };
+#endif
 
 /*
  * Move the free pages in a range to the free lists of the requested type.
@@ -795,7 +806,7 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0; i < ARRAY_SIZE(fallbacks[0]); i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
@@ -814,11 +825,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * agressive about taking ownership of free pages
+			 * agressive about taking ownership of free pages.
+			 * CMA pageblocks are lent, never taken over.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -836,7 +849,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			list_del(&page->lru);
 			rmv_page_order(page);
 
-			if (current_order == pageblock_order)
+			if (current_order == pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				set_pageblock_migratetype(page,
 							start_migratetype);
 
@@ -907,7 +921,14 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/*
+		 * Pages borrowed from a CMA pageblock keep that type so that
+		 * a pcp drain gives them back to the CMA free lists.
+		 */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+		else
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1100,6 +1121,17 @@ void split_page(struct page *page, unsigned int order)
 		set_page_refcounted(page + i);
 }
 
+/*
+ * CMA pages on the pcp list can satisfy movable allocations only.
+ */
+static inline int pcp_migratetype_match(struct page *page, int migratetype)
+{
+	int page_mt = page_private(page);
+
+	return page_mt == migratetype ||
+		(is_migrate_cma(page_mt) && migratetype == MIGRATE_MOVABLE);
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1133,11 +1165,11 @@ again:
 		/* Find a page of the appropriate migrate type */
 		if (cold) {
 			list_for_each_entry_reverse(page, &pcp->list, lru)
-				if (page_private(page) == migratetype)
+				if (pcp_migratetype_match(page, migratetype))
 					break;
 		} else {
 			list_for_each_entry(page, &pcp->list, lru)
-				if (page_private(page) == migratetype)
+				if (pcp_migratetype_match(page, migratetype))
 					break;
 		}
 
@@ -1911,6 +1943,123 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/**
+ * __alloc_pages_bulk - allocate a number of order-0 pages at once
+ * @gfp_mask: GFP flags for the allocation
+ * @nr_pages: number of pages wanted
+ * @page_list: list to add the pages to, or NULL
+ * @page_array: array to store the pages in, or NULL
+ *
+ * Takes the pages from the local node's first zone with enough free
+ * memory: first whatever suitable pages are on this cpu's pcp list, then
+ * the rest straight from the buddy lists under a single hold of
+ * zone->lock, instead of the pcp->batch refills a loop of alloc_page()
+ * calls would do.  Pages are added to @page_list through page->lru if it
+ * is given, else stored in @page_array from index 0.
+ *
+ * Fewer pages than asked for may be returned.  When no zone can satisfy
+ * the whole request cheaply, a single page is allocated through the
+ * normal allocator, with reclaim if @gfp_mask allows it, so that callers
+ * looping until they have all their pages still make progress.  NUMA
+ * memory policies are not applied.  Returns the number of pages added.
+ */
+unsigned long __alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+				 struct list_head *page_list,
+				 struct page **page_array)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int cold = !!(gfp_mask & __GFP_COLD);
+	struct zonelist *zonelist;
+	struct zone *preferred_zone, *zone;
+	struct per_cpu_pages *pcp;
+	struct zoneref *z;
+	struct page *page, *next;
+	unsigned long flags, i, nr = 0;
+	LIST_HEAD(pages);
+
+	if (!nr_pages)
+		return 0;
+
+	gfp_mask &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(gfp_mask);
+
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	if (nr_pages == 1 || should_fail_alloc_page(gfp_mask, 0))
+		goto single;
+
+	zonelist = node_zonelist(numa_node_id(), gfp_mask);
+	first_zones_zonelist(zonelist, high_zoneidx, NULL, &preferred_zone);
+	if (!preferred_zone)
+		return 0;
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
+		if (!cpuset_zone_allowed_softwall(zone,
+						  gfp_mask | __GFP_HARDWALL))
+			continue;
+		if (zone_watermark_ok(zone, 0,
+				      low_wmark_pages(zone) + nr_pages,
+				      zone_idx(preferred_zone),
+				      ALLOC_WMARK_LOW | ALLOC_CPUSET))
+			goto found;
+	}
+	goto single;
+
+found:
+	pcp = &zone_pcp(zone, get_cpu())->pcp;
+	local_irq_save(flags);
+
+	/* Use up what the pcp list already holds ... */
+	list_for_each_entry_safe(page, next, &pcp->list, lru) {
+		if (nr == nr_pages)
+			break;
+		if (!pcp_migratetype_match(page, migratetype))
+			continue;
+		list_move_tail(&page->lru, &pages);
+		pcp->count--;
+		nr++;
+	}
+
+	/* ... and take the rest from the buddy lists in one go */
+	if (nr < nr_pages)
+		nr += rmqueue_bulk(zone, 0, nr_pages - nr, pages.prev,
+				   migratetype, cold);
+
+	__count_zone_vm_events(PGALLOC, zone, nr);
+	for (i = 0; i < nr; i++)
+		zone_statistics(preferred_zone, zone);
+	local_irq_restore(flags);
+	put_cpu();
+
+	nr = 0;
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		VM_BUG_ON(bad_range(zone, page));
+		if (prep_new_page(page, 0, gfp_mask))
+			continue;
+		if (page_list)
+			list_add_tail(&page->lru, page_list);
+		else
+			page_array[nr] = page;
+		nr++;
+	}
+	if (nr)
+		return nr;
+
+single:
+	page = alloc_pages(gfp_mask, 0);
+	if (!page)
+		return 0;
+	if (page_list)
+		list_add_tail(&page->lru, page_list);
+	else
+		page_array[0] = page;
+	return 1;
+}
+EXPORT_SYMBOL(__alloc_pages_bulk);
+
 /*
  * Common helper functions.
  */
@@ -4890,7 +5039,8 @@ int set_migratetype_isolate(struct page *page)
 	/*
 	 * In future, more migrate types will be able to be isolation target.
 	 */
-	if (get_pageblock_migratetype(page) != MIGRATE_MOVABLE)
+	if (get_pageblock_migratetype(page) != MIGRATE_MOVABLE &&
+	    !is_migrate_cma(get_pageblock_migratetype(page)))
 		goto out;
 	set_pageblock_migratetype(page, MIGRATE_ISOLATE);
 	move_freepages_block(zone, page, MIGRATE_ISOLATE);
@@ -4902,7 +5052,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -4910,12 +5060,197 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+/*
+ * Hand a pageblock reserved at boot over to the page allocator as
+ * MIGRATE_CMA.  All of its pages must be PageReserved and unused.
+ */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+}
+
+static struct page *
+alloc_contig_migrate_alloc(struct page *page, unsigned long private,
+			   int **resultp)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/* Pages isolated from the LRU per migrate_pages() call */
+#define CONTIG_MIGRATE_BATCH	32
+
+/*
+ * Move everything that is in use in [start, end) somewhere else.  The
+ * range is already isolated, so freed pages stay put and the replacements
+ * come from outside.  Returns 0, or the number of pages that could not be
+ * moved, or a negative error.
+ */
+static int __alloc_contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn = start;
+	int ret = 0;
+	LIST_HEAD(source);
+
+	migrate_prep();
+
+	while (pfn < end && !ret) {
+		int nr = 0;
+
+		if (fatal_signal_pending(current))
+			return -EINTR;
+
+		for (; pfn < end && nr < CONTIG_MIGRATE_BATCH; pfn++) {
+			struct page *page = pfn_to_page(pfn);
+
+			if (PageBuddy(page)) {
+				unsigned long order = page_order(page);
+
+				/* racy, but a bogus order only skips less */
+				if (order < MAX_ORDER)
+					pfn += (1UL << order) - 1;
+				continue;
+			}
+			if (!page_count(page))
+				continue;
+			if (isolate_lru_page(page) == 0) {
+				list_add_tail(&page->lru, &source);
+				nr++;
+			}
+		}
+
+		if (!list_empty(&source))
+			ret = migrate_pages(&source,
+					    alloc_contig_migrate_alloc, 0);
+	}
+
+	return ret;
+}
+
+/*
+ * Take the free pages covering [start, end) off the buddy lists as order-0
+ * pages with a reference each.  A free block straddling either end is taken
+ * whole; *outer_start and the return value give the span actually taken.
+ * Returns 0 if anything in the range is still in use.  Call with zone->lock.
+ */
+static unsigned long
+__take_free_range(struct zone *zone, unsigned long start, unsigned long end,
+		  unsigned long *outer_start)
+{
+	unsigned long pfn = start;
+	unsigned int order;
+	struct page *page;
+	int i;
+
+	/* start may lie inside a larger free block */
+	for (order = 0; order < MAX_ORDER; order++) {
+		unsigned long head = start & ~((1UL << order) - 1);
+
+		page = pfn_to_page(head);
+		if (PageBuddy(page) && page_order(page) >= order) {
+			pfn = head;
+			break;
+		}
+	}
+	*outer_start = pfn;
+
+	for (; pfn < end; pfn += 1UL << page_order(page)) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			return 0;
+	}
+
+	for (pfn = *outer_start; pfn < end; pfn += 1UL << order) {
+		page = pfn_to_page(pfn);
+		order = page_order(page);
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+		for (i = 0; i < (1 << order); i++)
+			set_page_refcounted(page + i);
+	}
+
+	return pfn;
+}
+
+/**
+ * alloc_contig_range() -- allocate the pages in [start, end)
+ * @start:	first pfn to allocate
+ * @end:	one past the last pfn to allocate
+ *
+ * The range must lie within MIGRATE_CMA pageblocks of a single zone.  Pages
+ * in use are migrated away first, so this may sleep for a long time.  Each
+ * page comes back with a reference, to be dropped by free_contig_range().
+ * Callers must serialise allocations that touch the same pageblock.
+ *
+ * Returns 0 on success, -EBUSY if pages in the range could not be moved.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	unsigned long iso_start = start & ~(pageblock_nr_pages - 1);
+	unsigned long iso_end = ALIGN(end, pageblock_nr_pages);
+	unsigned long outer_start = start, outer_end = 0, pfn, flags;
+	struct zone *zone = page_zone(pfn_to_page(start));
+	int tries, ret;
+
+	ret = start_isolate_page_range(iso_start, iso_end, MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	for (tries = 0; tries < 5; tries++) {
+		ret = __alloc_contig_migrate_range(start, end);
+		if (ret == -EINTR)
+			break;
+
+		/* pages freed by migration may still sit on pcp lists */
+		drain_all_pages();
+
+		spin_lock_irqsave(&zone->lock, flags);
+		outer_end = __take_free_range(zone, start, end, &outer_start);
+		spin_unlock_irqrestore(&zone->lock, flags);
+		if (outer_end)
+			break;
+		ret = -EBUSY;
+	}
+
+	undo_isolate_page_range(iso_start, iso_end, MIGRATE_CMA);
+	if (!outer_end)
+		return ret;
+
+	/* give back whatever was taken beyond the requested range */
+	for (pfn = outer_start; pfn < start; pfn++)
+		__free_page(pfn_to_page(pfn));
+	for (pfn = end; pfn < outer_end; pfn++)
+		__free_page(pfn_to_page(pfn));
+
+	return 0;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif /* CONFIG_CMA */
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
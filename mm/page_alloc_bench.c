@@ -0,0 +1,118 @@
+/*
+ *  linux/mm/page_alloc_bench.c
+ *
+ *  Page allocator single versus bulk benchmark
+ *
+ *  Allocates the pages of a readahead window (1MB by default), first with
+ *  one alloc_page() call per page and then with alloc_pages_bulk_list(),
+ *  the way __do_page_cache_readahead() does, and reports the time taken
+ *  for the window and per page.  Only the allocation is timed; the pages
+ *  are freed outside the measured section.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+static unsigned int window_kb = 1024;
+module_param(window_kb, uint, 0444);
+MODULE_PARM_DESC(window_kb, "Readahead window size in KiB");
+
+static unsigned int rounds = 200;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Windows allocated per measurement");
+
+static u64 bench_single(unsigned long nr)
+{
+	LIST_HEAD(pages);
+	u64 ns = 0;
+	unsigned int n;
+
+	for (n = 0; n < rounds; n++) {
+		struct page *page;
+		unsigned long i;
+		ktime_t t0;
+
+		t0 = ktime_get();
+		for (i = 0; i < nr; i++) {
+			page = alloc_page(GFP_HIGHUSER_MOVABLE | __GFP_COLD);
+			if (!page)
+				break;
+			list_add(&page->lru, &pages);
+		}
+		ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+		put_pages_list(&pages);
+		cond_resched();
+	}
+	return ns;
+}
+
+static u64 bench_bulk(unsigned long nr)
+{
+	LIST_HEAD(pages);
+	u64 ns = 0;
+	unsigned int n;
+
+	for (n = 0; n < rounds; n++) {
+		unsigned long got = 0, ret;
+		ktime_t t0;
+
+		t0 = ktime_get();
+		while (got < nr) {
+			ret = alloc_pages_bulk_list(GFP_HIGHUSER_MOVABLE |
+						    __GFP_COLD, nr - got,
+						    &pages);
+			if (!ret)
+				break;
+			got += ret;
+		}
+		ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+		put_pages_list(&pages);
+		cond_resched();
+	}
+	return ns;
+}
+
+static int __init page_alloc_bench_init(void)
+{
+	unsigned long nr = (window_kb << 10) >> PAGE_SHIFT;
+	u64 single, bulk;
+
+	if (!nr || !rounds)
+		return -EINVAL;
+
+	/* Warm up the pcp lists and the zone's free lists */
+	bench_single(nr);
+
+	single = bench_single(nr);
+	bulk = bench_bulk(nr);
+
+	printk(KERN_INFO "page_alloc_bench: %u KiB window (%lu pages): "
+	       "alloc_page %llu us, bulk %llu us per window; "
+	       "%llu / %llu ns per page\n", window_kb, nr,
+	       div64_u64(single, (u64)rounds * 1000),
+	       div64_u64(bulk, (u64)rounds * 1000),
+	       div64_u64(single, (u64)rounds * nr),
+	       div64_u64(bulk, (u64)rounds * nr));
+	return 0;
+}
+
+static void __exit page_alloc_bench_exit(void)
+{
+}
+
+module_init(page_alloc_bench_init);
+module_exit(page_alloc_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Page allocator single versus bulk benchmark");
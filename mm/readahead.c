@@ -16,6 +16,12 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/genhd.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/readahead.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -108,9 +114,12 @@ EXPORT_SYMBOL(read_cache_pages);
 static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
+	struct blk_plug plug;
 	unsigned page_idx;
 	int ret;
 
+	blk_start_plug(&plug);
+
 	if (mapping->a_ops->readpages) {
 		ret = mapping->a_ops->readpages(filp, mapping, pages, nr_pages);
 		/* Clean up the remaining pages */
@@ -129,6 +138,8 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 	}
 	ret = 0;
 out:
+	blk_finish_plug(&plug);
+
 	return ret;
 }
 
@@ -149,6 +160,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	struct page *page;
 	unsigned long end_index;	/* The last page we want to read */
 	LIST_HEAD(page_pool);
+	LIST_HEAD(spare);		/* Allocated, not yet used */
 	int page_idx;
 	int ret = 0;
 	loff_t isize = i_size_read(inode);
@@ -159,7 +171,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	end_index = ((isize - 1) >> PAGE_CACHE_SHIFT);
 
 	/*
-	 * Preallocate as many pages as we will need.
+	 * Preallocate as many pages as we will need.  They are taken from
+	 * the page allocator in bulk, enough for the rest of the window at
+	 * a time; any left over because the pages turned out to be cached
+	 * already are given back at the end.
 	 */
 	for (page_idx = 0; page_idx < nr_to_read; page_idx++) {
 		pgoff_t page_offset = offset + page_idx;
@@ -173,10 +188,15 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (page)
 			continue;
 
-		page = page_cache_alloc_cold(mapping);
-		if (!page)
+		if (list_empty(&spare) &&
+		    !page_cache_alloc_cold_bulk(mapping,
+				min_t(unsigned long, nr_to_read - page_idx,
+				      end_index - page_offset + 1), &spare))
 			break;
+		page = list_first_entry(&spare, struct page, lru);
+		list_del(&page->lru);
 		page->index = page_offset;
+		__SetPagePrefetched(page);
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
@@ -188,6 +208,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
+	put_pages_list(&spare);
 	if (ret)
 		read_pages(mapping, filp, &page_pool, ret);
 	BUG_ON(!list_empty(&page_pool));
@@ -329,6 +350,151 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * it approaches max_readhead.
  */
 
+/*
+ * Readahead windows remembered per inode, so that a stream keeps its
+ * window across close and reopen, and a descriptor picking up where
+ * another one stopped continues the stream instead of ramping up from
+ * scratch.  A small hashed table rather than a field in every inode:
+ * losing a stream to a collision only costs a ramp-up.
+ */
+#define RA_STREAM_BITS		6
+#define RA_STREAM_EXPIRE	(30 * HZ)
+
+struct ra_stream {
+	struct address_space	*mapping;
+	pgoff_t			start;
+	unsigned int		size;
+	unsigned int		async_size;
+	unsigned long		stamp;
+};
+
+static struct ra_stream ra_streams[1 << RA_STREAM_BITS];
+static DEFINE_SPINLOCK(ra_stream_lock);
+
+static void ra_stream_save(struct address_space *mapping,
+			   struct file_ra_state *ra)
+{
+	struct ra_stream *s = &ra_streams[hash_ptr(mapping, RA_STREAM_BITS)];
+
+	spin_lock(&ra_stream_lock);
+	s->mapping = mapping;
+	s->start = ra->start;
+	s->size = ra->size;
+	s->async_size = ra->async_size;
+	s->stamp = jiffies;
+	spin_unlock(&ra_stream_lock);
+}
+
+/*
+ * Is @offset where the last stream seen on @mapping expects its next
+ * readahead?  If so, load that stream's window into @ra.
+ */
+static int ra_stream_resume(struct address_space *mapping,
+			    struct file_ra_state *ra, pgoff_t offset)
+{
+	struct ra_stream *s = &ra_streams[hash_ptr(mapping, RA_STREAM_BITS)];
+	int ret = 0;
+
+	spin_lock(&ra_stream_lock);
+	if (s->mapping == mapping && s->size &&
+	    time_before(jiffies, s->stamp + RA_STREAM_EXPIRE) &&
+	    (offset == s->start + s->size - s->async_size ||
+	     offset == s->start + s->size)) {
+		ra->start = s->start;
+		ra->size = s->size;
+		ra->async_size = s->async_size;
+		ret = 1;
+	}
+	spin_unlock(&ra_stream_lock);
+
+	return ret;
+}
+
+/*
+ * Adaptive per-device maximum.  Once a second, the read bandwidth the
+ * disk delivered while busy is measured and the window is sized so that
+ * one readahead takes about RA_TARGET_MSECS of device time: slow cards
+ * get small windows, fast ones larger windows than the static default.
+ * The result is scaled down by the share of read-ahead pages that were
+ * dropped without ever being accessed.
+ */
+#define RA_ADAPT_INTERVAL	HZ
+#define RA_TARGET_MSECS		50
+#define RA_ADAPT_MIN_PAGES	(32 * 1024 / PAGE_CACHE_SIZE)
+#define RA_ADAPT_MAX_PAGES	(2048 * 1024 / PAGE_CACHE_SIZE)
+#define RA_ADAPT_MIN_SAMPLES	64	/* pages before waste counts */
+
+static void ra_adapt(struct backing_dev_info *bdi,
+		     struct address_space *mapping)
+{
+	struct block_device *bdev = mapping->host->i_sb->s_bdev;
+	unsigned long sectors, ticks, hit, wasted;
+	unsigned long d_sectors, d_ticks, d_hit, d_wasted;
+	unsigned long now = jiffies;
+	u64 target;
+
+	if (!bdev || !bdev->bd_disk ||
+	    time_before(now, bdi->ra_stamp + RA_ADAPT_INTERVAL))
+		return;
+	/* racing updaters only cost a duplicate sample */
+	bdi->ra_stamp = now;
+
+	sectors = part_stat_read(&bdev->bd_disk->part0, sectors[READ]);
+	ticks = part_stat_read(&bdev->bd_disk->part0, io_ticks);
+	hit = bdi_stat(bdi, BDI_RA_HIT);
+	wasted = bdi_stat(bdi, BDI_RA_WASTED);
+
+	d_sectors = sectors - bdi->ra_sectors;
+	d_ticks = ticks - bdi->ra_ticks;
+	d_hit = hit - bdi->ra_hit;
+	d_wasted = wasted - bdi->ra_wasted;
+	bdi->ra_sectors = sectors;
+	bdi->ra_ticks = ticks;
+	bdi->ra_hit = hit;
+	bdi->ra_wasted = wasted;
+
+	if (d_ticks >= HZ / 20 && d_sectors) {
+		unsigned long bw = div_u64((u64)d_sectors * HZ, d_ticks * 2);
+
+		bdi->read_bw = bdi->read_bw ? (3 * bdi->read_bw + bw) / 4 : bw;
+	}
+	if (!bdi->read_bw)
+		return;
+
+	target = ((u64)bdi->read_bw * RA_TARGET_MSECS / MSEC_PER_SEC) >>
+			(PAGE_CACHE_SHIFT - 10);
+	if (d_hit + d_wasted >= RA_ADAPT_MIN_SAMPLES)
+		target = div_u64(target * d_hit, d_hit + d_wasted);
+	target = clamp_t(u64, target, RA_ADAPT_MIN_PAGES, RA_ADAPT_MAX_PAGES);
+
+	if (target != bdi->ra_max_pages) {
+		bdi->ra_max_pages = target;
+		trace_readahead_adapt(bdi, d_hit, d_wasted);
+	}
+}
+
+/*
+ * The window limit for @ra: its ra_pages, rescaled by the device's
+ * adapted maximum when there is one.  ra_pages can differ from the
+ * device's (fadvise doubles it for sequential files), so the ratio
+ * between the two is kept.
+ */
+static unsigned long ra_max_pages(struct address_space *mapping,
+				  struct file_ra_state *ra)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+	unsigned long max = ra->ra_pages;
+
+	if (bdi->ra_adaptive) {
+		ra_adapt(bdi, mapping);
+		if (bdi->ra_max_pages && bdi->ra_pages)
+			max = div_u64((u64)max * bdi->ra_max_pages,
+				      bdi->ra_pages);
+	}
+
+	return max_sane_readahead(max);
+}
+
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
  * this count is a conservative estimation of
@@ -391,7 +557,8 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = ra_max_pages(mapping, ra);
+	const char *pattern = "initial";
 
 	/*
 	 * start of file
@@ -408,6 +575,19 @@ ondemand_readahead(struct address_space *mapping,
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
+		pattern = "sequential";
+		goto readit;
+	}
+
+	/*
+	 * The file was being read sequentially up to here, through another
+	 * descriptor or an earlier open: carry on with that stream's window.
+	 */
+	if (ra_stream_resume(mapping, ra, offset)) {
+		ra->start += ra->size;
+		ra->size = get_next_ra_size(ra, max);
+		ra->async_size = ra->size;
+		pattern = "stream";
 		goto readit;
 	}
 
@@ -432,6 +612,7 @@ ondemand_readahead(struct address_space *mapping,
 		ra->size += req_size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
+		pattern = "marker";
 		goto readit;
 	}
 
@@ -451,13 +632,17 @@ ondemand_readahead(struct address_space *mapping,
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (try_context_readahead(mapping, ra, offset, req_size, max)) {
+		pattern = "context";
 		goto readit;
+	}
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
+	trace_readahead(mapping, offset, req_size, offset, req_size, 0,
+			"random");
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
@@ -476,6 +661,9 @@ readit:
 		ra->size += ra->async_size;
 	}
 
+	ra_stream_save(mapping, ra);
+	trace_readahead(mapping, offset, req_size, ra->start, ra->size,
+			ra->async_size, pattern);
 	return ra_submit(ra, mapping, filp);
 }
 
@@ -501,6 +689,8 @@ void page_cache_sync_readahead(struct address_space *mapping,
 	if (!ra->ra_pages)
 		return;
 
+	count_vm_event(RA_MISS);
+
 	/* do read-ahead */
 	ondemand_readahead(mapping, ra, filp, false, offset, req_size);
 }
@@ -1482,6 +1482,26 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+static void __slab_free(struct kmem_cache *s, struct page *page,
+			void *x, unsigned long addr, unsigned int offset);
+
+/*
+ * Give the @count oldest objects in the magazine back to their slabs.
+ * Interrupts must be disabled.
+ */
+static void flush_magazine(struct kmem_cache *s, struct kmem_cache_cpu *c,
+			   unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		__slab_free(s, virt_to_head_page(c->mag[i]), c->mag[i],
+			    _RET_IP_, c->offset);
+
+	c->mag_count -= count;
+	memmove(c->mag, c->mag + count, c->mag_count * sizeof(void *));
+}
+
 /*
  * Flush cpu slab.
  *
@@ -1491,7 +1511,12 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
 
-	if (likely(c && c->page))
+	if (unlikely(!c))
+		return;
+
+	if (c->mag_count)
+		flush_magazine(s, c, c->mag_count);
+	if (likely(c->page))
 		flush_slab(s, c);
 }
 
@@ -1520,6 +1545,19 @@ static inline int node_match(struct kmem_cache_cpu *c, int node)
 	return 1;
 }
 
+/*
+ * Magazine objects may come from any node, so only hand them out to
+ * callers without a node preference.
+ */
+static inline int mag_match(int node)
+{
+#ifdef CONFIG_NUMA
+	return node == -1;
+#else
+	return 1;
+#endif
+}
+
 static int count_free(struct page *page)
 {
 	return page->objects - page->inuse;
@@ -1702,7 +1740,10 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	local_irq_save(flags);
 	c = get_cpu_slab(s, smp_processor_id());
 	objsize = c->objsize;
-	if (unlikely(!c->freelist || !node_match(c, node)))
+	if (c->mag_count && mag_match(node)) {
+		object = c->mag[--c->mag_count];
+		stat(c, ALLOC_MAGAZINE);
+	} else if (unlikely(!c->freelist || !node_match(c, node)))
 
 		object = __slab_alloc(s, gfpflags, node, addr, c);
 
@@ -1830,6 +1871,30 @@ debug:
 	goto checks_ok;
 }
 
+/*
+ * Free to the cpu slab if the object belongs to it, else park it in the
+ * magazine, and only take the slab lock when neither is possible.
+ * Interrupts must be disabled.
+ */
+static __always_inline void __slab_free_local(struct kmem_cache *s,
+			struct kmem_cache_cpu *c, struct page *page,
+			void **object, unsigned long addr)
+{
+	if (likely(page == c->page && c->node >= 0)) {
+		object[c->offset] = c->freelist;
+		c->freelist = object;
+		stat(c, FREE_FASTPATH);
+	} else if (c->mag_size && !(SLABDEBUG && PageSlubDebug(page))) {
+		if (unlikely(c->mag_count == c->mag_size)) {
+			stat(c, MAGAZINE_FLUSH);
+			flush_magazine(s, c, (c->mag_size + 1) / 2);
+		}
+		c->mag[c->mag_count++] = object;
+		stat(c, FREE_MAGAZINE);
+	} else
+		__slab_free(s, page, object, addr, c->offset);
+}
+
 /*
  * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
  * can perform fastpath freeing without additional function calls.
@@ -1855,13 +1920,7 @@ static __always_inline void slab_free(struct kmem_cache *s,
 	debug_check_no_locks_freed(object, c->objsize);
 	if (!(s->flags & SLAB_DEBUG_OBJECTS))
 		debug_check_no_obj_freed(object, c->objsize);
-	if (likely(page == c->page && c->node >= 0)) {
-		object[c->offset] = c->freelist;
-		c->freelist = object;
-		stat(c, FREE_FASTPATH);
-	} else
-		__slab_free(s, page, x, addr, c->offset);
-
+	__slab_free_local(s, c, page, object, addr);
 	local_irq_restore(flags);
 }
 
@@ -1877,6 +1936,115 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_alloc_bulk - allocate several objects from a cache
+ * @s: the cache
+ * @flags: allocation flags, as for kmem_cache_alloc()
+ * @nr: number of objects
+ * @p: array receiving the objects
+ *
+ * Fills @p with @nr objects taking interrupts off only once for the lot.
+ * Returns @nr, or 0 if the objects could not all be allocated, in which
+ * case none are.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t nr,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	unsigned int objsize;
+	size_t i;
+
+	flags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(flags);
+	might_sleep_if(flags & __GFP_WAIT);
+
+	if (should_failslab(s->objsize, flags))
+		return 0;
+
+	local_irq_save(irqflags);
+	c = get_cpu_slab(s, smp_processor_id());
+	objsize = c->objsize;
+	for (i = 0; i < nr; i++) {
+		void **object;
+
+		if (c->mag_count) {
+			object = c->mag[--c->mag_count];
+			stat(c, ALLOC_MAGAZINE);
+		} else if (likely(c->freelist)) {
+			object = c->freelist;
+			c->freelist = object[c->offset];
+			stat(c, ALLOC_FASTPATH);
+		} else {
+			object = __slab_alloc(s, flags, -1, _RET_IP_, c);
+			/* We may have been rescheduled to another cpu */
+			c = get_cpu_slab(s, smp_processor_id());
+			if (unlikely(!object))
+				goto fail;
+		}
+		p[i] = object;
+	}
+	local_irq_restore(irqflags);
+
+	for (i = 0; i < nr; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, objsize);
+		kmemcheck_slab_alloc(s, flags, p[i], objsize);
+		kmemleak_alloc_recursive(p[i], objsize, 1, s->flags, flags);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->objsize, s->size,
+				       flags);
+	}
+
+	return nr;
+
+fail:
+	/*
+	 * Nothing has been reported to kmemleak or kmemcheck yet, so give
+	 * the objects back without going through the slab_free() hooks.
+	 */
+	while (i--)
+		__slab_free_local(s, c, virt_to_head_page(p[i]), p[i],
+				  _RET_IP_);
+	local_irq_restore(irqflags);
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
+/**
+ * kmem_cache_free_bulk - free several objects to a cache
+ * @s: the cache
+ * @nr: number of objects
+ * @p: the objects
+ *
+ * Frees @nr objects from @s taking interrupts off only once for the lot.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t nr, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		kmemleak_free_recursive(p[i], s->flags);
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	for (i = 0; i < nr; i++) {
+		void **object = p[i];
+		struct page *page = virt_to_head_page(object);
+
+		kmemcheck_slab_free(s, object, c->objsize);
+		debug_check_no_locks_freed(object, c->objsize);
+		if (!(s->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(object, c->objsize);
+		__slab_free_local(s, c, page, object, _RET_IP_);
+		trace_kmem_cache_free(_RET_IP_, object);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /* Figure out on which slab page the object resides */
 static struct page *get_object_page(const void *x)
 {
@@ -2055,6 +2223,17 @@ static void init_kmem_cache_cpu(struct kmem_cache *s,
 	c->node = 0;
 	c->offset = s->offset / sizeof(void *);
 	c->objsize = s->objsize;
+	c->mag_count = 0;
+	/*
+	 * Keep the magazine within about a page worth of objects, and leave
+	 * it off for caches that are being debugged so that every free goes
+	 * through the checks.
+	 */
+	if (s->flags & (DEBUG_DEFAULT_FLAGS | SLAB_TRACE))
+		c->mag_size = 0;
+	else
+		c->mag_size = clamp_t(unsigned int, PAGE_SIZE / s->size,
+				      0, SLUB_MAG_SIZE);
 #ifdef CONFIG_SLUB_STATS
 	memset(c->stat, 0, NR_SLUB_STAT_ITEMS * sizeof(unsigned));
 #endif
@@ -4340,6 +4519,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(ALLOC_MAGAZINE, alloc_magazine);
+STAT_ATTR(FREE_MAGAZINE, free_magazine);
+STAT_ATTR(MAGAZINE_FLUSH, magazine_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4394,6 +4576,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&alloc_magazine_attr.attr,
+	&free_magazine_attr.attr,
+	&magazine_flush_attr.attr,
 #endif
 	NULL
 };
@@ -0,0 +1,154 @@
+/*
+ *  linux/mm/slub_bench.c
+ *
+ *  Slab allocator single versus bulk benchmark
+ *
+ *  For a few object sizes and batch lengths, allocates a batch of objects
+ *  and frees it again, first one kmem_cache_alloc()/kmem_cache_free() call
+ *  per object and then with kmem_cache_alloc_bulk()/kmem_cache_free_bulk(),
+ *  and reports the cost per object.  Batches larger than a slab also make
+ *  the frees miss the cpu slab, which is where the SLUB magazine comes in.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/timex.h>
+
+#define BENCH_MAX_BATCH	512
+
+static unsigned int loops = 2000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Batches allocated and freed per measurement");
+
+static void *objs[BENCH_MAX_BATCH];
+
+struct bench_result {
+	u64		ns;
+	cycles_t	cycles;
+};
+
+static int bench_single(struct kmem_cache *s, unsigned int batch,
+			struct bench_result *r)
+{
+	cycles_t c0;
+	ktime_t t0;
+	unsigned int n, i;
+
+	t0 = ktime_get();
+	c0 = get_cycles();
+	for (n = 0; n < loops; n++) {
+		for (i = 0; i < batch; i++) {
+			objs[i] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[i]) {
+				while (i--)
+					kmem_cache_free(s, objs[i]);
+				return -ENOMEM;
+			}
+		}
+		for (i = 0; i < batch; i++)
+			kmem_cache_free(s, objs[i]);
+		if (!(n & 63))
+			cond_resched();
+	}
+	r->cycles = get_cycles() - c0;
+	r->ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	return 0;
+}
+
+static int bench_bulk(struct kmem_cache *s, unsigned int batch,
+		      struct bench_result *r)
+{
+	cycles_t c0;
+	ktime_t t0;
+	unsigned int n;
+
+	t0 = ktime_get();
+	c0 = get_cycles();
+	for (n = 0; n < loops; n++) {
+		if (!kmem_cache_alloc_bulk(s, GFP_KERNEL, batch, objs))
+			return -ENOMEM;
+		kmem_cache_free_bulk(s, batch, objs);
+		if (!(n & 63))
+			cond_resched();
+	}
+	r->cycles = get_cycles() - c0;
+	r->ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	return 0;
+}
+
+/* Per object cost, in hundredths */
+static unsigned long per_obj(u64 total, unsigned int batch)
+{
+	return (unsigned long)div64_u64(total * 100, (u64)loops * batch);
+}
+
+static int bench_size(size_t size)
+{
+	static const unsigned int batches[] = { 1, 16, 64, 256, 512 };
+	struct bench_result single, bulk;
+	struct kmem_cache *s;
+	int i, ret = 0;
+
+	s = kmem_cache_create("slub_bench", size, 0, 0, NULL);
+	if (!s)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(batches); i++) {
+		ret = bench_single(s, batches[i], &single);
+		if (!ret)
+			ret = bench_bulk(s, batches[i], &bulk);
+		if (ret) {
+			printk(KERN_ERR "slub_bench: %zu bytes x %u: "
+			       "allocation failed\n", size, batches[i]);
+			break;
+		}
+
+		printk(KERN_INFO "slub_bench: %5zu bytes x %3u: single "
+		       "%lu.%02lu ns %lu.%02lu cycles, bulk %lu.%02lu ns "
+		       "%lu.%02lu cycles per object\n", size, batches[i],
+		       per_obj(single.ns, batches[i]) / 100,
+		       per_obj(single.ns, batches[i]) % 100,
+		       per_obj(single.cycles, batches[i]) / 100,
+		       per_obj(single.cycles, batches[i]) % 100,
+		       per_obj(bulk.ns, batches[i]) / 100,
+		       per_obj(bulk.ns, batches[i]) % 100,
+		       per_obj(bulk.cycles, batches[i]) / 100,
+		       per_obj(bulk.cycles, batches[i]) % 100);
+	}
+
+	kmem_cache_destroy(s);
+	return ret;
+}
+
+static int __init slub_bench_init(void)
+{
+	static const size_t sizes[] = { 32, 256, 1024 };
+	int i, ret = 0;
+
+	if (!get_cycles())
+		printk(KERN_INFO "slub_bench: no cycle counter, "
+		       "cycle counts will read 0\n");
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && !ret; i++)
+		ret = bench_size(sizes[i]);
+
+	return ret;
+}
+
+static void __exit slub_bench_exit(void)
+{
+}
+
+module_init(slub_bench_init);
+module_exit(slub_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Slab allocator single versus bulk benchmark");
@@ -16,6 +16,7 @@
 #include <linux/highmem.h>
 #include <linux/pagevec.h>
 #include <linux/task_io_accounting_ops.h>
+#include <linux/ccache.h>
 #include <linux/buffer_head.h>	/* grr. try_to_release_page,
 				   do_invalidatepage */
 #include "internal.h"
@@ -168,8 +169,12 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	pgoff_t next;
 	int i;
 
+	/* includes the partial page, whose tail is about to be zeroed */
+	ccache_flush_range(mapping, lstart >> PAGE_CACHE_SHIFT,
+			   lend >> PAGE_CACHE_SHIFT);
+
 	if (mapping->nrpages == 0)
-		return;
+		goto out;
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
@@ -251,6 +256,10 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		}
 		pagevec_release(&pvec);
 	}
+out:
+	/* reclaim may have stored pages of the range while we walked it */
+	ccache_flush_range(mapping, lstart >> PAGE_CACHE_SHIFT,
+			   lend >> PAGE_CACHE_SHIFT);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
@@ -391,6 +400,9 @@ int invalidate_inode_pages2_range(struct address_space *mapping,
 	int did_range_unmap = 0;
 	int wrapped = 0;
 
+	/* direct I/O is about to change the blocks under the range */
+	ccache_flush_range(mapping, start, end);
+
 	pagevec_init(&pvec, 0);
 	next = start;
 	while (next <= end && !wrapped &&
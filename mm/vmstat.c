@@ -14,6 +14,7 @@
 #include <linux/module.h>
 #include <linux/cpu.h>
 #include <linux/vmstat.h>
+#include <linux/ccache.h>
 #include <linux/sched.h>
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
@@ -385,6 +386,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -653,6 +657,12 @@ static const char * const vmstat_text[] = {
 	"numa_other",
 #endif
 
+#ifdef CONFIG_COMPRESSED_PAGECACHE
+	"ccache_pages",
+	"ccache_pool_bytes",
+	"ccache_compr_percent",
+#endif
+
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	"pgpgin",
 	"pgpgout",
@@ -696,6 +706,16 @@ static const char * const vmstat_text[] = {
 	"unevictable_pgs_cleared",
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
+	"ra_hit",
+	"ra_miss",
+	"ra_wasted",
+#ifdef CONFIG_COMPRESSED_PAGECACHE
+	"ccache_store",
+	"ccache_reject",
+	"ccache_evict",
+	"ccache_hit",
+	"ccache_miss",
+#endif
 #endif
 };
 
@@ -804,19 +824,21 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 		return NULL;
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
-	v = kmalloc(NR_VM_ZONE_STAT_ITEMS * sizeof(unsigned long)
-			+ sizeof(struct vm_event_state), GFP_KERNEL);
-#else
-	v = kmalloc(NR_VM_ZONE_STAT_ITEMS * sizeof(unsigned long),
+	v = kmalloc((NR_VM_ZONE_STAT_ITEMS + NR_CCACHE_STAT_ITEMS) *
+			sizeof(unsigned long) + sizeof(struct vm_event_state),
 			GFP_KERNEL);
+#else
+	v = kmalloc((NR_VM_ZONE_STAT_ITEMS + NR_CCACHE_STAT_ITEMS) *
+			sizeof(unsigned long), GFP_KERNEL);
 #endif
 	m->private = v;
 	if (!v)
 		return ERR_PTR(-ENOMEM);
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
 		v[i] = global_page_state(i);
+	ccache_stats(v + NR_VM_ZONE_STAT_ITEMS);
 #ifdef CONFIG_VM_EVENT_COUNTERS
-	e = v + NR_VM_ZONE_STAT_ITEMS;
+	e = v + NR_VM_ZONE_STAT_ITEMS + NR_CCACHE_STAT_ITEMS;
 	all_vm_events(e);
 	e[PGPGIN] /= 2;		/* sectors -> kbytes */
 	e[PGPGOUT] /= 2;
@@ -268,6 +268,158 @@ struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 }
 EXPORT_SYMBOL(__netdev_alloc_skb);
 
+#ifdef CONFIG_NET_SKB_RECYCLE
+static void skb_recycle_pool_put(struct skb_recycle_pool *pool)
+{
+	if (atomic_dec_and_test(&pool->refcnt)) {
+		skb_queue_purge(&pool->list);
+		kfree(pool);
+	}
+}
+
+/**
+ *	skb_recycle_pool_attach - give a device a receive buffer pool
+ *	@dev: network device
+ *	@skb_size: size of the receive buffers, as passed to netdev_alloc_skb
+ *	@depth: maximum number of free buffers kept in the pool
+ *
+ *	Buffers the driver gets from netdev_alloc_skb_recycle() are put
+ *	back in the pool when the stack frees them, as long as they are
+ *	still linear, unshared and at least @skb_size long, and handed out
+ *	again by the next allocation instead of going through the slab.
+ *	If the pool cannot be allocated the device runs without one.
+ */
+void skb_recycle_pool_attach(struct net_device *dev, unsigned int skb_size,
+			     unsigned int depth)
+{
+	struct skb_recycle_pool *pool;
+
+	if (dev->skb_pool)
+		return;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return;
+
+	skb_queue_head_init(&pool->list);
+	pool->skb_size = skb_size;
+	pool->depth = depth;
+	atomic_set(&pool->refcnt, 1);
+
+	/* /proc/net/skb_recycle reads dev->skb_pool under dev_base_lock */
+	write_lock_bh(&dev_base_lock);
+	dev->skb_pool = pool;
+	write_unlock_bh(&dev_base_lock);
+}
+EXPORT_SYMBOL(skb_recycle_pool_attach);
+
+/**
+ *	skb_recycle_pool_detach - drop a device's receive buffer pool
+ *	@dev: network device
+ *
+ *	Frees the buffers held in the pool.  Buffers still in flight are
+ *	freed normally when the stack is done with them; the pool itself
+ *	goes away with the last of them.  The driver must have stopped
+ *	calling netdev_alloc_skb_recycle().  Must be called from process
+ *	context.
+ */
+void skb_recycle_pool_detach(struct net_device *dev)
+{
+	struct skb_recycle_pool *pool = dev->skb_pool;
+	unsigned long flags;
+
+	if (!pool)
+		return;
+
+	/* no /proc/net/skb_recycle reader can still be looking at it */
+	write_lock_bh(&dev_base_lock);
+	dev->skb_pool = NULL;
+	write_unlock_bh(&dev_base_lock);
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	pool->depth = 0;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	skb_queue_purge(&pool->list);
+	skb_recycle_pool_put(pool);
+}
+EXPORT_SYMBOL(skb_recycle_pool_detach);
+
+/**
+ *	netdev_alloc_skb_recycle - allocate a receive skb from the device pool
+ *	@dev: network device to receive on
+ *	@length: length to allocate
+ *
+ *	Like netdev_alloc_skb(), but takes the skb from the pool set up by
+ *	skb_recycle_pool_attach() when there is one, and marks it to go back
+ *	there when it is freed.  Requests larger than the pool's buffer size
+ *	fall back to netdev_alloc_skb().  Can be called from an interrupt.
+ */
+struct sk_buff *netdev_alloc_skb_recycle(struct net_device *dev,
+					 unsigned int length)
+{
+	struct skb_recycle_pool *pool = dev->skb_pool;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	if (!pool || length > pool->skb_size)
+		return netdev_alloc_skb(dev, length);
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	skb = __skb_dequeue(&pool->list);
+	if (skb)
+		pool->hits++;
+	else
+		pool->misses++;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	if (skb)
+		skb->dev = dev;
+	else {
+		skb = netdev_alloc_skb(dev, pool->skb_size);
+		if (unlikely(!skb))
+			return NULL;
+	}
+
+	atomic_inc(&pool->refcnt);
+	skb->recycle_pool = pool;
+	return skb;
+}
+EXPORT_SYMBOL(netdev_alloc_skb_recycle);
+
+/*
+ * Called from __kfree_skb() for skbs that came from a device pool.
+ * Returns 1 if the skb went back to the pool.
+ */
+static int skb_recycle(struct sk_buff *skb)
+{
+	struct skb_recycle_pool *pool = skb->recycle_pool;
+	unsigned long flags;
+	int ret = 0;
+
+	skb->recycle_pool = NULL;
+
+	if (skb_queue_len(&pool->list) < pool->depth &&
+	    skb_recycle_check(skb, pool->skb_size)) {
+		spin_lock_irqsave(&pool->list.lock, flags);
+		if (skb_queue_len(&pool->list) < pool->depth) {
+			__skb_queue_head(&pool->list, skb);
+			pool->recycled++;
+			ret = 1;
+		} else
+			pool->rejected++;
+		spin_unlock_irqrestore(&pool->list.lock, flags);
+	} else {
+		spin_lock_irqsave(&pool->list.lock, flags);
+		pool->rejected++;
+		spin_unlock_irqrestore(&pool->list.lock, flags);
+	}
+
+	skb_recycle_pool_put(pool);
+	return ret;
+}
+#endif /* CONFIG_NET_SKB_RECYCLE */
+
 struct page *__netdev_alloc_page(struct net_device *dev, gfp_t gfp_mask)
 {
 	int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
@@ -390,6 +542,12 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 static void skb_release_head_state(struct sk_buff *skb)
 {
+#ifdef CONFIG_NET_SKB_RECYCLE
+	if (skb->recycle_pool) {
+		skb_recycle_pool_put(skb->recycle_pool);
+		skb->recycle_pool = NULL;
+	}
+#endif
 	skb_dst_drop(skb);
 #ifdef CONFIG_XFRM
 	secpath_put(skb->sp);
@@ -432,11 +590,58 @@ static void skb_release_all(struct sk_buff *skb)
 
 void __kfree_skb(struct sk_buff *skb)
 {
+#ifdef CONFIG_NET_SKB_RECYCLE
+	if (skb->recycle_pool && skb_recycle(skb))
+		return;
+#endif
 	skb_release_all(skb);
 	kfree_skbmem(skb);
 }
 EXPORT_SYMBOL(__kfree_skb);
 
+#define SKB_FREE_BATCH	16
+
+/**
+ *	__kfree_skb_list - free a chain of unreferenced buffers
+ *	@skb: first buffer, the rest linked through ->next
+ *
+ *	Like calling __kfree_skb() on each buffer, but plain (non fast-clone)
+ *	heads go back to skbuff_head_cache in batches.  Used for the
+ *	transmit completion queue, where freed skbs pile up.
+ */
+void __kfree_skb_list(struct sk_buff *skb)
+{
+	void *heads[SKB_FREE_BATCH];
+	unsigned int n = 0;
+
+	while (skb) {
+		struct sk_buff *next = skb->next;
+
+		WARN_ON(atomic_read(&skb->users));
+#ifdef CONFIG_NET_SKB_RECYCLE
+		if (skb->recycle_pool && skb_recycle(skb)) {
+			skb = next;
+			continue;
+		}
+#endif
+		skb_release_all(skb);
+		if (skb->fclone == SKB_FCLONE_UNAVAILABLE) {
+			heads[n++] = skb;
+			if (n == SKB_FREE_BATCH) {
+				kmem_cache_free_bulk(skbuff_head_cache, n,
+						     heads);
+				n = 0;
+			}
+		} else
+			kfree_skbmem(skb);
+		skb = next;
+	}
+
+	if (n)
+		kmem_cache_free_bulk(skbuff_head_cache, n, heads);
+}
+EXPORT_SYMBOL(__kfree_skb_list);
+
 /**
  *	kfree_skb - free an sk_buff
  *	@skb: buffer to free
@@ -547,6 +752,9 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->protocol		= old->protocol;
 	new->mark		= old->mark;
 	new->iif		= old->iif;
+#ifdef CONFIG_RPS
+	new->rxhash		= old->rxhash;
+#endif
 	__nf_copy(new, old);
 #if defined(CONFIG_NETFILTER_XT_TARGET_TRACE) || \
     defined(CONFIG_NETFILTER_XT_TARGET_TRACE_MODULE)
@@ -577,6 +785,9 @@ static struct sk_buff *__skb_clone(struct sk_buff *n, struct sk_buff *skb)
 	n->next = n->prev = NULL;
 	n->sk = NULL;
 	__copy_skb_header(n, skb);
+#ifdef CONFIG_NET_SKB_RECYCLE
+	n->recycle_pool = NULL;
+#endif
 
 	C(len);
 	C(data_len);
@@ -160,10 +160,18 @@ rpc_alloc_inode(struct super_block *sb)
 	return &rpci->vfs_inode;
 }
 
+static void rpc_i_callback(struct rcu_head *head)
+{
+	struct inode *inode = container_of(head, struct inode, i_rcu);
+
+	INIT_LIST_HEAD(&inode->i_dentry);
+	kmem_cache_free(rpc_inode_cachep, RPC_I(inode));
+}
+
 static void
 rpc_destroy_inode(struct inode *inode)
 {
-	kmem_cache_free(rpc_inode_cachep, RPC_I(inode));
+	call_rcu(&inode->i_rcu, rpc_i_callback);
 }
 
 static int
@@ -951,6 +959,7 @@ int register_rpc_pipefs(void)
 
 void unregister_rpc_pipefs(void)
 {
+	rcu_barrier();	/* wait for rpc_i_callback() */
 	kmem_cache_destroy(rpc_inode_cachep);
 	unregister_filesystem(&rpc_pipe_fs_type);
 }
@@ -45,6 +45,23 @@ static bool UseIram = 1;
 #else
 static bool UseIram;
 #endif
+static struct iram_client *imx_pcm_iram;
+
+/*
+ * The audio IRAM (SND_RAM_SIZE, reserved for the "audio" client by the
+ * platform code) is shared by the playback streams of every PCM: each one
+ * takes at most SND_RAM_SIZE / iram_streams, and a stream that finds no
+ * room left gets its buffer in external RAM instead.
+ */
+static unsigned int iram_streams = 2;
+module_param(iram_streams, uint, 0444);
+MODULE_PARM_DESC(iram_streams, "playback streams sharing the audio IRAM");
+
+/* buffers in IRAM are tagged through their private_data */
+static inline int imx_pcm_buf_in_iram(struct snd_dma_buffer *buf)
+{
+	return buf->private_data == &imx_pcm_iram;
+}
 
 /* debug */
 #define IMX_PCM_DEBUG 0
@@ -98,7 +115,7 @@ static int imx_iram_audio_playback_mmap(struct snd_pcm_substream *substream,
 	phys = buf->addr + off;
 	size = area->vm_end - area->vm_start;
 
-	if (off + size > SND_RAM_SIZE)
+	if (off + size > buf->bytes)
 		return -EINVAL;
 
 	area->vm_page_prot = pgprot_writecombine(area->vm_page_prot);
@@ -488,6 +505,15 @@ static int imx_pcm_open(struct snd_pcm_substream *substream)
 	if (ret < 0)
 		return ret;
 
+	/* an IRAM buffer is only this stream's share of the audio IRAM */
+	if (imx_pcm_buf_in_iram(&substream->dma_buffer)) {
+		ret = snd_pcm_hw_constraint_minmax(runtime,
+					SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
+					0, substream->dma_buffer.bytes);
+		if (ret < 0)
+			return ret;
+	}
+
 	prtd = kzalloc(sizeof(struct mxc_runtime_data), GFP_KERNEL);
 	if (prtd == NULL)
 		return -ENOMEM;
@@ -509,25 +535,15 @@ static int
 imx_pcm_mmap(struct snd_pcm_substream *substream, struct vm_area_struct *vma)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_device *socdev = rtd->socdev;
-	struct snd_soc_dai *cpu_dai = socdev->card->dai_link->cpu_dai;
-	struct mxc_audio_platform_data *dev_data;
-	int ext_ram = 0;
 	int ret = 0;
 
 	dbg("+imx_pcm_mmap:"
-	    "UseIram=%d dma_addr=%x dma_area=%x dma_bytes=%d\n",
-	    UseIram, (unsigned int)runtime->dma_addr,
+	    "iram=%d dma_addr=%x dma_area=%x dma_bytes=%d\n",
+	    imx_pcm_buf_in_iram(&substream->dma_buffer),
+	    (unsigned int)runtime->dma_addr,
 	    runtime->dma_area, runtime->dma_bytes);
 
-	if (cpu_dai->dev && cpu_dai->dev->platform_data) {
-		dev_data = cpu_dai->dev->platform_data;
-		ext_ram = dev_data->ext_ram;
-	}
-
-	if ((substream->stream == SNDRV_PCM_STREAM_CAPTURE)
-	    || ext_ram || !UseIram) {
+	if (!imx_pcm_buf_in_iram(&substream->dma_buffer)) {
 		ret =
 		    dma_mmap_writecombine(substream->pcm->card->
 					  dev, vma,
@@ -562,6 +578,7 @@ static int imx_pcm_preallocate_dma_buffer(struct snd_pcm *pcm, int stream)
 	unsigned long buf_paddr;
 	int ext_ram = 0;
 	size_t size = imx_pcm_hardware.buffer_bytes_max;
+	size_t share;
 
 	if (cpu_dai->dev && cpu_dai->dev->platform_data) {
 		dev_data = cpu_dai->dev->platform_data;
@@ -572,29 +589,40 @@ static int imx_pcm_preallocate_dma_buffer(struct snd_pcm *pcm, int stream)
 	buf->dev.dev = pcm->card->dev;
 	buf->private_data = NULL;
 
-	if ((stream == SNDRV_PCM_STREAM_CAPTURE) || ext_ram || !UseIram)
+	/*
+	 * This stream's share of the audio IRAM, in whole pages for mmap.
+	 * A share too small for two of the smallest periods is not used.
+	 */
+	share = (SND_RAM_SIZE / max(iram_streams, 1U)) & PAGE_MASK;
+	if (share > size)
+		share = size;
+
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK && !ext_ram && UseIram &&
+	    share >= imx_pcm_hardware.period_bytes_min *
+		     imx_pcm_hardware.periods_min) {
+		imx_pcm_iram = iram_client_register("audio", 0, 0);
+		buf->area = iram_client_alloc(imx_pcm_iram, share, 0,
+					      &buf_paddr);
+		if (buf->area) {
+			buf->addr = buf_paddr;
+			buf->private_data = &imx_pcm_iram;
+			size = share;
+		} else
+			pr_warning("imx-pcm: no IRAM left for %s, "
+				   "falling back to external ram.\n",
+				   pcm->name);
+	}
+
+	if (!buf->area)
 		buf->area =
 		    dma_alloc_writecombine(pcm->card->dev, size,
 					   &buf->addr, GFP_KERNEL);
-	else {
-		buf->area = iram_alloc(size, &buf_paddr);
-		buf->addr = buf_paddr;
-
-		if (!buf->area) {
-			pr_warning("imx-pcm: Falling back to external ram.\n");
-			UseIram = 0;
-			buf->area =
-			    dma_alloc_writecombine(pcm->card->dev, size,
-						   &buf->addr, GFP_KERNEL);
-		}
-	}
-
 	if (!buf->area)
 		return -ENOMEM;
 	buf->bytes = size;
 	printk(KERN_INFO "DMA Sound Buffers Allocated:"
-	       "UseIram=%d buf->addr=%x buf->area=%p size=%d\n",
-	       UseIram, buf->addr, buf->area, size);
+	       "iram=%d buf->addr=%x buf->area=%p size=%d\n",
+	       imx_pcm_buf_in_iram(buf), buf->addr, buf->area, size);
 	return 0;
 }
 
@@ -602,18 +630,8 @@ static void imx_pcm_free_dma_buffers(struct snd_pcm *pcm)
 {
 	struct snd_pcm_substream *substream;
 	struct snd_dma_buffer *buf;
-	struct snd_soc_pcm_runtime *rtd = pcm->private_data;
-	struct snd_soc_device *socdev = rtd->socdev;
-	struct snd_soc_dai *cpu_dai = socdev->card->dai_link->cpu_dai;
-	struct mxc_audio_platform_data *dev_data;
-	int ext_ram = 0;
 	int stream;
 
-	if (cpu_dai->dev && cpu_dai->dev->platform_data) {
-		dev_data = cpu_dai->dev->platform_data;
-		ext_ram = dev_data->ext_ram;
-	}
-
 	for (stream = 0; stream < 2; stream++) {
 		substream = pcm->streams[stream].substream;
 		if (!substream)
@@ -623,14 +641,13 @@ static void imx_pcm_free_dma_buffers(struct snd_pcm *pcm)
 		if (!buf->area)
 			continue;
 
-		if ((stream == SNDRV_PCM_STREAM_CAPTURE)
-		    || ext_ram || !UseIram)
+		if (imx_pcm_buf_in_iram(buf))
+			iram_client_free(imx_pcm_iram, buf->addr, buf->bytes);
+		else
 			dma_free_writecombine(pcm->card->dev,
 					      buf->bytes, buf->area, buf->addr);
-		else {
-			iram_free(buf->addr, imx_pcm_hardware.buffer_bytes_max);
-		}
 		buf->area = NULL;
+		buf->private_data = NULL;
 	}
 }
 
@@ -0,0 +1,276 @@
+/*
+ * loop-bench - compare the loop driver's page-cache and direct map paths
+ *
+ * Creates a fully allocated file, binds it to a free loop device and runs
+ * the same tests on it twice: first through the backing file's page cache
+ * (the default), then with LO_FLAGS_DIRECT_MAP set, where bios are remapped
+ * through ->bmap() straight onto the filesystem's block device.
+ *
+ * The loop device is opened with O_DIRECT so that its own page cache stays
+ * out of the picture, and the backing file's cache is dropped before each
+ * test.  For each test the throughput and the growth of "Cached" in
+ * /proc/meminfo are printed; the latter shows the second copy of the data
+ * that the page-cache path keeps in the backing file.
+ *
+ * Usage: loop-bench [-s size_mb] [-b block_kb] [-n random_ios] [-d dir]
+ *	-s	size of the backing file in MB (default 256)
+ *	-b	block size for the sequential tests in KiB (default 128)
+ *	-n	number of random 4KiB reads (default 4096)
+ *	-d	directory to create the backing file in (default: current)
+ *
+ * Needs root, and a filesystem that implements ->bmap (ext2/3/4, xfs...).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <linux/loop.h>
+
+#ifndef LO_FLAGS_DIRECT_MAP
+#define LO_FLAGS_DIRECT_MAP	8
+#endif
+
+#define MAX_LOOP	8
+#define RANDOM_BS	4096
+
+static unsigned long size_mb = 256;
+static unsigned long block_kb = 128;
+static unsigned long random_ios = 4096;
+static char backing[PATH_MAX];
+static char loopdev[32];
+static char *buf;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Returns "Cached:" from /proc/meminfo in KiB */
+static long cached_kb(void)
+{
+	char line[128];
+	long kb = 0;
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "Cached: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb;
+}
+
+static void make_backing(const char *dir)
+{
+	unsigned long i, nr = size_mb * 1024 / block_kb;
+	int fd;
+
+	snprintf(backing, sizeof(backing), "%s/loop-bench.XXXXXX",
+		 dir ? dir : ".");
+	fd = mkstemp(backing);
+	if (fd < 0)
+		die(backing);
+
+	/* written out in full: direct map refuses files with holes */
+	memset(buf, 0x5a, block_kb * 1024);
+	for (i = 0; i < nr; i++)
+		if (write(fd, buf, block_kb * 1024) != block_kb * 1024)
+			die("write");
+	if (fsync(fd))
+		die("fsync");
+	close(fd);
+}
+
+/* Binds the backing file to the first free loop device */
+static int bind_loop(void)
+{
+	struct loop_info64 info;
+	int i, fd, file;
+
+	file = open(backing, O_RDWR);
+	if (file < 0)
+		die(backing);
+	for (i = 0; i < MAX_LOOP; i++) {
+		snprintf(loopdev, sizeof(loopdev), "/dev/loop%d", i);
+		fd = open(loopdev, O_RDWR);
+		if (fd < 0)
+			continue;
+		if (ioctl(fd, LOOP_GET_STATUS64, &info) < 0 &&
+		    errno == ENXIO && !ioctl(fd, LOOP_SET_FD, file)) {
+			close(file);
+			return fd;
+		}
+		close(fd);
+	}
+	fprintf(stderr, "no free loop device\n");
+	exit(1);
+}
+
+static void set_direct_map(int ctl, int on)
+{
+	struct loop_info64 info;
+
+	if (ioctl(ctl, LOOP_GET_STATUS64, &info))
+		die("LOOP_GET_STATUS64");
+	if (on)
+		info.lo_flags |= LO_FLAGS_DIRECT_MAP;
+	else
+		info.lo_flags &= ~LO_FLAGS_DIRECT_MAP;
+	if (ioctl(ctl, LOOP_SET_STATUS64, &info))
+		die("LOOP_SET_STATUS64 (direct map)");
+}
+
+static void drop_backing_cache(void)
+{
+	int fd = open(backing, O_RDONLY);
+
+	if (fd < 0)
+		die(backing);
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+enum { SEQ_WRITE, SEQ_READ, RANDOM_READ, NR_TESTS };
+
+static const char *test_name[NR_TESTS] = {
+	"seq write", "seq read", "rand read",
+};
+
+static void run_test(int test, double *mbs, long *cached)
+{
+	unsigned long i, nr, bs;
+	unsigned long nr_blocks = size_mb * 1024 * 1024 / RANDOM_BS;
+	double start, elapsed;
+	long before;
+	int fd;
+
+	drop_backing_cache();
+	fd = open(loopdev, (test == SEQ_WRITE ? O_WRONLY : O_RDONLY) |
+		  O_DIRECT);
+	if (fd < 0)
+		die(loopdev);
+
+	if (test == RANDOM_READ) {
+		bs = RANDOM_BS;
+		nr = random_ios;
+	} else {
+		bs = block_kb * 1024;
+		nr = size_mb * 1024 / block_kb;
+	}
+
+	srandom(1);
+	before = cached_kb();
+	start = now();
+	for (i = 0; i < nr; i++) {
+		ssize_t ret;
+
+		switch (test) {
+		case SEQ_WRITE:
+			ret = write(fd, buf, bs);
+			break;
+		case SEQ_READ:
+			ret = read(fd, buf, bs);
+			break;
+		default:
+			ret = pread(fd, buf, bs,
+				    (off_t)(random() % nr_blocks) * bs);
+		}
+		if (ret != (ssize_t)bs)
+			die(test_name[test]);
+	}
+	if (test == SEQ_WRITE && fdatasync(fd))
+		die("fdatasync");
+	elapsed = now() - start;
+	*cached = cached_kb() - before;
+	close(fd);
+
+	*mbs = (double)nr * bs / (1024 * 1024) / elapsed;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s size_mb] [-b block_kb] "
+		"[-n random_ios] [-d dir]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	double mbs[2][NR_TESTS];
+	long cached[2][NR_TESTS];
+	const char *dir = NULL;
+	int opt, ctl, mode, test;
+
+	while ((opt = getopt(argc, argv, "s:b:n:d:")) != -1) {
+		switch (opt) {
+		case 's':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			block_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			random_ios = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!size_mb || !block_kb || (size_mb * 1024) % block_kb ||
+	    block_kb % 4)
+		usage(argv[0]);
+
+	if (posix_memalign((void **)&buf, 4096, block_kb * 1024))
+		die("posix_memalign");
+
+	make_backing(dir);
+	ctl = bind_loop();
+
+	/* mode 0: backing file page cache, mode 1: LO_FLAGS_DIRECT_MAP */
+	for (mode = 0; mode < 2; mode++) {
+		if (mode)
+			set_direct_map(ctl, 1);
+		for (test = 0; test < NR_TESTS; test++)
+			run_test(test, &mbs[mode][test], &cached[mode][test]);
+	}
+	set_direct_map(ctl, 0);
+
+	printf("%s on %s, %lu MB, %lu KiB sequential, %lu random 4KiB reads\n",
+	       loopdev, backing, size_mb, block_kb, random_ios);
+	printf("%-10s %15s %15s %14s %14s\n", "test", "page cache",
+	       "direct map", "cached (pc)", "cached (dm)");
+	for (test = 0; test < NR_TESTS; test++)
+		printf("%-10s %10.1f MB/s %10.1f MB/s %10ld KiB %10ld KiB\n",
+		       test_name[test], mbs[0][test], mbs[1][test],
+		       cached[0][test], cached[1][test]);
+
+	ioctl(ctl, LOOP_CLR_FD, 0);
+	close(ctl);
+	unlink(backing);
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * mmsgbench - UDP packet rate with and without recvmmsg()/sendmmsg()
+ *
+ * Sends and receives datagrams over the loopback interface, first one
+ * system call per packet (sendmsg/recvmsg) and then in batches
+ * (sendmmsg/recvmmsg), and prints the packet rate of each.
+ *
+ * The send test blasts packets at a socket that is never read, so only
+ * the transmit path is timed.  The receive test queues a round of packets
+ * on a socket with a large receive buffer and then times draining it, so
+ * only the receive path is timed.
+ *
+ * Usage: mmsgbench [-n packets] [-s size] [-b batch] [-p port]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifndef __NR_recvmmsg
+# if defined(__arm__) && defined(__ARM_EABI__)
+#  define __NR_recvmmsg		365
+#  define __NR_sendmmsg		374
+# elif defined(__arm__)
+#  define __NR_recvmmsg		(0x900000 + 365)
+#  define __NR_sendmmsg		(0x900000 + 374)
+# else
+#  error "unknown recvmmsg/sendmmsg syscall numbers"
+# endif
+#endif
+
+#ifndef MSG_WAITFORONE
+#define MSG_WAITFORONE	0x10000
+#endif
+
+/* same layout as the kernel's struct mmsghdr */
+struct bench_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+
+#define MAX_BATCH	1024
+#define ROUND		256	/* packets queued per receive round */
+
+static int npackets = 200000;
+static int size = 172;		/* G.711 20ms RTP payload plus header */
+static int batch = 32;
+static int port = 34567;
+
+static char *bufs;
+static struct iovec iov[MAX_BATCH];
+static struct bench_mmsghdr msgs[MAX_BATCH];
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int udp_socket(int bind_port, int rcvbuf)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	if (rcvbuf)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(bind_port);
+	if (bind_port && bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("bind");
+		exit(1);
+	}
+	return fd;
+}
+
+static void connect_to(int fd, int to_port)
+{
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(to_port);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("connect");
+		exit(1);
+	}
+}
+
+static void setup_msgs(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_BATCH; i++) {
+		iov[i].iov_base = bufs + i * size;
+		iov[i].iov_len = size;
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/* Send @n packets, one call per packet or @b per call; returns calls made */
+static long send_packets(int fd, int n, int b)
+{
+	long calls = 0;
+	int ret;
+
+	while (n > 0) {
+		if (b == 1) {
+			ret = sendmsg(fd, &msgs[0].msg_hdr, 0);
+			if (ret > 0)
+				ret = 1;
+		} else {
+			ret = syscall(__NR_sendmmsg, fd, msgs,
+				      n < b ? n : b, 0);
+		}
+		calls++;
+		if (ret < 0) {
+			if (errno == ENOBUFS || errno == ECONNREFUSED)
+				continue;
+			perror("send");
+			exit(1);
+		}
+		n -= ret;
+	}
+	return calls;
+}
+
+static int recv_packets(int fd, int n, int b)
+{
+	struct timespec ts = { 1, 0 };
+	int got = 0, ret;
+
+	while (got < n) {
+		if (b == 1) {
+			ret = recvmsg(fd, &msgs[0].msg_hdr, 0);
+			if (ret >= 0)
+				ret = 1;
+		} else {
+			ret = syscall(__NR_recvmmsg, fd, msgs,
+				      n - got < b ? n - got : b,
+				      MSG_WAITFORONE, &ts);
+		}
+		if (ret < 0) {
+			perror("recv");
+			exit(1);
+		}
+		got += ret;
+	}
+	return got;
+}
+
+static void bench_send(int b)
+{
+	int sink = udp_socket(port, 0);
+	int fd = udp_socket(0, 0);
+	double t;
+	long calls;
+
+	connect_to(fd, port);
+
+	t = now();
+	calls = send_packets(fd, npackets, b);
+	t = now() - t;
+
+	printf("send %-10s %9.0f pkt/s  %6.2f us/pkt  %ld calls\n",
+	       b == 1 ? "sendmsg" : "sendmmsg", npackets / t,
+	       t * 1e6 / npackets, calls);
+	close(fd);
+	close(sink);
+}
+
+static void bench_recv(int b)
+{
+	int rfd = udp_socket(port, 4 << 20);
+	int sfd = udp_socket(0, 0);
+	double t = 0, start;
+	int done = 0;
+
+	connect_to(sfd, port);
+
+	while (done < npackets) {
+		int n = npackets - done < ROUND ? npackets - done : ROUND;
+
+		send_packets(sfd, n, batch);
+		start = now();
+		recv_packets(rfd, n, b);
+		t += now() - start;
+		done += n;
+	}
+
+	printf("recv %-10s %9.0f pkt/s  %6.2f us/pkt\n",
+	       b == 1 ? "recvmsg" : "recvmmsg", npackets / t,
+	       t * 1e6 / npackets);
+	close(sfd);
+	close(rfd);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n packets] [-s size] [-b batch] "
+		"[-p port]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:b:p:")) != -1) {
+		switch (c) {
+		case 'n':
+			npackets = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (npackets <= 0 || size <= 0 || size > 65507 ||
+	    batch < 2 || batch > MAX_BATCH)
+		usage(argv[0]);
+
+	bufs = calloc(MAX_BATCH, size);
+	if (!bufs) {
+		perror("calloc");
+		return 1;
+	}
+	setup_msgs();
+
+	printf("%d packets of %d bytes, batches of %d\n",
+	       npackets, size, batch);
+	bench_send(1);
+	bench_send(batch);
+	bench_recv(1);
+	bench_recv(batch);
+	return 0;
+}
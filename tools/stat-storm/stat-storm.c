@@ -0,0 +1,274 @@
+/*
+ * stat-storm - measure how path lookup scales across CPUs
+ *
+ * Runs 1, 2, ... N threads, each pinned to its own CPU, that stat() the
+ * same set of paths in a loop for a fixed time, and prints the aggregate
+ * rate for each thread count.  This is roughly what make and git status
+ * do to the dcache.  With perfect scaling "speedup" equals "threads".
+ *
+ * Without path arguments a small tree is created in the current directory
+ * (or the one given with -d): files at depth 1..8 plus a name that does
+ * not exist, so both positive and negative lookups are covered.  The
+ * paths are relative, so the walk never crosses a mountpoint; /tmp is
+ * usually a tmpfs mount and would force every RCU walk to fall back.
+ *
+ * If /proc/sys/fs/rcu-walk-stat exists, the share of lookups that fell
+ * back from RCU walk to the locked walk is printed for each run.
+ *
+ * Usage: stat-storm [-t seconds] [-j threads] [-d dir] [-l] [path...]
+ *	-t	seconds per run (default 2)
+ *	-j	maximum number of threads (default: online CPUs)
+ *	-d	directory to create the tree in (default: current directory)
+ *	-l	use lstat() instead of stat()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define _GNU_SOURCE
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define TREE_DEPTH	8
+#define RCU_WALK_STAT	"/proc/sys/fs/rcu-walk-stat"
+
+static char **paths;
+static int nr_paths;
+static int use_lstat;
+static volatile int running;
+static volatile int go;
+
+struct worker {
+	pthread_t thread;
+	int cpu;
+	unsigned long ops;
+};
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long ops = 0;
+	struct stat st;
+	cpu_set_t set;
+	int i;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+
+	while (!go)
+		;
+	while (running) {
+		for (i = 0; i < nr_paths; i++) {
+			if (use_lstat)
+				lstat(paths[i], &st);
+			else
+				stat(paths[i], &st);
+		}
+		ops += nr_paths;
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Returns 0 and the walk/fallback counts, or -1 if the kernel has none */
+static int read_walk_stat(unsigned long *walks, unsigned long *fallbacks)
+{
+	FILE *f = fopen(RCU_WALK_STAT, "r");
+	int ret = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%lu %lu", walks, fallbacks) == 2)
+		ret = 0;
+	fclose(f);
+	return ret;
+}
+
+static double run(int nr_threads, int seconds, double *fallback)
+{
+	struct worker *w;
+	unsigned long total = 0;
+	unsigned long walks[2], fallbacks[2];
+	double start, elapsed;
+	int i, have_stat;
+
+	w = calloc(nr_threads, sizeof(*w));
+	if (!w) {
+		perror("calloc");
+		exit(1);
+	}
+
+	have_stat = !read_walk_stat(&walks[0], &fallbacks[0]);
+	go = 0;
+	running = 1;
+	for (i = 0; i < nr_threads; i++) {
+		w[i].cpu = i;
+		if (pthread_create(&w[i].thread, NULL, worker_fn, &w[i])) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	start = now();
+	go = 1;
+	sleep(seconds);
+	running = 0;
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(w[i].thread, NULL);
+		total += w[i].ops;
+	}
+	elapsed = now() - start;
+
+	*fallback = -1;
+	if (have_stat && !read_walk_stat(&walks[1], &fallbacks[1]) &&
+	    walks[1] > walks[0])
+		*fallback = 100.0 * (fallbacks[1] - fallbacks[0]) /
+			    (walks[1] - walks[0]);
+
+	free(w);
+	return total / elapsed;
+}
+
+static char tree[] = "stat-storm.XXXXXX";
+
+static void make_tree(const char *dir)
+{
+	char path[PATH_MAX];
+	int depth, len;
+
+	if (dir && chdir(dir)) {
+		perror(dir);
+		exit(1);
+	}
+	if (!mkdtemp(tree)) {
+		perror("mkdtemp");
+		exit(1);
+	}
+
+	paths = calloc(TREE_DEPTH + 1, sizeof(*paths));
+	len = snprintf(path, sizeof(path), "%s", tree);
+	for (depth = 1; depth <= TREE_DEPTH; depth++) {
+		FILE *f;
+
+		len += snprintf(path + len, sizeof(path) - len, "/d%d", depth);
+		if (mkdir(path, 0755)) {
+			perror(path);
+			exit(1);
+		}
+		strcat(path, "/file");
+		f = fopen(path, "w");
+		if (!f) {
+			perror(path);
+			exit(1);
+		}
+		fclose(f);
+		paths[nr_paths++] = strdup(path);
+		path[len] = '\0';
+	}
+	strcat(path, "/missing");
+	paths[nr_paths++] = strdup(path);
+}
+
+static void remove_tree(void)
+{
+	char path[PATH_MAX];
+	int depth;
+
+	for (depth = TREE_DEPTH; depth >= 1; depth--) {
+		int i, len;
+
+		len = snprintf(path, sizeof(path), "%s", tree);
+		for (i = 1; i <= depth; i++)
+			len += snprintf(path + len, sizeof(path) - len,
+					"/d%d", i);
+		strcat(path, "/file");
+		unlink(path);
+		path[len] = '\0';
+		rmdir(path);
+	}
+	rmdir(tree);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t seconds] [-j threads] [-d dir] [-l] [path...]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int seconds = 2, max_threads, own_tree = 0;
+	const char *dir = NULL;
+	double base = 0;
+	int opt, n;
+
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, "t:j:d:l")) != -1) {
+		switch (opt) {
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'j':
+			max_threads = atoi(optarg);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'l':
+			use_lstat = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (seconds < 1 || max_threads < 1)
+		usage(argv[0]);
+
+	if (optind < argc) {
+		paths = argv + optind;
+		nr_paths = argc - optind;
+	} else {
+		make_tree(dir);
+		own_tree = 1;
+	}
+
+	printf("%d paths, %d s per run, %s()\n", nr_paths, seconds,
+	       use_lstat ? "lstat" : "stat");
+	printf("%8s %14s %14s %8s %10s\n", "threads", "lookups/s",
+	       "per thread", "speedup", "fallback");
+	for (n = 1; n <= max_threads; n++) {
+		double fallback;
+		double rate = run(n, seconds, &fallback);
+
+		if (n == 1)
+			base = rate;
+		printf("%8d %14.0f %14.0f %8.2f", n, rate, rate / n,
+		       rate / base);
+		if (fallback >= 0)
+			printf(" %9.1f%%\n", fallback);
+		else
+			printf(" %10s\n", "n/a");
+	}
+
+	if (own_tree)
+		remove_tree();
+	return 0;
+}